@@ -4,6 +4,8 @@
 
 #include "pch.h"
 #include "Game.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
 
 using namespace DirectX;
 
@@ -17,6 +19,90 @@ using namespace DirectX;
 namespace
 {
     std::unique_ptr<Game> g_game;
+
+    // Size of the synthetic OBJ the parse benchmark writes when it is given no file
+    constexpr size_t SYNTHETIC_OBJ_BYTES = size_t(1) << 30;
+    constexpr unsigned int PARSE_ITERATIONS = 3;
+
+    // Report to the console that started us, if any
+    void AttachReportConsole()
+    {
+        FILE* out = nullptr;
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+        {
+            freopen_s(&out, "CONOUT$", "w", stdout);
+            freopen_s(&out, "CONOUT$", "w", stderr);
+        }
+    }
+
+    // "-benchobj [file]" at the start of the command line, the file is empty when not given
+    bool ParseBenchmarkOption(LPCWSTR cmdLine, std::string& filepath)
+    {
+        const wchar_t option[] = L"-benchobj";
+        const size_t length = wcslen(option);
+        if (wcsncmp(cmdLine, option, length) != 0 || (cmdLine[length] != L'\0' && cmdLine[length] != L' '))
+            return false;
+
+        const wchar_t* file = cmdLine + length;
+        while (*file == L' ' || *file == L'"')
+            ++file;
+        std::wstring wfile(file);
+        while (!wfile.empty() && (wfile.back() == L' ' || wfile.back() == L'"'))
+            wfile.pop_back();
+
+        const int size = WideCharToMultiByte(CP_ACP, 0, wfile.c_str(), -1, nullptr, 0, nullptr, nullptr);
+        filepath.resize(size > 0 ? size - 1 : 0);
+        WideCharToMultiByte(CP_ACP, 0, wfile.c_str(), -1, &filepath[0], size, nullptr, nullptr);
+        return true;
+    }
+
+    // Parse throughput of one thread and its scaling up to the core count. Without a file
+    // a synthetic OBJ of about 1 GB is written to the temp directory once and reused.
+    int RunParseBenchmark(std::string filepath)
+    {
+        AttachReportConsole();
+        if (filepath.empty())
+        {
+            char tempPath[MAX_PATH] = {};
+            if (GetTempPathA(MAX_PATH, tempPath) == 0)
+                return 1;
+            filepath = std::string(tempPath) + "model-loading-synthetic.obj";
+
+            // the mapping has to be closed before the file can be rewritten
+            bool written = false;
+            {
+                const MappedFile existing(filepath);
+                written = existing.IsOpen() && existing.GetSize() >= SYNTHETIC_OBJ_BYTES;
+            }
+            if (!written)
+            {
+                fprintf(stdout, "writing %s\n", filepath.c_str());
+                fflush(stdout);
+                if (!WriteSyntheticObj(filepath, SYNTHETIC_OBJ_BYTES))
+                {
+                    fprintf(stderr, "ERROR: Failed to write %s\n", filepath.c_str());
+                    return 1;
+                }
+            }
+        }
+
+        const MappedFile file(filepath);
+        if (!file.IsOpen())
+        {
+            fprintf(stderr, "ERROR: Failed to open %s\n", filepath.c_str());
+            return 1;
+        }
+        fprintf(stdout, "%s, %.1f MB, %u iterations\n", filepath.c_str(), file.GetSize() / (1024.0 * 1024.0), PARSE_ITERATIONS);
+
+        const std::vector<ObjScalingResult> results = MeasureObjParseScaling(filepath, PARSE_ITERATIONS);
+        fprintf(stdout, "%8s %10s %8s\n", "threads", "MB/s", "speedup");
+        for (const ObjScalingResult& result : results)
+        {
+            fprintf(stdout, "%8u %10.1f %7.2fx\n", result.Threads, result.MegabytesPerSecond, result.Speedup);
+        }
+        fflush(stdout);
+        return !results.empty() && results.front().MegabytesPerSecond > 0.0 ? 0 : 1;
+    }
 }
 
 LPCWSTR g_szAppName = L"model-loading";
@@ -35,7 +121,6 @@ extern "C"
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
     if (!XMVerifyCPUSupport())
         return 1;
@@ -44,6 +129,16 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     if (FAILED(hr))
         return 1;
 
+    // "-benchobj [file]" measures OBJ parse throughput and its scaling with the core
+    // count instead of running the game
+    std::string benchmarkFile;
+    if (ParseBenchmarkOption(lpCmdLine, benchmarkFile))
+    {
+        const int result = RunParseBenchmark(benchmarkFile);
+        CoUninitialize();
+        return result;
+    }
+
     g_game = std::make_unique<Game>();
 
     // Register class and create window
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#include <fstream>
+
+MappedFile::MappedFile(const std::string& filepath)
+{
+	m_file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size = {};
+		if (GetFileSizeEx(m_file, &size) && size.QuadPart > 0)
+		{
+			// NOTE: CreateFileMapping fails for empty files, they take the fallback path
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping)
+			{
+				m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+				if (m_data)
+				{
+					m_size = static_cast<size_t>(size.QuadPart);
+					m_isOpen = true;
+					return;
+				}
+			}
+		}
+		Close();
+	}
+
+	// Fallback: read the whole file at once
+	std::ifstream in(filepath, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!in)
+	{
+		return;
+	}
+
+	const std::streamoff len = in.tellg();
+	in.seekg(0, std::ios::beg);
+	m_buffer.resize(static_cast<size_t>(len));
+	if (len > 0 && !in.read(m_buffer.data(), len))
+	{
+		m_buffer.clear();
+		return;
+	}
+
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+	m_isOpen = true;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept:
+	m_file(other.m_file),
+	m_mapping(other.m_mapping),
+	m_data(other.m_data),
+	m_size(other.m_size),
+	m_isOpen(other.m_isOpen),
+	m_buffer(std::move(other.m_buffer))
+{
+	if (!m_mapping)
+	{
+		m_data = m_buffer.data();
+	}
+	other.m_file = INVALID_HANDLE_VALUE;
+	other.m_mapping = nullptr;
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_isOpen = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_file = other.m_file;
+		m_mapping = other.m_mapping;
+		m_size = other.m_size;
+		m_isOpen = other.m_isOpen;
+		m_buffer = std::move(other.m_buffer);
+		m_data = m_mapping ? other.m_data : m_buffer.data();
+
+		other.m_file = INVALID_HANDLE_VALUE;
+		other.m_mapping = nullptr;
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_isOpen = false;
+	}
+	return *this;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_isOpen;
+}
+
+const char* MappedFile::GetData() const
+{
+	return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
+
+void MappedFile::Close()
+{
+	if (m_mapping)
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = nullptr;
+	m_data = nullptr;
+	m_size = 0;
+	m_isOpen = false;
+	m_buffer.clear();
+}
@@ -1,80 +1,55 @@
 #include "pch.h"
 #include "Model.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
 
-#include <fstream>
 #include <string>
-#include <iostream>
-#include <sstream>
 
 Model::Model()
 {
 }
 
-Model::Model(const std::vector<Position>& positions, const std::vector<Face>& faces):
-	m_positions(positions),
-	m_faces(faces)
+Model::Model(std::vector<Position>&& positions, std::vector<Face>&& faces):
+	m_positions(std::move(positions)),
+	m_faces(std::move(faces))
 {
 }
 
-std::unique_ptr<Model> ParseObjectFile(std::fstream& f)
+std::unique_ptr<Model> ParseObjectFile(const MappedFile& f)
 {
-	std::vector<Face> faces;
-	std::vector<Position> positions;
+	// below this size spinning up threads costs more than it saves
+	constexpr size_t PARALLEL_PARSE_THRESHOLD = 8 * 1024 * 1024;
 
-	char ch;
-	Face face;
-	Position p;
+	ObjData data;
+	if (f.GetSize() >= PARALLEL_PARSE_THRESHOLD)
+	{
+		ParseObjBufferParallel(f.GetData(), f.GetData() + f.GetSize(), data);
+	}
+	else
+	{
+		ParseObjBuffer(f.GetData(), f.GetData() + f.GetSize(), data);
+	}
 
-	std::string line;
-	std::istringstream in;
-	
-	while (std::getline(f, line))
+	// Only positions are used, so faces index the positions directly without tuple welding.
+	// Positions a rounding apart are still welded, normals and texture coordinates are left out.
+	std::vector<Face> faces;
+	faces.reserve(data.Corners.size() / 3);
+	for (size_t i = 0; i + 2 < data.Corners.size(); i += 3)
 	{
-		in.str(line);
-		if (line.find("v ") != std::string::npos)
-		{
-			in >> ch >> p.X >> p.Y >> p.Z;
-			assert(ch == 'v');
-			positions.push_back(p);
-		}
-		else if (line.find("f ") != std::string::npos)
-		{
-			// NOTE: Found by debugging. Indices in *.obj start from 1, not from 0!
-			if (line.find("/") != std::string::npos)
-			{
-				unsigned int v = 0;
-				unsigned int vt = 0;
-				unsigned int vn = 0;
-				in >> ch >> v >> ch >> vt >> ch >> vn;
-				face.X = v;
-				in >> v >> ch >> vt >> ch >> vn;
-				face.Y = v;
-				in >> v >> ch >> vt >> ch >> vn;
-				face.Z = v;
-				--face.X;
-				--face.Y;
-				--face.Z;
-				faces.push_back(face);
-			}
-			else
-			{
-				in >> ch >> face.X >> face.Y >> face.Z;
-				assert(ch == 'f');
-				--face.X;
-				--face.Y;
-				--face.Z;
-				faces.push_back(face);
-			}
-		}
-		in.clear();
+		faces.push_back({ data.Corners[i].Position, data.Corners[i + 1].Position, data.Corners[i + 2].Position });
 	}
+	std::vector<Normal> normals;
+	std::vector<TextCoord> textCoords;
+	WeldVertices(data.Positions, normals, textCoords, faces, GetDefaultWeldSettings(data.Positions));
 
-	return std::make_unique<Model>(positions, faces);
+	return std::make_unique<Model>(std::move(data.Positions), std::move(faces));
 }
 
 std::unique_ptr<Model> Model::LoadModel(const std::string& filepath)
 {
-	if (auto f = std::fstream(filepath))
+	const MappedFile f(filepath);
+	if (f.IsOpen())
 	{
 		return ParseObjectFile(f);
 	}
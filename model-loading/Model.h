@@ -17,11 +17,24 @@ struct Face
 	unsigned int Z;
 };
 
+struct Normal
+{
+	float X;
+	float Y;
+	float Z;
+};
+
+struct TextCoord
+{
+	float X;
+	float Y;
+};
+
 class Model
 {
 public:
 	Model();
-	Model(const std::vector<Position>& positions, const std::vector<Face>& faces);
+	Model(std::vector<Position>&& positions, std::vector<Face>&& faces);
 	static std::unique_ptr<Model> LoadModel(const std::string& filepath);
 
 	const std::vector<Position>& GetPositions() const;
@@ -0,0 +1,686 @@
+#include "pch.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	constexpr double s_pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	constexpr int MAX_POW10 = 22;
+	// uint64_t holds any 19 decimal digits without overflow
+	constexpr int MAX_MANTISSA_DIGITS = 19;
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return static_cast<unsigned char>(c - '0') < 10;
+	}
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const void* nl = memchr(p, '\n', end - p);
+		return nl ? static_cast<const char*>(nl) + 1 : end;
+	}
+
+	// Scans [+-]digits[.digits][(e|E)[+-]digits]
+	const char* ScanFloat(const char* p, const char* end, float& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			if (digits < MAX_MANTISSA_DIGITS)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				// leading zeros do not use up precision
+				digits += mantissa != 0;
+			}
+			else
+			{
+				++exponent;
+			}
+		}
+
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p)
+			{
+				if (digits < MAX_MANTISSA_DIGITS)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExp = *p == '-';
+				++p;
+			}
+			int e = 0;
+			for (; p < end && IsDigit(*p); ++p)
+			{
+				if (e < 1000)
+					e = e * 10 + (*p - '0');
+			}
+			exponent += negativeExp ? -e : e;
+		}
+
+		double value = static_cast<double>(mantissa);
+		if (exponent < 0)
+		{
+			for (; exponent < -MAX_POW10 && value != 0.0; exponent += MAX_POW10)
+				value /= s_pow10[MAX_POW10];
+			value /= s_pow10[exponent < -MAX_POW10 ? 0 : -exponent];
+		}
+		else
+		{
+			for (; exponent > MAX_POW10; exponent -= MAX_POW10)
+				value *= s_pow10[MAX_POW10];
+			value *= s_pow10[exponent];
+		}
+
+		out = static_cast<float>(negative ? -value : value);
+		return p;
+	}
+
+	const char* ScanInt(const char* p, const char* end, long long& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+		long long value = 0;
+		for (; p < end && IsDigit(*p); ++p)
+			value = value * 10 + (*p - '0');
+		out = negative ? -value : value;
+		return p;
+	}
+
+	// Scans one of v, v/vt, v//vn or v/vt/vn. Missing indices are set to 0.
+	const char* ScanIndexGroup(const char* p, const char* end, long long& v, long long& vt, long long& vn)
+	{
+		vt = 0;
+		vn = 0;
+		p = ScanInt(p, end, v);
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (p < end && *p != '/')
+				p = ScanInt(p, end, vt);
+			if (p < end && *p == '/')
+				p = ScanInt(p + 1, end, vn);
+		}
+		return p;
+	}
+
+	inline bool StartsIndex(char c)
+	{
+		return IsDigit(c) || c == '-' || c == '+';
+	}
+
+	enum ObjStream
+	{
+		STREAM_POSITION,
+		STREAM_TEXTCOORD,
+		STREAM_NORMAL,
+		STREAM_COUNT
+	};
+
+	inline unsigned int& CornerIndex(ObjCorner& corner, size_t stream)
+	{
+		return stream == STREAM_POSITION ? corner.Position : (stream == STREAM_TEXTCOORD ? corner.TextCoord : corner.Normal);
+	}
+
+	// A negative index that could not be resolved inside its chunk because the
+	// chunk does not know how many elements the chunks before it hold.
+	struct IndexFixup
+	{
+		size_t		Corner;			// corner within the chunk
+		size_t		Stream;			// ObjStream
+		long long	LocalIndex;		// zero based, relative to the start of the chunk
+	};
+
+	// Face corner as read from the file, before it knows its place in the output
+	struct PendingCorner
+	{
+		long long	Index[STREAM_COUNT];
+		bool		Relative[STREAM_COUNT];
+	};
+
+	struct ObjChunk
+	{
+		ObjData						Data;
+		std::vector<IndexFixup>		Fixups;
+		// scratch storage for the polygon being triangulated, reused between faces
+		std::vector<PendingCorner>	Polygon;
+	};
+
+	// NOTE: Indices in *.obj start from 1, not from 0! Negative indices are
+	// relative to the number of elements read so far, -1 is the last one.
+	// Zero means the stream is not referenced.
+	inline void ResolvePending(long long index, size_t count, long long& value, bool& relative)
+	{
+		relative = index < 0;
+		if (index > 0)
+			value = index - 1;
+		else if (index < 0)
+			value = static_cast<long long>(count) + index;
+		else
+			value = OBJ_NO_INDEX;
+	}
+
+	void EmitCorner(ObjChunk& chunk, const PendingCorner& pending)
+	{
+		ObjCorner corner = {};
+		for (size_t s = 0; s < STREAM_COUNT; ++s)
+		{
+			if (pending.Relative[s])
+			{
+				CornerIndex(corner, s) = OBJ_NO_INDEX;
+				chunk.Fixups.push_back({ chunk.Data.Corners.size(), s, pending.Index[s] });
+			}
+			else
+			{
+				CornerIndex(corner, s) = static_cast<unsigned int>(pending.Index[s]);
+			}
+		}
+		chunk.Data.Corners.push_back(corner);
+	}
+
+	inline bool StartsWord(const char* p, const char* end, const char* word, size_t length)
+	{
+		return static_cast<size_t>(end - p) > length && memcmp(p, word, length) == 0 && IsSpace(p[length]);
+	}
+
+	void ParseChunk(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		std::vector<Position>& positions = chunk.Data.Positions;
+		std::vector<Normal>& normals = chunk.Data.Normals;
+		std::vector<TextCoord>& textCoords = chunk.Data.TextCoords;
+
+		const char* p = begin;
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p + 1 >= end)
+				break;
+
+			if (p[0] == 'v' && IsSpace(p[1]))
+			{
+				Position pos = {};
+				p = ScanFloat(SkipSpaces(p + 2, end), end, pos.X);
+				p = ScanFloat(SkipSpaces(p, end), end, pos.Y);
+				p = ScanFloat(SkipSpaces(p, end), end, pos.Z);
+				positions.push_back(pos);
+			}
+			else if (p[0] == 'v' && p[1] == 'n' && p + 2 < end && IsSpace(p[2]))
+			{
+				Normal n = {};
+				p = ScanFloat(SkipSpaces(p + 3, end), end, n.X);
+				p = ScanFloat(SkipSpaces(p, end), end, n.Y);
+				p = ScanFloat(SkipSpaces(p, end), end, n.Z);
+				normals.push_back(n);
+			}
+			else if (p[0] == 'v' && p[1] == 't' && p + 2 < end && IsSpace(p[2]))
+			{
+				TextCoord tc = {};
+				p = ScanFloat(SkipSpaces(p + 3, end), end, tc.X);
+				p = ScanFloat(SkipSpaces(p, end), end, tc.Y);
+				textCoords.push_back(tc);
+			}
+			else if (p[0] == 'f' && IsSpace(p[1]))
+			{
+				chunk.Polygon.clear();
+				p += 2;
+				for (;;)
+				{
+					p = SkipSpaces(p, end);
+					if (p == end || !StartsIndex(*p))
+						break;
+
+					long long v = 0;
+					long long vt = 0;
+					long long vn = 0;
+					p = ScanIndexGroup(p, end, v, vt, vn);
+					assert(v != 0);
+
+					PendingCorner pending = {};
+					ResolvePending(v, positions.size(), pending.Index[STREAM_POSITION], pending.Relative[STREAM_POSITION]);
+					ResolvePending(vt, textCoords.size(), pending.Index[STREAM_TEXTCOORD], pending.Relative[STREAM_TEXTCOORD]);
+					ResolvePending(vn, normals.size(), pending.Index[STREAM_NORMAL], pending.Relative[STREAM_NORMAL]);
+					chunk.Polygon.push_back(pending);
+				}
+
+				// Quads and n-gons are triangulated as a fan around the first corner
+				for (size_t i = 2; i < chunk.Polygon.size(); ++i)
+				{
+					EmitCorner(chunk, chunk.Polygon[0]);
+					EmitCorner(chunk, chunk.Polygon[i - 1]);
+					EmitCorner(chunk, chunk.Polygon[i]);
+				}
+			}
+			else if (chunk.Data.MaterialLibrary.empty() && StartsWord(p, end, "mtllib", 6))
+			{
+				const char* name = SkipSpaces(p + 7, end);
+				const char* nameEnd = SkipLine(name, end);
+				while (nameEnd > name && (nameEnd[-1] == '\n' || nameEnd[-1] == '\r' || IsSpace(nameEnd[-1])))
+					--nameEnd;
+				chunk.Data.MaterialLibrary.assign(name, nameEnd);
+				p = nameEnd;
+			}
+
+			p = SkipLine(p, end);
+		}
+	}
+
+	inline size_t HashCorner(const ObjCorner& c)
+	{
+		uint64_t h = c.Position * 0x9E3779B97F4A7C15ull;
+		h ^= c.TextCoord * 0xC2B2AE3D27D4EB4Full;
+		h ^= c.Normal * 0x165667B19E3779F9ull;
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+
+	inline bool SameCorner(const ObjCorner& a, const ObjCorner& b)
+	{
+		return a.Position == b.Position && a.TextCoord == b.TextCoord && a.Normal == b.Normal;
+	}
+
+	// Area weighted smooth normals for vertices whose corners did not reference a normal
+	void GenerateMissingNormals(const ObjData& data, const std::vector<unsigned int>& sourcePositions, ObjMesh& out)
+	{
+		std::vector<Normal> accum(data.Positions.size(), Normal{ 0.0f, 0.0f, 0.0f });
+		for (size_t i = 0; i + 2 < data.Corners.size(); i += 3)
+		{
+			const unsigned int i0 = data.Corners[i].Position;
+			const unsigned int i1 = data.Corners[i + 1].Position;
+			const unsigned int i2 = data.Corners[i + 2].Position;
+			const Position& p0 = data.Positions[i0];
+			const Position& p1 = data.Positions[i1];
+			const Position& p2 = data.Positions[i2];
+			const float e1[3] = { p1.X - p0.X, p1.Y - p0.Y, p1.Z - p0.Z };
+			const float e2[3] = { p2.X - p0.X, p2.Y - p0.Y, p2.Z - p0.Z };
+			// the cross product length is twice the triangle area, which gives the weighting
+			const Normal n = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0] };
+			for (const unsigned int idx : { i0, i1, i2 })
+			{
+				accum[idx].X += n.X;
+				accum[idx].Y += n.Y;
+				accum[idx].Z += n.Z;
+			}
+		}
+
+		for (size_t v = 0; v < sourcePositions.size(); ++v)
+		{
+			if (sourcePositions[v] == OBJ_NO_INDEX)
+				continue;
+			const Normal& n = accum[sourcePositions[v]];
+			const float len = std::sqrt(n.X * n.X + n.Y * n.Y + n.Z * n.Z);
+			out.Normals[v] = len > 0.0f ? Normal{ n.X / len, n.Y / len, n.Z / len } : Normal{ 0.0f, 1.0f, 0.0f };
+		}
+	}
+
+	// Runs fn(i) for i in [0, count) on 'numThreads' threads
+	template <typename Fn>
+	void RunParallel(size_t count, unsigned int numThreads, Fn&& fn)
+	{
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				fn(i);
+		};
+
+		std::vector<std::thread> threads;
+		const size_t numWorkers = (std::min)(static_cast<size_t>(numThreads), count);
+		threads.reserve(numWorkers > 0 ? numWorkers - 1 : 0);
+		for (size_t i = 1; i < numWorkers; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for (std::thread& t : threads)
+			t.join();
+	}
+
+	// Exclusive prefix sum of the chunk array sizes, returns the total
+	template <typename T>
+	size_t PrefixSum(const std::vector<ObjChunk>& chunks, std::vector<T> ObjData::* member, std::vector<size_t>& offsets)
+	{
+		offsets.resize(chunks.size());
+		size_t total = 0;
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			offsets[i] = total;
+			total += (chunks[i].Data.*member).size();
+		}
+		return total;
+	}
+
+	template <typename T>
+	void CopyChunk(const std::vector<T>& src, std::vector<T>& dst, size_t offset)
+	{
+		if (!src.empty())
+			memcpy(&dst[offset], src.data(), src.size() * sizeof(T));
+	}
+
+	unsigned int DefaultThreadCount()
+	{
+		const unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 0 ? cores : 1;
+	}
+}
+
+void ParseObjBuffer(const char* begin, const char* end, ObjData& out)
+{
+	ObjChunk chunk;
+	ParseChunk(begin, end, chunk);
+	// a single chunk starts at zero, so chunk local indices are already final
+	for (const IndexFixup& fixup : chunk.Fixups)
+	{
+		assert(fixup.LocalIndex >= 0);
+		CornerIndex(chunk.Data.Corners[fixup.Corner], fixup.Stream) = static_cast<unsigned int>(fixup.LocalIndex);
+	}
+	out = std::move(chunk.Data);
+}
+
+void ParseObjBufferParallel(const char* begin, const char* end, ObjData& out, unsigned int numThreads)
+{
+	// chunks smaller than this are not worth a thread
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+	// more chunks than threads to even out the load between threads
+	constexpr size_t CHUNKS_PER_THREAD = 4;
+
+	if (numThreads == 0)
+		numThreads = DefaultThreadCount();
+
+	const size_t size = static_cast<size_t>(end - begin);
+	const size_t numChunks = (std::max)(static_cast<size_t>(1),
+		(std::min)(numThreads * CHUNKS_PER_THREAD, size / MIN_CHUNK_SIZE));
+	if (numThreads == 1 || numChunks == 1)
+	{
+		ParseObjBuffer(begin, end, out);
+		return;
+	}
+
+	// Split at line boundaries
+	std::vector<const char*> bounds(numChunks + 1);
+	bounds[0] = begin;
+	bounds[numChunks] = end;
+	for (size_t i = 1; i < numChunks; ++i)
+	{
+		const char* p = (std::max)(begin + size / numChunks * i, bounds[i - 1]);
+		bounds[i] = p > begin && p[-1] == '\n' ? p : SkipLine(p, end);
+	}
+
+	std::vector<ObjChunk> chunks(numChunks);
+	RunParallel(numChunks, numThreads, [&](size_t i)
+	{
+		ParseChunk(bounds[i], bounds[i + 1], chunks[i]);
+	});
+
+	// Every chunk gets its place in the output arrays
+	std::vector<size_t> positionOffsets;
+	std::vector<size_t> normalOffsets;
+	std::vector<size_t> textCoordOffsets;
+	std::vector<size_t> cornerOffsets;
+	out.Positions.resize(PrefixSum(chunks, &ObjData::Positions, positionOffsets));
+	out.Normals.resize(PrefixSum(chunks, &ObjData::Normals, normalOffsets));
+	out.TextCoords.resize(PrefixSum(chunks, &ObjData::TextCoords, textCoordOffsets));
+	out.Corners.resize(PrefixSum(chunks, &ObjData::Corners, cornerOffsets));
+	out.MaterialLibrary.clear();
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (!chunk.Data.MaterialLibrary.empty())
+		{
+			out.MaterialLibrary = chunk.Data.MaterialLibrary;
+			break;
+		}
+	}
+	const std::vector<size_t>* streamOffsets[STREAM_COUNT] = { &positionOffsets, &textCoordOffsets, &normalOffsets };
+
+	RunParallel(numChunks, numThreads, [&](size_t i)
+	{
+		ObjChunk& chunk = chunks[i];
+		CopyChunk(chunk.Data.Positions, out.Positions, positionOffsets[i]);
+		CopyChunk(chunk.Data.Normals, out.Normals, normalOffsets[i]);
+		CopyChunk(chunk.Data.TextCoords, out.TextCoords, textCoordOffsets[i]);
+		CopyChunk(chunk.Data.Corners, out.Corners, cornerOffsets[i]);
+
+		// Relative indices become absolute once the chunk knows where it starts
+		for (const IndexFixup& fixup : chunk.Fixups)
+		{
+			const long long index = static_cast<long long>((*streamOffsets[fixup.Stream])[i]) + fixup.LocalIndex;
+			assert(index >= 0);
+			CornerIndex(out.Corners[cornerOffsets[i] + fixup.Corner], fixup.Stream) = static_cast<unsigned int>(index);
+		}
+		chunk = ObjChunk();
+	});
+}
+
+void WeldObjVertices(const ObjData& data, ObjMesh& out)
+{
+	const size_t numCorners = data.Corners.size();
+	assert(numCorners % 3 == 0);
+
+	// Open addressing with linear probing, the load factor stays at or below 1/2
+	struct Slot
+	{
+		ObjCorner		Key;
+		unsigned int	Vertex;
+	};
+	size_t capacity = 16;
+	while (capacity < numCorners * 2)
+		capacity *= 2;
+	const size_t mask = capacity - 1;
+	std::vector<Slot> table(capacity, Slot{ { 0, 0, 0 }, OBJ_NO_INDEX });
+
+	out.Positions.clear();
+	out.Normals.clear();
+	out.TextCoords.clear();
+	out.Faces.clear();
+	out.Faces.reserve(numCorners / 3);
+
+	const bool hasTextCoords = !data.TextCoords.empty();
+	bool needsNormals = false;
+	// source position of every welded vertex that has no normal, OBJ_NO_INDEX otherwise
+	std::vector<unsigned int> sourcePositions;
+
+	unsigned int triangle[3] = {};
+	for (size_t i = 0; i < numCorners; ++i)
+	{
+		const ObjCorner& corner = data.Corners[i];
+		assert(corner.Position < data.Positions.size());
+
+		size_t slot = HashCorner(corner) & mask;
+		while (table[slot].Vertex != OBJ_NO_INDEX && !SameCorner(table[slot].Key, corner))
+			slot = (slot + 1) & mask;
+
+		if (table[slot].Vertex == OBJ_NO_INDEX)
+		{
+			table[slot].Key = corner;
+			table[slot].Vertex = static_cast<unsigned int>(out.Positions.size());
+
+			out.Positions.push_back(data.Positions[corner.Position]);
+			if (hasTextCoords)
+			{
+				out.TextCoords.push_back(corner.TextCoord < data.TextCoords.size()
+					? data.TextCoords[corner.TextCoord] : TextCoord{ 0.0f, 0.0f });
+			}
+			if (corner.Normal < data.Normals.size())
+			{
+				out.Normals.push_back(data.Normals[corner.Normal]);
+				sourcePositions.push_back(OBJ_NO_INDEX);
+			}
+			else
+			{
+				out.Normals.push_back({ 0.0f, 0.0f, 0.0f });
+				sourcePositions.push_back(corner.Position);
+				needsNormals = true;
+			}
+		}
+
+		triangle[i % 3] = table[slot].Vertex;
+		if (i % 3 == 2)
+		{
+			out.Faces.push_back({ triangle[0], triangle[1], triangle[2] });
+		}
+	}
+
+	if (needsNormals)
+	{
+		GenerateMissingNormals(data, sourcePositions, out);
+	}
+}
+
+std::string ParseMtlDiffuseMap(const char* begin, const char* end)
+{
+	const char* p = begin;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (StartsWord(p, end, "map_Kd", 6))
+		{
+			// the file name is the last token, options like -s or -o come before it
+			const char* nameEnd = SkipLine(p, end);
+			while (nameEnd > p && (nameEnd[-1] == '\n' || nameEnd[-1] == '\r' || IsSpace(nameEnd[-1])))
+				--nameEnd;
+			const char* name = nameEnd;
+			while (name > p + 6 && !IsSpace(name[-1]))
+				--name;
+			return std::string(name, nameEnd);
+		}
+		p = SkipLine(p, end);
+	}
+	return std::string();
+}
+
+double MeasureObjParseThroughput(const std::string& filepath, unsigned int iterations, unsigned int numThreads)
+{
+	const MappedFile file(filepath);
+	if (!file.IsOpen() || file.GetSize() == 0 || iterations == 0)
+	{
+		return 0.0;
+	}
+
+	ObjData data;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		if (numThreads == 1)
+			ParseObjBuffer(file.GetData(), file.GetData() + file.GetSize(), data);
+		else
+			ParseObjBufferParallel(file.GetData(), file.GetData() + file.GetSize(), data, numThreads);
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	const double megabytes = static_cast<double>(file.GetSize()) * iterations / (1024.0 * 1024.0);
+	return megabytes / elapsed.count();
+}
+
+std::vector<ObjScalingResult> MeasureObjParseScaling(const std::string& filepath, unsigned int iterations)
+{
+	const unsigned int cores = DefaultThreadCount();
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int n = 1; n < cores; n *= 2)
+		threadCounts.push_back(n);
+	threadCounts.push_back(cores);
+
+	std::vector<ObjScalingResult> results;
+	for (unsigned int n : threadCounts)
+	{
+		const double mbps = MeasureObjParseThroughput(filepath, iterations, n);
+		const double baseline = results.empty() ? mbps : results.front().MegabytesPerSecond;
+		results.push_back({ n, mbps, baseline > 0.0 ? mbps / baseline : 0.0 });
+	}
+	return results;
+}
+
+bool WriteSyntheticObj(const std::string& filepath, size_t targetBytes)
+{
+	std::FILE* f = nullptr;
+	if (fopen_s(&f, filepath.c_str(), "wb") != 0 || !f)
+	{
+		return false;
+	}
+
+	constexpr unsigned int GRID_WIDTH = 1024;
+	std::vector<char> buffer(1 << 20);
+	size_t written = 0;
+	size_t numVertices = 0;
+	bool ok = true;
+
+	// Rows of quads, every quad writes its own 4 corners. Even quads reference
+	// them with negative indices, odd ones with absolute indices.
+	for (unsigned int row = 0; ok && written < targetBytes; ++row)
+	{
+		size_t used = 0;
+		for (unsigned int col = 0; col < GRID_WIDTH; ++col)
+		{
+			const float x = static_cast<float>(col);
+			const float z = static_cast<float>(row);
+			const float y = 0.01f * static_cast<float>((col * 7 + row * 13) % 100);
+			used += snprintf(&buffer[used], buffer.size() - used,
+				"v %.4f %.4f %.4f\nv %.4f %.4f %.4f\nv %.4f %.4f %.4f\nv %.4f %.4f %.4f\n"
+				"vt 0.0 0.0\nvt 1.0 0.0\nvt 0.0 1.0\nvt 1.0 1.0\n"
+				"vn 0.0 1.0 0.0\nvn 0.0 1.0 0.0\nvn 0.0 1.0 0.0\nvn 0.0 1.0 0.0\n",
+				x, y, z, x + 1.0f, y, z, x, y, z + 1.0f, x + 1.0f, y, z + 1.0f);
+			if (col % 2 == 0)
+			{
+				used += snprintf(&buffer[used], buffer.size() - used,
+					"f -4/-4/-4 -3/-3/-3 -2/-2/-2\nf -3/-3/-3 -1/-1/-1 -2/-2/-2\n");
+			}
+			else
+			{
+				const size_t a = numVertices + 1;
+				used += snprintf(&buffer[used], buffer.size() - used,
+					"f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+					a, a, a, a + 1, a + 1, a + 1, a + 2, a + 2, a + 2,
+					a + 1, a + 1, a + 1, a + 3, a + 3, a + 3, a + 2, a + 2, a + 2);
+			}
+			numVertices += 4;
+		}
+		ok = fwrite(buffer.data(), 1, used, f) == used;
+		written += used;
+	}
+
+	fclose(f);
+	return ok;
+}
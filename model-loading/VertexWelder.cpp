@@ -0,0 +1,342 @@
+#include "pch.h"
+#include "VertexWelder.h"
+
+#include <limits>
+
+namespace
+{
+	// caps the slab count array, slabs get wider than the tolerance on huge extents
+	constexpr size_t WELD_MAX_SLABS = 1 << 16;
+	// representatives know their new index while the remap is numbered
+	constexpr unsigned int WELD_NUMBERED = 0x80000000u;
+	constexpr unsigned int WELD_EMPTY = ~0u;
+
+	constexpr float DEFAULT_WELD_POSITION_TOLERANCE = 1e-6f;
+	constexpr float DEFAULT_WELD_NORMAL_ANGLE = 1.0f;
+	constexpr float DEFAULT_WELD_TEXTCOORD_TOLERANCE = 1e-5f;
+
+	float GetAxis(const Position& p, int axis)
+	{
+		return axis == 0 ? p.X : (axis == 1 ? p.Y : p.Z);
+	}
+
+	class RepresentativeGrid
+	{
+	public:
+		RepresentativeGrid(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+			const std::vector<TextCoord>& textCoords, const WeldSettings& settings,
+			const Position& origin, float cellSize):
+			m_positions(positions),
+			m_normals(settings.NormalAngle >= 0.0f && normals.size() == positions.size() ? &normals : nullptr),
+			m_textCoords(settings.TextCoordTolerance >= 0.0f && textCoords.size() == positions.size() ? &textCoords : nullptr),
+			m_origin(origin),
+			m_invCellSize(1.0f / cellSize),
+			m_positionTolerance2((std::max)(settings.PositionTolerance, 0.0f) * (std::max)(settings.PositionTolerance, 0.0f)),
+			m_textCoordTolerance2(settings.TextCoordTolerance * settings.TextCoordTolerance),
+			m_normalCos(std::cos(settings.NormalAngle * DirectX::XM_PI / 180.0f))
+		{
+		}
+
+		void Reset(size_t expectedCount)
+		{
+			size_t capacity = 16;
+			while (capacity < expectedCount * 2)
+				capacity *= 2;
+			m_cells.assign(capacity, Cell{ 0, 0, 0, WELD_EMPTY });
+			m_vertices.clear();
+			m_next.clear();
+		}
+
+		void Insert(unsigned int v)
+		{
+			int x, y, z;
+			GetCell(m_positions[v], x, y, z);
+			Cell& cell = m_cells[FindSlot(x, y, z)];
+			if (cell.Head == WELD_EMPTY)
+			{
+				cell.X = x;
+				cell.Y = y;
+				cell.Z = z;
+			}
+			m_vertices.push_back(v);
+			m_next.push_back(cell.Head);
+			cell.Head = static_cast<unsigned int>(m_vertices.size() - 1);
+		}
+
+		// Closest representative within the tolerances, WELD_EMPTY when there is none
+		unsigned int FindMatch(unsigned int v) const
+		{
+			const Position& p = m_positions[v];
+			int x, y, z;
+			GetCell(p, x, y, z);
+
+			unsigned int best = WELD_EMPTY;
+			float bestDistance2 = std::numeric_limits<float>::infinity();
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						const Cell& cell = m_cells[FindSlot(x + dx, y + dy, z + dz)];
+						for (unsigned int e = cell.Head; e != WELD_EMPTY; e = m_next[e])
+						{
+							const unsigned int r = m_vertices[e];
+							const Position& q = m_positions[r];
+							const float distance2 = (p.X - q.X) * (p.X - q.X) + (p.Y - q.Y) * (p.Y - q.Y) + (p.Z - q.Z) * (p.Z - q.Z);
+							if (distance2 > m_positionTolerance2 || distance2 > bestDistance2
+								|| (distance2 == bestDistance2 && r > best) || !AttributesMatch(v, r))
+							{
+								continue;
+							}
+							best = r;
+							bestDistance2 = distance2;
+						}
+					}
+				}
+			}
+			return best;
+		}
+
+	private:
+		struct Cell
+		{
+			int				X, Y, Z;
+			unsigned int	Head;
+		};
+
+		void GetCell(const Position& p, int& x, int& y, int& z) const
+		{
+			x = static_cast<int>(std::floor((p.X - m_origin.X) * m_invCellSize));
+			y = static_cast<int>(std::floor((p.Y - m_origin.Y) * m_invCellSize));
+			z = static_cast<int>(std::floor((p.Z - m_origin.Z) * m_invCellSize));
+		}
+
+		// Slot of the cell, or the empty slot where it would go
+		size_t FindSlot(int x, int y, int z) const
+		{
+			const size_t mask = m_cells.size() - 1;
+			size_t slot = ((static_cast<unsigned int>(x) * 73856093u) ^ (static_cast<unsigned int>(y) * 19349663u) ^ (static_cast<unsigned int>(z) * 83492791u)) & mask;
+			while (m_cells[slot].Head != WELD_EMPTY && (m_cells[slot].X != x || m_cells[slot].Y != y || m_cells[slot].Z != z))
+				slot = (slot + 1) & mask;
+			return slot;
+		}
+
+		bool AttributesMatch(unsigned int a, unsigned int b) const
+		{
+			if (m_normals)
+			{
+				const Normal& na = (*m_normals)[a];
+				const Normal& nb = (*m_normals)[b];
+				const bool same = na.X == nb.X && na.Y == nb.Y && na.Z == nb.Z;
+				const float dot = na.X * nb.X + na.Y * nb.Y + na.Z * nb.Z;
+				const float lengths = std::sqrt((na.X * na.X + na.Y * na.Y + na.Z * na.Z) * (nb.X * nb.X + nb.Y * nb.Y + nb.Z * nb.Z));
+				if (!same && dot < m_normalCos * lengths)
+					return false;
+			}
+			if (m_textCoords)
+			{
+				const TextCoord& ta = (*m_textCoords)[a];
+				const TextCoord& tb = (*m_textCoords)[b];
+				if ((ta.X - tb.X) * (ta.X - tb.X) + (ta.Y - tb.Y) * (ta.Y - tb.Y) > m_textCoordTolerance2)
+					return false;
+			}
+			return true;
+		}
+
+		const std::vector<Position>&	m_positions;
+		const std::vector<Normal>*		m_normals;
+		const std::vector<TextCoord>*	m_textCoords;
+		Position						m_origin;
+		float							m_invCellSize;
+		float							m_positionTolerance2;
+		float							m_textCoordTolerance2;
+		float							m_normalCos;
+
+		std::vector<Cell>				m_cells;
+		// representatives in the grid, chained per cell
+		std::vector<unsigned int>		m_vertices;
+		std::vector<unsigned int>		m_next;
+	};
+
+	// Representative of every vertex, a representative is its own
+	std::vector<unsigned int> FindRepresentatives(const std::vector<Position>& positions,
+		const std::vector<Normal>& normals, const std::vector<TextCoord>& textCoords, const WeldSettings& settings)
+	{
+		const size_t numVertices = positions.size();
+		assert(numVertices < WELD_NUMBERED);
+		std::vector<unsigned int> representatives(numVertices);
+		if (numVertices == 0)
+			return representatives;
+
+		Position lo = positions[0];
+		Position hi = positions[0];
+		for (const Position& p : positions)
+		{
+			lo = { (std::min)(lo.X, p.X), (std::min)(lo.Y, p.Y), (std::min)(lo.Z, p.Z) };
+			hi = { (std::max)(hi.X, p.X), (std::max)(hi.Y, p.Y), (std::max)(hi.Z, p.Z) };
+		}
+
+		// Sweep along the longest axis. Cells are at least the tolerance wide, so matches are
+		// always in neighbouring cells, and small enough for the cell coordinates to fit an int.
+		const float extents[3] = { hi.X - lo.X, hi.Y - lo.Y, hi.Z - lo.Z };
+		const int axis = extents[0] >= extents[1] && extents[0] >= extents[2] ? 0 : (extents[1] >= extents[2] ? 1 : 2);
+		const float maxExtent = extents[axis];
+		float cellSize = (std::max)(settings.PositionTolerance, maxExtent / static_cast<float>(1 << 30));
+		if (!(cellSize > 0.0f))
+			cellSize = 1.0f;
+		const float slabWidth = (std::max)(cellSize, maxExtent / WELD_MAX_SLABS);
+		const size_t numSlabs = (std::min)(WELD_MAX_SLABS, static_cast<size_t>(maxExtent / slabWidth)) + 1;
+
+		// Counting sort by slab, vertices keep their order inside a slab
+		const auto slabOf = [&](const Position& p)
+		{
+			return (std::min)(numSlabs - 1, static_cast<size_t>((GetAxis(p, axis) - GetAxis(lo, axis)) / slabWidth));
+		};
+		std::vector<unsigned int> slabStart(numSlabs + 1, 0);
+		for (const Position& p : positions)
+			++slabStart[slabOf(p) + 1];
+		for (size_t s = 0; s < numSlabs; ++s)
+			slabStart[s + 1] += slabStart[s];
+		std::vector<unsigned int> order(numVertices);
+		{
+			std::vector<unsigned int> fill(slabStart.begin(), slabStart.end() - 1);
+			for (size_t v = 0; v < numVertices; ++v)
+				order[fill[slabOf(positions[v])]++] = static_cast<unsigned int>(v);
+		}
+
+		// The grid only ever holds the representatives of two neighbouring slabs
+		RepresentativeGrid grid(positions, normals, textCoords, settings, lo, cellSize);
+		std::vector<unsigned int> previousReps;
+		std::vector<unsigned int> currentReps;
+		for (size_t s = 0; s < numSlabs; ++s)
+		{
+			const unsigned int first = slabStart[s];
+			const unsigned int last = slabStart[s + 1];
+			if (first == last)
+			{
+				previousReps.clear();
+				continue;
+			}
+
+			grid.Reset(previousReps.size() + (last - first));
+			for (unsigned int r : previousReps)
+				grid.Insert(r);
+
+			currentReps.clear();
+			for (unsigned int i = first; i < last; ++i)
+			{
+				const unsigned int v = order[i];
+				const unsigned int match = grid.FindMatch(v);
+				if (match != WELD_EMPTY)
+				{
+					representatives[v] = match;
+				}
+				else
+				{
+					representatives[v] = v;
+					currentReps.push_back(v);
+					grid.Insert(v);
+				}
+			}
+			previousReps.swap(currentReps);
+		}
+		return representatives;
+	}
+
+	// Turns representatives into new indices in place, numbered in the order of the
+	// representatives. move(from, to) is called for every representative in that order,
+	// to is never above from. Returns the number of new vertices.
+	template <typename MoveFn>
+	size_t NumberRepresentatives(std::vector<unsigned int>& remap, MoveFn&& move)
+	{
+		unsigned int count = 0;
+		for (size_t v = 0; v < remap.size(); ++v)
+		{
+			if (remap[v] == v)
+			{
+				move(static_cast<unsigned int>(v), count);
+				remap[v] = count++ | WELD_NUMBERED;
+			}
+		}
+		for (unsigned int& r : remap)
+		{
+			if (!(r & WELD_NUMBERED))
+				r = remap[r];
+		}
+		for (unsigned int& r : remap)
+			r &= ~WELD_NUMBERED;
+		return count;
+	}
+}
+
+WeldSettings GetDefaultWeldSettings(const std::vector<Position>& positions)
+{
+	WeldSettings settings;
+	settings.NormalAngle = DEFAULT_WELD_NORMAL_ANGLE;
+	settings.TextCoordTolerance = DEFAULT_WELD_TEXTCOORD_TOLERANCE;
+	if (positions.empty())
+		return settings;
+
+	Position lo = positions[0];
+	Position hi = positions[0];
+	for (const Position& p : positions)
+	{
+		lo = { (std::min)(lo.X, p.X), (std::min)(lo.Y, p.Y), (std::min)(lo.Z, p.Z) };
+		hi = { (std::max)(hi.X, p.X), (std::max)(hi.Y, p.Y), (std::max)(hi.Z, p.Z) };
+	}
+	const float dx = hi.X - lo.X;
+	const float dy = hi.Y - lo.Y;
+	const float dz = hi.Z - lo.Z;
+	settings.PositionTolerance = DEFAULT_WELD_POSITION_TOLERANCE * std::sqrt(dx * dx + dy * dy + dz * dz);
+	return settings;
+}
+
+std::vector<unsigned int> BuildWeldRemap(const std::vector<Position>& positions,
+	const std::vector<Normal>& normals, const std::vector<TextCoord>& textCoords, const WeldSettings& settings)
+{
+	std::vector<unsigned int> remap = FindRepresentatives(positions, normals, textCoords, settings);
+	NumberRepresentatives(remap, [](unsigned int, unsigned int) {});
+	return remap;
+}
+
+WeldReport WeldVertices(std::vector<Position>& positions, std::vector<Normal>& normals,
+	std::vector<TextCoord>& textCoords, std::vector<Face>& faces, const WeldSettings& settings,
+	std::vector<unsigned int>* remap)
+{
+	WeldReport report;
+	report.VerticesBefore = positions.size();
+
+	std::vector<unsigned int> newIndices = FindRepresentatives(positions, normals, textCoords, settings);
+	const bool hasNormals = normals.size() == positions.size();
+	const bool hasTextCoords = textCoords.size() == positions.size();
+	const size_t count = NumberRepresentatives(newIndices, [&](unsigned int from, unsigned int to)
+	{
+		positions[to] = positions[from];
+		if (hasNormals)
+			normals[to] = normals[from];
+		if (hasTextCoords)
+			textCoords[to] = textCoords[from];
+	});
+	positions.resize(count);
+	if (hasNormals)
+		normals.resize(count);
+	if (hasTextCoords)
+		textCoords.resize(count);
+	report.VerticesAfter = count;
+
+	size_t write = 0;
+	for (const Face& f : faces)
+	{
+		const Face welded = { newIndices[f.X], newIndices[f.Y], newIndices[f.Z] };
+		if (welded.X == welded.Y || welded.Y == welded.Z || welded.X == welded.Z)
+			continue;
+		faces[write++] = welded;
+	}
+	report.TrianglesRemoved = faces.size() - write;
+	faces.resize(write);
+
+	if (remap)
+		remap->swap(newIndices);
+	return report;
+}
@@ -0,0 +1,260 @@
+#include "pch.h"
+#include "AssetCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Records the content hash of a source file under the hash of its path
+	struct SourceRecord
+	{
+		uint64_t	Size;
+		uint64_t	WriteTime;
+		uint64_t	Hash;
+	};
+
+	constexpr const char* SOURCE_RECORD_EXTENSION = ".source";
+
+	struct CachedFile
+	{
+		std::string	Name;
+		uint64_t	Size;
+		uint64_t	LastUse;
+	};
+
+	uint64_t ToUInt64(const FILETIME& time)
+	{
+		return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	}
+
+	bool EndsWith(const std::string& s, const char* suffix)
+	{
+		const size_t length = strlen(suffix);
+		return s.size() >= length && s.compare(s.size() - length, length, suffix) == 0;
+	}
+
+	std::string ToHex(uint64_t value)
+	{
+		char buff[17] = {};
+		sprintf_s(buff, "%016llx", static_cast<unsigned long long>(value));
+		return buff;
+	}
+
+	// Every file in the directory matching the pattern, without subdirectories
+	template <typename Fn>
+	void ForEachFile(const std::string& directory, const char* pattern, Fn&& fn)
+	{
+		WIN32_FIND_DATAA data = {};
+		HANDLE find = FindFirstFileA((directory + pattern).c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		do
+		{
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				fn(data);
+			}
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+
+	// Artifacts only, source records are tiny and temporary files belong to a writer
+	std::vector<CachedFile> ListArtifacts(const std::string& directory)
+	{
+		std::vector<CachedFile> files;
+		ForEachFile(directory, "*", [&](const WIN32_FIND_DATAA& data)
+		{
+			const std::string name = data.cFileName;
+			if (EndsWith(name, SOURCE_RECORD_EXTENSION) || EndsWith(name, ".tmp"))
+			{
+				return;
+			}
+			const uint64_t size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+			files.push_back({ name, size, ToUInt64(data.ftLastWriteTime) });
+		});
+		return files;
+	}
+}
+
+bool GetSourceStamp(const std::string& filepath, SourceStamp& stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr = {};
+	if (!GetFileAttributesExA(filepath.c_str(), GetFileExInfoStandard, &attr))
+	{
+		return false;
+	}
+	stamp.Size = (static_cast<uint64_t>(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+	stamp.WriteTime = ToUInt64(attr.ftLastWriteTime);
+	return true;
+}
+
+uint64_t HashSettings(const void* data, size_t size, uint64_t seed)
+{
+	return HashBytes(data, size, seed);
+}
+
+AssetCache::AssetCache(const std::string& directory):
+	m_directory(directory)
+{
+	if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+	{
+		m_directory += '/';
+	}
+	CreateDirectoryA(m_directory.c_str(), nullptr);
+}
+
+AssetCache& AssetCache::GetDefault()
+{
+	static AssetCache cache(ASSET_CACHE_DIRECTORY);
+	return cache;
+}
+
+const std::string& AssetCache::GetDirectory() const
+{
+	return m_directory;
+}
+
+bool AssetCache::HashSource(const std::string& sourcePath, uint64_t& hash) const
+{
+	SourceStamp stamp = {};
+	if (!GetSourceStamp(sourcePath, stamp))
+	{
+		return false;
+	}
+
+	const std::string recordPath = m_directory + ToHex(HashBytes(sourcePath.data(), sourcePath.size())) + SOURCE_RECORD_EXTENSION;
+	{
+		const MappedFile file(recordPath);
+		SourceRecord record = {};
+		if (file.IsOpen() && file.GetSize() == sizeof(SourceRecord))
+		{
+			memcpy(&record, file.GetData(), sizeof(SourceRecord));
+			if (record.Size == stamp.Size && record.WriteTime == stamp.WriteTime)
+			{
+				hash = record.Hash;
+				return true;
+			}
+		}
+	}
+
+	{
+		const MappedFile source(sourcePath);
+		if (!source.IsOpen())
+		{
+			return false;
+		}
+		hash = HashBytes(source.GetData(), source.GetSize());
+	}
+	const SourceRecord record = { stamp.Size, stamp.WriteTime, hash };
+	WriteArtifact(recordPath, &record, sizeof(record));
+	return true;
+}
+
+std::string AssetCache::GetArtifactPath(const AssetKey& key, const char* kind) const
+{
+	return m_directory + ToHex(key.SourceHash) + "-" + ToHex(key.SettingsHash) + "." + kind;
+}
+
+bool AssetCache::WriteArtifact(const std::string& artifactPath, const void* data, size_t size) const
+{
+	// Threads building the same artifact each write their own temporary file
+	const std::string tmpPath = artifactPath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			return false;
+		}
+		out.write(static_cast<const char*>(data), size);
+		out.close();
+		if (!out)
+		{
+			DeleteFileA(tmpPath.c_str());
+			return false;
+		}
+	}
+	if (!MoveFileExA(tmpPath.c_str(), artifactPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AssetCache::Touch(const std::string& artifactPath) const
+{
+	HANDLE file = CreateFileA(artifactPath.c_str(), FILE_WRITE_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	FILETIME now = {};
+	GetSystemTimeAsFileTime(&now);
+	const BOOL result = SetFileTime(file, nullptr, nullptr, &now);
+	CloseHandle(file);
+	return result != 0;
+}
+
+size_t AssetCache::RemoveSource(uint64_t sourceHash) const
+{
+	std::vector<std::string> names;
+	ForEachFile(m_directory, (ToHex(sourceHash) + "-*").c_str(), [&](const WIN32_FIND_DATAA& data)
+	{
+		names.push_back(data.cFileName);
+	});
+
+	size_t count = 0;
+	for (const std::string& name : names)
+	{
+		if (DeleteFileA((m_directory + name).c_str()))
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+uint64_t AssetCache::GetSize() const
+{
+	uint64_t size = 0;
+	for (const CachedFile& file : ListArtifacts(m_directory))
+	{
+		size += file.Size;
+	}
+	return size;
+}
+
+uint64_t AssetCache::Evict(uint64_t maxBytes) const
+{
+	std::vector<CachedFile> files = ListArtifacts(m_directory);
+	uint64_t size = 0;
+	for (const CachedFile& file : files)
+	{
+		size += file.Size;
+	}
+
+	// Oldest use first, the name keeps the order stable for equal times
+	std::sort(files.begin(), files.end(), [](const CachedFile& a, const CachedFile& b)
+	{
+		return a.LastUse != b.LastUse ? a.LastUse < b.LastUse : a.Name < b.Name;
+	});
+
+	uint64_t freed = 0;
+	for (size_t i = 0; i < files.size() && size - freed > maxBytes; ++i)
+	{
+		// a file still mapped by a reader can't be deleted, it goes on the next run
+		if (DeleteFileA((m_directory + files[i].Name).c_str()))
+		{
+			freed += files[i].Size;
+		}
+	}
+	return freed;
+}
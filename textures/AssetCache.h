@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Where the application keeps derived assets, next to the source assets
+constexpr const char* ASSET_CACHE_DIRECTORY = "../assets/cache/";
+// Least recently used artifacts are evicted beyond this
+constexpr uint64_t ASSET_CACHE_MAX_BYTES = 1ull << 30;
+
+// Cheap to query identity of a source file
+struct SourceStamp
+{
+	uint64_t Size;
+	uint64_t WriteTime;
+};
+
+bool GetSourceStamp(const std::string& filepath, SourceStamp& stamp);
+
+// An artifact is identified by what it was built from, not where the source lives:
+// the hash of the source content and the hash of everything else that went into it
+// (format version, processing settings).
+struct AssetKey
+{
+	uint64_t	SourceHash;
+	uint64_t	SettingsHash;
+};
+
+// Content addressed directory of derived artifacts. Artifacts are plain files named
+// after their key, writers produce them next to the final name and rename them into
+// place, see WriteArtifact. Use times are tracked through the write time of the
+// artifact, which never changes otherwise, for least recently used eviction.
+class AssetCache
+{
+public:
+	explicit AssetCache(const std::string& directory);
+	// Cache in ASSET_CACHE_DIRECTORY shared by the whole application
+	static AssetCache& GetDefault();
+
+	const std::string& GetDirectory() const;
+
+	// Content hash of a source file, false when it can't be read. The hash is recorded
+	// with the size and write time of the source, later calls trust a matching stamp
+	// and don't read the source again.
+	bool HashSource(const std::string& sourcePath, uint64_t& hash) const;
+
+	// File of the artifact, kind is its extension like "mesh"
+	std::string GetArtifactPath(const AssetKey& key, const char* kind) const;
+	// Writes the artifact atomically, readers see the old file or the whole new one
+	bool WriteArtifact(const std::string& artifactPath, const void* data, size_t size) const;
+	// Marks the artifact as just used, false when there is none
+	bool Touch(const std::string& artifactPath) const;
+	// Deletes every artifact built from the source content, whatever the settings.
+	// Returns the number of files deleted.
+	size_t RemoveSource(uint64_t sourceHash) const;
+
+	// Bytes of all artifacts
+	uint64_t GetSize() const;
+	// Deletes least recently used artifacts until the rest fits in maxBytes.
+	// Returns the bytes freed.
+	uint64_t Evict(uint64_t maxBytes) const;
+
+private:
+	std::string	m_directory;
+};
+
+// Hash of the settings that shape an artifact, chain calls to add more of them
+uint64_t HashSettings(const void* data, size_t size, uint64_t seed = 0);
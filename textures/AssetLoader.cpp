@@ -0,0 +1,417 @@
+#include "pch.h"
+#include "AssetLoader.h"
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	constexpr uint32_t PLACEHOLDER_TEXTURE_SIZE = 8;
+
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Unit cube with a face per axis direction, so it lights and textures like a model
+	std::unique_ptr<Model> CreatePlaceholderCube()
+	{
+		static const float axes[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+		std::vector<Position> positions;
+		std::vector<Normal> normals;
+		std::vector<TextCoord> textCoords;
+		std::vector<Face> faces;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float* n = axes[axis];
+			const float* u = axes[(axis + 1) % 3];
+			const float* v = axes[(axis + 2) % 3];
+			for (float side = -1.0f; side <= 1.0f; side += 2.0f)
+			{
+				const unsigned int first = static_cast<unsigned int>(positions.size());
+				for (int corner = 0; corner < 4; ++corner)
+				{
+					const float cu = (corner & 1) ? 0.5f : -0.5f;
+					const float cv = (corner & 2) ? 0.5f : -0.5f;
+					positions.push_back({ n[0] * side * 0.5f + u[0] * cu + v[0] * cv,
+						n[1] * side * 0.5f + u[1] * cu + v[1] * cv,
+						n[2] * side * 0.5f + u[2] * cu + v[2] * cv });
+					normals.push_back({ n[0] * side, n[1] * side, n[2] * side });
+					textCoords.push_back({ cu + 0.5f, 0.5f - cv });
+				}
+				// counter clockwise seen from outside on the positive side
+				if (side > 0.0f)
+				{
+					faces.emplace_back(first, first + 1, first + 3);
+					faces.emplace_back(first, first + 3, first + 2);
+				}
+				else
+				{
+					faces.emplace_back(first, first + 3, first + 1);
+					faces.emplace_back(first, first + 2, first + 3);
+				}
+			}
+		}
+		return std::make_unique<Model>(std::move(positions), std::move(faces), std::move(normals), std::move(textCoords), "");
+	}
+
+	// Grey and magenta checker, obvious on screen and cheap to upload
+	TextureData CreatePlaceholderTexture()
+	{
+		TextureData texture;
+		texture.Width = PLACEHOLDER_TEXTURE_SIZE;
+		texture.Height = PLACEHOLDER_TEXTURE_SIZE;
+		texture.Pixels.resize(PLACEHOLDER_TEXTURE_SIZE * PLACEHOLDER_TEXTURE_SIZE * 4);
+		for (uint32_t y = 0; y < PLACEHOLDER_TEXTURE_SIZE; ++y)
+		{
+			for (uint32_t x = 0; x < PLACEHOLDER_TEXTURE_SIZE; ++x)
+			{
+				uint8_t* bgra = &texture.Pixels[(y * PLACEHOLDER_TEXTURE_SIZE + x) * 4];
+				const bool odd = ((x ^ y) & 1) != 0;
+				bgra[0] = odd ? 0xff : 0x80;
+				bgra[1] = odd ? 0x00 : 0x80;
+				bgra[2] = odd ? 0xff : 0x80;
+				bgra[3] = 0xff;
+			}
+		}
+		return texture;
+	}
+}
+
+struct TextureHandle::Slot
+{
+	std::atomic<AssetState>								State{ ASSET_LOADING };
+	// only touched on the upload thread
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	View;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	Placeholder;
+};
+
+struct ModelHandle::Slot
+{
+	std::atomic<AssetState>			State{ ASSET_LOADING };
+	// set on the upload thread before State turns resident
+	std::unique_ptr<Model>			Loaded;
+	std::shared_ptr<const Model>	Placeholder;
+	TextureHandle					Texture;
+};
+
+AssetState TextureHandle::GetState() const
+{
+	return m_slot ? m_slot->State.load() : ASSET_FAILED;
+}
+
+bool TextureHandle::IsResident() const
+{
+	return GetState() == ASSET_RESIDENT;
+}
+
+ID3D11ShaderResourceView* TextureHandle::GetView() const
+{
+	if (!m_slot)
+	{
+		return nullptr;
+	}
+	return m_slot->State == ASSET_RESIDENT ? m_slot->View.Get() : m_slot->Placeholder.Get();
+}
+
+AssetState ModelHandle::GetState() const
+{
+	return m_slot ? m_slot->State.load() : ASSET_FAILED;
+}
+
+bool ModelHandle::IsResident() const
+{
+	return GetState() == ASSET_RESIDENT;
+}
+
+const Model& ModelHandle::GetModel() const
+{
+	assert(m_slot);
+	return m_slot->State == ASSET_RESIDENT ? *m_slot->Loaded : *m_slot->Placeholder;
+}
+
+const TextureHandle& ModelHandle::GetTexture() const
+{
+	assert(m_slot);
+	return m_slot->Texture;
+}
+
+D3D11UploadDevice::D3D11UploadDevice(ID3D11Device* device):
+	m_device(device)
+{
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> D3D11UploadDevice::CreateTexture(const TextureData& texture, uint32_t firstLevel)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	::CreateTexture(m_device, texture, firstLevel, resource.GetAddressOf(), view.GetAddressOf());
+	return view;
+}
+
+RecordingUploadDevice::RecordingUploadDevice(double msPerMegabyte):
+	m_msPerMegabyte(msPerMegabyte)
+{
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> RecordingUploadDevice::CreateTexture(const TextureData& texture, uint32_t firstLevel)
+{
+	// a texture holds either decoded pixels or a compressed file
+	const size_t bytes = texture.DDSFile.empty()
+		? texture.Pixels.size() - GetMipOffset(texture.Width, texture.Height, firstLevel)
+		: texture.DDSFile.size();
+	m_uploads.push_back({ (std::max)(1u, texture.Width >> firstLevel), (std::max)(1u, texture.Height >> firstLevel), bytes });
+	const double cost = m_msPerMegabyte * bytes / (1024.0 * 1024.0);
+	const Clock::time_point start = Clock::now();
+	while (MillisecondsSince(start) < cost)
+	{
+	}
+	return nullptr;
+}
+
+const std::vector<UploadRecord>& RecordingUploadDevice::GetUploads() const
+{
+	return m_uploads;
+}
+
+AssetLoader::AssetLoader(IUploadDevice& device, unsigned int numThreads):
+	m_device(device),
+	m_placeholderModel(CreatePlaceholderCube()),
+	m_pending(0),
+	m_stop(false)
+{
+	m_placeholderTexture = m_device.CreateTexture(CreatePlaceholderTexture(), 0);
+
+	if (numThreads == 0)
+	{
+		numThreads = (std::max)(1u, DefaultThreadCount() - 1);
+	}
+	m_workers.reserve(numThreads);
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		m_workers.emplace_back([this]() { WorkerMain(); });
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_stop = true;
+	}
+	m_jobReady.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+ModelHandle AssetLoader::LoadModel(const std::string& filepath)
+{
+	ModelHandle& handle = m_models[filepath];
+	if (handle.m_slot)
+	{
+		return handle;
+	}
+	handle.m_slot = std::make_shared<ModelHandle::Slot>();
+	handle.m_slot->Placeholder = m_placeholderModel;
+	handle.m_slot->Texture = MakePlaceholderHandle();
+	++m_pending;
+
+	std::shared_ptr<ModelHandle::Slot> slot = handle.m_slot;
+	Submit([this, slot, filepath]()
+	{
+		PendingUpload upload;
+		upload.ModelSlot = slot;
+		try
+		{
+			upload.LoadedModel = Model::LoadModel(filepath);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what() << std::endl;
+		}
+		if (!upload.LoadedModel)
+		{
+			std::cerr << "ERROR: Failed to load model " << filepath << std::endl;
+		}
+		PushUpload(std::move(upload));
+	});
+	return handle;
+}
+
+TextureHandle AssetLoader::LoadTexture(const std::string& filename)
+{
+	TextureHandle& handle = m_textures[filename];
+	if (!handle.m_slot)
+	{
+		handle = MakeTextureHandle(filename);
+	}
+	return handle;
+}
+
+TextureHandle AssetLoader::MakeTextureHandle(const std::string& filename)
+{
+	TextureHandle handle;
+	handle.m_slot = std::make_shared<TextureHandle::Slot>();
+	handle.m_slot->Placeholder = m_placeholderTexture;
+	++m_pending;
+
+	std::shared_ptr<TextureHandle::Slot> slot = handle.m_slot;
+	Submit([this, slot, filename]()
+	{
+		PendingUpload upload;
+		upload.TextureSlot = slot;
+		try
+		{
+			if (!LoadTextureData(FindTexture(filename), upload.Texture))
+			{
+				std::cerr << "ERROR: Failed to open texture " << filename << std::endl;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: Failed to decode texture " << filename << ": " << e.what() << std::endl;
+		}
+		PushUpload(std::move(upload));
+	});
+	return handle;
+}
+
+TextureHandle AssetLoader::MakePlaceholderHandle() const
+{
+	TextureHandle handle;
+	handle.m_slot = std::make_shared<TextureHandle::Slot>();
+	handle.m_slot->Placeholder = m_placeholderTexture;
+	return handle;
+}
+
+size_t AssetLoader::ProcessUploads(double budgetMs)
+{
+	const Clock::time_point start = Clock::now();
+	size_t count = 0;
+	for (;;)
+	{
+		PendingUpload upload;
+		{
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
+			if (m_uploads.empty() || (count > 0 && MillisecondsSince(start) >= budgetMs))
+			{
+				break;
+			}
+			upload = std::move(m_uploads.front());
+			m_uploads.pop_front();
+		}
+		Upload(upload);
+		++count;
+	}
+	return count;
+}
+
+size_t AssetLoader::GetPendingCount() const
+{
+	return m_pending;
+}
+
+void AssetLoader::Flush()
+{
+	while (m_pending > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_uploadMutex);
+			m_uploadReady.wait(lock, [this]() { return !m_uploads.empty(); });
+		}
+		ProcessUploads(std::numeric_limits<double>::infinity());
+	}
+}
+
+const Model& AssetLoader::GetPlaceholderModel() const
+{
+	return *m_placeholderModel;
+}
+
+void AssetLoader::WorkerMain()
+{
+	// WIC decoding (TIFF) needs COM on every thread that uses it
+	const bool comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_jobReady.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop)
+			{
+				break;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+	if (comInitialized)
+	{
+		CoUninitialize();
+	}
+}
+
+void AssetLoader::Submit(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobReady.notify_one();
+}
+
+void AssetLoader::PushUpload(PendingUpload&& upload)
+{
+	if (upload.TextureSlot)
+	{
+		// decoded pixels, or the block compressed .dds file LoadTextureData preferred
+		const bool loaded = !upload.Texture.Pixels.empty() || !upload.Texture.DDSFile.empty();
+		upload.TextureSlot->State = loaded ? ASSET_UPLOADING : ASSET_FAILED;
+	}
+	if (upload.ModelSlot)
+	{
+		upload.ModelSlot->State = upload.LoadedModel ? ASSET_UPLOADING : ASSET_FAILED;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_uploadMutex);
+		m_uploads.push_back(std::move(upload));
+	}
+	m_uploadReady.notify_one();
+}
+
+void AssetLoader::Upload(PendingUpload& upload)
+{
+	if (upload.TextureSlot && upload.TextureSlot->State == ASSET_UPLOADING)
+	{
+		try
+		{
+			// the whole chain, levels of a .dds file can't be skipped
+			upload.TextureSlot->View = m_device.CreateTexture(upload.Texture, 0);
+			upload.TextureSlot->State = ASSET_RESIDENT;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: Failed to upload texture: " << e.what() << std::endl;
+			upload.TextureSlot->State = ASSET_FAILED;
+		}
+	}
+	else if (upload.ModelSlot && upload.LoadedModel)
+	{
+		// The mesh has nothing to upload here, the renderer builds its buffers. Its texture
+		// is requested now and becomes resident after the model.
+		const std::string& textPath = upload.LoadedModel->GetTextPath();
+		upload.ModelSlot->Texture = textPath.empty() ? TextureHandle() : LoadTexture(textPath);
+		upload.ModelSlot->Loaded = std::move(upload.LoadedModel);
+		upload.ModelSlot->State = ASSET_RESIDENT;
+	}
+	--m_pending;
+}
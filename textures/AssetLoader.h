@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Model.h"
+#include "TextureCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum AssetState
+{
+	// parsed or decoded on a worker thread
+	ASSET_LOADING,
+	// waiting in the upload queue of the main thread
+	ASSET_UPLOADING,
+	ASSET_RESIDENT,
+	ASSET_FAILED
+};
+
+// Everything the loader does on the GPU, only ever called from the thread running
+// AssetLoader::ProcessUploads
+class IUploadDevice
+{
+public:
+	virtual ~IUploadDevice() = default;
+	// View of the levels from firstLevel on, see ::CreateTexture. Throws when the texture
+	// can't be created.
+	virtual Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const TextureData& texture, uint32_t firstLevel) = 0;
+};
+
+class D3D11UploadDevice : public IUploadDevice
+{
+public:
+	explicit D3D11UploadDevice(ID3D11Device* device);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const TextureData& texture, uint32_t firstLevel) override;
+
+private:
+	ID3D11Device*	m_device;
+};
+
+struct UploadRecord
+{
+	uint32_t	Width;
+	uint32_t	Height;
+	size_t		Bytes;
+};
+
+// Headless device that records the uploads and creates no views. Every upload can
+// busy wait msPerMegabyte per MB of pixels to stand in for the driver copy.
+class RecordingUploadDevice : public IUploadDevice
+{
+public:
+	explicit RecordingUploadDevice(double msPerMegabyte = 0.0);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const TextureData& texture, uint32_t firstLevel) override;
+	const std::vector<UploadRecord>& GetUploads() const;
+
+private:
+	double						m_msPerMegabyte;
+	std::vector<UploadRecord>	m_uploads;
+};
+
+// Handles are cheap to copy and stay valid after the loader is gone, an asset that
+// is not resident yet reads as the placeholder of the loader.
+class TextureHandle
+{
+public:
+	AssetState GetState() const;
+	bool IsResident() const;
+	// Null for a default constructed handle
+	ID3D11ShaderResourceView* GetView() const;
+
+private:
+	friend class AssetLoader;
+	struct Slot;
+	std::shared_ptr<Slot>	m_slot;
+};
+
+class ModelHandle
+{
+public:
+	AssetState GetState() const;
+	bool IsResident() const;
+	// The loaded model once resident, a placeholder cube until then or when loading failed.
+	// Must not be called on a default constructed handle.
+	const Model& GetModel() const;
+	// Diffuse map of the first submesh, see Model::GetTextPath. Until the model is resident
+	// this is a handle that only ever shows the placeholder, ask again afterwards. A
+	// default handle when the model has no texture.
+	const TextureHandle& GetTexture() const;
+
+private:
+	friend class AssetLoader;
+	struct Slot;
+	std::shared_ptr<Slot>	m_slot;
+};
+
+// Parses models and decodes textures on a pool of worker threads and hands the results
+// to the thread calling ProcessUploads, which creates the GPU resources within a time
+// budget. Requests for a path that was already requested share the handle. Requests,
+// uploads and handle reads all belong to the same thread.
+class AssetLoader
+{
+public:
+	// numThreads 0 leaves one core to the main thread
+	explicit AssetLoader(IUploadDevice& device, unsigned int numThreads = 0);
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	ModelHandle LoadModel(const std::string& filepath);
+	// Texture name as a material refers to it, resolved with FindTexture
+	TextureHandle LoadTexture(const std::string& filename);
+
+	// Uploads finished assets in request completion order until budgetMs has passed.
+	// At least one upload is done per call so large assets can't starve. Returns the
+	// number of uploads.
+	size_t ProcessUploads(double budgetMs);
+	// Requested assets that are neither resident nor failed
+	size_t GetPendingCount() const;
+	// Blocks until every requested asset is resident or failed, uploading as they arrive
+	void Flush();
+
+	const Model& GetPlaceholderModel() const;
+
+private:
+	struct PendingUpload
+	{
+		std::shared_ptr<TextureHandle::Slot>	TextureSlot;
+		TextureData								Texture;
+		std::shared_ptr<ModelHandle::Slot>		ModelSlot;
+		std::unique_ptr<Model>					LoadedModel;
+	};
+
+	void WorkerMain();
+	void Submit(std::function<void()>&& job);
+	void PushUpload(PendingUpload&& upload);
+	void Upload(PendingUpload& upload);
+	TextureHandle MakeTextureHandle(const std::string& filename);
+	TextureHandle MakePlaceholderHandle() const;
+
+	IUploadDevice&									m_device;
+	std::shared_ptr<const Model>					m_placeholderModel;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	m_placeholderTexture;
+
+	std::map<std::string, TextureHandle>			m_textures;
+	std::map<std::string, ModelHandle>				m_models;
+	std::atomic<size_t>								m_pending;
+
+	// worker jobs
+	std::mutex										m_jobMutex;
+	std::condition_variable							m_jobReady;
+	std::deque<std::function<void()>>				m_jobs;
+	bool											m_stop;
+	std::vector<std::thread>						m_workers;
+
+	// finished on a worker, uploaded on the main thread
+	std::mutex										m_uploadMutex;
+	std::condition_variable							m_uploadReady;
+	std::deque<PendingUpload>						m_uploads;
+};
@@ -0,0 +1,221 @@
+#include "pch.h"
+#include "AssetWarmup.h"
+#include "IndexBuffer.h"
+#include "Model.h"
+#include "Parallel.h"
+#include "TextureCache.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+	// what ImportModel is used for, besides the native OBJ parser
+	const char* const MESH_EXTENSIONS[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply" };
+	// what LoadBGRAImage decodes, TIFF through WIC
+	const char* const TEXTURE_EXTENSIONS[] = { ".jpg", ".jpeg", ".png", ".bmp", ".gif", ".tga", ".tif", ".tiff" };
+
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	template <size_t N>
+	bool HasAnyExtension(const std::string& filepath, const char* const (&extensions)[N])
+	{
+		for (const char* ext : extensions)
+		{
+			if (HasExtension(filepath, ext))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool LoadAsset(const WarmupResult& asset, const AssetCache& cache)
+	{
+		try
+		{
+			if (asset.Kind == WARMUP_MESH)
+			{
+				return Model::LoadModel(asset.Path, cache) != nullptr;
+			}
+			TextureData texture;
+			return LoadTextureData(asset.Path, texture, cache);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << asset.Path << ": " << e.what() << std::endl;
+			return false;
+		}
+	}
+
+	// Encodes the indices of the cached mesh like WriteMeshCache and decodes them until
+	// the time is long enough to measure. Fails when the round trip changes an index.
+	bool MeasureIndexDecode(WarmupResult& asset, const AssetCache& cache, double& decodeSeconds)
+	{
+		constexpr double MIN_DECODE_MS = 50.0;
+
+		const std::unique_ptr<Model> model = Model::LoadModel(asset.Path, cache);
+		if (!model)
+		{
+			return false;
+		}
+		asset.NumIndices = model->GetIndexCount();
+		std::vector<uint8_t> encoded;
+		EncodeIndices(model->GetIndices(), asset.NumIndices, encoded);
+		asset.EncodedBytes = encoded.size();
+		if (asset.NumIndices == 0)
+		{
+			return true;
+		}
+
+		std::vector<uint32_t> decoded(asset.NumIndices);
+		size_t iterations = 0;
+		const Clock::time_point start = Clock::now();
+		double ms = 0.0;
+		do
+		{
+			if (!DecodeIndices(encoded.data(), encoded.size(), decoded.data(), decoded.size()))
+			{
+				return false;
+			}
+			++iterations;
+			ms = MillisecondsSince(start);
+		} while (ms < MIN_DECODE_MS);
+
+		if (memcmp(decoded.data(), model->GetIndices(), decoded.size() * sizeof(uint32_t)) != 0)
+		{
+			std::cerr << "ERROR: " << asset.Path << ": decoded indices differ" << std::endl;
+			return false;
+		}
+		decodeSeconds = ms / 1000.0 / iterations;
+		asset.DecodeGBs = asset.NumIndices * sizeof(uint32_t) / decodeSeconds / 1e9;
+		return true;
+	}
+}
+
+std::vector<WarmupResult> FindAssets(const std::string& directory)
+{
+	std::string dir = directory;
+	if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+	{
+		dir += '/';
+	}
+
+	std::vector<WarmupResult> assets;
+	WIN32_FIND_DATAA data = {};
+	HANDLE find = FindFirstFileA((dir + "*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return assets;
+	}
+	do
+	{
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			continue;
+		}
+		const std::string path = dir + data.cFileName;
+		if (HasAnyExtension(path, MESH_EXTENSIONS))
+		{
+			assets.push_back({ path, WARMUP_MESH, false, 0.0, 0.0, 0, 0, 0.0 });
+		}
+		else if (HasAnyExtension(path, TEXTURE_EXTENSIONS))
+		{
+			assets.push_back({ path, WARMUP_TEXTURE, false, 0.0, 0.0, 0, 0, 0.0 });
+		}
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+
+	// listing order is up to the file system
+	std::sort(assets.begin(), assets.end(), [](const WarmupResult& a, const WarmupResult& b) { return a.Path < b.Path; });
+	return assets;
+}
+
+WarmupReport WarmAssetCache(const std::string& directory, const AssetCache& cache, unsigned int numThreads)
+{
+	WarmupReport report = {};
+	report.Assets = FindAssets(directory);
+	report.NumThreads = numThreads > 0 ? numThreads : DefaultThreadCount();
+
+	// Every asset is one task, the passes are timed as a whole and per asset
+	const auto runPass = [&](bool cold)
+	{
+		const Clock::time_point start = Clock::now();
+		RunParallel(report.Assets.size(), report.NumThreads, [&](size_t i)
+		{
+			// WIC (TIFF) needs COM on the thread, initializing it again is cheap
+			const bool comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+
+			WarmupResult& asset = report.Assets[i];
+			uint64_t sourceHash = 0;
+			if (cold && cache.HashSource(asset.Path, sourceHash))
+			{
+				cache.RemoveSource(sourceHash);
+			}
+			const Clock::time_point assetStart = Clock::now();
+			const bool succeeded = LoadAsset(asset, cache);
+			(cold ? asset.ColdMs : asset.WarmMs) = MillisecondsSince(assetStart);
+			asset.Succeeded = cold ? succeeded : asset.Succeeded && succeeded;
+
+			if (comInitialized)
+			{
+				CoUninitialize();
+			}
+		});
+		return MillisecondsSince(start);
+	};
+	report.ColdMs = runPass(true);
+	report.WarmMs = runPass(false);
+
+	// Alone, so the decode rate isn't shared with the other loads
+	double decodedBytes = 0.0;
+	double decodeSeconds = 0.0;
+	for (WarmupResult& asset : report.Assets)
+	{
+		if (asset.Kind != WARMUP_MESH || !asset.Succeeded)
+		{
+			continue;
+		}
+		double seconds = 0.0;
+		asset.Succeeded = MeasureIndexDecode(asset, cache, seconds);
+		decodedBytes += static_cast<double>(asset.NumIndices) * sizeof(uint32_t);
+		decodeSeconds += seconds;
+	}
+	report.DecodeGBs = decodeSeconds > 0.0 ? decodedBytes / decodeSeconds / 1e9 : 0.0;
+
+	report.EvictedBytes = cache.Evict(ASSET_CACHE_MAX_BYTES);
+	report.CacheBytes = cache.GetSize();
+	return report;
+}
+
+void PrintWarmupReport(const WarmupReport& report, FILE* out)
+{
+	fprintf(out, "%-40s %-8s %10s %10s %8s %12s %11s\n", "asset", "kind", "cold ms", "warm ms", "speedup",
+		"index B/idx", "decode GB/s");
+	for (const WarmupResult& asset : report.Assets)
+	{
+		const char* kind = asset.Kind == WARMUP_MESH ? "mesh" : "texture";
+		if (!asset.Succeeded)
+		{
+			fprintf(out, "%-40s %-8s %10s\n", asset.Path.c_str(), kind, "FAILED");
+			continue;
+		}
+		fprintf(out, "%-40s %-8s %10.2f %10.2f %7.1fx", asset.Path.c_str(), kind,
+			asset.ColdMs, asset.WarmMs, asset.WarmMs > 0.0 ? asset.ColdMs / asset.WarmMs : 0.0);
+		if (asset.Kind == WARMUP_MESH && asset.NumIndices > 0)
+		{
+			fprintf(out, " %12.2f %11.2f", static_cast<double>(asset.EncodedBytes) / asset.NumIndices, asset.DecodeGBs);
+		}
+		fprintf(out, "\n");
+	}
+	fprintf(out, "%zu assets on %u threads: cold %.2f ms, warm %.2f ms\n",
+		report.Assets.size(), report.NumThreads, report.ColdMs, report.WarmMs);
+	fprintf(out, "index decode %.2f GB/s over all meshes\n", report.DecodeGBs);
+	fprintf(out, "cache %llu KB, evicted %llu KB\n",
+		static_cast<unsigned long long>(report.CacheBytes / 1024), static_cast<unsigned long long>(report.EvictedBytes / 1024));
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "AssetCache.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum WarmupKind
+{
+	WARMUP_MESH,
+	WARMUP_TEXTURE
+};
+
+struct WarmupResult
+{
+	std::string	Path;
+	WarmupKind	Kind;
+	bool		Succeeded;
+	// load from the source including the cache write
+	double		ColdMs;
+	// load of the artifact the cold pass wrote
+	double		WarmMs;
+	// meshes, DecodeIndices over the cached index encoding, in decoded uint32_t bytes
+	size_t		NumIndices;
+	size_t		EncodedBytes;
+	double		DecodeGBs;
+};
+
+struct WarmupReport
+{
+	std::vector<WarmupResult>	Assets;
+	unsigned int				NumThreads;
+	// wall clock of each pass over all assets
+	double						ColdMs;
+	double						WarmMs;
+	uint64_t					CacheBytes;
+	uint64_t					EvictedBytes;
+	// all meshes, decoded bytes over decode time
+	double						DecodeGBs;
+};
+
+// Mesh and texture files in the directory, not recursing, sorted by path
+std::vector<WarmupResult> FindAssets(const std::string& directory);
+
+// Rebuilds the cached artifacts of every mesh and texture in the directory, not
+// recursing, on numThreads threads (0 uses every core). The cold pass drops what the
+// cache holds for each source before loading it, the warm pass loads everything
+// again from the cache, so both columns of the report are real load times. The index
+// decode of every mesh is then timed on its own, on one thread. The cache is evicted to
+// ASSET_CACHE_MAX_BYTES afterwards.
+WarmupReport WarmAssetCache(const std::string& directory, const AssetCache& cache, unsigned int numThreads = 0);
+
+void PrintWarmupReport(const WarmupReport& report, FILE* out);
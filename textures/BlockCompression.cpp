@@ -0,0 +1,842 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	constexpr uint32_t DDS_FOURCC_DX10 = 0x30315844; // "DX10"
+	constexpr uint32_t DDSD_CAPS = 0x1;
+	constexpr uint32_t DDSD_HEIGHT = 0x2;
+	constexpr uint32_t DDSD_WIDTH = 0x4;
+	constexpr uint32_t DDSD_PIXELFORMAT = 0x1000;
+	constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	constexpr uint32_t DDSD_LINEARSIZE = 0x80000;
+	constexpr uint32_t DDPF_FOURCC = 0x4;
+	constexpr uint32_t DDSCAPS_COMPLEX = 0x8;
+	constexpr uint32_t DDSCAPS_TEXTURE = 0x1000;
+	constexpr uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	struct DDSPixelFormat
+	{
+		uint32_t	Size;
+		uint32_t	Flags;
+		uint32_t	FourCC;
+		uint32_t	RGBBitCount;
+		uint32_t	RBitMask;
+		uint32_t	GBitMask;
+		uint32_t	BBitMask;
+		uint32_t	ABitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t		Size;
+		uint32_t		Flags;
+		uint32_t		Height;
+		uint32_t		Width;
+		uint32_t		PitchOrLinearSize;
+		uint32_t		Depth;
+		uint32_t		MipMapCount;
+		uint32_t		Reserved1[11];
+		DDSPixelFormat	PixelFormat;
+		uint32_t		Caps;
+		uint32_t		Caps2;
+		uint32_t		Caps3;
+		uint32_t		Caps4;
+		uint32_t		Reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		uint32_t	DXGIFormat;
+		uint32_t	ResourceDimension;
+		uint32_t	MiscFlag;
+		uint32_t	ArraySize;
+		uint32_t	MiscFlags2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header layout");
+	static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header layout");
+
+	// BC7 interpolation weights of 4 bit indices, out of 64
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// 16 texels of a block, channels in [0, 255] in the order the encoder works in
+	struct BlockColors
+	{
+		float	Texels[16][4];
+	};
+
+	uint32_t BlockCount(uint32_t size)
+	{
+		return (std::max)(1u, (size + 3) / 4);
+	}
+
+	uint32_t MipSize(uint32_t size, uint32_t level)
+	{
+		return (std::max)(1u, size >> level);
+	}
+
+	// Texels of the block at (bx, by), edges of levels smaller than a block repeat
+	void LoadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t (&bgra)[16][4])
+	{
+		for (uint32_t y = 0; y < 4; ++y)
+		{
+			const uint32_t sy = (std::min)(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; ++x)
+			{
+				const uint32_t sx = (std::min)(bx * 4 + x, width - 1);
+				memcpy(bgra[y * 4 + x], pixels + (size_t(sy) * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	void StoreBlock(const uint8_t (&bgra)[16][4], uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by)
+	{
+		for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+		{
+			for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+			{
+				memcpy(pixels + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, bgra[y * 4 + x], 4);
+			}
+		}
+	}
+
+	// Line through the block colors along their principal axis, start and end are the
+	// extreme projections of the texels
+	void FitPrincipalAxis(const BlockColors& block, int numChannels, float (&start)[4], float (&end)[4])
+	{
+		float mean[4] = {};
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < numChannels; ++c)
+				mean[c] += block.Texels[i][c] * (1.0f / 16.0f);
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+			for (int a = 0; a < numChannels; ++a)
+				for (int b = 0; b < numChannels; ++b)
+					covariance[a][b] += (block.Texels[i][a] - mean[a]) * (block.Texels[i][b] - mean[b]);
+
+		// power iteration converges quickly for the dominant axis
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (int a = 0; a < numChannels; ++a)
+			{
+				for (int b = 0; b < numChannels; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				length = (std::max)(length, std::abs(next[a]));
+			}
+			if (length < 1e-6f)
+				break;
+			for (int a = 0; a < numChannels; ++a)
+				axis[a] = next[a] / length;
+		}
+
+		float minT = std::numeric_limits<float>::max();
+		float maxT = -std::numeric_limits<float>::max();
+		float axisLength = 0.0f;
+		for (int c = 0; c < numChannels; ++c)
+			axisLength += axis[c] * axis[c];
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < numChannels; ++c)
+				t += (block.Texels[i][c] - mean[c]) * axis[c];
+			minT = (std::min)(minT, t);
+			maxT = (std::max)(maxT, t);
+		}
+		for (int c = 0; c < numChannels; ++c)
+		{
+			start[c] = mean[c] + axis[c] * minT / axisLength;
+			end[c] = mean[c] + axis[c] * maxT / axisLength;
+		}
+	}
+
+	// Endpoints that minimize the squared error of the texels for the given positions
+	// between them (0 is start, 1 is end). False when the positions don't determine them.
+	bool LeastSquaresEndpoints(const BlockColors& block, int numChannels, const float (&positions)[16], float (&start)[4], float (&end)[4])
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float b = positions[i];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < numChannels; ++c)
+			{
+				ax[c] += a * block.Texels[i][c];
+				bx[c] += b * block.Texels[i][c];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+		for (int c = 0; c < numChannels; ++c)
+		{
+			start[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+			end[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+		}
+		return true;
+	}
+
+	float Clamp255(float v)
+	{
+		return (std::min)(255.0f, (std::max)(0.0f, v));
+	}
+
+	int Expand5(int v)
+	{
+		return (v << 3) | (v >> 2);
+	}
+
+	int Expand6(int v)
+	{
+		return (v << 2) | (v >> 4);
+	}
+
+	// BGR floats to 5:6:5 with blue in the low bits
+	uint16_t Quantize565(const float (&bgr)[4])
+	{
+		const int b = static_cast<int>(Clamp255(bgr[0]) * 31.0f / 255.0f + 0.5f);
+		const int g = static_cast<int>(Clamp255(bgr[1]) * 63.0f / 255.0f + 0.5f);
+		const int r = static_cast<int>(Clamp255(bgr[2]) * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t c, int (&bgr)[3])
+	{
+		bgr[0] = Expand5(c & 31);
+		bgr[1] = Expand6((c >> 5) & 63);
+		bgr[2] = Expand5(c >> 11);
+	}
+
+	// The four colors of a BC1 block with c0 > c1, or three colors and black with c0 <= c1
+	void BC1Palette(uint16_t c0, uint16_t c1, bool fourColors, int (&palette)[4][4])
+	{
+		int e0[3];
+		int e1[3];
+		Unpack565(c0, e0);
+		Unpack565(c1, e1);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[0][c] = e0[c];
+			palette[1][c] = e1[c];
+			if (fourColors)
+			{
+				palette[2][c] = (2 * e0[c] + e1[c]) / 3;
+				palette[3][c] = (e0[c] + 2 * e1[c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (e0[c] + e1[c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = fourColors ? 255 : 0;
+	}
+
+	// Picks the closest palette entry for every texel, returns the squared error
+	template <int N>
+	float AssignIndices(const BlockColors& block, int numChannels, const int (&palette)[N][4], uint8_t (&indices)[16])
+	{
+		float total = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = std::numeric_limits<float>::max();
+			for (int p = 0; p < N; ++p)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < numChannels; ++c)
+				{
+					const float d = block.Texels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < best)
+				{
+					best = error;
+					indices[i] = static_cast<uint8_t>(p);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	// BC1 color block in four color mode, the color half of BC3 as well
+	void EncodeBC1(const uint8_t (&bgra)[16][4], uint8_t* out)
+	{
+		// position of the four palette entries between c0 and c1
+		static const float s_positions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		BlockColors block;
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 3; ++c)
+				block.Texels[i][c] = bgra[i][c];
+
+		float start[4];
+		float end[4];
+		FitPrincipalAxis(block, 3, start, end);
+
+		uint16_t best0 = 0;
+		uint16_t best1 = 0;
+		uint8_t bestIndices[16] = {};
+		float bestError = std::numeric_limits<float>::max();
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			uint16_t c0 = Quantize565(start);
+			uint16_t c1 = Quantize565(end);
+			if (c0 < c1)
+				std::swap(c0, c1);
+
+			uint8_t indices[16] = {};
+			float error;
+			if (c0 == c1)
+			{
+				// a single color, every texel takes c0
+				int bgr[3];
+				Unpack565(c0, bgr);
+				const int palette[1][4] = { { bgr[0], bgr[1], bgr[2], 255 } };
+				error = AssignIndices(block, 3, palette, indices);
+			}
+			else
+			{
+				int palette[4][4];
+				BC1Palette(c0, c1, true, palette);
+				error = AssignIndices(block, 3, palette, indices);
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best0 = c0;
+				best1 = c1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+			if (error == 0.0f || c0 == c1)
+				break;
+
+			float positions[16];
+			for (int i = 0; i < 16; ++i)
+				positions[i] = s_positions[indices[i]];
+			if (!LeastSquaresEndpoints(block, 3, positions, start, end))
+				break;
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= uint32_t(bestIndices[i]) << (2 * i);
+		memcpy(out, &best0, 2);
+		memcpy(out + 2, &best1, 2);
+		memcpy(out + 4, &bits, 4);
+	}
+
+	void DecodeBC1(const uint8_t* in, bool fourColorsOnly, uint8_t (&bgra)[16][4])
+	{
+		uint16_t c0;
+		uint16_t c1;
+		uint32_t bits;
+		memcpy(&c0, in, 2);
+		memcpy(&c1, in + 2, 2);
+		memcpy(&bits, in + 4, 4);
+		int palette[4][4];
+		BC1Palette(c0, c1, fourColorsOnly || c0 > c1, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int* color = palette[(bits >> (2 * i)) & 3];
+			for (int c = 0; c < 3; ++c)
+				bgra[i][c] = static_cast<uint8_t>(color[c]);
+			if (!fourColorsOnly)
+				bgra[i][3] = static_cast<uint8_t>(color[3]);
+		}
+	}
+
+	void BC4Palette(int a0, int a1, int (&palette)[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1)
+		{
+			for (int i = 2; i < 8; ++i)
+				palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; ++i)
+				palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// One channel block in the eight value mode, the alpha of BC3 and each half of BC5
+	void EncodeBC4(const uint8_t (&bgra)[16][4], int channel, uint8_t* out)
+	{
+		int a0 = 0;
+		int a1 = 255;
+		for (int i = 0; i < 16; ++i)
+		{
+			a0 = (std::max)(a0, int(bgra[i][channel]));
+			a1 = (std::min)(a1, int(bgra[i][channel]));
+		}
+
+		int palette[8];
+		BC4Palette(a0, a1, palette);
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+			for (int p = 1; p < 8; ++p)
+			{
+				if (std::abs(palette[p] - bgra[i][channel]) < std::abs(palette[best] - bgra[i][channel]))
+					best = p;
+			}
+			bits |= uint64_t(best) << (3 * i);
+		}
+		out[0] = static_cast<uint8_t>(a0);
+		out[1] = static_cast<uint8_t>(a1);
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	void DecodeBC4(const uint8_t* in, int channel, uint8_t (&bgra)[16][4])
+	{
+		int palette[8];
+		BC4Palette(in[0], in[1], palette);
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= uint64_t(in[2 + i]) << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			bgra[i][channel] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7]);
+	}
+
+	class BlockBitWriter
+	{
+	public:
+		explicit BlockBitWriter(uint8_t* out):
+			m_out(out)
+		{
+			memset(m_out, 0, 16);
+		}
+
+		void Write(uint32_t value, int count)
+		{
+			for (int i = 0; i < count; ++i, ++m_position)
+			{
+				if (value & (1u << i))
+					m_out[m_position >> 3] |= static_cast<uint8_t>(1u << (m_position & 7));
+			}
+		}
+
+	private:
+		uint8_t*	m_out;
+		int			m_position = 0;
+	};
+
+	class BlockBitReader
+	{
+	public:
+		explicit BlockBitReader(const uint8_t* in):
+			m_in(in)
+		{
+		}
+
+		uint32_t Read(int count)
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < count; ++i, ++m_position)
+				value |= uint32_t((m_in[m_position >> 3] >> (m_position & 7)) & 1) << i;
+			return value;
+		}
+
+	private:
+		const uint8_t*	m_in;
+		int				m_position = 0;
+	};
+
+	// RGBA 7 bit endpoints each with its own p-bit, closest to the float endpoint
+	void QuantizeBC7Endpoint(const float (&rgba)[4], int (&quantized)[4], int& pBit)
+	{
+		float bestError = std::numeric_limits<float>::max();
+		for (int p = 0; p < 2; ++p)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				candidate[c] = (std::min)(127, (std::max)(0, static_cast<int>((Clamp255(rgba[c]) - p) * 0.5f + 0.5f)));
+				const float d = float(candidate[c] * 2 + p) - rgba[c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	void BC7Mode6Palette(const int (&e0)[4], int p0, const int (&e1)[4], int p1, int (&palette)[16][4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			const int v0 = e0[c] * 2 + p0;
+			const int v1 = e1[c] * 2 + p1;
+			for (int i = 0; i < 16; ++i)
+				palette[i][c] = ((64 - BC7_WEIGHTS[i]) * v0 + BC7_WEIGHTS[i] * v1 + 32) >> 6;
+		}
+	}
+
+	void EncodeBC7(const uint8_t (&bgra)[16][4], uint8_t* out)
+	{
+		BlockColors block;
+		for (int i = 0; i < 16; ++i)
+		{
+			block.Texels[i][0] = bgra[i][2];
+			block.Texels[i][1] = bgra[i][1];
+			block.Texels[i][2] = bgra[i][0];
+			block.Texels[i][3] = bgra[i][3];
+		}
+
+		float start[4];
+		float end[4];
+		FitPrincipalAxis(block, 4, start, end);
+
+		int best0[4] = {};
+		int best1[4] = {};
+		int bestP0 = 0;
+		int bestP1 = 0;
+		uint8_t bestIndices[16] = {};
+		float bestError = std::numeric_limits<float>::max();
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			int e0[4];
+			int e1[4];
+			int p0;
+			int p1;
+			QuantizeBC7Endpoint(start, e0, p0);
+			QuantizeBC7Endpoint(end, e1, p1);
+			int palette[16][4];
+			BC7Mode6Palette(e0, p0, e1, p1, palette);
+			uint8_t indices[16];
+			const float error = AssignIndices(block, 4, palette, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(best0, e0, sizeof(e0));
+				memcpy(best1, e1, sizeof(e1));
+				bestP0 = p0;
+				bestP1 = p1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+			if (error == 0.0f)
+				break;
+
+			float positions[16];
+			for (int i = 0; i < 16; ++i)
+				positions[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+			if (!LeastSquaresEndpoints(block, 4, positions, start, end))
+				break;
+		}
+
+		// the first index is stored without its top bit
+		if (bestIndices[0] >= 8)
+		{
+			std::swap(best0, best1);
+			std::swap(bestP0, bestP1);
+			for (uint8_t& index : bestIndices)
+				index = static_cast<uint8_t>(15 - index);
+		}
+
+		BlockBitWriter writer(out);
+		writer.Write(1u << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Write(best0[c], 7);
+			writer.Write(best1[c], 7);
+		}
+		writer.Write(bestP0, 1);
+		writer.Write(bestP1, 1);
+		writer.Write(bestIndices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.Write(bestIndices[i], 4);
+	}
+
+	// Only mode 6, the one EncodeBC7 writes
+	void DecodeBC7(const uint8_t* in, uint8_t (&bgra)[16][4])
+	{
+		BlockBitReader reader(in);
+		if (reader.Read(7) != (1u << 6))
+		{
+			memset(bgra, 0, sizeof(bgra));
+			return;
+		}
+		int e0[4];
+		int e1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			e0[c] = static_cast<int>(reader.Read(7));
+			e1[c] = static_cast<int>(reader.Read(7));
+		}
+		const int p0 = static_cast<int>(reader.Read(1));
+		const int p1 = static_cast<int>(reader.Read(1));
+		int palette[16][4];
+		BC7Mode6Palette(e0, p0, e1, p1, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int* rgba = palette[reader.Read(i == 0 ? 3 : 4)];
+			bgra[i][0] = static_cast<uint8_t>(rgba[2]);
+			bgra[i][1] = static_cast<uint8_t>(rgba[1]);
+			bgra[i][2] = static_cast<uint8_t>(rgba[0]);
+			bgra[i][3] = static_cast<uint8_t>(rgba[3]);
+		}
+	}
+
+	void EncodeBlock(BlockFormat format, const uint8_t (&bgra)[16][4], uint8_t* out)
+	{
+		switch (format)
+		{
+		case BLOCK_FORMAT_BC1:
+			EncodeBC1(bgra, out);
+			break;
+		case BLOCK_FORMAT_BC3:
+			EncodeBC4(bgra, 3, out);
+			EncodeBC1(bgra, out + 8);
+			break;
+		case BLOCK_FORMAT_BC5:
+			EncodeBC4(bgra, 2, out);
+			EncodeBC4(bgra, 1, out + 8);
+			break;
+		case BLOCK_FORMAT_BC7:
+			EncodeBC7(bgra, out);
+			break;
+		}
+	}
+
+	void DecodeBlock(BlockFormat format, const uint8_t* in, uint8_t (&bgra)[16][4])
+	{
+		switch (format)
+		{
+		case BLOCK_FORMAT_BC1:
+			DecodeBC1(in, false, bgra);
+			break;
+		case BLOCK_FORMAT_BC3:
+			DecodeBC4(in, 3, bgra);
+			DecodeBC1(in + 8, true, bgra);
+			break;
+		case BLOCK_FORMAT_BC5:
+			DecodeBC4(in, 2, bgra);
+			DecodeBC4(in + 8, 1, bgra);
+			for (int i = 0; i < 16; ++i)
+			{
+				bgra[i][0] = 0;
+				bgra[i][3] = 255;
+			}
+			break;
+		case BLOCK_FORMAT_BC7:
+			DecodeBC7(in, bgra);
+			break;
+		}
+	}
+}
+
+DXGI_FORMAT GetBlockDXGIFormat(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_FORMAT_BC1: return DXGI_FORMAT_BC1_UNORM_SRGB;
+	case BLOCK_FORMAT_BC3: return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case BLOCK_FORMAT_BC5: return DXGI_FORMAT_BC5_UNORM;
+	case BLOCK_FORMAT_BC7: return DXGI_FORMAT_BC7_UNORM_SRGB;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+size_t GetBlockBytes(BlockFormat format)
+{
+	return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+const char* GetBlockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_FORMAT_BC1: return "BC1";
+	case BLOCK_FORMAT_BC3: return "BC3";
+	case BLOCK_FORMAT_BC5: return "BC5";
+	case BLOCK_FORMAT_BC7: return "BC7";
+	}
+	return "?";
+}
+
+bool CanBlockCompress(uint32_t width, uint32_t height)
+{
+	return width > 0 && height > 0 && width % 4 == 0 && height % 4 == 0;
+}
+
+size_t GetBlockLevelOffset(BlockFormat format, uint32_t width, uint32_t height, uint32_t level)
+{
+	size_t offset = 0;
+	for (uint32_t l = 0; l < level; ++l)
+		offset += size_t(BlockCount(MipSize(width, l))) * BlockCount(MipSize(height, l)) * GetBlockBytes(format);
+	return offset;
+}
+
+CompressedTexture CompressTexture(const TextureData& texture, BlockFormat format, unsigned int numThreads)
+{
+	CompressedTexture compressed;
+	compressed.Format = format;
+	compressed.Width = texture.Width;
+	compressed.Height = texture.Height;
+	compressed.MipLevels = texture.MipLevels;
+	compressed.Blocks.resize(GetBlockLevelOffset(format, texture.Width, texture.Height, texture.MipLevels));
+
+	// One task per row of blocks, over all levels
+	struct BlockRow
+	{
+		uint32_t	Level;
+		uint32_t	Row;
+	};
+	std::vector<BlockRow> rows;
+	for (uint32_t level = 0; level < texture.MipLevels; ++level)
+	{
+		for (uint32_t row = 0; row < BlockCount(MipSize(texture.Height, level)); ++row)
+			rows.push_back({ level, row });
+	}
+
+	const size_t blockBytes = GetBlockBytes(format);
+	RunParallel(rows.size(), numThreads > 0 ? numThreads : DefaultThreadCount(), [&](size_t i)
+	{
+		const uint32_t level = rows[i].Level;
+		const uint32_t width = MipSize(texture.Width, level);
+		const uint32_t height = MipSize(texture.Height, level);
+		const uint8_t* pixels = texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level);
+		uint8_t* out = compressed.Blocks.data() + GetBlockLevelOffset(format, texture.Width, texture.Height, level)
+			+ size_t(rows[i].Row) * BlockCount(width) * blockBytes;
+		for (uint32_t bx = 0; bx < BlockCount(width); ++bx)
+		{
+			uint8_t bgra[16][4];
+			LoadBlock(pixels, width, height, bx, rows[i].Row, bgra);
+			EncodeBlock(format, bgra, out + bx * blockBytes);
+		}
+	});
+	return compressed;
+}
+
+TextureData DecompressTexture(const CompressedTexture& texture)
+{
+	TextureData decoded;
+	decoded.Width = texture.Width;
+	decoded.Height = texture.Height;
+	decoded.MipLevels = texture.MipLevels;
+	decoded.Pixels.resize(GetMipOffset(texture.Width, texture.Height, texture.MipLevels));
+
+	const size_t blockBytes = GetBlockBytes(texture.Format);
+	for (uint32_t level = 0; level < texture.MipLevels; ++level)
+	{
+		const uint32_t width = MipSize(texture.Width, level);
+		const uint32_t height = MipSize(texture.Height, level);
+		const uint8_t* in = texture.Blocks.data() + GetBlockLevelOffset(texture.Format, texture.Width, texture.Height, level);
+		uint8_t* pixels = decoded.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level);
+		for (uint32_t by = 0; by < BlockCount(height); ++by)
+		{
+			for (uint32_t bx = 0; bx < BlockCount(width); ++bx, in += blockBytes)
+			{
+				uint8_t bgra[16][4];
+				memset(bgra, 255, sizeof(bgra));
+				DecodeBlock(texture.Format, in, bgra);
+				StoreBlock(bgra, pixels, width, height, bx, by);
+			}
+		}
+	}
+	return decoded;
+}
+
+double ComputePSNR(const TextureData& original, const TextureData& decoded, BlockFormat format)
+{
+	// BGRA byte order of the channels each format keeps
+	static const bool s_channels[][4] = {
+		{ true, true, true, false },	// BC1
+		{ true, true, true, true },		// BC3
+		{ false, true, true, false },	// BC5
+		{ true, true, true, true }		// BC7
+	};
+	const bool (&channels)[4] = s_channels[format];
+
+	double squaredError = 0.0;
+	size_t count = 0;
+	const size_t texels = size_t(original.Width) * original.Height;
+	for (size_t i = 0; i < texels; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			if (!channels[c])
+				continue;
+			const double d = double(original.Pixels[i * 4 + c]) - decoded.Pixels[i * 4 + c];
+			squaredError += d * d;
+			++count;
+		}
+	}
+	if (squaredError == 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / (squaredError / count));
+}
+
+std::vector<uint8_t> BuildDDSFile(const CompressedTexture& texture)
+{
+	DDSHeader header = {};
+	header.Size = sizeof(DDSHeader);
+	header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.Height = texture.Height;
+	header.Width = texture.Width;
+	header.PitchOrLinearSize = static_cast<uint32_t>(GetBlockLevelOffset(texture.Format, texture.Width, texture.Height, 1));
+	header.MipMapCount = texture.MipLevels;
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = DDPF_FOURCC;
+	header.PixelFormat.FourCC = DDS_FOURCC_DX10;
+	header.Caps = DDSCAPS_TEXTURE | (texture.MipLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	DDSHeaderDX10 dx10 = {};
+	dx10.DXGIFormat = GetBlockDXGIFormat(texture.Format);
+	dx10.ResourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+	dx10.ArraySize = 1;
+
+	std::vector<uint8_t> file(sizeof(DDS_MAGIC) + sizeof(header) + sizeof(dx10) + texture.Blocks.size());
+	uint8_t* out = file.data();
+	memcpy(out, &DDS_MAGIC, sizeof(DDS_MAGIC));
+	memcpy(out + sizeof(DDS_MAGIC), &header, sizeof(header));
+	memcpy(out + sizeof(DDS_MAGIC) + sizeof(header), &dx10, sizeof(dx10));
+	std::copy(texture.Blocks.begin(), texture.Blocks.end(), file.begin() + sizeof(DDS_MAGIC) + sizeof(header) + sizeof(dx10));
+	return file;
+}
+
+bool ReadDDSDescription(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, uint32_t& mipLevels)
+{
+	uint32_t magic;
+	DDSHeader header;
+	if (size < sizeof(magic) + sizeof(header))
+		return false;
+	memcpy(&magic, data, sizeof(magic));
+	memcpy(&header, data + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC || header.Size != sizeof(DDSHeader) || header.Width == 0 || header.Height == 0)
+		return false;
+
+	width = header.Width;
+	height = header.Height;
+	mipLevels = (std::max)(1u, header.MipMapCount);
+	return true;
+}
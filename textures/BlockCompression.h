@@ -0,0 +1,55 @@
+#pragma once
+
+#include "TextureCache.h"
+
+#include <d3d11.h>
+
+#include <cstdint>
+#include <vector>
+
+enum BlockFormat
+{
+	// opaque color, 4 bits per texel
+	BLOCK_FORMAT_BC1,
+	// color with alpha, BC1 color plus a BC4 alpha block, 8 bits per texel
+	BLOCK_FORMAT_BC3,
+	// two channel normal maps, X from red and Y from green, 8 bits per texel
+	BLOCK_FORMAT_BC5,
+	// high quality color and alpha, 8 bits per texel
+	BLOCK_FORMAT_BC7
+};
+
+// Rows of 4x4 blocks of every level of the mip chain, one level after another
+struct CompressedTexture
+{
+	BlockFormat				Format = BLOCK_FORMAT_BC1;
+	uint32_t				Width = 0;
+	uint32_t				Height = 0;
+	uint32_t				MipLevels = 1;
+	std::vector<uint8_t>	Blocks;
+};
+
+// sRGB variants for the color formats, BC5 stays linear
+DXGI_FORMAT GetBlockDXGIFormat(BlockFormat format);
+size_t GetBlockBytes(BlockFormat format);
+const char* GetBlockFormatName(BlockFormat format);
+// D3D11 needs the top level of a block compressed texture in whole blocks
+bool CanBlockCompress(uint32_t width, uint32_t height);
+// Byte offset of the level in CompressedTexture::Blocks
+size_t GetBlockLevelOffset(BlockFormat format, uint32_t width, uint32_t height, uint32_t level);
+
+// Encodes every level of the texture, the rows of blocks run on numThreads threads
+// (0 uses every core). BC1 and BC3 fit the endpoints along the principal axis of the
+// block colors and refine them by least squares, BC7 does the same in RGBA with mode 6
+// only, a single subset with 16 index levels.
+CompressedTexture CompressTexture(const TextureData& texture, BlockFormat format, unsigned int numThreads = 0);
+// Decodes what CompressTexture writes back into BGRA8, for measuring the quality
+TextureData DecompressTexture(const CompressedTexture& texture);
+// Peak signal to noise ratio in dB over the top level and the channels the format
+// stores, infinite for identical images
+double ComputePSNR(const TextureData& original, const TextureData& decoded, BlockFormat format);
+
+// Contents of a .dds file with a DX10 header that DDSTextureLoader reads
+std::vector<uint8_t> BuildDDSFile(const CompressedTexture& texture);
+// Size and levels from a .dds file, false when it isn't one
+bool ReadDDSDescription(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, uint32_t& mipLevels);
@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "CommandExecutor.h"
+
+using namespace Render;
+
+ResourceId D3D11CommandExecutor::AddBuffer(ID3D11Buffer* buffer)
+{
+    return Add(buffer);
+}
+
+ResourceId D3D11CommandExecutor::AddInputLayout(ID3D11InputLayout* layout)
+{
+    return Add(layout);
+}
+
+ResourceId D3D11CommandExecutor::AddVertexShader(ID3D11VertexShader* shader)
+{
+    return Add(shader);
+}
+
+ResourceId D3D11CommandExecutor::AddPixelShader(ID3D11PixelShader* shader)
+{
+    return Add(shader);
+}
+
+ResourceId D3D11CommandExecutor::AddSampler(ID3D11SamplerState* sampler)
+{
+    return Add(sampler);
+}
+
+ResourceId D3D11CommandExecutor::AddShaderResource(ID3D11ShaderResourceView* view)
+{
+    return Add(view);
+}
+
+void D3D11CommandExecutor::Execute(ID3D11DeviceContext1* context, const CommandList& commands)
+{
+    m_filter.ResetStats();
+    Command command;
+    for (size_t offset = 0; commands.Read(offset, command);)
+    {
+        if (!m_filter.ShouldIssue(command))
+            continue;
+
+        switch (command.Type)
+        {
+        case COMMAND_SET_VERTEX_BUFFER:
+        {
+            const SetVertexBufferCommand& set = *static_cast<const SetVertexBufferCommand*>(command.Data);
+            ID3D11Buffer* buffer = Get<ID3D11Buffer>(set.Buffer);
+            context->IASetVertexBuffers(set.Slot, 1, &buffer, &set.Stride, &set.Offset);
+            break;
+        }
+        case COMMAND_SET_INDEX_BUFFER:
+        {
+            const SetIndexBufferCommand& set = *static_cast<const SetIndexBufferCommand*>(command.Data);
+            context->IASetIndexBuffer(Get<ID3D11Buffer>(set.Buffer), set.Format, set.Offset);
+            break;
+        }
+        case COMMAND_SET_INPUT_LAYOUT:
+            context->IASetInputLayout(Get<ID3D11InputLayout>(static_cast<const SetResourceCommand*>(command.Data)->Resource));
+            break;
+        case COMMAND_SET_TOPOLOGY:
+            context->IASetPrimitiveTopology(static_cast<const SetTopologyCommand*>(command.Data)->Topology);
+            break;
+        case COMMAND_SET_VERTEX_SHADER:
+            context->VSSetShader(Get<ID3D11VertexShader>(static_cast<const SetResourceCommand*>(command.Data)->Resource), nullptr, 0);
+            break;
+        case COMMAND_SET_PIXEL_SHADER:
+            context->PSSetShader(Get<ID3D11PixelShader>(static_cast<const SetResourceCommand*>(command.Data)->Resource), nullptr, 0);
+            break;
+        case COMMAND_SET_CONSTANT_BUFFER:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            ID3D11Buffer* buffer = Get<ID3D11Buffer>(set.Resource);
+            if (set.Stage == SHADER_STAGE_VERTEX)
+                context->VSSetConstantBuffers(set.Slot, 1, &buffer);
+            else
+                context->PSSetConstantBuffers(set.Slot, 1, &buffer);
+            break;
+        }
+        case COMMAND_SET_CONSTANT_BUFFER_RANGE:
+        {
+            const SetConstantBufferRangeCommand& set = *static_cast<const SetConstantBufferRangeCommand*>(command.Data);
+            ID3D11Buffer* buffer = Get<ID3D11Buffer>(set.Buffer);
+            if (set.Stage == SHADER_STAGE_VERTEX)
+                context->VSSetConstantBuffers1(set.Slot, 1, &buffer, &set.FirstConstant, &set.ConstantCount);
+            else
+                context->PSSetConstantBuffers1(set.Slot, 1, &buffer, &set.FirstConstant, &set.ConstantCount);
+            break;
+        }
+        case COMMAND_SET_SAMPLER:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            ID3D11SamplerState* sampler = Get<ID3D11SamplerState>(set.Resource);
+            if (set.Stage == SHADER_STAGE_VERTEX)
+                context->VSSetSamplers(set.Slot, 1, &sampler);
+            else
+                context->PSSetSamplers(set.Slot, 1, &sampler);
+            break;
+        }
+        case COMMAND_SET_SHADER_RESOURCE:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            ID3D11ShaderResourceView* view = Get<ID3D11ShaderResourceView>(set.Resource);
+            if (set.Stage == SHADER_STAGE_VERTEX)
+                context->VSSetShaderResources(set.Slot, 1, &view);
+            else
+                context->PSSetShaderResources(set.Slot, 1, &view);
+            break;
+        }
+        case COMMAND_UPDATE_CONSTANTS:
+        {
+            const UpdateConstantsCommand& update = *static_cast<const UpdateConstantsCommand*>(command.Data);
+            ID3D11Buffer* buffer = Get<ID3D11Buffer>(update.Buffer);
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            DX::ThrowIfFailed(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+            memcpy(mapped.pData, &update + 1, update.Size);
+            context->Unmap(buffer, 0);
+            break;
+        }
+        case COMMAND_UPDATE_BUFFER:
+        {
+            const UpdateBufferCommand& update = *static_cast<const UpdateBufferCommand*>(command.Data);
+            ID3D11Buffer* buffer = Get<ID3D11Buffer>(update.Buffer);
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            const D3D11_MAP map = update.Mode == BUFFER_UPDATE_DISCARD ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+            DX::ThrowIfFailed(context->Map(buffer, 0, map, 0, &mapped));
+            memcpy(static_cast<uint8_t*>(mapped.pData) + update.Offset, &update + 1, update.Size);
+            context->Unmap(buffer, 0);
+            break;
+        }
+        case COMMAND_DRAW_INDEXED:
+        {
+            const DrawIndexedCommand& draw = *static_cast<const DrawIndexedCommand*>(command.Data);
+            context->DrawIndexed(draw.IndexCount, draw.StartIndex, draw.BaseVertex);
+            break;
+        }
+        case COMMAND_DRAW_INDEXED_INSTANCED:
+        {
+            const DrawIndexedInstancedCommand& draw = *static_cast<const DrawIndexedInstancedCommand*>(command.Data);
+            context->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.StartIndex, draw.BaseVertex, draw.StartInstance);
+            break;
+        }
+        default:
+            assert(false);
+            break;
+        }
+    }
+}
+
+const StateFilterStats& D3D11CommandExecutor::GetStats() const
+{
+    return m_filter.GetStats();
+}
+
+void D3D11CommandExecutor::InvalidateState()
+{
+    m_filter.Invalidate();
+}
+
+void D3D11CommandExecutor::Clear()
+{
+    m_resources.clear();
+    m_filter.Invalidate();
+}
+
+ResourceId D3D11CommandExecutor::Add(ID3D11DeviceChild* resource)
+{
+    m_resources.emplace_back(resource);
+    return static_cast<ResourceId>(m_resources.size() - 1);
+}
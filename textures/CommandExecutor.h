@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CommandList.h"
+#include "StateFilter.h"
+
+#include <vector>
+
+namespace Render
+{
+    // Replays command lists on a D3D11 context. Resources are added once and named by the
+    // id Add* returns; the executor holds a reference to each until Clear. Binds that would
+    // set what the context already holds are dropped.
+    class D3D11CommandExecutor
+    {
+    public:
+        ResourceId AddBuffer(ID3D11Buffer* buffer);
+        ResourceId AddInputLayout(ID3D11InputLayout* layout);
+        ResourceId AddVertexShader(ID3D11VertexShader* shader);
+        ResourceId AddPixelShader(ID3D11PixelShader* shader);
+        ResourceId AddSampler(ID3D11SamplerState* sampler);
+        ResourceId AddShaderResource(ID3D11ShaderResourceView* view);
+
+        // Constant updates map the buffer with WRITE_DISCARD, buffer updates as they say; the
+        // buffers have to be dynamic. Constant buffer ranges are bound with VSSetConstantBuffers1
+        // and PSSetConstantBuffers1, the device has to support offsets.
+        void Execute(ID3D11DeviceContext1* context, const CommandList& commands);
+
+        // Binds of the last Execute
+        const StateFilterStats& GetStats() const;
+        // For when something else has bound on the context since the last Execute
+        void InvalidateState();
+
+        void Clear();
+
+    private:
+        ResourceId Add(ID3D11DeviceChild* resource);
+
+        template <typename T>
+        T* Get(ResourceId id) const
+        {
+            return id == NULL_RESOURCE ? nullptr : static_cast<T*>(m_resources[id].Get());
+        }
+
+        std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceChild>> m_resources;
+        RedundantStateFilter                                    m_filter;
+    };
+}
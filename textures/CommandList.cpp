@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "CommandList.h"
+
+#include <algorithm>
+
+using namespace Render;
+
+void CommandList::SetVertexBuffer(uint32_t slot, ResourceId buffer, uint32_t stride, uint32_t offset)
+{
+    Append(COMMAND_SET_VERTEX_BUFFER, SetVertexBufferCommand{ slot, buffer, stride, offset });
+}
+
+void CommandList::SetIndexBuffer(ResourceId buffer, DXGI_FORMAT format, uint32_t offset)
+{
+    Append(COMMAND_SET_INDEX_BUFFER, SetIndexBufferCommand{ buffer, format, offset });
+}
+
+void CommandList::SetInputLayout(ResourceId layout)
+{
+    Append(COMMAND_SET_INPUT_LAYOUT, SetResourceCommand{ layout });
+}
+
+void CommandList::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    Append(COMMAND_SET_TOPOLOGY, SetTopologyCommand{ topology });
+}
+
+void CommandList::SetVertexShader(ResourceId shader)
+{
+    Append(COMMAND_SET_VERTEX_SHADER, SetResourceCommand{ shader });
+}
+
+void CommandList::SetPixelShader(ResourceId shader)
+{
+    Append(COMMAND_SET_PIXEL_SHADER, SetResourceCommand{ shader });
+}
+
+void CommandList::SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceId buffer)
+{
+    Append(COMMAND_SET_CONSTANT_BUFFER, SetSlotCommand{ stage, slot, buffer });
+}
+
+void CommandList::SetConstantBufferRange(ShaderStage stage, uint32_t slot, ResourceId buffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    Append(COMMAND_SET_CONSTANT_BUFFER_RANGE, SetConstantBufferRangeCommand{ stage, slot, buffer, firstConstant, constantCount });
+}
+
+void CommandList::SetSampler(ShaderStage stage, uint32_t slot, ResourceId sampler)
+{
+    Append(COMMAND_SET_SAMPLER, SetSlotCommand{ stage, slot, sampler });
+}
+
+void CommandList::SetShaderResource(ShaderStage stage, uint32_t slot, ResourceId view)
+{
+    Append(COMMAND_SET_SHADER_RESOURCE, SetSlotCommand{ stage, slot, view });
+}
+
+void CommandList::UpdateConstants(ResourceId buffer, const void* data, uint32_t size)
+{
+    uint8_t* payload = static_cast<uint8_t*>(Append(COMMAND_UPDATE_CONSTANTS, sizeof(UpdateConstantsCommand) + size));
+    *reinterpret_cast<UpdateConstantsCommand*>(payload) = { buffer, size };
+    memcpy(payload + sizeof(UpdateConstantsCommand), data, size);
+}
+
+void CommandList::UpdateBuffer(ResourceId buffer, uint32_t offset, const void* data, uint32_t size, BufferUpdate mode)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (uint32_t done = 0; done < size;)
+    {
+        const uint32_t chunk = (std::min)(size - done, MAX_UPDATE_BYTES);
+        uint8_t* payload = static_cast<uint8_t*>(Append(COMMAND_UPDATE_BUFFER, sizeof(UpdateBufferCommand) + chunk));
+        *reinterpret_cast<UpdateBufferCommand*>(payload) = { buffer, offset + done, chunk,
+            done == 0 ? mode : BUFFER_UPDATE_NO_OVERWRITE };
+        memcpy(payload + sizeof(UpdateBufferCommand), bytes + done, chunk);
+        done += chunk;
+    }
+}
+
+void CommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    Append(COMMAND_DRAW_INDEXED, DrawIndexedCommand{ indexCount, startIndex, baseVertex });
+}
+
+void CommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+    uint32_t startInstance)
+{
+    Append(COMMAND_DRAW_INDEXED_INSTANCED,
+        DrawIndexedInstancedCommand{ indexCount, instanceCount, startIndex, baseVertex, startInstance });
+}
+
+void CommandList::Reset()
+{
+    m_words.clear();
+    m_commandCount = 0;
+}
+
+bool CommandList::Read(size_t& offset, Command& command) const
+{
+    if (offset >= m_words.size())
+    {
+        return false;
+    }
+    const CommandHeader& header = *reinterpret_cast<const CommandHeader*>(&m_words[offset]);
+    command.Type = header.Type;
+    command.Data = &m_words[offset + 1];
+    offset += 1 + header.PayloadWords;
+    return true;
+}
+
+size_t CommandList::GetCommandCount() const
+{
+    return m_commandCount;
+}
+
+size_t CommandList::GetSizeInBytes() const
+{
+    return m_words.size() * sizeof(uint32_t);
+}
+
+void* CommandList::Append(CommandType type, size_t payloadSize)
+{
+    static_assert(sizeof(CommandHeader) == sizeof(uint32_t), "A command header is one word");
+
+    const size_t payloadWords = (payloadSize + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    if (payloadWords > UINT16_MAX)
+    {
+        throw std::runtime_error("CommandList: command too large");
+    }
+
+    const size_t offset = m_words.size();
+    m_words.resize(offset + 1 + payloadWords);
+    CommandHeader& header = *reinterpret_cast<CommandHeader*>(&m_words[offset]);
+    header = { type, 0, static_cast<uint16_t>(payloadWords) };
+    ++m_commandCount;
+    return &m_words[offset + 1];
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <d3d11.h>
+
+namespace Render
+{
+    // Commands name resources by their index in the table of the backend that runs them,
+    // so a command list is plain data and replays on any backend that has the same table
+    using ResourceId = uint32_t;
+    constexpr ResourceId NULL_RESOURCE = UINT32_MAX;
+
+    enum ShaderStage : uint32_t
+    {
+        SHADER_STAGE_VERTEX,
+        SHADER_STAGE_PIXEL,
+        SHADER_STAGE_COUNT
+    };
+
+    // D3D11 slot counts of the input assembler and per shader stage
+    constexpr uint32_t MAX_VERTEX_BUFFER_SLOTS = 32;
+    constexpr uint32_t MAX_CONSTANT_BUFFER_SLOTS = 14;
+    constexpr uint32_t MAX_SAMPLER_SLOTS = 16;
+    constexpr uint32_t MAX_SHADER_RESOURCE_SLOTS = 128;
+
+    enum CommandType : uint8_t
+    {
+        COMMAND_SET_VERTEX_BUFFER,
+        COMMAND_SET_INDEX_BUFFER,
+        COMMAND_SET_INPUT_LAYOUT,
+        COMMAND_SET_TOPOLOGY,
+        COMMAND_SET_VERTEX_SHADER,
+        COMMAND_SET_PIXEL_SHADER,
+        COMMAND_SET_CONSTANT_BUFFER,
+        // part of a constant buffer, needs a D3D11.1 context and hardware that offsets
+        COMMAND_SET_CONSTANT_BUFFER_RANGE,
+        COMMAND_SET_SAMPLER,
+        COMMAND_SET_SHADER_RESOURCE,
+        // the contents of a whole constant buffer, stored in the command list
+        COMMAND_UPDATE_CONSTANTS,
+        // part of a dynamic buffer, stored in the command list
+        COMMAND_UPDATE_BUFFER,
+        COMMAND_DRAW_INDEXED,
+        COMMAND_DRAW_INDEXED_INSTANCED,
+        COMMAND_TYPE_COUNT
+    };
+
+    // Every command is a header followed by its payload, padded to whole words
+    struct CommandHeader
+    {
+        CommandType Type;
+        uint8_t     Reserved;
+        uint16_t    PayloadWords;
+    };
+
+    struct SetVertexBufferCommand
+    {
+        uint32_t    Slot;
+        ResourceId  Buffer;
+        uint32_t    Stride;
+        uint32_t    Offset;
+    };
+
+    struct SetIndexBufferCommand
+    {
+        ResourceId  Buffer;
+        DXGI_FORMAT Format;
+        uint32_t    Offset;
+    };
+
+    struct SetTopologyCommand
+    {
+        D3D11_PRIMITIVE_TOPOLOGY Topology;
+    };
+
+    // Input layouts and shaders
+    struct SetResourceCommand
+    {
+        ResourceId  Resource;
+    };
+
+    // Constant buffers, samplers and shader resource views of a stage
+    struct SetSlotCommand
+    {
+        ShaderStage Stage;
+        uint32_t    Slot;
+        ResourceId  Resource;
+    };
+
+    // FirstConstant and ConstantCount are in 16 byte constants and multiples of 16
+    struct SetConstantBufferRangeCommand
+    {
+        ShaderStage Stage;
+        uint32_t    Slot;
+        ResourceId  Buffer;
+        uint32_t    FirstConstant;
+        uint32_t    ConstantCount;
+    };
+
+    // Followed by Size bytes of constants
+    struct UpdateConstantsCommand
+    {
+        ResourceId  Buffer;
+        uint32_t    Size;
+    };
+
+    enum BufferUpdate : uint32_t
+    {
+        // the buffer starts over, nothing it held before is kept
+        BUFFER_UPDATE_DISCARD,
+        // the range isn't one the GPU may still read, the rest of the buffer stays
+        BUFFER_UPDATE_NO_OVERWRITE
+    };
+
+    // Followed by Size bytes for the buffer from Offset on
+    struct UpdateBufferCommand
+    {
+        ResourceId      Buffer;
+        uint32_t        Offset;
+        uint32_t        Size;
+        BufferUpdate    Mode;
+    };
+
+    struct DrawIndexedCommand
+    {
+        uint32_t    IndexCount;
+        uint32_t    StartIndex;
+        int32_t     BaseVertex;
+    };
+
+    struct DrawIndexedInstancedCommand
+    {
+        uint32_t    IndexCount;
+        uint32_t    InstanceCount;
+        uint32_t    StartIndex;
+        int32_t     BaseVertex;
+        uint32_t    StartInstance;
+    };
+
+    struct Command
+    {
+        CommandType Type;
+        // one of the command structs above
+        const void* Data;
+    };
+
+    // Bytes of one buffer update command, a header describes no more than 256 KB
+    constexpr uint32_t MAX_UPDATE_BYTES = 64 * 1024;
+
+    // Draws, binds and constant updates of a frame in one linear buffer, recorded once and
+    // replayed by a backend. Reset keeps the memory for the next frame.
+    class CommandList
+    {
+    public:
+        void SetVertexBuffer(uint32_t slot, ResourceId buffer, uint32_t stride, uint32_t offset);
+        void SetIndexBuffer(ResourceId buffer, DXGI_FORMAT format, uint32_t offset);
+        void SetInputLayout(ResourceId layout);
+        void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+        void SetVertexShader(ResourceId shader);
+        void SetPixelShader(ResourceId shader);
+        void SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceId buffer);
+        void SetConstantBufferRange(ShaderStage stage, uint32_t slot, ResourceId buffer, uint32_t firstConstant,
+            uint32_t constantCount);
+        void SetSampler(ShaderStage stage, uint32_t slot, ResourceId sampler);
+        void SetShaderResource(ShaderStage stage, uint32_t slot, ResourceId view);
+        void UpdateConstants(ResourceId buffer, const void* data, uint32_t size);
+        // In as many commands as the data needs, a command holds up to MAX_UPDATE_BYTES. Only
+        // the first one discards, the others write behind it.
+        void UpdateBuffer(ResourceId buffer, uint32_t offset, const void* data, uint32_t size, BufferUpdate mode);
+        void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+        void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+            uint32_t startInstance);
+
+        void Reset();
+
+        // Reads the command at offset and moves offset to the next one, false at the end
+        bool Read(size_t& offset, Command& command) const;
+
+        size_t GetCommandCount() const;
+        size_t GetSizeInBytes() const;
+
+    private:
+        void* Append(CommandType type, size_t payloadSize);
+
+        template <typename T>
+        void Append(CommandType type, const T& payload)
+        {
+            *static_cast<T*>(Append(type, sizeof(T))) = payload;
+        }
+
+        // whole words keep every payload aligned for reading in place
+        std::vector<uint32_t>   m_words;
+        size_t                  m_commandCount = 0;
+    };
+}
@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "CommandRecorder.h"
+
+#include <algorithm>
+
+using namespace Render;
+
+namespace
+{
+    constexpr size_t MAX_ERROR_MESSAGES = 32;
+
+    const char* const COMMAND_NAMES[COMMAND_TYPE_COUNT] = {
+        "SetVertexBuffer", "SetIndexBuffer", "SetInputLayout", "SetPrimitiveTopology", "SetVertexShader",
+        "SetPixelShader", "SetConstantBuffer", "SetConstantBufferRange", "SetSampler", "SetShaderResource",
+        "UpdateConstants", "UpdateBuffer", "DrawIndexed", "DrawIndexedInstanced"
+    };
+}
+
+ResourceId CommandRecorder::AddBuffer(uint32_t size, uint32_t bindFlags)
+{
+    return Add(RESOURCE_BUFFER, size, bindFlags);
+}
+
+ResourceId CommandRecorder::AddInputLayout()
+{
+    return Add(RESOURCE_INPUT_LAYOUT, 0, 0);
+}
+
+ResourceId CommandRecorder::AddVertexShader()
+{
+    return Add(RESOURCE_VERTEX_SHADER, 0, 0);
+}
+
+ResourceId CommandRecorder::AddPixelShader()
+{
+    return Add(RESOURCE_PIXEL_SHADER, 0, 0);
+}
+
+ResourceId CommandRecorder::AddSampler()
+{
+    return Add(RESOURCE_SAMPLER, 0, 0);
+}
+
+ResourceId CommandRecorder::AddShaderResource()
+{
+    return Add(RESOURCE_SHADER_RESOURCE, 0, 0);
+}
+
+void CommandRecorder::Execute(const CommandList& commands)
+{
+    Command command;
+    for (size_t offset = 0; commands.Read(offset, command);)
+    {
+        ++m_counts.Commands;
+        if (command.Type >= COMMAND_TYPE_COUNT)
+        {
+            Fail("unknown command type " + std::to_string(command.Type));
+            continue;
+        }
+        ++m_counts.PerType[command.Type];
+        m_filter.ShouldIssue(command);
+        const char* name = COMMAND_NAMES[command.Type];
+
+        switch (command.Type)
+        {
+        case COMMAND_SET_VERTEX_BUFFER:
+        {
+            const SetVertexBufferCommand& set = *static_cast<const SetVertexBufferCommand*>(command.Data);
+            if (set.Slot >= MAX_VERTEX_BUFFER_SLOTS)
+                Fail("SetVertexBuffer: slot out of range");
+            else if (Check(set.Buffer, RESOURCE_BUFFER, true, name))
+            {
+                if (set.Buffer != NULL_RESOURCE && !(m_resources[set.Buffer].BindFlags & D3D11_BIND_VERTEX_BUFFER))
+                    Fail("SetVertexBuffer: not a vertex buffer");
+                if (set.Slot == 0)
+                    m_state.VertexBuffer = set.Buffer;
+            }
+            break;
+        }
+        case COMMAND_SET_INDEX_BUFFER:
+        {
+            const SetIndexBufferCommand& set = *static_cast<const SetIndexBufferCommand*>(command.Data);
+            if (Check(set.Buffer, RESOURCE_BUFFER, true, name))
+            {
+                if (set.Buffer != NULL_RESOURCE && !(m_resources[set.Buffer].BindFlags & D3D11_BIND_INDEX_BUFFER))
+                    Fail("SetIndexBuffer: not an index buffer");
+                if (set.Format != DXGI_FORMAT_R16_UINT && set.Format != DXGI_FORMAT_R32_UINT)
+                    Fail("SetIndexBuffer: format is neither R16_UINT nor R32_UINT");
+                m_state.IndexBuffer = set.Buffer;
+                m_state.IndexFormat = set.Format;
+                m_state.IndexOffset = set.Offset;
+            }
+            break;
+        }
+        case COMMAND_SET_INPUT_LAYOUT:
+        {
+            const ResourceId layout = static_cast<const SetResourceCommand*>(command.Data)->Resource;
+            if (Check(layout, RESOURCE_INPUT_LAYOUT, true, name))
+                m_state.InputLayout = layout;
+            break;
+        }
+        case COMMAND_SET_TOPOLOGY:
+            m_state.HasTopology = true;
+            break;
+        case COMMAND_SET_VERTEX_SHADER:
+        {
+            const ResourceId shader = static_cast<const SetResourceCommand*>(command.Data)->Resource;
+            if (Check(shader, RESOURCE_VERTEX_SHADER, true, name))
+                m_state.VertexShader = shader;
+            break;
+        }
+        case COMMAND_SET_PIXEL_SHADER:
+        {
+            const ResourceId shader = static_cast<const SetResourceCommand*>(command.Data)->Resource;
+            if (Check(shader, RESOURCE_PIXEL_SHADER, true, name))
+                m_state.PixelShader = shader;
+            break;
+        }
+        case COMMAND_SET_CONSTANT_BUFFER:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            if (set.Stage >= SHADER_STAGE_COUNT || set.Slot >= MAX_CONSTANT_BUFFER_SLOTS)
+                Fail("SetConstantBuffer: slot out of range");
+            else if (Check(set.Resource, RESOURCE_BUFFER, true, name) && set.Resource != NULL_RESOURCE
+                && !(m_resources[set.Resource].BindFlags & D3D11_BIND_CONSTANT_BUFFER))
+                Fail("SetConstantBuffer: not a constant buffer");
+            break;
+        }
+        case COMMAND_SET_CONSTANT_BUFFER_RANGE:
+        {
+            const SetConstantBufferRangeCommand& set = *static_cast<const SetConstantBufferRangeCommand*>(command.Data);
+            if (set.Stage >= SHADER_STAGE_COUNT || set.Slot >= MAX_CONSTANT_BUFFER_SLOTS)
+                Fail("SetConstantBufferRange: slot out of range");
+            else if (set.FirstConstant % 16 != 0 || set.ConstantCount % 16 != 0 || set.ConstantCount == 0
+                || set.ConstantCount > D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT)
+                Fail("SetConstantBufferRange: range not in whole multiples of 16 constants up to 4096");
+            else if (Check(set.Buffer, RESOURCE_BUFFER, false, name))
+            {
+                const Resource& buffer = m_resources[set.Buffer];
+                if (!(buffer.BindFlags & D3D11_BIND_CONSTANT_BUFFER))
+                    Fail("SetConstantBufferRange: not a constant buffer");
+                else if ((uint64_t(set.FirstConstant) + set.ConstantCount) * 16 > buffer.Size)
+                    Fail("SetConstantBufferRange: past the end of the buffer");
+            }
+            break;
+        }
+        case COMMAND_SET_SAMPLER:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            if (set.Stage >= SHADER_STAGE_COUNT || set.Slot >= MAX_SAMPLER_SLOTS)
+                Fail("SetSampler: slot out of range");
+            else
+                Check(set.Resource, RESOURCE_SAMPLER, true, name);
+            break;
+        }
+        case COMMAND_SET_SHADER_RESOURCE:
+        {
+            const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+            if (set.Stage >= SHADER_STAGE_COUNT || set.Slot >= MAX_SHADER_RESOURCE_SLOTS)
+                Fail("SetShaderResource: slot out of range");
+            else
+                Check(set.Resource, RESOURCE_SHADER_RESOURCE, true, name);
+            break;
+        }
+        case COMMAND_UPDATE_CONSTANTS:
+        {
+            const UpdateConstantsCommand& update = *static_cast<const UpdateConstantsCommand*>(command.Data);
+            m_counts.ConstantBytes += update.Size;
+            if (Check(update.Buffer, RESOURCE_BUFFER, false, name))
+            {
+                const Resource& buffer = m_resources[update.Buffer];
+                if (!(buffer.BindFlags & D3D11_BIND_CONSTANT_BUFFER))
+                    Fail("UpdateConstants: not a constant buffer");
+                else if (update.Size > buffer.Size)
+                    Fail("UpdateConstants: more data than the buffer holds");
+            }
+            break;
+        }
+        case COMMAND_UPDATE_BUFFER:
+        {
+            const UpdateBufferCommand& update = *static_cast<const UpdateBufferCommand*>(command.Data);
+            m_counts.UploadBytes += update.Size;
+            if (Check(update.Buffer, RESOURCE_BUFFER, false, name)
+                && uint64_t(update.Offset) + update.Size > m_resources[update.Buffer].Size)
+                Fail("UpdateBuffer: past the end of the buffer");
+            break;
+        }
+        case COMMAND_DRAW_INDEXED:
+        {
+            const DrawIndexedCommand& draw = *static_cast<const DrawIndexedCommand*>(command.Data);
+            Draw(draw.IndexCount, draw.StartIndex, 1);
+            break;
+        }
+        case COMMAND_DRAW_INDEXED_INSTANCED:
+        {
+            const DrawIndexedInstancedCommand& draw = *static_cast<const DrawIndexedInstancedCommand*>(command.Data);
+            Draw(draw.IndexCount, draw.StartIndex, draw.InstanceCount);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    m_counts.Binds = m_filter.GetStats();
+}
+
+const CommandCounts& CommandRecorder::GetCounts() const
+{
+    return m_counts;
+}
+
+const std::vector<std::string>& CommandRecorder::GetErrors() const
+{
+    return m_errors;
+}
+
+void CommandRecorder::ResetCounts()
+{
+    m_counts = {};
+    m_filter.ResetStats();
+}
+
+ResourceId CommandRecorder::Add(ResourceKind kind, uint32_t size, uint32_t bindFlags)
+{
+    m_resources.push_back({ kind, size, bindFlags });
+    return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+bool CommandRecorder::Check(ResourceId id, ResourceKind kind, bool allowNull, const char* command)
+{
+    if (id == NULL_RESOURCE)
+    {
+        if (!allowNull)
+            Fail(std::string(command) + ": null resource");
+        return allowNull;
+    }
+    if (id >= m_resources.size())
+    {
+        Fail(std::string(command) + ": unknown resource");
+        return false;
+    }
+    if (m_resources[id].Kind != kind)
+    {
+        Fail(std::string(command) + ": resource of the wrong kind");
+        return false;
+    }
+    return true;
+}
+
+void CommandRecorder::Fail(const std::string& error)
+{
+    ++m_counts.Errors;
+    if (m_errors.size() < MAX_ERROR_MESSAGES && std::find(m_errors.begin(), m_errors.end(), error) == m_errors.end())
+        m_errors.push_back(error);
+}
+
+void CommandRecorder::Draw(uint32_t indexCount, uint32_t startIndex, uint32_t instanceCount)
+{
+    ++m_counts.Draws;
+    m_counts.Indices += indexCount;
+    m_counts.Instances += instanceCount;
+
+    if (m_state.VertexShader == NULL_RESOURCE || m_state.PixelShader == NULL_RESOURCE)
+        Fail("DrawIndexed: no vertex or pixel shader");
+    if (m_state.InputLayout == NULL_RESOURCE)
+        Fail("DrawIndexed: no input layout");
+    if (!m_state.HasTopology)
+        Fail("DrawIndexed: no primitive topology");
+    if (m_state.VertexBuffer == NULL_RESOURCE)
+        Fail("DrawIndexed: no vertex buffer");
+    if (m_state.IndexBuffer == NULL_RESOURCE)
+    {
+        Fail("DrawIndexed: no index buffer");
+        return;
+    }
+
+    const uint32_t indexSize = m_state.IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+    const uint64_t end = m_state.IndexOffset + (uint64_t(startIndex) + indexCount) * indexSize;
+    if (end > m_resources[m_state.IndexBuffer].Size)
+        Fail("DrawIndexed: indices past the end of the index buffer");
+}
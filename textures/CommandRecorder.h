@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CommandList.h"
+#include "StateFilter.h"
+
+#include <string>
+#include <vector>
+
+namespace Render
+{
+    struct CommandCounts
+    {
+        size_t  Commands;
+        size_t  PerType[COMMAND_TYPE_COUNT];
+        size_t  Draws;
+        // of every draw command, instanced or not, and the instances they draw
+        size_t  Indices;
+        size_t  Instances;
+        size_t  ConstantBytes;
+        size_t  UploadBytes;
+        size_t  Errors;
+        // what RedundantStateFilter would do with the binds, as D3D11CommandExecutor does
+        StateFilterStats    Binds;
+    };
+
+    // Headless backend without a device: tracks what a D3D11 context would have bound,
+    // checks every command against the resources it was told about and counts them.
+    // Ids are handed out in the order resources are added, the same as
+    // D3D11CommandExecutor does, so both run the same command lists.
+    class CommandRecorder
+    {
+    public:
+        // bindFlags are D3D11_BIND_FLAG values, size is in bytes
+        ResourceId AddBuffer(uint32_t size, uint32_t bindFlags);
+        ResourceId AddInputLayout();
+        ResourceId AddVertexShader();
+        ResourceId AddPixelShader();
+        ResourceId AddSampler();
+        ResourceId AddShaderResource();
+
+        void Execute(const CommandList& commands);
+
+        const CommandCounts& GetCounts() const;
+        // The first errors found, each once
+        const std::vector<std::string>& GetErrors() const;
+        // Counts only, the resources and bound state stay
+        void ResetCounts();
+
+    private:
+        enum ResourceKind
+        {
+            RESOURCE_BUFFER,
+            RESOURCE_INPUT_LAYOUT,
+            RESOURCE_VERTEX_SHADER,
+            RESOURCE_PIXEL_SHADER,
+            RESOURCE_SAMPLER,
+            RESOURCE_SHADER_RESOURCE
+        };
+
+        struct Resource
+        {
+            ResourceKind    Kind;
+            uint32_t        Size;
+            uint32_t        BindFlags;
+        };
+
+        // What a draw needs bound
+        struct BoundState
+        {
+            // slot 0
+            ResourceId      VertexBuffer = NULL_RESOURCE;
+            ResourceId      IndexBuffer = NULL_RESOURCE;
+            DXGI_FORMAT     IndexFormat = DXGI_FORMAT_UNKNOWN;
+            uint32_t        IndexOffset = 0;
+            ResourceId      InputLayout = NULL_RESOURCE;
+            bool            HasTopology = false;
+            ResourceId      VertexShader = NULL_RESOURCE;
+            ResourceId      PixelShader = NULL_RESOURCE;
+        };
+
+        ResourceId Add(ResourceKind kind, uint32_t size, uint32_t bindFlags);
+        // Null is fine where unbinding is, otherwise the resource has to exist and be of the kind
+        bool Check(ResourceId id, ResourceKind kind, bool allowNull, const char* command);
+        void Fail(const std::string& error);
+        void Draw(uint32_t indexCount, uint32_t startIndex, uint32_t instanceCount);
+
+        std::vector<Resource>       m_resources;
+        BoundState                  m_state;
+        RedundantStateFilter        m_filter;
+        CommandCounts               m_counts = {};
+        std::vector<std::string>    m_errors;
+    };
+}
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "ConstantRing.h"
+
+using namespace Render;
+
+ConstantRingAllocator::ConstantRingAllocator(uint32_t size):
+    m_size(size / CONSTANT_SLICE_ALIGNMENT * CONSTANT_SLICE_ALIGNMENT)
+{
+}
+
+bool ConstantRingAllocator::Allocate(uint32_t size, ConstantSlice& slice)
+{
+    const uint32_t aligned = (size + CONSTANT_SLICE_ALIGNMENT - 1) / CONSTANT_SLICE_ALIGNMENT * CONSTANT_SLICE_ALIGNMENT;
+    if (size == 0 || aligned > MAX_CONSTANT_SLICE_SIZE || aligned > m_size)
+    {
+        ++m_stats.Failures;
+        return false;
+    }
+
+    // a slice that doesn't fit before the end starts over at 0, the rest of the ring goes
+    // with the frame as padding
+    uint32_t padding = 0;
+    if (m_head + aligned > m_size)
+        padding = m_size - m_head;
+    if (m_bytesInUse + padding + aligned > m_size)
+    {
+        ++m_stats.Failures;
+        return false;
+    }
+    if (padding > 0 || m_head == m_size)
+    {
+        m_head = 0;
+        ++m_stats.Wraps;
+    }
+
+    slice = { m_head, aligned };
+    m_head += aligned;
+    m_bytesInUse += padding + aligned;
+    m_frameBytes += padding + aligned;
+
+    ++m_stats.Allocations;
+    m_stats.Bytes += aligned;
+    m_stats.PaddingBytes += padding;
+    return true;
+}
+
+void ConstantRingAllocator::EndFrame(uint64_t fence)
+{
+    if (m_frameBytes == 0)
+        return;
+    m_frames.push_back({ fence, m_frameBytes });
+    m_frameBytes = 0;
+}
+
+void ConstantRingAllocator::Retire(uint64_t completedFence)
+{
+    while (!m_frames.empty() && m_frames.front().Fence <= completedFence)
+    {
+        m_bytesInUse -= m_frames.front().Bytes;
+        m_frames.pop_front();
+    }
+}
+
+bool ConstantRingAllocator::GetOldestFence(uint64_t& fence) const
+{
+    if (m_frames.empty())
+        return false;
+    fence = m_frames.front().Fence;
+    return true;
+}
+
+uint32_t ConstantRingAllocator::GetSize() const
+{
+    return m_size;
+}
+
+uint32_t ConstantRingAllocator::GetBytesInUse() const
+{
+    return m_bytesInUse;
+}
+
+const ConstantRingStats& ConstantRingAllocator::GetStats() const
+{
+    return m_stats;
+}
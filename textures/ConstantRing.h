@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace Render
+{
+    // Offset binding counts in 16 constants of 16 bytes, slices start and end on that
+    constexpr uint32_t CONSTANT_SLICE_ALIGNMENT = 256;
+    // Most one constant buffer binding covers, 4096 constants
+    constexpr uint32_t MAX_CONSTANT_SLICE_SIZE = 65536;
+
+    struct ConstantSlice
+    {
+        // bytes from the start of the ring, and the aligned size
+        uint32_t    Offset;
+        uint32_t    Size;
+    };
+
+    struct ConstantRingStats
+    {
+        size_t      Allocations;
+        // aligned sizes, and what was skipped at the end of the ring to keep slices whole
+        size_t      Bytes;
+        size_t      PaddingBytes;
+        size_t      Wraps;
+        // allocations that found the ring full of slices the GPU may still read
+        size_t      Failures;
+    };
+
+    // Bookkeeping of constant slices in one large dynamic buffer, without a device. Slices
+    // are handed out one after the other and never straddle the end of the ring. The slices
+    // of a frame stay in use until the fence value the frame ended with has completed, so
+    // writing a new slice with NO_OVERWRITE never touches what the GPU may still read.
+    class ConstantRingAllocator
+    {
+    public:
+        explicit ConstantRingAllocator(uint32_t size);
+
+        // False when there is no room before the slices of unfinished frames
+        bool Allocate(uint32_t size, ConstantSlice& slice);
+        // Closes the slices allocated since the last call, they are free once fence completes
+        void EndFrame(uint64_t fence);
+        // Frees the slices of every frame that ended with a fence up to completedFence
+        void Retire(uint64_t completedFence);
+        // Fence of the oldest frame still in use, false when there is none
+        bool GetOldestFence(uint64_t& fence) const;
+
+        uint32_t GetSize() const;
+        uint32_t GetBytesInUse() const;
+        const ConstantRingStats& GetStats() const;
+
+    private:
+        struct Frame
+        {
+            uint64_t    Fence;
+            uint32_t    Bytes;
+        };
+
+        uint32_t            m_size;
+        // the next free byte; everything from there on around to the oldest slice in use is free
+        uint32_t            m_head = 0;
+        uint32_t            m_bytesInUse = 0;
+        uint32_t            m_frameBytes = 0;
+        std::deque<Frame>   m_frames;
+        ConstantRingStats   m_stats = {};
+    };
+}
@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "ConstantRingSimulation.h"
+#include "Renderer.h"
+
+#include <random>
+#include <vector>
+
+using namespace Render;
+
+namespace
+{
+	struct LiveSlice
+	{
+		uint64_t		Fence;
+		ConstantSlice	Slice;
+	};
+}
+
+ConstantRingSimulationSettings GetDefaultConstantRingSimulationSettings()
+{
+	ConstantRingSimulationSettings settings;
+	settings.RingSize = CONSTANT_RING_SIZE;
+	settings.Frames = 600;
+	settings.MinDraws = 500;
+	settings.MaxDraws = 4000;
+	settings.Latency = 1;
+	settings.HitchInterval = 50;
+	settings.HitchFrames = 4;
+	return settings;
+}
+
+ConstantRingSimulationReport RunConstantRingSimulation(const ConstantRingSimulationSettings& settings)
+{
+	ConstantRingSimulationReport report = {};
+	report.Settings = settings;
+
+	ConstantRingAllocator ring(settings.RingSize);
+	std::mt19937 random(25);
+	std::uniform_int_distribution<uint32_t> drawCount(settings.MinDraws, (std::max)(settings.MinDraws, settings.MaxDraws));
+	std::uniform_int_distribution<uint32_t> constantSize(4, 32);
+
+	// the owner fence of every 256 byte block of the ring, 0 when free
+	std::vector<uint64_t> owners(ring.GetSize() / CONSTANT_SLICE_ALIGNMENT, 0);
+	std::vector<LiveSlice> live;
+	// the frame a fence completes on, in order like event queries
+	std::vector<unsigned int> completesOn(1, 0);
+	uint64_t submittedFence = 0;
+	uint64_t completedFence = 0;
+
+	for (unsigned int frame = 1; frame <= settings.Frames; ++frame)
+	{
+		while (completedFence < submittedFence && completesOn[completedFence + 1] <= frame)
+			++completedFence;
+		// the query of the oldest frame in flight is reused by this one
+		if (submittedFence - completedFence >= MAX_FRAMES_IN_FLIGHT)
+		{
+			completedFence = submittedFence - MAX_FRAMES_IN_FLIGHT + 1;
+			++report.Waits;
+		}
+		ring.Retire(completedFence);
+
+		size_t kept = 0;
+		for (const LiveSlice& slice : live)
+		{
+			if (slice.Fence > completedFence)
+			{
+				live[kept++] = slice;
+				continue;
+			}
+			for (uint32_t block = 0; block < slice.Slice.Size / CONSTANT_SLICE_ALIGNMENT; ++block)
+				owners[slice.Slice.Offset / CONSTANT_SLICE_ALIGNMENT + block] = 0;
+		}
+		live.resize(kept);
+
+		const uint64_t fence = submittedFence + 1;
+		const uint32_t draws = drawCount(random);
+		for (uint32_t draw = 0; draw < draws; ++draw)
+		{
+			ConstantSlice slice;
+			if (!ring.Allocate(constantSize(random) * 16, slice))
+				continue;
+			if (slice.Offset % CONSTANT_SLICE_ALIGNMENT != 0 || slice.Offset + slice.Size > ring.GetSize())
+			{
+				++report.Overlaps;
+				continue;
+			}
+			bool overlaps = false;
+			for (uint32_t block = 0; block < slice.Size / CONSTANT_SLICE_ALIGNMENT; ++block)
+			{
+				uint64_t& owner = owners[slice.Offset / CONSTANT_SLICE_ALIGNMENT + block];
+				overlaps |= owner != 0;
+				owner = fence;
+			}
+			if (overlaps)
+				++report.Overlaps;
+			live.push_back({ fence, slice });
+		}
+		report.PeakBytesInUse = (std::max)(report.PeakBytesInUse, ring.GetBytesInUse());
+
+		submittedFence = fence;
+		ring.EndFrame(fence);
+		const bool hitch = settings.HitchInterval > 0 && frame % settings.HitchInterval == 0;
+		const unsigned int latency = settings.Latency + (hitch ? settings.HitchFrames : 0);
+		completesOn.push_back((std::max)(completesOn.back(), frame + latency));
+	}
+	report.Stats = ring.GetStats();
+	return report;
+}
+
+void PrintConstantRingSimulation(const ConstantRingSimulationReport& report, FILE* out)
+{
+	const auto megabytes = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+	const ConstantRingSimulationSettings& settings = report.Settings;
+	fprintf(out, "%u frames of %u to %u draws, ring %.2f MB, latency %u frames, +%u every %u frames\n",
+		settings.Frames, settings.MinDraws, settings.MaxDraws, megabytes(settings.RingSize),
+		settings.Latency, settings.HitchFrames, settings.HitchInterval);
+	fprintf(out, "%zu slices, %.2f MB, padding %.2f MB, %zu wraps, %zu failed, %zu waits\n",
+		report.Stats.Allocations, megabytes(report.Stats.Bytes), megabytes(report.Stats.PaddingBytes),
+		report.Stats.Wraps, report.Stats.Failures, report.Waits);
+	fprintf(out, "peak in use %.2f MB, %zu overlapping slices\n", megabytes(report.PeakBytesInUse), report.Overlaps);
+}
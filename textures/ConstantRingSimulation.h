@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ConstantRing.h"
+
+#include <cstdio>
+
+struct ConstantRingSimulationSettings
+{
+	uint32_t		RingSize;
+	unsigned int	Frames;
+	// per draw constants each frame, of 64 to 512 bytes
+	uint32_t		MinDraws;
+	uint32_t		MaxDraws;
+	// frames the GPU finishes a frame after it was submitted, and one in HitchInterval
+	// frames takes HitchFrames longer
+	unsigned int	Latency;
+	unsigned int	HitchInterval;
+	unsigned int	HitchFrames;
+};
+
+struct ConstantRingSimulationReport
+{
+	ConstantRingSimulationSettings	Settings;
+	Render::ConstantRingStats		Stats;
+	// frames that waited for the GPU before recording, their query was about to be reused
+	size_t							Waits;
+	uint32_t						PeakBytesInUse;
+	// slices that overlapped one of a frame the GPU hadn't finished, or left the ring;
+	// anything but 0 is a bug of the allocator
+	size_t							Overlaps;
+};
+
+ConstantRingSimulationSettings GetDefaultConstantRingSimulationSettings();
+
+// Runs a ConstantRingAllocator the way Renderer::Render does without a GPU: every frame
+// retires what a simulated fence has completed, allocates a slice per draw and ends with
+// the next fence value. The fence of a frame completes some frames later, longer on a
+// hitch, and recording waits for it once MAX_FRAMES_IN_FLIGHT frames are outstanding.
+ConstantRingSimulationReport RunConstantRingSimulation(const ConstantRingSimulationSettings& settings);
+
+void PrintConstantRingSimulation(const ConstantRingSimulationReport& report, FILE* out);
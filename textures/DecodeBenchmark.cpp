@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "DecodeBenchmark.h"
+#include "AssetWarmup.h"
+#include "ImageDecoder.h"
+#include "Model.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool DecodeWith(bool wic, const std::string& path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+	{
+		try
+		{
+			pixels = wic ? LoadBGRAImageWIC(StrToWstr(path).c_str(), width, height) : LoadBGRAImage(path, width, height);
+			return true;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << path << ": " << e.what() << std::endl;
+			return false;
+		}
+	}
+}
+
+DecodeBenchmarkReport BenchmarkImageDecode(const std::string& directory, unsigned int numThreads)
+{
+	DecodeBenchmarkReport report = {};
+	report.NumThreads = numThreads > 0 ? numThreads : DefaultThreadCount();
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind == WARMUP_TEXTURE)
+		{
+			report.Images.push_back({ asset.Path, 0, 0, false, 0, 0.0, 0.0 });
+		}
+	}
+
+	// One image at a time, timing each and comparing the results
+	for (DecodeTiming& image : report.Images)
+	{
+		std::vector<uint8_t> stb;
+		std::vector<uint8_t> wic;
+		uint32_t wicWidth = 0;
+		uint32_t wicHeight = 0;
+
+		Clock::time_point start = Clock::now();
+		const bool stbDecoded = DecodeWith(false, image.Path, stb, image.Width, image.Height);
+		image.StbMs = MillisecondsSince(start);
+		start = Clock::now();
+		const bool wicDecoded = DecodeWith(true, image.Path, wic, wicWidth, wicHeight);
+		image.WicMs = MillisecondsSince(start);
+
+		image.Succeeded = stbDecoded && wicDecoded && image.Width == wicWidth && image.Height == wicHeight;
+		if (!image.Succeeded)
+		{
+			continue;
+		}
+		for (size_t i = 0; i < stb.size(); ++i)
+		{
+			image.MaxDifference = (std::max)(image.MaxDifference, std::abs(int(stb[i]) - int(wic[i])));
+		}
+		report.Megapixels += double(image.Width) * image.Height / 1e6;
+		report.StbSerialMs += image.StbMs;
+		report.WicSerialMs += image.WicMs;
+	}
+
+	// Everything at once, the way the asset loader decodes
+	const auto runParallel = [&](bool wic)
+	{
+		const Clock::time_point start = Clock::now();
+		RunParallel(report.Images.size(), report.NumThreads, [&](size_t i)
+		{
+			if (!report.Images[i].Succeeded)
+			{
+				return;
+			}
+			const bool comInitialized = wic && SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+			std::vector<uint8_t> pixels;
+			uint32_t width;
+			uint32_t height;
+			DecodeWith(wic, report.Images[i].Path, pixels, width, height);
+			if (comInitialized)
+			{
+				CoUninitialize();
+			}
+		});
+		return MillisecondsSince(start);
+	};
+	report.StbParallelMs = runParallel(false);
+	report.WicParallelMs = runParallel(true);
+	return report;
+}
+
+void PrintDecodeBenchmark(const DecodeBenchmarkReport& report, FILE* out)
+{
+	fprintf(out, "%-40s %11s %10s %10s %8s %8s\n", "image", "size", "stb ms", "WIC ms", "speedup", "max diff");
+	for (const DecodeTiming& image : report.Images)
+	{
+		if (!image.Succeeded)
+		{
+			fprintf(out, "%-40s %11s\n", image.Path.c_str(), "FAILED");
+			continue;
+		}
+		fprintf(out, "%-40s %5ux%-5u %10.2f %10.2f %7.1fx %8d\n", image.Path.c_str(), image.Width, image.Height,
+			image.StbMs, image.WicMs, image.StbMs > 0.0 ? image.WicMs / image.StbMs : 0.0, image.MaxDifference);
+	}
+
+	const auto megapixelsPerSecond = [&](double ms) { return ms > 0.0 ? report.Megapixels / (ms / 1000.0) : 0.0; };
+	fprintf(out, "%zu images, %.2f MP\n", report.Images.size(), report.Megapixels);
+	fprintf(out, "one at a time:  stb %.1f ms (%.1f MP/s), WIC %.1f ms (%.1f MP/s)\n",
+		report.StbSerialMs, megapixelsPerSecond(report.StbSerialMs), report.WicSerialMs, megapixelsPerSecond(report.WicSerialMs));
+	fprintf(out, "on %u threads:   stb %.1f ms (%.1f MP/s), WIC %.1f ms (%.1f MP/s)\n", report.NumThreads,
+		report.StbParallelMs, megapixelsPerSecond(report.StbParallelMs), report.WicParallelMs, megapixelsPerSecond(report.WicParallelMs));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct DecodeTiming
+{
+	std::string	Path;
+	uint32_t	Width;
+	uint32_t	Height;
+	bool		Succeeded;
+	// largest channel difference between the two, JPEG decoders round differently
+	int			MaxDifference;
+	// one decode of the image on its own
+	double		StbMs;
+	double		WicMs;
+};
+
+struct DecodeBenchmarkReport
+{
+	std::vector<DecodeTiming>	Images;
+	unsigned int				NumThreads;
+	double						Megapixels;
+	// wall clock of decoding every image, one after another and on all threads
+	double						StbSerialMs;
+	double						WicSerialMs;
+	double						StbParallelMs;
+	double						WicParallelMs;
+};
+
+// Decodes every texture in the directory, not recursing, with LoadBGRAImage (stb_image
+// from a mapped file) and with LoadBGRAImageWIC, first one image at a time and then
+// all images at once on numThreads threads (0 uses every core). An image fails when
+// either path can't decode it.
+DecodeBenchmarkReport BenchmarkImageDecode(const std::string& directory, unsigned int numThreads = 0);
+
+void PrintDecodeBenchmark(const DecodeBenchmarkReport& report, FILE* out);
@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "DrawBucket.h"
+
+using namespace Render;
+
+namespace
+{
+    constexpr uint32_t RADIX_BITS = 8;
+    constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+    constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+    constexpr uint32_t STATE_BITS = SORT_KEY_SHADER_BITS + SORT_KEY_MATERIAL_BITS + SORT_KEY_TEXTURE_BITS;
+    constexpr uint32_t MAX_DEPTH = (1u << SORT_KEY_DEPTH_BITS) - 1;
+
+    uint64_t Field(uint32_t value, uint32_t bits)
+    {
+        return value & ((1ull << bits) - 1);
+    }
+
+    // The bits of a positive float order like its value, the top ones keep the same relative
+    // precision at any distance and need no far plane
+    uint32_t QuantizeDepth(float depth)
+    {
+        // also NaN
+        if (!(depth > 0.0f))
+            return 0;
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - SORT_KEY_DEPTH_BITS);
+    }
+}
+
+uint64_t Render::MakeSortKey(uint32_t layer, DrawPass pass, uint32_t shader, uint32_t material, uint32_t texture, float depth)
+{
+    const uint64_t state = Field(shader, SORT_KEY_SHADER_BITS) << (SORT_KEY_MATERIAL_BITS + SORT_KEY_TEXTURE_BITS)
+        | Field(material, SORT_KEY_MATERIAL_BITS) << SORT_KEY_TEXTURE_BITS
+        | Field(texture, SORT_KEY_TEXTURE_BITS);
+
+    uint64_t key = Field(layer, SORT_KEY_LAYER_BITS) << (64 - SORT_KEY_LAYER_BITS)
+        | Field(pass, SORT_KEY_PASS_BITS) << (64 - SORT_KEY_LAYER_BITS - SORT_KEY_PASS_BITS);
+    if (pass == DRAW_PASS_TRANSPARENT)
+        key |= uint64_t(MAX_DEPTH - QuantizeDepth(depth)) << STATE_BITS | state;
+    else
+        key |= state << SORT_KEY_DEPTH_BITS | QuantizeDepth(depth);
+    return key;
+}
+
+void DrawBucket::Add(uint64_t key, uint32_t draw)
+{
+    m_items.push_back({ key, draw });
+}
+
+void DrawBucket::Sort()
+{
+    const size_t count = m_items.size();
+    if (count < 2)
+        return;
+
+    // the histograms of every byte in one read of the keys
+    uint32_t histograms[RADIX_PASSES][RADIX_SIZE] = {};
+    for (const DrawItem& item : m_items)
+    {
+        for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+        {
+            ++histograms[pass][(item.Key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+        }
+    }
+
+    m_scratch.resize(count);
+    DrawItem* src = m_items.data();
+    DrawItem* dst = m_scratch.data();
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        const uint32_t shift = pass * RADIX_BITS;
+        uint32_t* histogram = histograms[pass];
+        // layer, pass and the high depth bits are mostly the same for every draw
+        if (histogram[(src[0].Key >> shift) & (RADIX_SIZE - 1)] == count)
+            continue;
+
+        // counts to the first position of each digit
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+        {
+            const uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[histogram[(src[i].Key >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != m_items.data())
+        m_items.swap(m_scratch);
+}
+
+void DrawBucket::Clear()
+{
+    m_items.clear();
+}
+
+const std::vector<DrawItem>& DrawBucket::GetItems() const
+{
+    return m_items;
+}
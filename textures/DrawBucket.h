@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Render
+{
+    enum DrawPass : uint32_t
+    {
+        DRAW_PASS_OPAQUE,
+        // after the opaque draws of the same layer
+        DRAW_PASS_TRANSPARENT,
+        DRAW_PASS_COUNT
+    };
+
+    // Bits of the sort key fields, from the most significant one down
+    constexpr uint32_t SORT_KEY_LAYER_BITS = 4;
+    constexpr uint32_t SORT_KEY_PASS_BITS = 2;
+    constexpr uint32_t SORT_KEY_SHADER_BITS = 12;
+    constexpr uint32_t SORT_KEY_MATERIAL_BITS = 12;
+    constexpr uint32_t SORT_KEY_TEXTURE_BITS = 10;
+    constexpr uint32_t SORT_KEY_DEPTH_BITS = 24;
+
+    static_assert(SORT_KEY_LAYER_BITS + SORT_KEY_PASS_BITS + SORT_KEY_SHADER_BITS + SORT_KEY_MATERIAL_BITS
+        + SORT_KEY_TEXTURE_BITS + SORT_KEY_DEPTH_BITS == 64, "Sort key fields must fill 64 bits");
+
+    // Key that orders draws by layer and pass first. Opaque draws follow by shader, material,
+    // texture and then near to far, so state changes are rare and early depth rejects what
+    // is hidden. Transparent draws follow far to near, state only orders equal depths.
+    // Values are cut to their field, one that doesn't fit only sorts less well. Depth is
+    // the view space distance, anything behind the eye counts as 0.
+    uint64_t MakeSortKey(uint32_t layer, DrawPass pass, uint32_t shader, uint32_t material, uint32_t texture, float depth);
+
+    struct DrawItem
+    {
+        uint64_t    Key;
+        // index of the draw in the caller's list
+        uint32_t    Draw;
+    };
+
+    // Sort keys of the draws of one frame. Clear keeps the memory for the next frame.
+    class DrawBucket
+    {
+    public:
+        void Add(uint64_t key, uint32_t draw);
+        // Stable LSD radix sort a byte at a time, bytes all keys share are skipped
+        void Sort();
+        void Clear();
+
+        const std::vector<DrawItem>& GetItems() const;
+
+    private:
+        std::vector<DrawItem>   m_items;
+        std::vector<DrawItem>   m_scratch;
+    };
+}
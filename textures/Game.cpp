@@ -24,6 +24,9 @@ using namespace Render;
 
 namespace
 {
+    // time per frame spent creating GPU resources for loaded assets
+    constexpr double UPLOAD_BUDGET_MS = 2.0;
+
     struct Plane
     {
         std::vector<Vertex> Vertices;
@@ -88,7 +91,6 @@ void Game::Initialize(HWND window, int width, int height)
     m_mouse->SetMode(Mouse::MODE_RELATIVE);
     // Initialize camera
     m_camera = std::make_unique<Camera>();
-    m_model = Model::LoadModel("../assets/cube_text.obj");
     m_renderer = std::make_unique<Renderer>();
 
     m_deviceResources->CreateDeviceResources();
@@ -112,6 +114,14 @@ void Game::Tick()
         Update(m_timer);
     });
 
+    m_assetLoader->ProcessUploads(UPLOAD_BUDGET_MS);
+    if (!m_modelResident && m_model.IsResident())
+    {
+        // Swap the placeholder for the loaded mesh
+        m_modelResident = true;
+        m_renderer->Init(&*m_deviceResources, { m_model.GetModel() });
+    }
+
     Render();
 }
 
@@ -245,7 +255,7 @@ void Game::Render()
     //// Draw indexed
     //context->DrawIndexed(m_model->GetFaces().size() * 3, 0, 0);
 
-    m_renderer->Render({ *m_model });
+    m_renderer->Render();
 
     m_deviceResources->PIXEndEvent();
 
@@ -331,7 +341,13 @@ void Game::GetDefaultSize(int& width, int& height) const noexcept
 void Game::CreateDeviceDependentResources()
 {
     auto device = m_deviceResources->GetD3DDevice();
-    m_renderer->Init(&*m_deviceResources, { *m_model });
+
+    // Models and textures load in the background, the renderer starts with the placeholder
+    m_uploadDevice = std::make_unique<D3D11UploadDevice>(device);
+    m_assetLoader = std::make_unique<AssetLoader>(*m_uploadDevice);
+    m_model = m_assetLoader->LoadModel("../assets/cube_text.obj");
+    m_modelResident = false;
+    m_renderer->Init(&*m_deviceResources, { m_model.GetModel() });
 
     // Initialize device dependent objects here (independent of window size).
     // Load and create shaders
@@ -433,11 +449,7 @@ void Game::CreateDeviceDependentResources()
     //            m_indexBuffer.ReleaseAndGetAddressOf()));
     //}
 
-    // Create textures for model
-    // TODO: use loop to load texture for array of models
-    {
-        m_model->LoadTexture(device);
-    }
+    // Textures of the model are requested by the asset loader once the model is parsed
 
     // Create the constant buffer
     //{
@@ -507,6 +519,8 @@ void Game::OnDeviceLost()
     m_pixelShader.Reset();
     m_constantBuffer.Reset();
     m_lightingData.Reset();
+    m_assetLoader.reset();
+    m_uploadDevice.reset();
 }
 
 void Game::OnDeviceRestored()
@@ -8,6 +8,7 @@
 #include "StepTimer.h"
 #include "Camera.h"
 #include "Model.h"
+#include "AssetLoader.h"
 
 #include <Keyboard.h>
 #include <GamePad.h>
@@ -179,7 +180,12 @@ private:
 
     // Camera
     std::unique_ptr<Camera>     m_camera;
-    std::unique_ptr<Model>      m_model;
+
+    // Assets, the model renders as a placeholder until the loader made it resident
+    std::unique_ptr<IUploadDevice>  m_uploadDevice;
+    std::unique_ptr<AssetLoader>    m_assetLoader;
+    ModelHandle                     m_model;
+    bool                            m_modelResident = false;
 
     // Renderer
     std::unique_ptr<Render::Renderer> m_renderer;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// 64-bit non-cryptographic hash, consumes 8 bytes per step.
+// Used to detect changed asset files, not for anything security related.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+{
+	constexpr uint64_t K1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t K2 = 0xC2B2AE3D27D4EB4Full;
+
+	auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	auto mix = [&](uint64_t h, uint64_t w)
+	{
+		w *= K2;
+		w = rotl(w, 31);
+		w *= K1;
+		h ^= w;
+		return rotl(h, 27) * K1 + 0x52DCE729ull;
+	};
+
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t h = seed ^ (static_cast<uint64_t>(size) * K1);
+	for (size_t i = 0; i < size / 8; ++i, p += 8)
+	{
+		uint64_t w;
+		memcpy(&w, p, 8);
+		h = mix(h, w);
+	}
+	if (size % 8)
+	{
+		uint64_t w = 0;
+		memcpy(&w, p, size % 8);
+		h = mix(h, w);
+	}
+
+	// final avalanche
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
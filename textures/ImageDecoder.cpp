@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "Model.h"
+
+#include <climits>
+#include <memory>
+#include <stdexcept>
+
+#include <emmintrin.h>
+#include <wincodec.h>
+
+#include "stb_image.h"
+
+namespace
+{
+	struct StbiDeleter
+	{
+		void operator()(stbi_uc* pixels) const
+		{
+			stbi_image_free(pixels);
+		}
+	};
+
+	// Texels with red in the low byte of each 32 bit lane to blue there, alpha is
+	// or'ed in for sources without one
+	inline __m128i SwapRedBlue(__m128i rgba, __m128i alpha)
+	{
+		const __m128i greenAlpha = _mm_and_si128(rgba, _mm_set1_epi32(static_cast<int>(0xff00ff00)));
+		const __m128i red = _mm_and_si128(_mm_slli_epi32(rgba, 16), _mm_set1_epi32(0x00ff0000));
+		const __m128i blue = _mm_and_si128(_mm_srli_epi32(rgba, 16), _mm_set1_epi32(0x000000ff));
+		return _mm_or_si128(_mm_or_si128(greenAlpha, alpha), _mm_or_si128(red, blue));
+	}
+}
+
+void ConvertRGBAToBGRA(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), SwapRedBlue(rgba, _mm_setzero_si128()));
+	}
+	for (; i < count; ++i)
+	{
+		const uint8_t r = src[i * 4 + 0];
+		dst[i * 4 + 0] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = r;
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+void ConvertRGBToBGRA(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+	size_t i = 0;
+	// every load reads 16 bytes for the 12 of four texels, stop before the end
+	for (; i + 6 <= count; i += 4)
+	{
+		const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+		const __m128i texels01 = _mm_unpacklo_epi32(rgb, _mm_srli_si128(rgb, 3));
+		const __m128i texels23 = _mm_unpacklo_epi32(_mm_srli_si128(rgb, 6), _mm_srli_si128(rgb, 9));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), SwapRedBlue(_mm_unpacklo_epi64(texels01, texels23), alpha));
+	}
+	for (; i < count; ++i)
+	{
+		dst[i * 4 + 0] = src[i * 3 + 2];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3 + 0];
+		dst[i * 4 + 3] = 0xff;
+	}
+}
+
+std::vector<uint8_t> DecodeBGRAImage(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height)
+{
+	if (size > INT_MAX)
+	{
+		throw std::runtime_error("DecodeBGRAImage: image too large");
+	}
+
+	// Decoded with the channels of the file, widened to BGRA in one pass below
+	int w = 0;
+	int h = 0;
+	int channels = 0;
+	const std::unique_ptr<stbi_uc, StbiDeleter> decoded(stbi_load_from_memory(data, static_cast<int>(size), &w, &h, &channels, 0));
+	if (!decoded)
+	{
+		throw std::runtime_error(std::string("DecodeBGRAImage: ") + stbi_failure_reason());
+	}
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+
+	const size_t texels = size_t(width) * height;
+	const stbi_uc* src = decoded.get();
+	std::vector<uint8_t> image(texels * 4);
+	switch (channels)
+	{
+	case 4:
+		ConvertRGBAToBGRA(src, image.data(), texels);
+		break;
+	case 3:
+		ConvertRGBToBGRA(src, image.data(), texels);
+		break;
+	default:
+		// grey, with alpha for 2 channels
+		for (size_t i = 0; i < texels; ++i)
+		{
+			const stbi_uc grey = src[i * channels];
+			image[i * 4 + 0] = grey;
+			image[i * 4 + 1] = grey;
+			image[i * 4 + 2] = grey;
+			image[i * 4 + 3] = channels == 2 ? src[i * channels + 1] : 0xff;
+		}
+		break;
+	}
+	return image;
+}
+
+std::vector<uint8_t> LoadBGRAImage(const std::string& filepath, uint32_t& width, uint32_t& height)
+{
+	const MappedFile file(filepath);
+	if (!file.IsOpen())
+	{
+		throw std::runtime_error("LoadBGRAImage: failed to open " + filepath);
+	}
+
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(file.GetData());
+	int w = 0;
+	int h = 0;
+	int channels = 0;
+	if (file.GetSize() <= INT_MAX && !stbi_info_from_memory(data, static_cast<int>(file.GetSize()), &w, &h, &channels))
+	{
+		return LoadBGRAImageWIC(StrToWstr(filepath).c_str(), width, height);
+	}
+	return DecodeBGRAImage(data, file.GetSize(), width, height);
+}
+
+std::vector<uint8_t> LoadBGRAImageWIC(const wchar_t* filename, uint32_t& width, uint32_t& height)
+{
+	using namespace Microsoft::WRL;
+	ComPtr<IWICImagingFactory> wicFactory;
+	DX::ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory2, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory)));
+
+	ComPtr<IWICBitmapDecoder> decoder;
+	DX::ThrowIfFailed(wicFactory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf()));
+
+	ComPtr<IWICBitmapFrameDecode> frame;
+	DX::ThrowIfFailed(decoder->GetFrame(0, frame.GetAddressOf()));
+
+	DX::ThrowIfFailed(frame->GetSize(&width, &height));
+
+	WICPixelFormatGUID pixelFormat;
+	DX::ThrowIfFailed(frame->GetPixelFormat(&pixelFormat));
+
+	uint32_t rowPitch = width * sizeof(uint32_t);
+	uint32_t imageSize = rowPitch * height;
+
+	std::vector<uint8_t> image;
+	image.resize(size_t(imageSize));
+
+	if (memcmp(&pixelFormat, &GUID_WICPixelFormat32bppBGRA, sizeof(GUID)) == 0)
+	{
+		DX::ThrowIfFailed(frame->CopyPixels(nullptr, rowPitch, imageSize, reinterpret_cast<BYTE*>(image.data())));
+	}
+	else
+	{
+		ComPtr<IWICFormatConverter> formatConverter;
+		DX::ThrowIfFailed(wicFactory->CreateFormatConverter(formatConverter.GetAddressOf()));
+
+		BOOL canConvert = FALSE;
+		DX::ThrowIfFailed(formatConverter->CanConvert(pixelFormat, GUID_WICPixelFormat32bppBGRA, &canConvert));
+		if (!canConvert)
+		{
+			throw std::exception("CanConvert");
+		}
+
+		// 8 bit channels convert exactly, no dithering needed
+		DX::ThrowIfFailed(formatConverter->Initialize(frame.Get(), GUID_WICPixelFormat32bppBGRA,
+			WICBitmapDitherTypeNone, nullptr, 0, WICBitmapPaletteTypeCustom));
+
+		DX::ThrowIfFailed(formatConverter->CopyPixels(nullptr, rowPitch, imageSize, reinterpret_cast<BYTE*>(image.data())));
+	}
+
+	return image;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decodes an encoded image (JPEG, PNG, BMP, TGA, GIF, ...) from memory with stb_image
+// into tightly packed BGRA8 rows. Throws when the data isn't an image stb_image reads.
+std::vector<uint8_t> DecodeBGRAImage(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+// Decodes the memory mapped image file with DecodeBGRAImage. Formats stb_image doesn't
+// know (TIFF) go through LoadBGRAImageWIC. Throws when the file can't be decoded.
+std::vector<uint8_t> LoadBGRAImage(const std::string& filepath, uint32_t& width, uint32_t& height);
+
+// Decodes an image with WIC into tightly packed BGRA8 rows, needs COM on the thread
+std::vector<uint8_t> LoadBGRAImageWIC(const wchar_t* filename, uint32_t& width, uint32_t& height);
+
+// Swizzles 'count' texels from RGBA8 or RGB8 to BGRA8, opaque for RGB. SSE2 for four
+// texels at a time, dst may alias an RGBA src.
+void ConvertRGBAToBGRA(const uint8_t* src, uint8_t* dst, size_t count);
+void ConvertRGBToBGRA(const uint8_t* src, uint8_t* dst, size_t count);
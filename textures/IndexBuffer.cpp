@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "IndexBuffer.h"
+
+namespace
+{
+	// A triangle that does not fit a 16-bit range by itself
+	bool IsWide(const uint32_t* triangle)
+	{
+		const uint32_t lo = (std::min)({ triangle[0], triangle[1], triangle[2] });
+		const uint32_t hi = (std::max)({ triangle[0], triangle[1], triangle[2] });
+		return hi - lo >= INDEX16_VERTEX_LIMIT;
+	}
+
+	uint32_t ZigZag(uint32_t delta)
+	{
+		return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+	}
+
+	uint32_t UnZigZag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+}
+
+IndexBufferReport PackIndices(const uint32_t* indices, size_t numIndices, PackedIndices& packed, std::vector<IndexRange>& ranges)
+{
+	assert(numIndices % 3 == 0);
+
+	IndexBufferReport report;
+	report.NumIndices = numIndices;
+	report.Bytes32 = numIndices * sizeof(uint32_t);
+
+	size_t begin = 0;
+	while (begin < numIndices)
+	{
+		// Grow the range triangle by triangle while the span still fits
+		const bool wide = IsWide(indices + begin);
+		uint32_t lo = (std::min)({ indices[begin], indices[begin + 1], indices[begin + 2] });
+		uint32_t hi = (std::max)({ indices[begin], indices[begin + 1], indices[begin + 2] });
+		size_t end = begin + 3;
+		for (; end < numIndices; end += 3)
+		{
+			const uint32_t* triangle = indices + end;
+			if (IsWide(triangle) != wide)
+				break;
+
+			const uint32_t triangleLo = (std::min)({ triangle[0], triangle[1], triangle[2], lo });
+			const uint32_t triangleHi = (std::max)({ triangle[0], triangle[1], triangle[2], hi });
+			if (!wide && triangleHi - triangleLo >= INDEX16_VERTEX_LIMIT)
+				break;
+			lo = triangleLo;
+			hi = triangleHi;
+		}
+
+		IndexRange range;
+		range.IndexCount = static_cast<uint32_t>(end - begin);
+		range.BaseVertex = lo;
+		if (wide)
+		{
+			range.Format = DXGI_FORMAT_R32_UINT;
+			range.StartIndex = static_cast<uint32_t>(packed.Indices32.size());
+			for (size_t i = begin; i < end; ++i)
+				packed.Indices32.push_back(indices[i] - lo);
+			report.PackedBytes += range.IndexCount * sizeof(uint32_t);
+			++report.NumWideRanges;
+		}
+		else
+		{
+			range.Format = DXGI_FORMAT_R16_UINT;
+			range.StartIndex = static_cast<uint32_t>(packed.Indices16.size());
+			for (size_t i = begin; i < end; ++i)
+				packed.Indices16.push_back(static_cast<uint16_t>(indices[i] - lo));
+			report.PackedBytes += range.IndexCount * sizeof(uint16_t);
+		}
+		ranges.push_back(range);
+		++report.NumRanges;
+		begin = end;
+	}
+
+	return report;
+}
+
+void EncodeIndices(const uint32_t* indices, size_t numIndices, std::vector<uint8_t>& encoded)
+{
+	// worst case is five bytes per index
+	const size_t start = encoded.size();
+	encoded.resize(start + numIndices * 5);
+	uint8_t* out = encoded.data() + start;
+
+	uint32_t previous = 0;
+	for (size_t i = 0; i < numIndices; ++i)
+	{
+		uint32_t value = ZigZag(indices[i] - previous);
+		previous = indices[i];
+		while (value >= 0x80)
+		{
+			*out++ = static_cast<uint8_t>(value | 0x80);
+			value >>= 7;
+		}
+		*out++ = static_cast<uint8_t>(value);
+	}
+
+	encoded.resize(out - encoded.data());
+}
+
+bool DecodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t numIndices)
+{
+	const uint8_t* in = data;
+	const uint8_t* end = data + size;
+	uint32_t previous = 0;
+	size_t i = 0;
+	while (i < numIndices)
+	{
+		// Fast path, decode the run of single byte deltas at the front of the next eight bytes
+		if (end - in >= 8)
+		{
+			uint64_t block;
+			memcpy(&block, in, sizeof(block));
+			const uint64_t continuation = block & 0x8080808080808080ull;
+			// the halves on their own, _BitScanForward64 doesn't exist on 32-bit targets
+			const uint32_t continuationLow = static_cast<uint32_t>(continuation);
+			const uint32_t continuationHigh = static_cast<uint32_t>(continuation >> 32);
+			unsigned long firstMultiByte = 64;
+			if (continuationLow != 0)
+			{
+				_BitScanForward(&firstMultiByte, continuationLow);
+			}
+			else if (continuationHigh != 0)
+			{
+				_BitScanForward(&firstMultiByte, continuationHigh);
+				firstMultiByte += 32;
+			}
+			const size_t count = (std::min)(static_cast<size_t>(firstMultiByte / 8), numIndices - i);
+			for (size_t k = 0; k < count; ++k)
+			{
+				previous += UnZigZag(static_cast<uint32_t>(block >> (k * 8)) & 0x7F);
+				indices[i + k] = previous;
+			}
+			in += count;
+			i += count;
+			if (i == numIndices)
+				break;
+		}
+
+		uint32_t value = 0;
+		for (int shift = 0;; shift += 7)
+		{
+			if (in == end || shift > 28)
+				return false;
+			const uint8_t byte = *in++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (byte < 0x80)
+				break;
+		}
+		previous += UnZigZag(value);
+		indices[i++] = previous;
+	}
+
+	return in == end;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <d3d11.h>
+
+// Number of vertices a 16-bit index range can address above its base vertex
+constexpr uint32_t INDEX16_VERTEX_LIMIT = 65536;
+
+// Triangles drawn with one DrawIndexed call. The indices are stored relative to
+// BaseVertex, which in turn is relative to the first vertex of the mesh.
+struct IndexRange
+{
+	DXGI_FORMAT	Format;
+	uint32_t	StartIndex;	// first index in the buffer of the range's format
+	uint32_t	IndexCount;
+	uint32_t	BaseVertex;
+};
+
+// Index data of several meshes, one array per index format
+struct PackedIndices
+{
+	std::vector<uint16_t>	Indices16;
+	std::vector<uint32_t>	Indices32;
+};
+
+// Index memory of one mesh. The index buffer is read once per draw, so the packed
+// size is also the index fetch bandwidth per frame.
+struct IndexBufferReport
+{
+	size_t	NumIndices = 0;
+	size_t	NumRanges = 0;
+	size_t	NumWideRanges = 0;	// ranges left with 32-bit indices
+	size_t	Bytes32 = 0;		// size as a plain 32-bit buffer
+	size_t	PackedBytes = 0;
+};
+
+// Appends a triangle list to packed. The list is cut into consecutive ranges whose vertex
+// span fits INDEX16_VERTEX_LIMIT, so a mesh with fewer vertices always becomes one 16-bit
+// range. Only triangles that span more vertices on their own fall back to 32-bit ranges.
+// Works best on meshes sorted by OptimizeVertexFetch, where the span grows with the index.
+IndexBufferReport PackIndices(const uint32_t* indices, size_t numIndices, PackedIndices& packed, std::vector<IndexRange>& ranges);
+
+// Compact on-disk index encoding: the difference to the previous index, zigzag encoded as
+// a LEB128 varint. Cache and fetch optimized meshes mostly need a single byte per index.
+void EncodeIndices(const uint32_t* indices, size_t numIndices, std::vector<uint8_t>& encoded);
+// Fails when the data does not hold exactly numIndices indices
+bool DecodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t numIndices);
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "LoaderCheck.h"
+#include "AssetLoader.h"
+#include "AssetWarmup.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// timer resolution and the bookkeeping of a frame on top of its uploads
+	constexpr double FRAME_SLACK_MS = 0.5;
+}
+
+LoaderCheckReport RunLoaderCheck(const LoaderCheckSettings& settings)
+{
+	LoaderCheckReport report = {};
+	report.Settings = settings;
+	const auto fail = [&](const std::string& check) { report.Failures.push_back(check); };
+
+	RecordingUploadDevice device(settings.MsPerMegabyte);
+	std::vector<std::string> modelPaths;
+	std::vector<ModelHandle> models;
+	std::vector<std::string> textureNames;
+	std::vector<TextureHandle> textures;
+	ModelHandle missingModel;
+	TextureHandle missingTexture;
+	{
+		AssetLoader loader(device);
+		const Model* placeholder = &loader.GetPlaceholderModel();
+
+		const std::string directory = FindTexture("");
+		for (const WarmupResult& asset : FindAssets(directory))
+		{
+			if (asset.Kind == WARMUP_MESH)
+			{
+				modelPaths.push_back(asset.Path);
+				models.push_back(loader.LoadModel(asset.Path));
+			}
+			else
+			{
+				textureNames.push_back(asset.Path.substr(directory.size()));
+				textures.push_back(loader.LoadTexture(textureNames.back()));
+			}
+		}
+		missingModel = loader.LoadModel(directory + "missing-model.obj");
+		missingTexture = loader.LoadTexture("missing-texture.png");
+		report.Models = models.size();
+		report.Textures = textures.size();
+
+		// Nothing is resident before the first upload, whatever the workers have done
+		for (size_t i = 0; i < models.size(); ++i)
+		{
+			if (models[i].IsResident() || &models[i].GetModel() != placeholder)
+				fail("model " + modelPaths[i] + " is not the placeholder before its upload");
+		}
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			if (textures[i].IsResident())
+				fail("texture " + textureNames[i] + " is resident before its upload");
+		}
+
+		// Frame by frame until everything has arrived, model textures are requested on the way
+		const Clock::time_point start = Clock::now();
+		while (loader.GetPendingCount() > 0)
+		{
+			if (MillisecondsSince(start) > settings.TimeoutMs)
+			{
+				fail("the loader still had " + std::to_string(loader.GetPendingCount()) + " assets pending after the timeout");
+				break;
+			}
+
+			const size_t firstUpload = device.GetUploads().size();
+			const Clock::time_point frameStart = Clock::now();
+			const size_t count = loader.ProcessUploads(settings.BudgetMs);
+			const double frameMs = MillisecondsSince(frameStart);
+			if (count == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			// the last upload may start just before the budget runs out
+			double largestUploadMs = 0.0;
+			for (size_t u = firstUpload; u < device.GetUploads().size(); ++u)
+			{
+				largestUploadMs = (std::max)(largestUploadMs, settings.MsPerMegabyte * device.GetUploads()[u].Bytes / (1024.0 * 1024.0));
+			}
+			if (count > 1 && frameMs > settings.BudgetMs + largestUploadMs + FRAME_SLACK_MS)
+				++report.FramesOverBudget;
+			++report.Frames;
+			report.MaxUploadsPerFrame = (std::max)(report.MaxUploadsPerFrame, count);
+			report.MaxFrameMs = (std::max)(report.MaxFrameMs, frameMs);
+		}
+		report.Uploads = device.GetUploads().size();
+
+		for (size_t i = 0; i < models.size(); ++i)
+		{
+			if (!models[i].IsResident() || &models[i].GetModel() == placeholder)
+				fail("model " + modelPaths[i] + " did not replace the placeholder");
+			else if (&loader.LoadModel(modelPaths[i]).GetModel() != &models[i].GetModel())
+				fail("a second request for model " + modelPaths[i] + " loaded it again");
+			else if (!models[i].GetModel().GetTextPath().empty() && models[i].GetTexture().GetState() != ASSET_RESIDENT
+				&& models[i].GetTexture().GetState() != ASSET_FAILED)
+				fail("the texture of model " + modelPaths[i] + " never finished");
+		}
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			if (!textures[i].IsResident())
+				fail("texture " + textureNames[i] + " is not resident");
+		}
+		if (missingModel.GetState() != ASSET_FAILED || &missingModel.GetModel() != placeholder)
+			fail("a missing model did not fail with the placeholder");
+		if (missingTexture.GetState() != ASSET_FAILED)
+			fail("a missing texture did not fail");
+		if (report.FramesOverBudget > 0)
+			fail(std::to_string(report.FramesOverBudget) + " frames uploaded past the budget");
+	}
+
+	// The loader is gone, its handles still read the assets and the placeholder
+	for (size_t i = 0; i < models.size(); ++i)
+	{
+		if (models[i].IsResident() && models[i].GetModel().GetIndexCount() == 0)
+			fail("model " + modelPaths[i] + " is empty after the loader was destroyed");
+	}
+	if (missingModel.GetModel().GetIndexCount() == 0)
+		fail("the placeholder is gone with the loader");
+	if (TextureHandle().GetState() != ASSET_FAILED || TextureHandle().GetView() != nullptr)
+		fail("a default texture handle is not failed and empty");
+	return report;
+}
+
+void PrintLoaderCheck(const LoaderCheckReport& report, FILE* out)
+{
+	fprintf(out, "%zu models, %zu textures, %zu uploads in %zu frames\n", report.Models, report.Textures,
+		report.Uploads, report.Frames);
+	fprintf(out, "budget %.1f ms at %.1f ms/MB: longest frame %.2f ms, at most %zu uploads, %zu over budget\n",
+		report.Settings.BudgetMs, report.Settings.MsPerMegabyte, report.MaxFrameMs, report.MaxUploadsPerFrame,
+		report.FramesOverBudget);
+	for (const std::string& failure : report.Failures)
+	{
+		fprintf(out, "FAILED: %s\n", failure.c_str());
+	}
+	if (report.Failures.empty())
+		fprintf(out, "all checks passed\n");
+	else
+		fprintf(out, "%zu checks failed\n", report.Failures.size());
+}
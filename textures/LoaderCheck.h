@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct LoaderCheckSettings
+{
+	double	BudgetMs = 2.0;
+	// stands in for the driver copy of the recording device, large textures take
+	// longer than the budget on their own
+	double	MsPerMegabyte = 1.0;
+	// the loader must have finished by then
+	double	TimeoutMs = 60000.0;
+};
+
+struct LoaderCheckReport
+{
+	LoaderCheckSettings			Settings;
+	size_t						Models;
+	size_t						Textures;
+	size_t						Uploads;
+	size_t						Frames;
+	size_t						MaxUploadsPerFrame;
+	double						MaxFrameMs;
+	// frames that went on uploading after the budget was used up
+	size_t						FramesOverBudget;
+	// one line per check that didn't hold, empty when the loader behaves
+	std::vector<std::string>	Failures;
+};
+
+// Drives an AssetLoader on a RecordingUploadDevice without a GPU: requests every mesh and
+// texture of the directory FindTexture resolves names in, plus a model and a texture that
+// don't exist, and uploads frame by frame within the budget until nothing is pending.
+// Checks that handles show the placeholder until their upload and the asset afterwards,
+// that requests for the same path share the asset, that no frame uploads past the budget
+// except for its first upload, that missing assets end up ASSET_FAILED with the
+// placeholder, and that handles stay readable after the loader is gone.
+LoaderCheckReport RunLoaderCheck(const LoaderCheckSettings& settings);
+
+void PrintLoaderCheck(const LoaderCheckReport& report, FILE* out);
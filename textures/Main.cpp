@@ -4,6 +4,19 @@
 
 #include "pch.h"
 #include "Game.h"
+#include "AssetWarmup.h"
+#include "ConstantRingSimulation.h"
+#include "DecodeBenchmark.h"
+#include "LoaderCheck.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "MipGenerator.h"
+#include "StreamingSimulation.h"
+#include "SubmissionBenchmark.h"
+#include "TangentSpace.h"
+#include "TextureAtlas.h"
+#include "TextureCompressor.h"
+#include "VertexQuantization.h"
 
 using namespace DirectX;
 
@@ -17,6 +30,212 @@ using namespace DirectX;
 namespace
 {
     std::unique_ptr<Game> g_game;
+
+    // "<option> <directory>" at the start of the command line, runs a tool instead of
+    // the game. The directory defaults to the assets.
+    bool ParseDirectoryOption(LPCWSTR cmdLine, LPCWSTR option, std::string& directory)
+    {
+        const size_t length = wcslen(option);
+        if (wcsncmp(cmdLine, option, length) != 0 || (cmdLine[length] != L'\0' && cmdLine[length] != L' '))
+            return false;
+
+        const wchar_t* dir = cmdLine + length;
+        while (*dir == L' ' || *dir == L'"')
+            ++dir;
+        std::wstring wdir(dir);
+        while (!wdir.empty() && (wdir.back() == L' ' || wdir.back() == L'"'))
+            wdir.pop_back();
+        if (wdir.empty())
+            wdir = L"../assets/";
+
+        const int size = WideCharToMultiByte(CP_ACP, 0, wdir.c_str(), -1, nullptr, 0, nullptr, nullptr);
+        directory.resize(size > 0 ? size - 1 : 0);
+        WideCharToMultiByte(CP_ACP, 0, wdir.c_str(), -1, &directory[0], size, nullptr, nullptr);
+        return true;
+    }
+
+    // Report to the console that started us, if any
+    void AttachReportConsole()
+    {
+        FILE* out = nullptr;
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+        {
+            freopen_s(&out, "CONOUT$", "w", stdout);
+            freopen_s(&out, "CONOUT$", "w", stderr);
+        }
+    }
+
+    int RunWarmup(const std::string& directory)
+    {
+        AttachReportConsole();
+        const WarmupReport report = WarmAssetCache(directory, AssetCache::GetDefault());
+        PrintWarmupReport(report, stdout);
+        fflush(stdout);
+
+        for (const WarmupResult& asset : report.Assets)
+        {
+            if (!asset.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunDecodeBenchmark(const std::string& directory)
+    {
+        AttachReportConsole();
+        const DecodeBenchmarkReport report = BenchmarkImageDecode(directory);
+        PrintDecodeBenchmark(report, stdout);
+        fflush(stdout);
+
+        for (const DecodeTiming& image : report.Images)
+        {
+            if (!image.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunTextureCompression(const std::string& directory, bool highQuality)
+    {
+        AttachReportConsole();
+        const CompressionReport report = CompressTextures(directory, highQuality, AssetCache::GetDefault());
+        PrintCompressionReport(report, stdout);
+        fflush(stdout);
+
+        for (const CompressionResult& texture : report.Textures)
+        {
+            if (!texture.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunTexturePacking(const std::string& directory)
+    {
+        AttachReportConsole();
+        const AtlasReport report = MeasureTextureAtlas(directory, AtlasSettings(), AssetCache::GetDefault());
+        PrintAtlasReport(report, stdout);
+        fflush(stdout);
+        return report.Failed == 0 ? 0 : 1;
+    }
+
+    int RunMeshletCulling(const std::string& directory)
+    {
+        AttachReportConsole();
+        const MeshletCullReport report = MeasureMeshletCulling(directory, AssetCache::GetDefault());
+        PrintMeshletCullReport(report, stdout);
+        fflush(stdout);
+
+        for (const MeshletCullResult& mesh : report.Meshes)
+        {
+            if (!mesh.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunMeshQuantization(const std::string& directory)
+    {
+        AttachReportConsole();
+        const QuantizationReport report = MeasureMeshQuantization(directory, AssetCache::GetDefault());
+        PrintQuantizationReport(report, stdout);
+        fflush(stdout);
+
+        for (const MeshQuantizationResult& mesh : report.Meshes)
+        {
+            if (!mesh.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunMeshOptimization(const std::string& directory)
+    {
+        AttachReportConsole();
+        const MeshOptimizationReport report = MeasureMeshOptimization(directory);
+        PrintMeshOptimizationReport(report, stdout);
+        fflush(stdout);
+
+        for (const MeshOptimizationResult& mesh : report.Meshes)
+        {
+            if (!mesh.Succeeded)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunSubmissionBenchmark()
+    {
+        AttachReportConsole();
+        const SubmissionBenchmarkReport report = BenchmarkSubmission();
+        PrintSubmissionBenchmark(report, stdout);
+        fprintf(stdout, "\n");
+        const InstancingBenchmarkReport instancing = BenchmarkInstancing();
+        PrintInstancingBenchmark(instancing, stdout);
+        fflush(stdout);
+        return report.Counts.Errors == 0 && instancing.Counts.Errors == 0 ? 0 : 1;
+    }
+
+    int RunStreaming()
+    {
+        AttachReportConsole();
+        // a fraction of the full chains of the simulated grid, so levels get evicted
+        StreamingSettings settings;
+        settings.BudgetBytes = 24ull << 20;
+        settings.MaxUploadBytesPerUpdate = 4ull << 20;
+        const StreamingSimulationReport report = RunStreamingSimulation(settings);
+        PrintStreamingSimulation(report, stdout);
+        fflush(stdout);
+        return report.PeakResidentBytes <= settings.BudgetBytes ? 0 : 1;
+    }
+
+    int RunAssetLoaderCheck()
+    {
+        AttachReportConsole();
+        const LoaderCheckReport report = RunLoaderCheck(LoaderCheckSettings());
+        PrintLoaderCheck(report, stdout);
+        fflush(stdout);
+        return report.Failures.empty() ? 0 : 1;
+    }
+
+    int RunTangentSpaceCheck()
+    {
+        AttachReportConsole();
+        const TangentSpaceCheckReport report = CheckTangentSpace();
+        PrintTangentSpaceCheck(report, stdout);
+        fflush(stdout);
+
+        for (const TangentSpaceRun& run : report.Runs)
+        {
+            if (!run.Identical)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunMipCheck()
+    {
+        AttachReportConsole();
+        const MipCheckReport report = CheckMipGeneration();
+        PrintMipCheck(report, stdout);
+        fflush(stdout);
+
+        for (const MipCheckResult& result : report.Results)
+        {
+            if (result.MaxDifference > MIP_CHECK_MAX_DIFFERENCE)
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunConstantRing()
+    {
+        AttachReportConsole();
+        const ConstantRingSimulationReport report = RunConstantRingSimulation(GetDefaultConstantRingSimulationSettings());
+        PrintConstantRingSimulation(report, stdout);
+        fflush(stdout);
+        return report.Overlaps == 0 ? 0 : 1;
+    }
 }
 
 LPCWSTR g_szAppName = L"textures";
@@ -35,7 +254,6 @@ extern "C"
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
     if (!XMVerifyCPUSupport())
         return 1;
@@ -44,6 +262,109 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     if (FAILED(hr))
         return 1;
 
+    // "-warmcache <directory>" rebuilds the asset cache and times the index decode of the
+    // meshes, "-compresstextures <directory>"
+    // writes BC1/BC3/BC5 .dds files next to the textures, "-compresstextures-hq" BC7/BC5,
+    // "-benchdecode <directory>" times stb_image against WIC on the textures,
+    // "-simstreaming" runs texture streaming headless over a scripted camera path,
+    // "-simconstants" runs the constant ring against a simulated GPU fence,
+    // "-checkloader" drives the asset loader over the assets on a recording device and
+    // checks placeholders, upload budgets and failures,
+    // "-checktangents" compares the parallel normals and tangents with the scalar references
+    // bit for bit and reports triangles/s,
+    // "-checkmips" compares GenerateMips with the scalar reference and times both,
+    // "-packtextures <directory>" measures packing the textures into atlases and arrays,
+    // "-quantizemeshes <directory>" reports the error of the 16-byte vertex encodings,
+    // "-optimizemeshes <directory>" reports vertex cache ACMR and ATVR of the OBJ files before
+    // and after optimization,
+    // "-cullmeshlets <directory>" reports how many meshlets cone and frustum culling reject
+    // for cameras around each mesh,
+    // "-benchsubmit" times sorting, recording and replaying frames of draws and of instanced
+    // draws without a device
+    std::string toolDirectory;
+    if (ParseDirectoryOption(lpCmdLine, L"-warmcache", toolDirectory))
+    {
+        const int result = RunWarmup(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (ParseDirectoryOption(lpCmdLine, L"-benchdecode", toolDirectory))
+    {
+        const int result = RunDecodeBenchmark(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (ParseDirectoryOption(lpCmdLine, L"-packtextures", toolDirectory))
+    {
+        const int result = RunTexturePacking(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (ParseDirectoryOption(lpCmdLine, L"-cullmeshlets", toolDirectory))
+    {
+        const int result = RunMeshletCulling(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (ParseDirectoryOption(lpCmdLine, L"-quantizemeshes", toolDirectory))
+    {
+        const int result = RunMeshQuantization(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (ParseDirectoryOption(lpCmdLine, L"-optimizemeshes", toolDirectory))
+    {
+        const int result = RunMeshOptimization(toolDirectory);
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-benchsubmit") == 0)
+    {
+        const int result = RunSubmissionBenchmark();
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-simstreaming") == 0)
+    {
+        const int result = RunStreaming();
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-checkloader") == 0)
+    {
+        const int result = RunAssetLoaderCheck();
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-checktangents") == 0)
+    {
+        const int result = RunTangentSpaceCheck();
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-checkmips") == 0)
+    {
+        const int result = RunMipCheck();
+        CoUninitialize();
+        return result;
+    }
+    if (wcscmp(lpCmdLine, L"-simconstants") == 0)
+    {
+        const int result = RunConstantRing();
+        CoUninitialize();
+        return result;
+    }
+    const bool highQuality = ParseDirectoryOption(lpCmdLine, L"-compresstextures-hq", toolDirectory);
+    if (highQuality || ParseDirectoryOption(lpCmdLine, L"-compresstextures", toolDirectory))
+    {
+        const int result = RunTextureCompression(toolDirectory, highQuality);
+        CoUninitialize();
+        return result;
+    }
+
+    // Keep the cache of derived assets within its budget
+    AssetCache::GetDefault().Evict(ASSET_CACHE_MAX_BYTES);
+
     g_game = std::make_unique<Game>();
 
     // Register class and create window
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file.
+// The file is memory-mapped when possible, otherwise it is read into memory
+// with a single bulk read. Either way GetData() points at GetSize() bytes that
+// stay valid for the lifetime of the object. The data is NOT null-terminated.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& filepath);
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	void Close();
+
+	HANDLE				m_file = INVALID_HANDLE_VALUE;
+	HANDLE				m_mapping = nullptr;
+	const char*			m_data = nullptr;
+	size_t				m_size = 0;
+	bool				m_isOpen = false;
+	// used only when the file could not be mapped
+	std::vector<char>	m_buffer;
+};
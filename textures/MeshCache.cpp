@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include "IndexBuffer.h"
+#include "MeshData.h"
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+uint64_t GetMeshSettingsHash(bool encodeIndices)
+{
+	const uint32_t settings[] = { MESH_FILE_VERSION, static_cast<uint32_t>(sizeof(Render::Vertex)), encodeIndices ? MESH_FILE_ENCODED_INDICES : 0u };
+	return HashSettings(settings, sizeof(settings));
+}
+
+bool MeshBlob::Open(const std::string& cachePath, const AssetKey& key)
+{
+	m_file = MappedFile(cachePath);
+	if (!m_file.IsOpen() || m_file.GetSize() < sizeof(MeshFileHeader))
+	{
+		return false;
+	}
+
+	const uint64_t fileSize = m_file.GetSize();
+	const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(m_file.GetData());
+	if (header->Magic != MESH_FILE_MAGIC
+		|| header->Version != MESH_FILE_VERSION
+		|| header->VertexStride != sizeof(Render::Vertex)
+		|| header->SourceHash != key.SourceHash
+		|| header->SettingsHash != key.SettingsHash)
+	{
+		return false;
+	}
+
+	// Payload must fit in the file, the string table ends with a terminator
+	if (header->VertexOffset + static_cast<uint64_t>(header->NumVertices) * sizeof(Render::Vertex) > fileSize
+		|| header->IndexOffset + header->IndexSize > fileSize
+		|| header->SubmeshOffset + static_cast<uint64_t>(header->NumSubmeshes) * sizeof(Submesh) > fileSize
+		|| header->MaterialOffset + static_cast<uint64_t>(header->NumMaterials) * sizeof(MeshFileMaterial) > fileSize
+		|| header->StringOffset + header->StringSize > fileSize
+		|| header->StringSize == 0
+		|| m_file.GetData()[header->StringOffset + header->StringSize - 1] != '\0'
+		|| header->MeshletOffset + static_cast<uint64_t>(header->NumMeshlets) * sizeof(Meshlet) > fileSize
+		|| header->LodChainOffset + static_cast<uint64_t>(header->NumLodChains) * sizeof(MeshFileLodChain) > fileSize
+		|| header->LodLevelOffset + static_cast<uint64_t>(header->NumLodLevels) * sizeof(LodLevel) > fileSize
+		|| header->LodIndexOffset + static_cast<uint64_t>(header->NumLodIndices) * sizeof(uint32_t) > fileSize)
+	{
+		return false;
+	}
+
+	const uint8_t* indexData = reinterpret_cast<const uint8_t*>(m_file.GetData() + header->IndexOffset);
+	if (header->Flags & MESH_FILE_ENCODED_INDICES)
+	{
+		m_decodedIndices.resize(header->NumIndices);
+		if (!DecodeIndices(indexData, header->IndexSize, m_decodedIndices.data(), m_decodedIndices.size()))
+		{
+			return false;
+		}
+		m_indices = m_decodedIndices.data();
+	}
+	else
+	{
+		if (header->IndexSize != static_cast<uint64_t>(header->NumIndices) * sizeof(uint32_t))
+		{
+			return false;
+		}
+		m_indices = reinterpret_cast<const uint32_t*>(indexData);
+	}
+
+	const Submesh* submeshes = reinterpret_cast<const Submesh*>(m_file.GetData() + header->SubmeshOffset);
+	m_submeshes.assign(submeshes, submeshes + header->NumSubmeshes);
+	for (const Submesh& s : m_submeshes)
+	{
+		if (static_cast<uint64_t>(s.FirstIndex) + s.IndexCount > header->NumIndices
+			|| static_cast<uint64_t>(s.FirstVertex) + s.VertexCount > header->NumVertices
+			|| s.MaterialIndex >= header->NumMaterials)
+		{
+			return false;
+		}
+	}
+
+	const MeshFileMaterial* materials = reinterpret_cast<const MeshFileMaterial*>(m_file.GetData() + header->MaterialOffset);
+	const char* strings = m_file.GetData() + header->StringOffset;
+	m_materials.resize(header->NumMaterials);
+	for (uint32_t i = 0; i < header->NumMaterials; ++i)
+	{
+		const MeshFileMaterial& m = materials[i];
+		if (static_cast<uint64_t>(m.TextPathOffset) + m.TextPathLength >= header->StringSize)
+		{
+			return false;
+		}
+		m_materials[i].Mat = m.Mat;
+		m_materials[i].TextPath.assign(strings + m.TextPathOffset, m.TextPathLength);
+	}
+	if (static_cast<uint64_t>(header->MaterialLibraryOffset) + header->MaterialLibraryLength >= header->StringSize)
+	{
+		return false;
+	}
+	m_materialLibrary.assign(strings + header->MaterialLibraryOffset, header->MaterialLibraryLength);
+
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(m_file.GetData() + header->MeshletOffset);
+	m_meshlets.assign(meshlets, meshlets + header->NumMeshlets);
+	for (const Meshlet& m : m_meshlets)
+	{
+		if ((static_cast<uint64_t>(m.FirstTriangle) + m.TriangleCount) * 3 > header->NumIndices)
+		{
+			return false;
+		}
+	}
+
+	const MeshFileLodChain* chains = reinterpret_cast<const MeshFileLodChain*>(m_file.GetData() + header->LodChainOffset);
+	const LodLevel* levels = reinterpret_cast<const LodLevel*>(m_file.GetData() + header->LodLevelOffset);
+	const uint32_t* lodIndices = reinterpret_cast<const uint32_t*>(m_file.GetData() + header->LodIndexOffset);
+	m_lods.resize(header->NumLodChains);
+	for (uint32_t i = 0; i < header->NumLodChains; ++i)
+	{
+		const MeshFileLodChain& chain = chains[i];
+		if (static_cast<uint64_t>(chain.FirstLevel) + chain.NumLevels > header->NumLodLevels
+			|| static_cast<uint64_t>(chain.FirstIndex) + chain.NumIndices > header->NumLodIndices)
+		{
+			return false;
+		}
+		m_lods[i].Levels.assign(levels + chain.FirstLevel, levels + chain.FirstLevel + chain.NumLevels);
+		m_lods[i].Indices.assign(lodIndices + chain.FirstIndex, lodIndices + chain.FirstIndex + chain.NumIndices);
+		for (const LodLevel& level : m_lods[i].Levels)
+		{
+			if (static_cast<uint64_t>(level.FirstIndex) + level.IndexCount > chain.NumIndices)
+			{
+				return false;
+			}
+		}
+	}
+
+	m_header = header;
+	m_vertices = reinterpret_cast<const Render::Vertex*>(m_file.GetData() + header->VertexOffset);
+	return true;
+}
+
+const Render::Vertex* MeshBlob::GetVertices() const
+{
+	return m_vertices;
+}
+
+size_t MeshBlob::GetNumVertices() const
+{
+	return m_header ? m_header->NumVertices : 0;
+}
+
+const uint32_t* MeshBlob::GetIndices() const
+{
+	return m_indices;
+}
+
+size_t MeshBlob::GetNumIndices() const
+{
+	return m_header ? m_header->NumIndices : 0;
+}
+
+size_t MeshBlob::GetIndexDataSize() const
+{
+	return m_header ? m_header->IndexSize : 0;
+}
+
+const std::vector<Submesh>& MeshBlob::GetSubmeshes() const
+{
+	return m_submeshes;
+}
+
+const std::vector<MeshMaterial>& MeshBlob::GetMaterials() const
+{
+	return m_materials;
+}
+
+const std::vector<Meshlet>& MeshBlob::GetMeshlets() const
+{
+	return m_meshlets;
+}
+
+const std::vector<LodChain>& MeshBlob::GetLodChains() const
+{
+	return m_lods;
+}
+
+const std::string& MeshBlob::GetMaterialLibrary() const
+{
+	return m_materialLibrary;
+}
+
+uint64_t MeshBlob::GetMaterialLibraryHash() const
+{
+	return m_header ? m_header->MaterialLibraryHash : 0;
+}
+
+bool WriteMeshCache(const AssetCache& cache, const std::string& cachePath, const AssetKey& key, const Model& model,
+	bool encodeIndices, const std::string& materialLibrary, uint64_t materialLibraryHash)
+{
+	const std::vector<Position>& positions = model.GetPositions();
+	const std::vector<Submesh>& submeshes = model.GetSubmeshes();
+
+	// Texture paths go to the string table, every one with its terminator
+	std::vector<MeshFileMaterial> materials;
+	std::string strings;
+	for (const MeshMaterial& m : model.GetMaterials())
+	{
+		MeshFileMaterial material = {};
+		material.Mat = m.Mat;
+		material.TextPathOffset = static_cast<uint32_t>(strings.size());
+		material.TextPathLength = static_cast<uint32_t>(m.TextPath.size());
+		materials.push_back(material);
+		strings.append(m.TextPath.c_str(), m.TextPath.size() + 1);
+	}
+	const uint32_t materialLibraryOffset = static_cast<uint32_t>(strings.size());
+	strings.append(materialLibrary.c_str(), materialLibrary.size() + 1);
+
+	// Chains are flattened into one level and one index table
+	const std::vector<Meshlet>& meshlets = model.GetMeshlets();
+	std::vector<MeshFileLodChain> chains;
+	std::vector<LodLevel> levels;
+	std::vector<uint32_t> lodIndices;
+	for (const LodChain& lod : model.GetLodChains())
+	{
+		chains.push_back({ static_cast<uint32_t>(levels.size()), static_cast<uint32_t>(lod.Levels.size()),
+			static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(lod.Indices.size()) });
+		levels.insert(levels.end(), lod.Levels.begin(), lod.Levels.end());
+		lodIndices.insert(lodIndices.end(), lod.Indices.begin(), lod.Indices.end());
+	}
+
+	MeshFileHeader header = {};
+	header.Magic = MESH_FILE_MAGIC;
+	header.Version = MESH_FILE_VERSION;
+	header.SourceHash = key.SourceHash;
+	header.SettingsHash = key.SettingsHash;
+	header.MaterialLibraryOffset = materialLibraryOffset;
+	header.MaterialLibraryLength = static_cast<uint32_t>(materialLibrary.size());
+	header.MaterialLibraryHash = materialLibraryHash;
+	header.VertexStride = sizeof(Render::Vertex);
+	header.NumVertices = static_cast<uint32_t>(positions.size());
+	header.NumIndices = static_cast<uint32_t>(model.GetIndexCount());
+	header.NumSubmeshes = static_cast<uint32_t>(submeshes.size());
+	header.NumMaterials = static_cast<uint32_t>(materials.size());
+	header.NumMeshlets = static_cast<uint32_t>(meshlets.size());
+	header.NumLodChains = static_cast<uint32_t>(chains.size());
+	header.NumLodLevels = static_cast<uint32_t>(levels.size());
+	header.NumLodIndices = static_cast<uint32_t>(lodIndices.size());
+
+	std::vector<uint8_t> encoded;
+	if (encodeIndices)
+	{
+		EncodeIndices(model.GetIndices(), header.NumIndices, encoded);
+		header.Flags |= MESH_FILE_ENCODED_INDICES;
+		header.IndexSize = encoded.size();
+	}
+	else
+	{
+		header.IndexSize = static_cast<uint64_t>(header.NumIndices) * sizeof(uint32_t);
+	}
+
+	header.VertexOffset = AlignUp(sizeof(MeshFileHeader), 16);
+	header.IndexOffset = AlignUp(header.VertexOffset + static_cast<uint64_t>(header.NumVertices) * sizeof(Render::Vertex), 16);
+	header.SubmeshOffset = AlignUp(header.IndexOffset + header.IndexSize, 16);
+	header.MaterialOffset = AlignUp(header.SubmeshOffset + submeshes.size() * sizeof(Submesh), 16);
+	header.StringOffset = header.MaterialOffset + materials.size() * sizeof(MeshFileMaterial);
+	header.StringSize = strings.size();
+	header.MeshletOffset = AlignUp(header.StringOffset + header.StringSize, 16);
+	header.LodChainOffset = AlignUp(header.MeshletOffset + meshlets.size() * sizeof(Meshlet), 16);
+	header.LodLevelOffset = header.LodChainOffset + chains.size() * sizeof(MeshFileLodChain);
+	header.LodIndexOffset = header.LodLevelOffset + levels.size() * sizeof(LodLevel);
+
+	std::vector<Render::Vertex> vertices(positions.size());
+	MeshData::FromModel(model).Interleave(vertices.data());
+
+	// Every section at its offset, the padding between them stays zero
+	std::vector<uint8_t> file(header.LodIndexOffset + lodIndices.size() * sizeof(uint32_t));
+	const auto place = [&](uint64_t offset, const void* data, size_t size)
+	{
+		if (size > 0)
+		{
+			memcpy(file.data() + offset, data, size);
+		}
+	};
+	place(0, &header, sizeof(header));
+	place(header.VertexOffset, vertices.data(), vertices.size() * sizeof(Render::Vertex));
+	place(header.IndexOffset,
+		encodeIndices ? encoded.data() : reinterpret_cast<const uint8_t*>(model.GetIndices()), header.IndexSize);
+	place(header.SubmeshOffset, submeshes.data(), submeshes.size() * sizeof(Submesh));
+	place(header.MaterialOffset, materials.data(), materials.size() * sizeof(MeshFileMaterial));
+	place(header.StringOffset, strings.data(), strings.size());
+	place(header.MeshletOffset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	place(header.LodChainOffset, chains.data(), chains.size() * sizeof(MeshFileLodChain));
+	place(header.LodLevelOffset, levels.data(), levels.size() * sizeof(LodLevel));
+	place(header.LodIndexOffset, lodIndices.data(), lodIndices.size() * sizeof(uint32_t));
+	return cache.WriteArtifact(cachePath, file.data(), file.size());
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "AssetCache.h"
+#include "MappedFile.h"
+#include "Renderer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of a cached mesh:
+//     MeshFileHeader | Render::Vertex[NumVertices] | indices[IndexSize bytes]
+//     | Submesh[NumSubmeshes] | MeshFileMaterial[NumMaterials] | char[StringSize]
+//     | Meshlet[NumMeshlets] | MeshFileLodChain[NumLodChains] | LodLevel[NumLodLevels]
+//     | uint32_t[NumLodIndices]
+// Offsets are from the start of the file, so loading is a mapping plus pointer fixup.
+// The string table holds the null terminated texture paths of the materials and the
+// material library the texture paths came from, which is checked on load. Meshlets
+// and level of detail chains are stored as the model built them, indices absolute.
+// Indices are plain uint32_t, or with MESH_FILE_ENCODED_INDICES the EncodeIndices stream
+// that is decoded once on load.
+// Files live in the asset cache under the source content hash and GetMeshSettingsHash.
+// Bump MESH_FILE_VERSION whenever the layout, Render::Vertex or the import pipeline changes.
+constexpr uint32_t MESH_FILE_MAGIC = 0x4853454D; // "MESH"
+constexpr uint32_t MESH_FILE_VERSION = 9;
+
+constexpr uint32_t MESH_FILE_ENCODED_INDICES = 1 << 0;
+
+struct MeshFileHeader
+{
+	uint32_t	Magic;
+	uint32_t	Version;
+	// cache key
+	uint64_t	SourceHash;
+	uint64_t	SettingsHash;
+	// material library, relative to the model, into the string table, and its content hash
+	uint32_t	MaterialLibraryOffset;
+	uint32_t	MaterialLibraryLength;
+	uint64_t	MaterialLibraryHash;
+	// payload
+	uint32_t	VertexStride;
+	uint32_t	NumVertices;
+	uint32_t	NumIndices;
+	uint32_t	Flags;
+	uint32_t	NumSubmeshes;
+	uint32_t	NumMaterials;
+	uint32_t	NumMeshlets;
+	uint32_t	NumLodChains;
+	uint32_t	NumLodLevels;
+	uint32_t	NumLodIndices;
+	uint64_t	VertexOffset;
+	uint64_t	IndexOffset;
+	uint64_t	IndexSize;
+	uint64_t	SubmeshOffset;
+	uint64_t	MaterialOffset;
+	uint64_t	StringOffset;
+	uint64_t	StringSize;
+	uint64_t	MeshletOffset;
+	uint64_t	LodChainOffset;
+	uint64_t	LodLevelOffset;
+	uint64_t	LodIndexOffset;
+};
+
+struct MeshFileMaterial
+{
+	Material	Mat;
+	// into the string table
+	uint32_t	TextPathOffset;
+	uint32_t	TextPathLength;
+};
+
+// Ranges of one LodChain in the level and index tables
+struct MeshFileLodChain
+{
+	uint32_t	FirstLevel;
+	uint32_t	NumLevels;
+	uint32_t	FirstIndex;
+	uint32_t	NumIndices;
+};
+
+// Settings part of the cache key of a mesh, covers the version and the index encoding
+uint64_t GetMeshSettingsHash(bool encodeIndices);
+
+// A cached mesh mapped straight from disk
+class MeshBlob
+{
+public:
+	// Fails when the cache file is missing, corrupt or was built for another key
+	bool Open(const std::string& cachePath, const AssetKey& key);
+
+	const Render::Vertex* GetVertices() const;
+	size_t GetNumVertices() const;
+	const uint32_t* GetIndices() const;
+	size_t GetNumIndices() const;
+	// Bytes the indices take in the file
+	size_t GetIndexDataSize() const;
+	const std::vector<Submesh>& GetSubmeshes() const;
+	const std::vector<MeshMaterial>& GetMaterials() const;
+	const std::vector<Meshlet>& GetMeshlets() const;
+	const std::vector<LodChain>& GetLodChains() const;
+	// Material library the mesh was built with, empty without one. Its hash is 0 when the library was missing.
+	const std::string& GetMaterialLibrary() const;
+	uint64_t GetMaterialLibraryHash() const;
+
+private:
+	MappedFile				m_file;
+	const MeshFileHeader*	m_header = nullptr;
+	const Render::Vertex*	m_vertices = nullptr;
+	const uint32_t*			m_indices = nullptr;
+	std::vector<uint32_t>	m_decodedIndices;
+	std::vector<Submesh>	m_submeshes;
+	std::vector<MeshMaterial>	m_materials;
+	std::vector<Meshlet>	m_meshlets;
+	std::vector<LodChain>	m_lods;
+	std::string				m_materialLibrary;
+};
+
+// Writes the model, with its meshlets and levels of detail, as the cache file of the key. The file is built in memory
+// and written with AssetCache::WriteArtifact, so readers never see a partially written cache.
+bool WriteMeshCache(const AssetCache& cache, const std::string& cachePath, const AssetKey& key, const Model& model,
+	bool encodeIndices, const std::string& materialLibrary, uint64_t materialLibraryHash);
@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+	float HorizontalMin(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	float HorizontalMax(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+}
+
+static_assert(sizeof(Render::Vertex) == MeshData::STREAM_COUNT * sizeof(float),
+	"Interleave expects Render::Vertex to be the streams one after another");
+static_assert(MESH_DATA_PADDING % 4 == 0, "Streams are processed four floats at a time");
+
+void MeshData::AlignedDeleter::operator()(float* p) const
+{
+	_aligned_free(p);
+}
+
+MeshData::MeshData(size_t numVertices):
+	m_numVertices(numVertices),
+	m_paddedCount((numVertices + MESH_DATA_PADDING - 1) / MESH_DATA_PADDING * MESH_DATA_PADDING)
+{
+	if (m_paddedCount > 0)
+	{
+		// One allocation for all streams, the padded stream size keeps every stream aligned
+		void* p = _aligned_malloc(m_paddedCount * STREAM_COUNT * sizeof(float), MESH_DATA_ALIGNMENT);
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		m_storage.reset(static_cast<float*>(p));
+	}
+}
+
+MeshData MeshData::FromModel(const Model& model)
+{
+	MeshData mesh(model.GetVertexCount());
+	const size_t n = mesh.GetNumVertices();
+	float* px = mesh.GetStream(POSITION_X);
+	float* py = mesh.GetStream(POSITION_Y);
+	float* pz = mesh.GetStream(POSITION_Z);
+	float* nx = mesh.GetStream(NORMAL_X);
+	float* ny = mesh.GetStream(NORMAL_Y);
+	float* nz = mesh.GetStream(NORMAL_Z);
+	float* u = mesh.GetStream(TEXTCOORD_U);
+	float* v = mesh.GetStream(TEXTCOORD_V);
+
+	if (const MeshBlob* blob = model.GetMeshBlob())
+	{
+		const Render::Vertex* vertices = blob->GetVertices();
+		for (size_t i = 0; i < n; ++i)
+		{
+			px[i] = vertices[i].Pos.x;
+			py[i] = vertices[i].Pos.y;
+			pz[i] = vertices[i].Pos.z;
+			nx[i] = vertices[i].Norm.x;
+			ny[i] = vertices[i].Norm.y;
+			nz[i] = vertices[i].Norm.z;
+			u[i] = vertices[i].Tex.x;
+			v[i] = vertices[i].Tex.y;
+		}
+		mesh.UpdatePadding();
+		return mesh;
+	}
+
+	const std::vector<Position>& positions = model.GetPositions();
+	for (size_t i = 0; i < n; ++i)
+	{
+		px[i] = positions[i].X;
+		py[i] = positions[i].Y;
+		pz[i] = positions[i].Z;
+	}
+
+	const std::vector<Normal>& normals = model.GetNormals();
+	const size_t numNormals = (std::min)(normals.size(), n);
+	for (size_t i = 0; i < numNormals; ++i)
+	{
+		nx[i] = normals[i].X;
+		ny[i] = normals[i].Y;
+		nz[i] = normals[i].Z;
+	}
+	for (float* s : { nx, ny, nz })
+		std::fill(s + numNormals, s + n, 0.0f);
+
+	const std::vector<TextCoord>& textCoords = model.GetTextCoords();
+	const size_t numTextCoords = (std::min)(textCoords.size(), n);
+	for (size_t i = 0; i < numTextCoords; ++i)
+	{
+		u[i] = textCoords[i].X;
+		v[i] = textCoords[i].Y;
+	}
+	for (float* s : { u, v })
+		std::fill(s + numTextCoords, s + n, 0.0f);
+
+	mesh.UpdatePadding();
+	return mesh;
+}
+
+size_t MeshData::GetNumVertices() const
+{
+	return m_numVertices;
+}
+
+size_t MeshData::GetPaddedCount() const
+{
+	return m_paddedCount;
+}
+
+float* MeshData::GetStream(Stream stream)
+{
+	return m_storage.get() + stream * m_paddedCount;
+}
+
+const float* MeshData::GetStream(Stream stream) const
+{
+	return m_storage.get() + stream * m_paddedCount;
+}
+
+void MeshData::UpdatePadding()
+{
+	for (int s = 0; s < STREAM_COUNT; ++s)
+	{
+		float* stream = GetStream(static_cast<Stream>(s));
+		const float last = m_numVertices > 0 ? stream[m_numVertices - 1] : 0.0f;
+		std::fill(stream + m_numVertices, stream + m_paddedCount, last);
+	}
+}
+
+void MeshData::Interleave(Render::Vertex* dst) const
+{
+	const float* px = GetStream(POSITION_X);
+	const float* py = GetStream(POSITION_Y);
+	const float* pz = GetStream(POSITION_Z);
+	const float* nx = GetStream(NORMAL_X);
+	const float* ny = GetStream(NORMAL_Y);
+	const float* nz = GetStream(NORMAL_Z);
+	const float* u = GetStream(TEXTCOORD_U);
+	const float* v = GetStream(TEXTCOORD_V);
+
+	float* out = reinterpret_cast<float*>(dst);
+	const bool aligned = (reinterpret_cast<uintptr_t>(out) & 15) == 0;
+
+	// Four vertices per iteration: two 4x4 transposes turn eight stream registers
+	// into the two halves of four vertices
+	size_t i = 0;
+	for (; i + 4 <= m_numVertices; i += 4, out += 4 * STREAM_COUNT)
+	{
+		__m128 a0 = _mm_load_ps(px + i);
+		__m128 a1 = _mm_load_ps(py + i);
+		__m128 a2 = _mm_load_ps(pz + i);
+		__m128 a3 = _mm_load_ps(nx + i);
+		__m128 b0 = _mm_load_ps(ny + i);
+		__m128 b1 = _mm_load_ps(nz + i);
+		__m128 b2 = _mm_load_ps(u + i);
+		__m128 b3 = _mm_load_ps(v + i);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+		if (aligned)
+		{
+			// mapped buffers are write-combined, streaming stores skip the cache
+			_mm_stream_ps(out + 0, a0);
+			_mm_stream_ps(out + 4, b0);
+			_mm_stream_ps(out + 8, a1);
+			_mm_stream_ps(out + 12, b1);
+			_mm_stream_ps(out + 16, a2);
+			_mm_stream_ps(out + 20, b2);
+			_mm_stream_ps(out + 24, a3);
+			_mm_stream_ps(out + 28, b3);
+		}
+		else
+		{
+			_mm_storeu_ps(out + 0, a0);
+			_mm_storeu_ps(out + 4, b0);
+			_mm_storeu_ps(out + 8, a1);
+			_mm_storeu_ps(out + 12, b1);
+			_mm_storeu_ps(out + 16, a2);
+			_mm_storeu_ps(out + 20, b2);
+			_mm_storeu_ps(out + 24, a3);
+			_mm_storeu_ps(out + 28, b3);
+		}
+	}
+
+	for (; i < m_numVertices; ++i, out += STREAM_COUNT)
+	{
+		out[0] = px[i];
+		out[1] = py[i];
+		out[2] = pz[i];
+		out[3] = nx[i];
+		out[4] = ny[i];
+		out[5] = nz[i];
+		out[6] = u[i];
+		out[7] = v[i];
+	}
+
+	if (aligned)
+	{
+		_mm_sfence();
+	}
+}
+
+void MeshData::ComputeBounds(DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax) const
+{
+	if (m_numVertices == 0)
+	{
+		boundsMin = boundsMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	const float* px = GetStream(POSITION_X);
+	const float* py = GetStream(POSITION_Y);
+	const float* pz = GetStream(POSITION_Z);
+
+	__m128 minX = _mm_load_ps(px);
+	__m128 minY = _mm_load_ps(py);
+	__m128 minZ = _mm_load_ps(pz);
+	__m128 maxX = minX;
+	__m128 maxY = minY;
+	__m128 maxZ = minZ;
+	// the padded range is safe to read, padding repeats the last vertex
+	for (size_t i = 4; i < m_paddedCount; i += 4)
+	{
+		const __m128 x = _mm_load_ps(px + i);
+		const __m128 y = _mm_load_ps(py + i);
+		const __m128 z = _mm_load_ps(pz + i);
+		minX = _mm_min_ps(minX, x);
+		minY = _mm_min_ps(minY, y);
+		minZ = _mm_min_ps(minZ, z);
+		maxX = _mm_max_ps(maxX, x);
+		maxY = _mm_max_ps(maxY, y);
+		maxZ = _mm_max_ps(maxZ, z);
+	}
+
+	boundsMin = DirectX::XMFLOAT3(HorizontalMin(minX), HorizontalMin(minY), HorizontalMin(minZ));
+	boundsMax = DirectX::XMFLOAT3(HorizontalMax(maxX), HorizontalMax(maxY), HorizontalMax(maxZ));
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Model.h"
+#include "Renderer.h"
+
+#include <memory>
+
+// Structure-of-arrays vertex storage for CPU side processing (skinning, culling, bounds).
+// Every component lives in its own stream aligned to MESH_DATA_ALIGNMENT bytes and padded
+// to a multiple of MESH_DATA_PADDING elements, so SIMD loops run on full registers
+// without a scalar tail. Padding replicates the last vertex, min/max reductions over the
+// padded range give the same result as over the real vertices.
+constexpr size_t MESH_DATA_ALIGNMENT = 32;
+constexpr size_t MESH_DATA_PADDING = 8;
+
+class MeshData
+{
+public:
+	enum Stream
+	{
+		POSITION_X,
+		POSITION_Y,
+		POSITION_Z,
+		NORMAL_X,
+		NORMAL_Y,
+		NORMAL_Z,
+		TEXTCOORD_U,
+		TEXTCOORD_V,
+		STREAM_COUNT
+	};
+
+	MeshData() = default;
+	explicit MeshData(size_t numVertices);
+
+	MeshData(MeshData&&) = default;
+	MeshData& operator=(MeshData&&) = default;
+	MeshData(const MeshData&) = delete;
+	MeshData& operator=(const MeshData&) = delete;
+
+	// Missing normals or texture coordinates become zero
+	static MeshData FromModel(const Model& model);
+
+	size_t GetNumVertices() const;
+	// Number of elements in every stream, a multiple of MESH_DATA_PADDING
+	size_t GetPaddedCount() const;
+
+	float* GetStream(Stream stream);
+	const float* GetStream(Stream stream) const;
+
+	// Fills the padding at the end of every stream with the last vertex
+	void UpdatePadding();
+
+	// Writes GetNumVertices() interleaved vertices to dst, which may be a mapped GPU buffer.
+	// Uses non-temporal stores when dst is 16 byte aligned.
+	void Interleave(Render::Vertex* dst) const;
+
+	void ComputeBounds(DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax) const;
+
+private:
+	struct AlignedDeleter
+	{
+		void operator()(float* p) const;
+	};
+
+	std::unique_ptr<float[], AlignedDeleter>	m_storage;
+	size_t										m_numVertices = 0;
+	size_t										m_paddedCount = 0;
+};
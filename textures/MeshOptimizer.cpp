@@ -0,0 +1,493 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include "AssetWarmup.h"
+
+#include <iostream>
+#include <numeric>
+
+namespace
+{
+	// Forsyth's tuning constants, see "Linear-Speed Vertex Cache Optimisation"
+	constexpr int CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRI_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+	constexpr unsigned int MAX_VALENCE_SCORE = 32;
+
+	constexpr unsigned int NO_VERTEX = ~0u;
+
+	inline unsigned int Corner(const Face& f, int corner)
+	{
+		return corner == 0 ? f.X : (corner == 1 ? f.Y : f.Z);
+	}
+
+	struct ScoreTables
+	{
+		float CachePosition[CACHE_SIZE];
+		float Valence[MAX_VALENCE_SCORE + 1];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < CACHE_SIZE; ++i)
+			{
+				if (i < 3)
+				{
+					// the last triangle's vertices get a fixed score, so the algorithm
+					// does not favour using one of them over the others
+					CachePosition[i] = LAST_TRI_SCORE;
+				}
+				else
+				{
+					const float scaler = 1.0f / (CACHE_SIZE - 3);
+					CachePosition[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+			Valence[0] = 0.0f;
+			for (unsigned int i = 1; i <= MAX_VALENCE_SCORE; ++i)
+			{
+				// boost vertices with few triangles left, so lone triangles are not left behind
+				Valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+			}
+		}
+	};
+
+	float VertexScore(const ScoreTables& tables, int cachePosition, unsigned int remainingValence)
+	{
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.CachePosition[cachePosition] : 0.0f;
+		score += tables.Valence[(std::min)(remainingValence, MAX_VALENCE_SCORE)];
+		return score;
+	}
+
+	// Triangles adjacent to every vertex in compressed sparse row form
+	struct Adjacency
+	{
+		std::vector<unsigned int> Offsets;
+		std::vector<unsigned int> Counts;
+		std::vector<unsigned int> Triangles;
+
+		Adjacency(const std::vector<Face>& faces, size_t numVertices):
+			Offsets(numVertices + 1, 0),
+			Counts(numVertices, 0),
+			Triangles(faces.size() * 3)
+		{
+			for (const Face& f : faces)
+			{
+				++Counts[f.X];
+				++Counts[f.Y];
+				++Counts[f.Z];
+			}
+			for (size_t v = 0; v < numVertices; ++v)
+				Offsets[v + 1] = Offsets[v] + Counts[v];
+
+			std::vector<unsigned int> fill(Offsets.begin(), Offsets.end() - 1);
+			for (unsigned int t = 0; t < faces.size(); ++t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					const unsigned int v = Corner(faces[t], c);
+					Triangles[fill[v]++] = t;
+				}
+			}
+		}
+	};
+
+	template <typename IsHit, typename Touch>
+	VertexCacheStats SimulateCache(const std::vector<Face>& faces, size_t numVertices, IsHit&& isHit, Touch&& touch)
+	{
+		VertexCacheStats stats;
+		if (faces.empty())
+			return stats;
+
+		std::vector<bool> referenced(numVertices, false);
+		size_t numReferenced = 0;
+		size_t misses = 0;
+		for (const Face& f : faces)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				const unsigned int v = Corner(f, c);
+				if (!referenced[v])
+				{
+					referenced[v] = true;
+					++numReferenced;
+				}
+				if (!isHit(v))
+					++misses;
+				touch(v);
+			}
+		}
+
+		stats.Acmr = static_cast<float>(misses) / faces.size();
+		stats.Atvr = numReferenced > 0 ? static_cast<float>(misses) / numReferenced : 0.0f;
+		return stats;
+	}
+}
+
+VertexCacheStats SimulateFifoCache(const std::vector<Face>& faces, size_t numVertices, unsigned int cacheSize)
+{
+	// a vertex is in a FIFO cache if it was inserted less than cacheSize insertions ago
+	std::vector<size_t> insertedAt(numVertices, 0);
+	size_t timestamp = cacheSize + 1;
+	bool hit = false;
+	return SimulateCache(faces, numVertices,
+		[&](unsigned int v)
+		{
+			hit = timestamp - insertedAt[v] <= cacheSize;
+			return hit;
+		},
+		[&](unsigned int v)
+		{
+			if (!hit)
+				insertedAt[v] = timestamp++;
+		});
+}
+
+VertexCacheStats SimulateLruCache(const std::vector<Face>& faces, size_t numVertices, unsigned int cacheSize)
+{
+	std::vector<unsigned int> cache;
+	cache.reserve(cacheSize + 1);
+	return SimulateCache(faces, numVertices,
+		[&](unsigned int v)
+		{
+			return std::find(cache.begin(), cache.end(), v) != cache.end();
+		},
+		[&](unsigned int v)
+		{
+			auto it = std::find(cache.begin(), cache.end(), v);
+			if (it != cache.end())
+				cache.erase(it);
+			cache.insert(cache.begin(), v);
+			if (cache.size() > cacheSize)
+				cache.pop_back();
+		});
+}
+
+void OptimizeVertexCache(std::vector<Face>& faces, size_t numVertices)
+{
+	const size_t numFaces = faces.size();
+	if (numFaces == 0)
+		return;
+
+	static const ScoreTables s_tables;
+	Adjacency adjacency(faces, numVertices);
+
+	// Counts are the remaining valence from here on, the first Counts[v] entries of
+	// a vertex's triangle list are the triangles not emitted yet
+	std::vector<int> cachePositions(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (size_t v = 0; v < numVertices; ++v)
+		vertexScores[v] = VertexScore(s_tables, -1, adjacency.Counts[v]);
+
+	std::vector<float> triangleScores(numFaces);
+	std::vector<bool> emitted(numFaces, false);
+	for (size_t t = 0; t < numFaces; ++t)
+		triangleScores[t] = vertexScores[faces[t].X] + vertexScores[faces[t].Y] + vertexScores[faces[t].Z];
+
+	std::vector<Face> result;
+	result.reserve(numFaces);
+
+	unsigned int cache[CACHE_SIZE + 3];
+	unsigned int newCache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	unsigned int best = static_cast<unsigned int>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	size_t cursor = 0;
+
+	while (result.size() < numFaces)
+	{
+		if (best == NO_VERTEX)
+		{
+			// Nothing in the cache is useful, continue with the next triangle in input order
+			while (emitted[cursor])
+				++cursor;
+			best = static_cast<unsigned int>(cursor);
+		}
+
+		const Face& face = faces[best];
+		result.push_back(face);
+		emitted[best] = true;
+
+		// Remove the triangle from the active lists of its vertices
+		for (int c = 0; c < 3; ++c)
+		{
+			const unsigned int v = Corner(face, c);
+			unsigned int* tris = &adjacency.Triangles[adjacency.Offsets[v]];
+			unsigned int& count = adjacency.Counts[v];
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				if (tris[i] == best)
+				{
+					tris[i] = tris[--count];
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache
+		int newCount = 0;
+		for (int c = 0; c < 3; ++c)
+			newCache[newCount++] = Corner(face, c);
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			const unsigned int v = cache[i];
+			if (v != face.X && v != face.Y && v != face.Z)
+				newCache[newCount++] = v;
+		}
+
+		// Update scores of everything that was in the cache, including the evicted vertices
+		for (int i = 0; i < newCount; ++i)
+		{
+			const unsigned int v = newCache[i];
+			cachePositions[v] = i < CACHE_SIZE ? i : -1;
+			vertexScores[v] = VertexScore(s_tables, cachePositions[v], adjacency.Counts[v]);
+		}
+		cacheCount = (std::min)(newCount, CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// The next triangle is the best one touching the cache
+		best = NO_VERTEX;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; ++i)
+		{
+			const unsigned int v = newCache[i];
+			const unsigned int* tris = &adjacency.Triangles[adjacency.Offsets[v]];
+			for (unsigned int k = 0; k < adjacency.Counts[v]; ++k)
+			{
+				const unsigned int t = tris[k];
+				const Face& f = faces[t];
+				const float score = vertexScores[f.X] + vertexScores[f.Y] + vertexScores[f.Z];
+				triangleScores[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+
+	faces.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<Face>& faces, const std::vector<Position>& positions, float threshold)
+{
+	const size_t numFaces = faces.size();
+	if (numFaces == 0)
+		return;
+
+	// FIFO cache simulation shared by all passes, a flush makes every entry stale
+	std::vector<size_t> insertedAt(positions.size(), 0);
+	size_t timestamp = FIFO_CACHE_SIZE + 1;
+	auto countMisses = [&](const Face& f)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; ++c)
+		{
+			const unsigned int v = Corner(f, c);
+			if (timestamp - insertedAt[v] > FIFO_CACHE_SIZE)
+			{
+				insertedAt[v] = timestamp++;
+				++misses;
+			}
+		}
+		return misses;
+	};
+	auto flushCache = [&]()
+	{
+		timestamp += FIFO_CACHE_SIZE + 1;
+	};
+
+	// Hard boundaries: triangles that miss the cache with all three vertices start a new cluster
+	std::vector<size_t> clusterStarts;
+	for (size_t t = 0; t < numFaces; ++t)
+	{
+		if (countMisses(faces[t]) == 3 || t == 0)
+			clusterStarts.push_back(t);
+	}
+	clusterStarts.push_back(numFaces);
+
+	// Soft boundaries: split a hard cluster wherever the run so far is cheap enough
+	std::vector<size_t> softStarts;
+	for (size_t c = 0; c + 1 < clusterStarts.size(); ++c)
+	{
+		const size_t begin = clusterStarts[c];
+		const size_t end = clusterStarts[c + 1];
+
+		flushCache();
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; ++t)
+			clusterMisses += countMisses(faces[t]);
+		const float clusterAcmr = static_cast<float>(clusterMisses) / (end - begin);
+
+		flushCache();
+		size_t runStart = begin;
+		size_t runMisses = 0;
+		softStarts.push_back(begin);
+		for (size_t t = begin; t < end; ++t)
+		{
+			runMisses += countMisses(faces[t]);
+
+			const size_t runLength = t + 1 - runStart;
+			if (t + 1 < end && static_cast<float>(runMisses) / runLength <= threshold * clusterAcmr)
+			{
+				// the next run starts with a cold cache
+				softStarts.push_back(t + 1);
+				runStart = t + 1;
+				runMisses = 0;
+				flushCache();
+			}
+		}
+	}
+	softStarts.push_back(numFaces);
+
+	// Mesh centroid, and per cluster the area weighted centroid and normal
+	float meshCenter[3] = {};
+	for (const Position& p : positions)
+	{
+		meshCenter[0] += p.X;
+		meshCenter[1] += p.Y;
+		meshCenter[2] += p.Z;
+	}
+	for (float& m : meshCenter)
+		m /= (std::max)(static_cast<float>(positions.size()), 1.0f);
+
+	const size_t numClusters = softStarts.size() - 1;
+	std::vector<float> sortKeys(numClusters);
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		float center[3] = {};
+		float normal[3] = {};
+		float area = 0.0f;
+		for (size_t t = softStarts[c]; t < softStarts[c + 1]; ++t)
+		{
+			const Position& p0 = positions[faces[t].X];
+			const Position& p1 = positions[faces[t].Y];
+			const Position& p2 = positions[faces[t].Z];
+			const float e1[3] = { p1.X - p0.X, p1.Y - p0.Y, p1.Z - p0.Z };
+			const float e2[3] = { p2.X - p0.X, p2.Y - p0.Y, p2.Z - p0.Z };
+			const float n[3] = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0] };
+			const float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			center[0] += (p0.X + p1.X + p2.X) / 3.0f * a;
+			center[1] += (p0.Y + p1.Y + p2.Y) / 3.0f * a;
+			center[2] += (p0.Z + p1.Z + p2.Z) / 3.0f * a;
+			normal[0] += n[0];
+			normal[1] += n[1];
+			normal[2] += n[2];
+			area += a;
+		}
+
+		const float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+		const float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		const float invNormalLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+		// how far the cluster is out along its own normal, outer clusters occlude inner ones
+		sortKeys[c] = ((center[0] * invArea - meshCenter[0]) * normal[0]
+			+ (center[1] * invArea - meshCenter[1]) * normal[1]
+			+ (center[2] * invArea - meshCenter[2]) * normal[2]) * invNormalLength;
+	}
+
+	std::vector<size_t> order(numClusters);
+	std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<Face> result;
+	result.reserve(numFaces);
+	for (size_t c : order)
+		result.insert(result.end(), faces.begin() + softStarts[c], faces.begin() + softStarts[c + 1]);
+	faces.swap(result);
+}
+
+std::vector<unsigned int> OptimizeVertexFetch(std::vector<Face>& faces, size_t numVertices)
+{
+	std::vector<unsigned int> remap(numVertices, NO_VERTEX);
+	unsigned int next = 0;
+	for (Face& f : faces)
+	{
+		for (unsigned int* v : { &f.X, &f.Y, &f.Z })
+		{
+			if (remap[*v] == NO_VERTEX)
+				remap[*v] = next++;
+			*v = remap[*v];
+		}
+	}
+	return remap;
+}
+
+void OptimizeMesh(std::vector<Position>& positions,
+	std::vector<Normal>& normals,
+	std::vector<TextCoord>& textCoords,
+	std::vector<Face>& faces,
+	MeshOptimizerReport* report)
+{
+	if (report)
+	{
+		report->FifoBefore = SimulateFifoCache(faces, positions.size());
+		report->LruBefore = SimulateLruCache(faces, positions.size());
+	}
+
+	OptimizeVertexCache(faces, positions.size());
+	OptimizeOverdraw(faces, positions);
+
+	const std::vector<unsigned int> remap = OptimizeVertexFetch(faces, positions.size());
+	RemapVertices(positions, remap);
+	RemapVertices(normals, remap);
+	RemapVertices(textCoords, remap);
+
+	if (report)
+	{
+		report->FifoAfter = SimulateFifoCache(faces, positions.size());
+		report->LruAfter = SimulateLruCache(faces, positions.size());
+	}
+}
+
+MeshOptimizationReport MeasureMeshOptimization(const std::string& directory)
+{
+	MeshOptimizationReport report;
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind != WARMUP_MESH || !HasExtension(asset.Path, ".obj"))
+		{
+			continue;
+		}
+		MeshOptimizationResult result = {};
+		result.Path = asset.Path;
+		std::string materialLibrary;
+		const std::unique_ptr<Model> model = ParseObjectFile(asset.Path, materialLibrary, &result.Cache);
+		result.Succeeded = model != nullptr;
+		if (!result.Succeeded)
+		{
+			std::cerr << "ERROR: Failed to load mesh " << asset.Path << std::endl;
+			report.Meshes.push_back(result);
+			continue;
+		}
+		result.NumVertices = model->GetPositions().size();
+		result.NumTriangles = model->GetFaces().size();
+		report.Meshes.push_back(result);
+	}
+	return report;
+}
+
+void PrintMeshOptimizationReport(const MeshOptimizationReport& report, FILE* out)
+{
+	fprintf(out, "%-40s %9s %9s  %-14s %-14s %-14s %s\n", "mesh", "vertices", "triangles",
+		"ACMR FIFO16", "ACMR LRU32", "ATVR FIFO16", "ATVR LRU32");
+	for (const MeshOptimizationResult& mesh : report.Meshes)
+	{
+		if (!mesh.Succeeded)
+		{
+			fprintf(out, "%-40s %9s\n", mesh.Path.c_str(), "FAILED");
+			continue;
+		}
+		const MeshOptimizerReport& c = mesh.Cache;
+		fprintf(out, "%-40s %9zu %9zu  %5.3f->%-7.3f %5.3f->%-7.3f %5.3f->%-7.3f %5.3f->%.3f\n", mesh.Path.c_str(),
+			mesh.NumVertices, mesh.NumTriangles, c.FifoBefore.Acmr, c.FifoAfter.Acmr, c.LruBefore.Acmr, c.LruAfter.Acmr,
+			c.FifoBefore.Atvr, c.FifoAfter.Atvr, c.LruBefore.Atvr, c.LruAfter.Atvr);
+	}
+}
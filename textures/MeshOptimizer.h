@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Post-transform vertex cache efficiency of an index buffer.
+// ACMR - average cache miss ratio, transformed vertices per triangle (0.5 is the ideal for large grids, 3 the worst).
+// ATVR - average transformed vertex ratio, transformed vertices per referenced vertex (1 is the ideal).
+struct VertexCacheStats
+{
+	float	Acmr = 0.0f;
+	float	Atvr = 0.0f;
+};
+
+constexpr unsigned int FIFO_CACHE_SIZE = 16;
+constexpr unsigned int LRU_CACHE_SIZE = 32;
+
+VertexCacheStats SimulateFifoCache(const std::vector<Face>& faces, size_t numVertices, unsigned int cacheSize = FIFO_CACHE_SIZE);
+VertexCacheStats SimulateLruCache(const std::vector<Face>& faces, size_t numVertices, unsigned int cacheSize = LRU_CACHE_SIZE);
+
+// Reorders triangles for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(std::vector<Face>& faces, size_t numVertices);
+
+// Splits cache-optimized triangles into clusters and sorts the clusters so the ones
+// facing outwards are drawn first. A cluster may be cut as long as its ACMR stays
+// below 'threshold' times the ACMR of the unsplit run, e.g. 1.05 allows 5% more misses.
+void OptimizeOverdraw(std::vector<Face>& faces, const std::vector<Position>& positions, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use. Returns the old to new index remap,
+// unreferenced vertices map to ~0u and are dropped by RemapVertices.
+std::vector<unsigned int> OptimizeVertexFetch(std::vector<Face>& faces, size_t numVertices);
+
+template <typename T>
+void RemapVertices(std::vector<T>& vertices, const std::vector<unsigned int>& remap)
+{
+	if (vertices.empty())
+		return;
+
+	size_t count = 0;
+	for (unsigned int r : remap)
+		count += r != ~0u;
+
+	std::vector<T> result(count);
+	for (size_t i = 0; i < remap.size() && i < vertices.size(); ++i)
+	{
+		if (remap[i] != ~0u)
+			result[remap[i]] = vertices[i];
+	}
+	vertices.swap(result);
+}
+
+struct MeshOptimizerReport
+{
+	VertexCacheStats	FifoBefore;
+	VertexCacheStats	FifoAfter;
+	VertexCacheStats	LruBefore;
+	VertexCacheStats	LruAfter;
+};
+
+// Runs vertex cache, overdraw and vertex fetch optimization on an indexed mesh. The
+// caches are only simulated before and after when a report is asked for.
+void OptimizeMesh(std::vector<Position>& positions,
+	std::vector<Normal>& normals,
+	std::vector<TextCoord>& textCoords,
+	std::vector<Face>& faces,
+	MeshOptimizerReport* report = nullptr);
+
+struct MeshOptimizationResult
+{
+	std::string			Path;
+	bool				Succeeded;
+	size_t				NumVertices;
+	size_t				NumTriangles;
+	MeshOptimizerReport	Cache;
+};
+
+struct MeshOptimizationReport
+{
+	std::vector<MeshOptimizationResult>	Meshes;
+};
+
+// Imports every OBJ file in the directory, not recursing, with the native parser and
+// without the cache, and reports ACMR and ATVR before and after OptimizeMesh. Assimp
+// reorders the other formats itself.
+MeshOptimizationReport MeasureMeshOptimization(const std::string& directory);
+
+void PrintMeshOptimizationReport(const MeshOptimizationReport& report, FILE* out);
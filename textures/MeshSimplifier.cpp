@@ -0,0 +1,448 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+
+#include <numeric>
+
+namespace
+{
+	// a collapse may not turn a triangle more than about 75 degrees
+	constexpr float MIN_NORMAL_DOT = 0.25f;
+	// a level that keeps more than this share of the previous level is not worth storing
+	constexpr float MIN_LOD_REDUCTION = 0.9f;
+
+	struct Vec3
+	{
+		float X, Y, Z;
+	};
+
+	Vec3 Sub(const Vec3& a, const Vec3& b)
+	{
+		return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	}
+
+	Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	float Dot(const Vec3& a, const Vec3& b)
+	{
+		return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+	}
+
+	// Sum of squared distances to a set of planes, as the 10 unique terms of a symmetric 4x4
+	struct Quadric
+	{
+		double A2, B2, C2, D2, AB, AC, AD, BC, BD, CD;
+		double Weight;
+	};
+
+	void AddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+	{
+		q.A2 += a * a * weight;
+		q.B2 += b * b * weight;
+		q.C2 += c * c * weight;
+		q.D2 += d * d * weight;
+		q.AB += a * b * weight;
+		q.AC += a * c * weight;
+		q.AD += a * d * weight;
+		q.BC += b * c * weight;
+		q.BD += b * d * weight;
+		q.CD += c * d * weight;
+		q.Weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& r)
+	{
+		q.A2 += r.A2;
+		q.B2 += r.B2;
+		q.C2 += r.C2;
+		q.D2 += r.D2;
+		q.AB += r.AB;
+		q.AC += r.AC;
+		q.AD += r.AD;
+		q.BC += r.BC;
+		q.BD += r.BD;
+		q.CD += r.CD;
+		q.Weight += r.Weight;
+	}
+
+	// Mean squared distance of p to the planes of the quadric
+	float EvaluateQuadric(const Quadric& q, const Vec3& p)
+	{
+		const double x = p.X;
+		const double y = p.Y;
+		const double z = p.Z;
+		const double error = q.A2 * x * x + q.B2 * y * y + q.C2 * z * z + q.D2
+			+ 2.0 * (q.AB * x * y + q.AC * x * z + q.AD * x + q.BC * y * z + q.BD * y + q.CD * z);
+		return q.Weight > 0.0 ? static_cast<float>((std::max)(error, 0.0) / q.Weight) : 0.0f;
+	}
+
+	struct Collapse
+	{
+		uint32_t	From;
+		uint32_t	To;
+		float		Cost;
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const float* positions, size_t vertexStride, size_t numVertices):
+			m_positions(positions),
+			m_vertexStride(vertexStride),
+			m_numVertices(numVertices)
+		{
+		}
+
+		float Run(std::vector<uint32_t>& indices, size_t targetIndexCount);
+
+	private:
+		Vec3 GetPosition(uint32_t v) const
+		{
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(m_positions) + v * m_vertexStride);
+			return { p[0], p[1], p[2] };
+		}
+
+		bool SamePosition(uint32_t a, uint32_t b) const
+		{
+			const Vec3 pa = GetPosition(a);
+			const Vec3 pb = GetPosition(b);
+			return pa.X == pb.X && pa.Y == pb.Y && pa.Z == pb.Z;
+		}
+
+		void BuildPositionRemap();
+		void LockBorders(const std::vector<uint32_t>& indices);
+		void BuildQuadrics(const std::vector<uint32_t>& indices);
+		void BuildAdjacency(const std::vector<uint32_t>& indices);
+		bool FlipsTriangle(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to) const;
+
+		const float*			m_positions;
+		size_t					m_vertexStride;
+		size_t					m_numVertices;
+
+		// first vertex with the same position, quadrics and adjacency live there
+		std::vector<uint32_t>	m_remap;
+		std::vector<bool>		m_locked;
+		std::vector<Quadric>	m_quadrics;
+		// triangles around every remapped vertex
+		std::vector<uint32_t>	m_adjacencyOffsets;
+		std::vector<uint32_t>	m_adjacency;
+	};
+
+	void Simplifier::BuildPositionRemap()
+	{
+		std::vector<uint32_t> order(m_numVertices);
+		std::iota(order.begin(), order.end(), 0u);
+		const auto less = [&](uint32_t a, uint32_t b)
+		{
+			const Vec3 pa = GetPosition(a);
+			const Vec3 pb = GetPosition(b);
+			if (pa.X != pb.X) return pa.X < pb.X;
+			if (pa.Y != pb.Y) return pa.Y < pb.Y;
+			if (pa.Z != pb.Z) return pa.Z < pb.Z;
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		m_remap.resize(m_numVertices);
+		m_locked.assign(m_numVertices, false);
+		for (size_t i = 0; i < order.size();)
+		{
+			size_t end = i + 1;
+			while (end < order.size() && SamePosition(order[i], order[end]))
+				++end;
+
+			// several vertices at one position are a seam or a crease, keep it as it is
+			const uint32_t first = *std::min_element(order.begin() + i, order.begin() + end);
+			for (size_t k = i; k < end; ++k)
+			{
+				m_remap[order[k]] = first;
+			}
+			if (end - i > 1)
+			{
+				m_locked[first] = true;
+			}
+			i = end;
+		}
+	}
+
+	void Simplifier::LockBorders(const std::vector<uint32_t>& indices)
+	{
+		// Every edge of a closed manifold is used once in each direction
+		struct Edge
+		{
+			uint32_t	Lo;
+			uint32_t	Hi;
+			bool		Forward;
+		};
+		std::vector<Edge> edges;
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				const uint32_t a = m_remap[indices[i + e]];
+				const uint32_t b = m_remap[indices[i + (e + 1) % 3]];
+				if (a != b)
+					edges.push_back({ (std::min)(a, b), (std::max)(a, b), a < b });
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b)
+		{
+			if (a.Lo != b.Lo) return a.Lo < b.Lo;
+			if (a.Hi != b.Hi) return a.Hi < b.Hi;
+			return a.Forward < b.Forward;
+		});
+
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t end = i + 1;
+			while (end < edges.size() && edges[end].Lo == edges[i].Lo && edges[end].Hi == edges[i].Hi)
+				++end;
+
+			const bool manifold = end - i == 2 && edges[i].Forward != edges[i + 1].Forward;
+			if (!manifold)
+			{
+				m_locked[edges[i].Lo] = true;
+				m_locked[edges[i].Hi] = true;
+			}
+			i = end;
+		}
+	}
+
+	void Simplifier::BuildQuadrics(const std::vector<uint32_t>& indices)
+	{
+		m_quadrics.assign(m_numVertices, Quadric());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const uint32_t a = m_remap[indices[i + 0]];
+			const uint32_t b = m_remap[indices[i + 1]];
+			const uint32_t c = m_remap[indices[i + 2]];
+			const Vec3 p0 = GetPosition(a);
+			const Vec3 n = Cross(Sub(GetPosition(b), p0), Sub(GetPosition(c), p0));
+			const float length = std::sqrt(Dot(n, n));
+			if (length == 0.0f)
+				continue;
+
+			// area weighted, large triangles pull harder
+			const Vec3 unit = { n.X / length, n.Y / length, n.Z / length };
+			const double weight = length * 0.5;
+			for (uint32_t v : { a, b, c })
+				AddPlane(m_quadrics[v], unit.X, unit.Y, unit.Z, -Dot(unit, p0), weight);
+		}
+	}
+
+	void Simplifier::BuildAdjacency(const std::vector<uint32_t>& indices)
+	{
+		m_adjacencyOffsets.assign(m_numVertices + 1, 0);
+		for (uint32_t i : indices)
+			++m_adjacencyOffsets[m_remap[i] + 1];
+		for (size_t v = 0; v < m_numVertices; ++v)
+			m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+
+		m_adjacency.resize(indices.size());
+		std::vector<uint32_t> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			m_adjacency[fill[m_remap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	bool Simplifier::FlipsTriangle(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to) const
+	{
+		const Vec3 target = GetPosition(to);
+		for (uint32_t k = m_adjacencyOffsets[from]; k < m_adjacencyOffsets[from + 1]; ++k)
+		{
+			const uint32_t* triangle = &indices[m_adjacency[k] * 3];
+			uint32_t corners[3] = { m_remap[triangle[0]], m_remap[triangle[1]], m_remap[triangle[2]] };
+			// triangles on the collapsed edge disappear
+			if (corners[0] == to || corners[1] == to || corners[2] == to)
+				continue;
+
+			const Vec3 p0 = GetPosition(corners[0]);
+			const Vec3 before = Cross(Sub(GetPosition(corners[1]), p0), Sub(GetPosition(corners[2]), p0));
+			Vec3 moved[3] = { p0, GetPosition(corners[1]), GetPosition(corners[2]) };
+			for (int c = 0; c < 3; ++c)
+			{
+				if (corners[c] == from)
+					moved[c] = target;
+			}
+			const Vec3 after = Cross(Sub(moved[1], moved[0]), Sub(moved[2], moved[0]));
+			const float lengths = std::sqrt(Dot(before, before) * Dot(after, after));
+			if (Dot(before, after) <= MIN_NORMAL_DOT * lengths)
+				return true;
+		}
+		return false;
+	}
+
+	float Simplifier::Run(std::vector<uint32_t>& indices, size_t targetIndexCount)
+	{
+		BuildPositionRemap();
+		LockBorders(indices);
+		BuildQuadrics(indices);
+
+		float maxCost = 0.0f;
+		std::vector<Collapse> best(m_numVertices);
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> collapseTo(m_numVertices);
+		std::iota(collapseTo.begin(), collapseTo.end(), 0u);
+		std::vector<bool> touched(m_numVertices);
+
+		while (indices.size() > targetIndexCount)
+		{
+			BuildAdjacency(indices);
+
+			// Cheapest edge out of every vertex that may move. Unlocked vertices have a
+			// unique position, so the vertex is its own remap entry.
+			const float noCollapse = std::numeric_limits<float>::infinity();
+			for (Collapse& c : best)
+				c.Cost = noCollapse;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (int e = 0; e < 6; ++e)
+				{
+					const uint32_t from = indices[i + e % 3];
+					const uint32_t to = indices[i + (e < 3 ? (e + 1) % 3 : (e + 2) % 3)];
+					if (m_locked[m_remap[from]] || m_remap[to] == m_remap[from])
+						continue;
+
+					const float cost = EvaluateQuadric(m_quadrics[from], GetPosition(to));
+					Collapse& c = best[from];
+					if (cost < c.Cost || (cost == c.Cost && to < c.To))
+						c = { from, to, cost };
+				}
+			}
+
+			collapses.clear();
+			for (const Collapse& c : best)
+			{
+				if (c.Cost != noCollapse)
+					collapses.push_back(c);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.Cost != b.Cost ? a.Cost < b.Cost : a.From < b.From;
+			});
+
+			// Greedy in cost order. The fans of collapsed vertices are frozen for the rest of
+			// the pass, so the flip test always sees the final shape of its neighbourhood.
+			std::fill(touched.begin(), touched.end(), false);
+			size_t remaining = indices.size() / 3;
+			size_t applied = 0;
+			for (const Collapse& c : collapses)
+			{
+				if (remaining * 3 <= targetIndexCount)
+					break;
+
+				const uint32_t from = c.From;
+				const uint32_t to = m_remap[c.To];
+				if (touched[from] || touched[to] || FlipsTriangle(indices, from, to))
+					continue;
+
+				for (uint32_t k = m_adjacencyOffsets[from]; k < m_adjacencyOffsets[from + 1]; ++k)
+				{
+					const uint32_t* triangle = &indices[m_adjacency[k] * 3];
+					bool removed = false;
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						touched[m_remap[triangle[corner]]] = true;
+						removed |= m_remap[triangle[corner]] == to;
+					}
+					remaining -= removed;
+				}
+
+				collapseTo[from] = c.To;
+				AddQuadric(m_quadrics[to], m_quadrics[from]);
+				maxCost = (std::max)(maxCost, c.Cost);
+				++applied;
+			}
+
+			if (applied == 0)
+				break;
+
+			// Move the collapsed corners and drop the triangles that became degenerate
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const uint32_t a = collapseTo[indices[i + 0]];
+				const uint32_t b = collapseTo[indices[i + 1]];
+				const uint32_t c = collapseTo[indices[i + 2]];
+				if (m_remap[a] == m_remap[b] || m_remap[b] == m_remap[c] || m_remap[a] == m_remap[c])
+					continue;
+				indices[write++] = a;
+				indices[write++] = b;
+				indices[write++] = c;
+			}
+			indices.resize(write);
+
+			for (const Collapse& c : collapses)
+				collapseTo[c.From] = c.From;
+		}
+
+		return std::sqrt(maxCost);
+	}
+}
+
+float SimplifyMesh(const uint32_t* indices, size_t numIndices,
+	const float* positions, size_t vertexStride, size_t numVertices,
+	size_t targetIndexCount, std::vector<uint32_t>& destination)
+{
+	assert(numIndices % 3 == 0);
+	destination.assign(indices, indices + numIndices);
+	if (numIndices <= targetIndexCount)
+		return 0.0f;
+
+	Simplifier simplifier(positions, vertexStride, numVertices);
+	return simplifier.Run(destination, targetIndexCount);
+}
+
+LodChain BuildLodChain(const uint32_t* indices, size_t numIndices,
+	const float* positions, size_t vertexStride, size_t numVertices)
+{
+	LodChain chain;
+	chain.Indices.assign(indices, indices + numIndices);
+	chain.Levels.push_back({ 0, static_cast<uint32_t>(numIndices), 0.0f });
+
+	std::vector<uint32_t> level;
+	for (size_t i = 1; i < LOD_MAX_LEVELS; ++i)
+	{
+		const LodLevel& previous = chain.Levels.back();
+		const size_t targetIndexCount = static_cast<size_t>(numIndices / 3 * LOD_TRIANGLE_RATIOS[i]) * 3;
+		const float error = SimplifyMesh(chain.Indices.data() + previous.FirstIndex, previous.IndexCount,
+			positions, vertexStride, numVertices, targetIndexCount, level);
+		if (level.empty() || level.size() > previous.IndexCount * MIN_LOD_REDUCTION)
+			break;
+
+		// errors of consecutive levels add up at most
+		const LodLevel next = { static_cast<uint32_t>(chain.Indices.size()), static_cast<uint32_t>(level.size()), previous.Error + error };
+		chain.Indices.insert(chain.Indices.end(), level.begin(), level.end());
+		chain.Levels.push_back(next);
+	}
+	return chain;
+}
+
+void BuildLodChains(const std::vector<LodSource>& sources, std::vector<LodChain>& chains, unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = DefaultThreadCount();
+
+	chains.resize(sources.size());
+	RunParallel(sources.size(), numThreads, [&](size_t i)
+	{
+		const LodSource& s = sources[i];
+		chains[i] = BuildLodChain(s.Indices, s.NumIndices, s.Positions, s.VertexStride, s.NumVertices);
+	});
+}
+
+size_t SelectLod(const LodChain& chain, float distance, float viewportHeight, float fovY, float maxPixelError)
+{
+	const float pixelsPerUnit = viewportHeight / (2.0f * (std::max)(distance, 1e-6f) * std::tan(fovY * 0.5f));
+	size_t lod = 0;
+	for (size_t i = 1; i < chain.Levels.size(); ++i)
+	{
+		if (chain.Levels[i].Error * pixelsPerUnit > maxPixelError)
+			break;
+		lod = i;
+	}
+	return lod;
+}
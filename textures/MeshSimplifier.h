@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Triangle share of the full mesh for every level of detail, level 0 is the full mesh
+constexpr float LOD_TRIANGLE_RATIOS[] = { 1.0f, 0.5f, 0.25f, 0.125f };
+constexpr size_t LOD_MAX_LEVELS = sizeof(LOD_TRIANGLE_RATIOS) / sizeof(LOD_TRIANGLE_RATIOS[0]);
+
+// Index range of one level inside LodChain::Indices
+struct LodLevel
+{
+	uint32_t	FirstIndex;
+	uint32_t	IndexCount;
+	// Geometric error in mesh units, how far the level strays from the full mesh
+	float		Error;
+};
+
+// All levels share the vertex buffer of the mesh, a level is only a smaller index list
+struct LodChain
+{
+	std::vector<uint32_t>	Indices;
+	std::vector<LodLevel>	Levels;
+};
+
+// Quadric error metric edge collapse (Garland and Heckbert). Vertices are collapsed onto
+// one of their neighbours, so no new vertices are made. Vertices that share their position
+// with another vertex (UV seams, hard normal edges) and open or non-manifold borders are
+// never moved. Writes at least targetIndexCount indices to destination unless the locked
+// vertices stop it earlier, and returns the geometric error. Deterministic.
+float SimplifyMesh(const uint32_t* indices, size_t numIndices,
+	const float* positions, size_t vertexStride, size_t numVertices,
+	size_t targetIndexCount, std::vector<uint32_t>& destination);
+
+// Every level is simplified from the one before it. The chain ends early when a level
+// can not get meaningfully smaller than the previous one.
+LodChain BuildLodChain(const uint32_t* indices, size_t numIndices,
+	const float* positions, size_t vertexStride, size_t numVertices);
+
+struct LodSource
+{
+	const uint32_t*	Indices;
+	size_t			NumIndices;
+	const float*	Positions;
+	size_t			VertexStride;
+	size_t			NumVertices;
+};
+
+// One mesh per task across numThreads threads (0 picks the core count)
+void BuildLodChains(const std::vector<LodSource>& sources, std::vector<LodChain>& chains, unsigned int numThreads = 0);
+
+// Coarsest level whose error projects to at most maxPixelError pixels for a mesh at the
+// given view distance, with a vertical field of view of fovY radians
+size_t SelectLod(const LodChain& chain, float distance, float viewportHeight, float fovY, float maxPixelError);
@@ -0,0 +1,319 @@
+#include "pch.h"
+#include "Meshlets.h"
+#include "AssetWarmup.h"
+#include "Model.h"
+
+#include <iostream>
+
+namespace
+{
+	// below this the normals of a meshlet spread over more than about 84 degrees
+	// from the axis and the cone rejects almost nothing
+	constexpr float MIN_CONE_DOT = 0.1f;
+
+	struct Vec3
+	{
+		float X, Y, Z;
+	};
+
+	Vec3 Sub(const Vec3& a, const Vec3& b)
+	{
+		return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	}
+
+	Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	float Dot(const Vec3& a, const Vec3& b)
+	{
+		return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+	}
+
+	float Length(const Vec3& a)
+	{
+		return std::sqrt(Dot(a, a));
+	}
+
+	struct FacePlane
+	{
+		Vec3 Normal;
+		Vec3 Point;
+	};
+
+	Vec3 LoadPosition(const float* positions, size_t vertexStride, uint32_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + index * vertexStride);
+		return { p[0], p[1], p[2] };
+	}
+
+	void ComputeBounds(Meshlet& meshlet, const uint32_t* indices, const float* positions, size_t vertexStride)
+	{
+		const uint32_t* first = indices + meshlet.FirstTriangle * 3;
+		const uint32_t numIndices = meshlet.TriangleCount * 3;
+
+		Vec3 lo = LoadPosition(positions, vertexStride, first[0]);
+		Vec3 hi = lo;
+		for (uint32_t i = 1; i < numIndices; ++i)
+		{
+			const Vec3 p = LoadPosition(positions, vertexStride, first[i]);
+			lo = { (std::min)(lo.X, p.X), (std::min)(lo.Y, p.Y), (std::min)(lo.Z, p.Z) };
+			hi = { (std::max)(hi.X, p.X), (std::max)(hi.Y, p.Y), (std::max)(hi.Z, p.Z) };
+		}
+		meshlet.BoxMin = DirectX::XMFLOAT3(lo.X, lo.Y, lo.Z);
+		meshlet.BoxMax = DirectX::XMFLOAT3(hi.X, hi.Y, hi.Z);
+
+		// Sphere around the box center, tighter than the box diagonal for most clusters
+		const Vec3 center = { (lo.X + hi.X) * 0.5f, (lo.Y + hi.Y) * 0.5f, (lo.Z + hi.Z) * 0.5f };
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < numIndices; ++i)
+			radius = (std::max)(radius, Length(Sub(LoadPosition(positions, vertexStride, first[i]), center)));
+		meshlet.Sphere = DirectX::XMFLOAT4(center.X, center.Y, center.Z, radius);
+
+		// Normal cone around the average face normal
+		std::vector<FacePlane> faces;
+		faces.reserve(meshlet.TriangleCount);
+		Vec3 axis = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			const Vec3 p0 = LoadPosition(positions, vertexStride, first[t * 3 + 0]);
+			const Vec3 p1 = LoadPosition(positions, vertexStride, first[t * 3 + 1]);
+			const Vec3 p2 = LoadPosition(positions, vertexStride, first[t * 3 + 2]);
+			const Vec3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+			const float area = Length(n);
+			if (area == 0.0f)
+				continue;
+			const Vec3 normal = { n.X / area, n.Y / area, n.Z / area };
+			faces.push_back({ normal, p0 });
+			axis = { axis.X + normal.X, axis.Y + normal.Y, axis.Z + normal.Z };
+		}
+
+		meshlet.Cone = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		meshlet.ConeApex = DirectX::XMFLOAT3(center.X, center.Y, center.Z);
+		const float axisLength = Length(axis);
+		if (faces.empty() || axisLength == 0.0f)
+			return;
+		axis = { axis.X / axisLength, axis.Y / axisLength, axis.Z / axisLength };
+
+		float minDot = 1.0f;
+		for (const FacePlane& f : faces)
+			minDot = (std::min)(minDot, Dot(f.Normal, axis));
+		if (minDot <= MIN_CONE_DOT)
+			return;
+
+		// Move the apex back along the axis until every triangle plane is in front of it
+		float maxT = 0.0f;
+		for (const FacePlane& f : faces)
+			maxT = (std::max)(maxT, Dot(Sub(center, f.Point), f.Normal) / Dot(axis, f.Normal));
+
+		meshlet.Cone = DirectX::XMFLOAT4(axis.X, axis.Y, axis.Z, std::sqrt(1.0f - minDot * minDot));
+		meshlet.ConeApex = DirectX::XMFLOAT3(center.X - axis.X * maxT, center.Y - axis.Y * maxT, center.Z - axis.Z * maxT);
+	}
+}
+
+void BuildMeshlets(const uint32_t* indices, size_t numIndices, const float* positions, size_t vertexStride, std::vector<Meshlet>& meshlets)
+{
+	assert(numIndices % 3 == 0);
+	meshlets.clear();
+	if (numIndices == 0)
+		return;
+
+	// submeshes of a larger model only use a slice of the vertices
+	const auto range = std::minmax_element(indices, indices + numIndices);
+	const uint32_t firstVertex = *range.first;
+	// meshlet that last used a vertex, saves clearing a set per meshlet
+	std::vector<uint32_t> usedBy(*range.second - firstVertex + 1, ~0u);
+
+	Meshlet current = {};
+	const auto flush = [&]()
+	{
+		ComputeBounds(current, indices, positions, vertexStride);
+		meshlets.push_back(current);
+		current = {};
+		current.FirstTriangle = meshlets.back().FirstTriangle + meshlets.back().TriangleCount;
+	};
+
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	for (uint32_t t = 0; t < numTriangles; ++t)
+	{
+		const uint32_t triangle[3] = { indices[t * 3 + 0] - firstVertex, indices[t * 3 + 1] - firstVertex, indices[t * 3 + 2] - firstVertex };
+		const uint32_t id = static_cast<uint32_t>(meshlets.size());
+		const uint32_t newVertices = (usedBy[triangle[0]] != id)
+			+ (usedBy[triangle[1]] != id && triangle[1] != triangle[0])
+			+ (usedBy[triangle[2]] != id && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+
+		if (current.VertexCount + newVertices > MESHLET_MAX_VERTICES || current.TriangleCount == MESHLET_MAX_TRIANGLES)
+		{
+			flush();
+		}
+
+		const uint32_t meshletId = static_cast<uint32_t>(meshlets.size());
+		for (int k = 0; k < 3; ++k)
+		{
+			if (usedBy[triangle[k]] != meshletId)
+			{
+				usedBy[triangle[k]] = meshletId;
+				++current.VertexCount;
+			}
+		}
+		++current.TriangleCount;
+	}
+	flush();
+}
+
+Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& viewProj)
+{
+	// Gribb and Hartmann, clip = v * M, so the planes are sums of the matrix columns
+	const auto column = [&](int c) { return DirectX::XMFLOAT4(viewProj.m[0][c], viewProj.m[1][c], viewProj.m[2][c], viewProj.m[3][c]); };
+	const DirectX::XMFLOAT4 x = column(0);
+	const DirectX::XMFLOAT4 y = column(1);
+	const DirectX::XMFLOAT4 z = column(2);
+	const DirectX::XMFLOAT4 w = column(3);
+
+	Frustum frustum;
+	frustum.Planes[0] = DirectX::XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);	// left
+	frustum.Planes[1] = DirectX::XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);	// right
+	frustum.Planes[2] = DirectX::XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);	// bottom
+	frustum.Planes[3] = DirectX::XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);	// top
+	frustum.Planes[4] = z;																// near
+	frustum.Planes[5] = DirectX::XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);	// far
+
+	for (DirectX::XMFLOAT4& plane : frustum.Planes)
+	{
+		const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+			plane = DirectX::XMFLOAT4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+	}
+	return frustum;
+}
+
+MeshletCullStats CullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const DirectX::XMFLOAT3& eye, std::vector<uint32_t>& visible)
+{
+	MeshletCullStats stats;
+	for (uint32_t i = 0; i < meshlets.size(); ++i)
+	{
+		const Meshlet& m = meshlets[i];
+
+		// Cone test first, it is cheaper and rejects about half of a closed mesh
+		if (m.Cone.w < 1.0f)
+		{
+			const Vec3 view = { m.ConeApex.x - eye.x, m.ConeApex.y - eye.y, m.ConeApex.z - eye.z };
+			const float distance = Length(view);
+			if (Dot(view, { m.Cone.x, m.Cone.y, m.Cone.z }) >= m.Cone.w * distance)
+			{
+				++stats.BackFacing;
+				continue;
+			}
+		}
+
+		bool inside = true;
+		for (const DirectX::XMFLOAT4& plane : frustum.Planes)
+		{
+			if (plane.x * m.Sphere.x + plane.y * m.Sphere.y + plane.z * m.Sphere.z + plane.w < -m.Sphere.w)
+			{
+				inside = false;
+				break;
+			}
+		}
+		if (!inside)
+		{
+			++stats.OutsideFrustum;
+			continue;
+		}
+
+		visible.push_back(i);
+		++stats.Visible;
+	}
+	return stats;
+}
+
+MeshletCullReport MeasureMeshletCulling(const std::string& directory, const AssetCache& cache, unsigned int viewsPerOrbit)
+{
+	using namespace DirectX;
+
+	MeshletCullReport report;
+	report.ViewsPerOrbit = viewsPerOrbit;
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind != WARMUP_MESH)
+		{
+			continue;
+		}
+		MeshletCullResult result = {};
+		result.Path = asset.Path;
+		const std::unique_ptr<Model> model = Model::LoadModel(asset.Path, cache);
+		result.Succeeded = model != nullptr;
+		if (!result.Succeeded)
+		{
+			std::cerr << "ERROR: Failed to load mesh " << asset.Path << std::endl;
+			report.Meshes.push_back(result);
+			continue;
+		}
+		const std::vector<Meshlet>& meshlets = model->GetMeshlets();
+		result.Meshlets = meshlets.size();
+		if (meshlets.empty())
+		{
+			report.Meshes.push_back(result);
+			continue;
+		}
+
+		// the bounds of the meshlets are those of the mesh
+		XMVECTOR boundsMin = XMLoadFloat3(&meshlets.front().BoxMin);
+		XMVECTOR boundsMax = XMLoadFloat3(&meshlets.front().BoxMax);
+		for (const Meshlet& m : meshlets)
+		{
+			boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&m.BoxMin));
+			boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&m.BoxMax));
+		}
+		const XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		const float radius = (std::max)(XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, center))), 1e-3f);
+
+		std::vector<uint32_t> visible;
+		const auto cull = [&](float distance, float fovY, MeshletCullStats& total)
+		{
+			for (unsigned int v = 0; v < viewsPerOrbit; ++v)
+			{
+				// a little above the centre, looking down at it
+				const float angle = XM_2PI * v / viewsPerOrbit;
+				const XMVECTOR offset = XMVectorSet(std::cos(angle), 0.3f, std::sin(angle), 0.0f);
+				const XMVECTOR eye = XMVectorAdd(center, XMVectorScale(XMVector3Normalize(offset), distance));
+				const XMMATRIX view = XMMatrixLookAtLH(eye, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+				const XMMATRIX proj = XMMatrixPerspectiveFovLH(fovY, 16.0f / 9.0f, 0.01f * radius, distance + 2.0f * radius);
+				XMFLOAT4X4 viewProj;
+				XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+				XMFLOAT3 eyePosition;
+				XMStoreFloat3(&eyePosition, eye);
+
+				visible.clear();
+				const MeshletCullStats stats = CullMeshlets(meshlets, ExtractFrustum(viewProj), eyePosition, visible);
+				total.Visible += stats.Visible;
+				total.BackFacing += stats.BackFacing;
+				total.OutsideFrustum += stats.OutsideFrustum;
+			}
+		};
+		cull(3.0f * radius, XM_PIDIV4, result.Orbit);
+		cull(1.5f * radius, XM_PI / 12.0f, result.Close);
+		report.Meshes.push_back(result);
+	}
+	return report;
+}
+
+void PrintMeshletCullReport(const MeshletCullReport& report, FILE* out)
+{
+	fprintf(out, "%u views per orbit, meshlets per view on average\n", report.ViewsPerOrbit);
+	fprintf(out, "%-40s %9s | %-26s | %-26s\n", "mesh", "meshlets", "orbit", "close");
+	fprintf(out, "%-40s %9s | %8s %8s %8s | %8s %8s %8s\n", "", "", "visible", "back", "outside", "visible", "back", "outside");
+	const double views = (std::max)(report.ViewsPerOrbit, 1u);
+	for (const MeshletCullResult& mesh : report.Meshes)
+	{
+		if (!mesh.Succeeded)
+		{
+			fprintf(out, "%-40s %9s\n", mesh.Path.c_str(), "FAILED");
+			continue;
+		}
+		fprintf(out, "%-40s %9zu | %8.1f %8.1f %8.1f | %8.1f %8.1f %8.1f\n", mesh.Path.c_str(), mesh.Meshlets,
+			mesh.Orbit.Visible / views, mesh.Orbit.BackFacing / views, mesh.Orbit.OutsideFrustum / views,
+			mesh.Close.Visible / views, mesh.Close.BackFacing / views, mesh.Close.OutsideFrustum / views);
+	}
+}
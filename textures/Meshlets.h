@@ -0,0 +1,81 @@
+#pragma once
+
+#include "AssetCache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A run of consecutive triangles in the index buffer with its culling bounds.
+// Bounds are in mesh space.
+struct Meshlet
+{
+	uint32_t			FirstTriangle;
+	uint32_t			TriangleCount;
+	uint32_t			VertexCount;
+
+	DirectX::XMFLOAT4	Sphere;		// xyz center, w radius
+	DirectX::XMFLOAT3	BoxMin;
+	DirectX::XMFLOAT3	BoxMax;
+	// Normal cone, every triangle faces away from a camera for which
+	// dot(normalize(ConeApex - eye), Cone.xyz) >= Cone.w. Cone.w is 1 when the
+	// cone is too wide to ever cull.
+	DirectX::XMFLOAT4	Cone;
+	DirectX::XMFLOAT3	ConeApex;
+};
+
+// Cuts a triangle list into meshlets of at most MESHLET_MAX_VERTICES unique vertices
+// and MESHLET_MAX_TRIANGLES triangles. Triangles are taken in index buffer order, so the
+// vertex cache and overdraw order stays as it is and every meshlet can be drawn as one
+// DrawIndexed range. Cache optimized meshes (OptimizeVertexCache) give tight clusters.
+// Positions are three floats at the start of every vertexStride bytes.
+void BuildMeshlets(const uint32_t* indices, size_t numIndices, const float* positions, size_t vertexStride, std::vector<Meshlet>& meshlets);
+
+// Six planes, xyz pointing inwards
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+// Frustum of a row vector view * projection matrix (D3D convention, z from 0 to w).
+// Pass world * view * projection to get planes in mesh space.
+Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& viewProj);
+
+struct MeshletCullStats
+{
+	size_t	Visible = 0;
+	size_t	BackFacing = 0;
+	size_t	OutsideFrustum = 0;
+};
+
+// Appends the indices of meshlets that may be visible. Frustum and eye are in mesh space.
+MeshletCullStats CullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const DirectX::XMFLOAT3& eye, std::vector<uint32_t>& visible);
+
+struct MeshletCullResult
+{
+	std::string			Path;
+	bool				Succeeded;
+	size_t				Meshlets;
+	// summed over the views, the whole mesh in view and close up
+	MeshletCullStats	Orbit;
+	MeshletCullStats	Close;
+};
+
+struct MeshletCullReport
+{
+	unsigned int					ViewsPerOrbit;
+	std::vector<MeshletCullResult>	Meshes;
+};
+
+// Loads every mesh in the directory, not recursing, and culls its meshlets for cameras
+// on two circles around it looking at its centre: far enough to see all of it, and
+// close with a narrow field of view so most of it is outside the frustum
+MeshletCullReport MeasureMeshletCulling(const std::string& directory, const AssetCache& cache, unsigned int viewsPerOrbit = 8);
+
+void PrintMeshletCullReport(const MeshletCullReport& report, FILE* out);
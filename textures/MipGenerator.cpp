@@ -0,0 +1,480 @@
+#include "pch.h"
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <random>
+
+#include <emmintrin.h>
+
+namespace
+{
+	// Kaiser window radius in destination pixels and its shape, as in most texture tools
+	constexpr double KAISER_WIDTH = 3.0;
+	constexpr double KAISER_ALPHA = 4.0;
+	// linear to sRGB table resolution, fine enough to round like the exact curve
+	constexpr size_t SRGB_TABLE_SIZE = 1 << 16;
+	// smaller levels are not worth waking threads for
+	constexpr size_t MIP_PARALLEL_PIXELS = 128 * 128;
+	constexpr uint32_t MIP_MIN_BAND_ROWS = 8;
+
+	double SRGBToLinear(double c)
+	{
+		return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+	}
+
+	double LinearToSRGB(double l)
+	{
+		return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+	}
+
+	struct ColorTables
+	{
+		float	ToLinear[256];
+		uint8_t	FromLinear[SRGB_TABLE_SIZE];
+	};
+
+	const ColorTables& GetColorTables()
+	{
+		static const ColorTables* tables = []()
+		{
+			ColorTables* t = new ColorTables;
+			for (int i = 0; i < 256; ++i)
+				t->ToLinear[i] = static_cast<float>(SRGBToLinear(i / 255.0));
+			for (size_t i = 0; i < SRGB_TABLE_SIZE; ++i)
+				t->FromLinear[i] = static_cast<uint8_t>(LinearToSRGB(i / double(SRGB_TABLE_SIZE - 1)) * 255.0 + 0.5);
+			return t;
+		}();
+		return *tables;
+	}
+
+	double BesselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	double KaiserWeight(double x)
+	{
+		if (std::abs(x) >= KAISER_WIDTH)
+			return 0.0;
+		const double t = x / KAISER_WIDTH;
+		const double sinc = x == 0.0 ? 1.0 : std::sin(DirectX::XM_PI * x) / (DirectX::XM_PI * x);
+		return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA);
+	}
+
+	// Source pixels and normalized weights of every destination pixel along one axis,
+	// NumTaps per pixel with zero weights padding the shorter ones
+	struct FilterTable
+	{
+		uint32_t				NumTaps = 0;
+		std::vector<uint32_t>	Sources;
+		std::vector<float>		Weights;
+	};
+
+	FilterTable BuildFilterTable(uint32_t srcSize, uint32_t dstSize, const MipSettings& settings)
+	{
+		const double scale = double(srcSize) / dstSize;
+		const double radius = settings.Filter == MIP_FILTER_BOX ? scale * 0.5 : KAISER_WIDTH * scale;
+
+		std::vector<std::vector<std::pair<uint32_t, double>>> taps(dstSize);
+		size_t numTaps = 1;
+		for (uint32_t i = 0; i < dstSize; ++i)
+		{
+			const double center = (i + 0.5) * scale;
+			const int64_t first = static_cast<int64_t>(std::floor(center - radius));
+			const int64_t last = static_cast<int64_t>(std::ceil(center + radius));
+			double sum = 0.0;
+			for (int64_t j = first; j <= last; ++j)
+			{
+				double w;
+				if (srcSize == dstSize)
+					w = j == i ? 1.0 : 0.0;
+				else if (settings.Filter == MIP_FILTER_BOX)
+					w = (std::max)(0.0, (std::min)(j + 1.0, center + radius) - (std::max)(double(j), center - radius));
+				else
+					w = KaiserWeight((j + 0.5 - center) / scale);
+				if (w == 0.0)
+					continue;
+
+				const int64_t n = srcSize;
+				const int64_t source = settings.Wrap ? ((j % n) + n) % n : (std::min)((std::max)(j, int64_t(0)), n - 1);
+				taps[i].push_back({ static_cast<uint32_t>(source), w });
+				sum += w;
+			}
+			for (auto& tap : taps[i])
+				tap.second /= sum;
+			numTaps = (std::max)(numTaps, taps[i].size());
+		}
+
+		FilterTable table;
+		table.NumTaps = static_cast<uint32_t>(numTaps);
+		table.Sources.resize(dstSize * numTaps);
+		table.Weights.resize(dstSize * numTaps, 0.0f);
+		for (uint32_t i = 0; i < dstSize; ++i)
+		{
+			for (size_t k = 0; k < numTaps; ++k)
+			{
+				const bool used = k < taps[i].size();
+				table.Sources[i * numTaps + k] = used ? taps[i][k].first : taps[i].back().first;
+				table.Weights[i * numTaps + k] = used ? static_cast<float>(taps[i][k].second) : 0.0f;
+			}
+		}
+		return table;
+	}
+
+	struct MipLevelView
+	{
+		const uint8_t*	Pixels;
+		uint32_t		Width;
+		uint32_t		Height;
+	};
+
+	// Source rows converted to linear float, a row is converted once for all the
+	// destination rows of a band that read it
+	class LinearRowCache
+	{
+	public:
+		LinearRowCache(const MipLevelView& level, bool srgb, size_t numSlots):
+			m_level(level),
+			m_srgb(srgb),
+			m_tables(GetColorTables()),
+			m_rows(numSlots * level.Width * 4),
+			m_tags(numSlots, ~0u)
+		{
+		}
+
+		const float* Get(uint32_t row)
+		{
+			const size_t slot = row % m_tags.size();
+			float* dst = &m_rows[slot * m_level.Width * 4];
+			if (m_tags[slot] != row)
+			{
+				Convert(m_level.Pixels + size_t(row) * m_level.Width * 4, dst);
+				m_tags[slot] = row;
+			}
+			return dst;
+		}
+
+	private:
+		void Convert(const uint8_t* src, float* dst) const
+		{
+			const uint32_t width = m_level.Width;
+			if (m_srgb)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					dst[4 * x + 0] = m_tables.ToLinear[src[4 * x + 0]];
+					dst[4 * x + 1] = m_tables.ToLinear[src[4 * x + 1]];
+					dst[4 * x + 2] = m_tables.ToLinear[src[4 * x + 2]];
+					dst[4 * x + 3] = src[4 * x + 3] * (1.0f / 255.0f);
+				}
+				return;
+			}
+
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				int32_t bgra;
+				memcpy(&bgra, src + 4 * x, sizeof(bgra));
+				const __m128i bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bgra), zero), zero);
+				_mm_storeu_ps(dst + 4 * x, _mm_mul_ps(_mm_cvtepi32_ps(bytes), scale));
+			}
+		}
+
+		MipLevelView			m_level;
+		bool					m_srgb;
+		const ColorTables&		m_tables;
+		std::vector<float>		m_rows;
+		std::vector<uint32_t>	m_tags;
+	};
+
+	// Clamps a linear BGRA pixel to [0, 1] and writes it as 8 bits per channel
+	inline void PackPixel(__m128 color, bool srgb, const ColorTables& tables, uint8_t* dst)
+	{
+		color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		alignas(16) int32_t unorm[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(unorm), _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f))));
+		if (srgb)
+		{
+			alignas(16) int32_t index[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(float(SRGB_TABLE_SIZE - 1)))));
+			dst[0] = tables.FromLinear[index[0]];
+			dst[1] = tables.FromLinear[index[1]];
+			dst[2] = tables.FromLinear[index[2]];
+		}
+		else
+		{
+			dst[0] = static_cast<uint8_t>(unorm[0]);
+			dst[1] = static_cast<uint8_t>(unorm[1]);
+			dst[2] = static_cast<uint8_t>(unorm[2]);
+		}
+		dst[3] = static_cast<uint8_t>(unorm[3]);
+	}
+
+	// Destination rows [firstRow, lastRow): a vertical pass into one linear row at
+	// source width, then the horizontal pass packs the destination pixels
+	void FilterBand(const MipLevelView& src, uint8_t* dst, uint32_t dstWidth, const FilterTable& horizontal,
+		const FilterTable& vertical, const MipSettings& settings, uint32_t firstRow, uint32_t lastRow)
+	{
+		const ColorTables& tables = GetColorTables();
+		LinearRowCache rows(src, settings.SRGB, vertical.NumTaps + 2);
+		std::vector<float> column(size_t(src.Width) * 4);
+
+		for (uint32_t y = firstRow; y < lastRow; ++y)
+		{
+			std::fill(column.begin(), column.end(), 0.0f);
+			for (uint32_t k = 0; k < vertical.NumTaps; ++k)
+			{
+				const float weight = vertical.Weights[y * vertical.NumTaps + k];
+				if (weight == 0.0f)
+					continue;
+				const float* row = rows.Get(vertical.Sources[y * vertical.NumTaps + k]);
+				const __m128 w = _mm_set1_ps(weight);
+				for (uint32_t x = 0; x < src.Width; ++x)
+				{
+					const __m128 sum = _mm_add_ps(_mm_loadu_ps(&column[4 * x]), _mm_mul_ps(w, _mm_loadu_ps(row + 4 * x)));
+					_mm_storeu_ps(&column[4 * x], sum);
+				}
+			}
+
+			uint8_t* out = dst + size_t(y) * dstWidth * 4;
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				const uint32_t* sources = &horizontal.Sources[x * horizontal.NumTaps];
+				const float* weights = &horizontal.Weights[x * horizontal.NumTaps];
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t k = 0; k < horizontal.NumTaps; ++k)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&column[4 * sources[k]])));
+				}
+				PackPixel(sum, settings.SRGB, tables, out + 4 * x);
+			}
+		}
+	}
+
+	uint32_t MipSize(uint32_t size, uint32_t level)
+	{
+		return (std::max)(1u, size >> level);
+	}
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		++levels;
+	return levels;
+}
+
+size_t GetMipOffset(uint32_t width, uint32_t height, uint32_t level)
+{
+	size_t offset = 0;
+	for (uint32_t l = 0; l < level; ++l)
+		offset += size_t(MipSize(width, l)) * MipSize(height, l) * 4;
+	return offset;
+}
+
+void GenerateMips(TextureData& texture, const MipSettings& settings, unsigned int numThreads)
+{
+	assert(texture.MipLevels == 1 && texture.Pixels.size() == size_t(texture.Width) * texture.Height * 4);
+	if (numThreads == 0)
+		numThreads = DefaultThreadCount();
+
+	const uint32_t levels = GetMipLevelCount(texture.Width, texture.Height);
+	texture.Pixels.resize(GetMipOffset(texture.Width, texture.Height, levels));
+	texture.MipLevels = levels;
+
+	// Levels depend on the one above them, the rows of a level are split into bands
+	for (uint32_t level = 1; level < levels; ++level)
+	{
+		const MipLevelView src = { texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level - 1),
+			MipSize(texture.Width, level - 1), MipSize(texture.Height, level - 1) };
+		uint8_t* dst = texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level);
+		const uint32_t dstWidth = MipSize(texture.Width, level);
+		const uint32_t dstHeight = MipSize(texture.Height, level);
+
+		const FilterTable horizontal = BuildFilterTable(src.Width, dstWidth, settings);
+		const FilterTable vertical = BuildFilterTable(src.Height, dstHeight, settings);
+
+		const unsigned int levelThreads = size_t(dstWidth) * dstHeight >= MIP_PARALLEL_PIXELS ? numThreads : 1;
+		const uint32_t bandRows = (std::max)(MIP_MIN_BAND_ROWS, (dstHeight + levelThreads * 4 - 1) / (levelThreads * 4));
+		const uint32_t numBands = (dstHeight + bandRows - 1) / bandRows;
+		RunParallel(numBands, levelThreads, [&](size_t band)
+		{
+			const uint32_t firstRow = static_cast<uint32_t>(band) * bandRows;
+			FilterBand(src, dst, dstWidth, horizontal, vertical, settings, firstRow, (std::min)(dstHeight, firstRow + bandRows));
+		});
+	}
+}
+
+void GenerateMipsReference(TextureData& texture, const MipSettings& settings)
+{
+	assert(texture.MipLevels == 1 && texture.Pixels.size() == size_t(texture.Width) * texture.Height * 4);
+	const uint32_t levels = GetMipLevelCount(texture.Width, texture.Height);
+	texture.Pixels.resize(GetMipOffset(texture.Width, texture.Height, levels));
+	texture.MipLevels = levels;
+
+	for (uint32_t level = 1; level < levels; ++level)
+	{
+		const uint8_t* src = texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level - 1);
+		uint8_t* dst = texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level);
+		const uint32_t srcWidth = MipSize(texture.Width, level - 1);
+		const uint32_t dstWidth = MipSize(texture.Width, level);
+		const uint32_t dstHeight = MipSize(texture.Height, level);
+		const FilterTable horizontal = BuildFilterTable(srcWidth, dstWidth, settings);
+		const FilterTable vertical = BuildFilterTable(MipSize(texture.Height, level - 1), dstHeight, settings);
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				double sum[4] = {};
+				for (uint32_t ky = 0; ky < vertical.NumTaps; ++ky)
+				{
+					for (uint32_t kx = 0; kx < horizontal.NumTaps; ++kx)
+					{
+						const double w = double(vertical.Weights[y * vertical.NumTaps + ky]) * horizontal.Weights[x * horizontal.NumTaps + kx];
+						const uint8_t* p = src + (size_t(vertical.Sources[y * vertical.NumTaps + ky]) * srcWidth + horizontal.Sources[x * horizontal.NumTaps + kx]) * 4;
+						for (int c = 0; c < 4; ++c)
+							sum[c] += w * (settings.SRGB && c < 3 ? SRGBToLinear(p[c] / 255.0) : p[c] / 255.0);
+					}
+				}
+				for (int c = 0; c < 4; ++c)
+				{
+					const double v = (std::min)(1.0, (std::max)(0.0, sum[c]));
+					dst[(size_t(y) * dstWidth + x) * 4 + c] = static_cast<uint8_t>((settings.SRGB && c < 3 ? LinearToSRGB(v) : v) * 255.0 + 0.5);
+				}
+			}
+		}
+	}
+}
+
+std::vector<D3D11_SUBRESOURCE_DATA> GetSubresourceData(const TextureData& texture)
+{
+	std::vector<D3D11_SUBRESOURCE_DATA> data(texture.MipLevels);
+	for (uint32_t level = 0; level < texture.MipLevels; ++level)
+	{
+		data[level].pSysMem = texture.Pixels.data() + GetMipOffset(texture.Width, texture.Height, level);
+		data[level].SysMemPitch = MipSize(texture.Width, level) * 4;
+		data[level].SysMemSlicePitch = 0;
+	}
+	return data;
+}
+
+MipCheckReport CheckMipGeneration(uint32_t size)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto millisecondsSince = [](Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	MipCheckReport report = {};
+	report.NumThreads = DefaultThreadCount();
+
+	// the odd size takes the three tap box and uneven Kaiser tables
+	const uint32_t sizes[][2] = { { size, size }, { size - 1, size / 2 + 1 } };
+	const MipFilter filters[] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+	for (int s = 0; s < 2; ++s)
+	{
+		TextureData source;
+		source.Width = sizes[s][0];
+		source.Height = sizes[s][1];
+		source.Pixels.resize(size_t(source.Width) * source.Height * 4);
+		std::mt19937 random(1234);
+		for (uint32_t y = 0; y < source.Height; ++y)
+		{
+			for (uint32_t x = 0; x < source.Width; ++x)
+			{
+				uint8_t* p = &source.Pixels[(size_t(y) * source.Width + x) * 4];
+				const bool checker = ((x / 7) ^ (y / 5)) & 1;
+				p[0] = static_cast<uint8_t>(random() & 0xFF);
+				p[1] = checker ? 255 : 0;
+				p[2] = static_cast<uint8_t>(x * 255 / source.Width);
+				p[3] = static_cast<uint8_t>((x + y) & 0xFF);
+			}
+		}
+
+		for (MipFilter filter : filters)
+		{
+			MipCheckResult result = {};
+			result.Width = source.Width;
+			result.Height = source.Height;
+			result.Settings.Filter = filter;
+			result.Settings.Wrap = s == 0;
+
+			TextureData fast = source;
+			Clock::time_point start = Clock::now();
+			GenerateMips(fast, result.Settings, report.NumThreads);
+			result.Ms = millisecondsSince(start);
+
+			TextureData reference = source;
+			start = Clock::now();
+			GenerateMipsReference(reference, result.Settings);
+			result.ReferenceMs = millisecondsSince(start);
+
+			const size_t first = GetMipOffset(source.Width, source.Height, 1);
+			for (size_t i = first; i < fast.Pixels.size(); ++i)
+			{
+				const int difference = std::abs(int(fast.Pixels[i]) - int(reference.Pixels[i]));
+				result.ChainMaxDifference = (std::max)(result.ChainMaxDifference, difference);
+			}
+
+			// One level at a time from the same input, what the kernels themselves get wrong
+			size_t different = 0;
+			for (uint32_t level = 1; level < reference.MipLevels; ++level)
+			{
+				TextureData above;
+				above.Width = MipSize(source.Width, level - 1);
+				above.Height = MipSize(source.Height, level - 1);
+				const auto begin = reference.Pixels.begin() + GetMipOffset(source.Width, source.Height, level - 1);
+				above.Pixels.assign(begin, begin + size_t(above.Width) * above.Height * 4);
+				GenerateMips(above, result.Settings, report.NumThreads);
+
+				const uint8_t* actual = above.Pixels.data() + GetMipOffset(above.Width, above.Height, 1);
+				const uint8_t* expected = reference.Pixels.data() + GetMipOffset(source.Width, source.Height, level);
+				const size_t levelBytes = size_t(MipSize(source.Width, level)) * MipSize(source.Height, level) * 4;
+				for (size_t i = 0; i < levelBytes; ++i)
+				{
+					const int difference = std::abs(int(actual[i]) - int(expected[i]));
+					result.MaxDifference = (std::max)(result.MaxDifference, difference);
+					different += difference != 0;
+				}
+			}
+			result.DifferentChannels = reference.Pixels.size() > first ? double(different) / (reference.Pixels.size() - first) : 0.0;
+			report.Results.push_back(result);
+		}
+	}
+	return report;
+}
+
+void PrintMipCheck(const MipCheckReport& report, FILE* out)
+{
+	fprintf(out, "%-11s %-7s %-6s %10s %12s %8s %8s %10s %10s\n", "size", "filter", "edges", "ms", "reference ms",
+		"speedup", "max diff", "different", "chain diff");
+	size_t failed = 0;
+	for (const MipCheckResult& r : report.Results)
+	{
+		char size[32] = {};
+		sprintf_s(size, "%ux%u", r.Width, r.Height);
+		fprintf(out, "%-11s %-7s %-6s %10.1f %12.1f %7.1fx %8d %9.3f%% %10d\n", size,
+			r.Settings.Filter == MIP_FILTER_BOX ? "box" : "kaiser", r.Settings.Wrap ? "wrap" : "clamp",
+			r.Ms, r.ReferenceMs, r.Ms > 0.0 ? r.ReferenceMs / r.Ms : 0.0, r.MaxDifference, r.DifferentChannels * 100.0,
+			r.ChainMaxDifference);
+		if (r.MaxDifference > MIP_CHECK_MAX_DIFFERENCE)
+			++failed;
+	}
+	fprintf(out, "%u threads, ", report.NumThreads);
+	if (failed == 0)
+		fprintf(out, "every level within %d of the reference\n", MIP_CHECK_MAX_DIFFERENCE);
+	else
+		fprintf(out, "%zu textures have levels more than %d from the reference\n", failed, MIP_CHECK_MAX_DIFFERENCE);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "TextureCache.h"
+
+#include <d3d11.h>
+
+#include <cstdio>
+#include <vector>
+
+enum MipFilter
+{
+	// average of the 2x2 (or 3x3 for odd sizes) source pixels, cheapest and softest
+	MIP_FILTER_BOX,
+	// Kaiser windowed sinc over 12 source pixels per axis, keeps detail without ringing much
+	MIP_FILTER_KAISER
+};
+
+struct MipSettings
+{
+	MipFilter	Filter = MIP_FILTER_KAISER;
+	// colors are sRGB encoded and filtered in linear space, alpha is always linear
+	bool		SRGB = true;
+	// filter taps wrap around the edges, matches D3D11_TEXTURE_ADDRESS_WRAP, otherwise clamp
+	bool		Wrap = true;
+};
+
+// Levels of the full chain down to 1x1
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+// Byte offset of the level in a chain of tightly packed BGRA8 levels
+size_t GetMipOffset(uint32_t width, uint32_t height, uint32_t level);
+
+// Appends the full mip chain to the single level texture. Every level is filtered from
+// the one above it, the rows of a level are split into bands that run on numThreads
+// threads (0 picks the core count). SSE2 kernels work on one pixel per register in
+// linear float.
+void GenerateMips(TextureData& texture, const MipSettings& settings, unsigned int numThreads = 0);
+
+// Single threaded scalar version with exact sRGB conversions, for checking GenerateMips
+void GenerateMipsReference(TextureData& texture, const MipSettings& settings);
+
+// GenerateMips may round a channel of a level one step away from the reference filtering
+// the same level above. Levels cascade, so whole chains can drift a little further.
+constexpr int MIP_CHECK_MAX_DIFFERENCE = 1;
+
+struct MipCheckResult
+{
+	uint32_t	Width;
+	uint32_t	Height;
+	MipSettings	Settings;
+	double		Ms;
+	double		ReferenceMs;
+	// every level filtered from the reference level above it, over all channels
+	int			MaxDifference;
+	double		DifferentChannels;	// fraction
+	// the two whole chains
+	int			ChainMaxDifference;
+};
+
+struct MipCheckReport
+{
+	unsigned int				NumThreads;
+	std::vector<MipCheckResult>	Results;
+};
+
+// Generates the chains of a synthetic sRGB texture with noise, sharp edges and gradients
+// with GenerateMips and GenerateMipsReference, with both filters, on a size x size texture
+// with wrapping and an odd sized one with clamping, and compares them
+MipCheckReport CheckMipGeneration(uint32_t size = 1024);
+
+void PrintMipCheck(const MipCheckReport& report, FILE* out);
+
+// Initial data for every level, points into texture.Pixels
+std::vector<D3D11_SUBRESOURCE_DATA> GetSubresourceData(const TextureData& texture);
@@ -1,5 +1,17 @@
 #include "pch.h"
 #include "Model.h"
+#include "AssetCache.h"
+#include "DDSTextureLoader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "MipGenerator.h"
+#include "ObjParser.h"
+#include "Parallel.h"
+#include "TangentSpace.h"
+#include "TextureCache.h"
+#include "VertexWelder.h"
 
 #include <string>
 #include <iostream>
@@ -8,8 +20,6 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#include <wincodec.h>
-
 Model::Model():
 	m_positions(),
 	m_faces(),
@@ -17,128 +27,360 @@ Model::Model():
 {
 }
 
-std::vector<uint8_t> LoadBGRAImage(const wchar_t* filename, uint32_t& width, uint32_t& height)
+std::wstring StrToWstr(const std::string& s)
 {
-	using namespace Microsoft::WRL;
-	ComPtr<IWICImagingFactory> wicFactory;
-	DX::ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory2, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory)));
+	size_t numConverted = 0;
+	std::unique_ptr<wchar_t*> bytes = std::make_unique<wchar_t*>(new wchar_t[s.size() + 1]);
+	mbstowcs_s(&numConverted, *bytes, s.size() + 1, s.c_str(), s.size());
+	return std::wstring(*bytes);
+}
 
-	ComPtr<IWICBitmapDecoder> decoder;
-	DX::ThrowIfFailed(wicFactory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf()));
+namespace
+{
+	void CopyColor(float* dst, const aiColor4D& color)
+	{
+		dst[0] = color.r;
+		dst[1] = color.g;
+		dst[2] = color.b;
+		dst[3] = color.a;
+	}
 
-	ComPtr<IWICBitmapFrameDecode> frame;
-	DX::ThrowIfFailed(decoder->GetFrame(0, frame.GetAddressOf()));
+	MeshMaterial ConvertMaterial(const aiMaterial& mat)
+	{
+		MeshMaterial result;
+		aiColor4D color;
+		if (mat.Get(AI_MATKEY_COLOR_AMBIENT, color) == aiReturn_SUCCESS)
+			CopyColor(result.Mat.Ambient, color);
+		if (mat.Get(AI_MATKEY_COLOR_DIFFUSE, color) == aiReturn_SUCCESS)
+			CopyColor(result.Mat.Diffuse, color);
+		if (mat.Get(AI_MATKEY_COLOR_SPECULAR, color) == aiReturn_SUCCESS)
+			CopyColor(result.Mat.Specular, color);
+		float shininess = 0.0f;
+		if (mat.Get(AI_MATKEY_SHININESS, shininess) == aiReturn_SUCCESS)
+			result.Mat.Specular[3] = shininess;
+
+		// TODO: add support for specular and normal maps
+		aiString textPath;
+		if (mat.GetTexture(aiTextureType_DIFFUSE, 0, &textPath) == aiReturn_SUCCESS)
+			result.TextPath = textPath.C_Str();
+		return result;
+	}
 
-	DX::ThrowIfFailed(frame->GetSize(&width, &height));
+	// Index of the material in materials, equal materials are stored once
+	uint32_t AddMaterial(const MeshMaterial& material, std::vector<MeshMaterial>& materials)
+	{
+		for (size_t i = 0; i < materials.size(); ++i)
+		{
+			if (memcmp(&materials[i].Mat, &material.Mat, sizeof(Material)) == 0 && materials[i].TextPath == material.TextPath)
+				return static_cast<uint32_t>(i);
+		}
+		materials.push_back(material);
+		return static_cast<uint32_t>(materials.size() - 1);
+	}
 
-	WICPixelFormatGUID pixelFormat;
-	DX::ThrowIfFailed(frame->GetPixelFormat(&pixelFormat));
+	// Writes the mesh into its slice of the shared arrays, indices are made absolute
+	void CopyMesh(const aiMesh& mesh, const Submesh& submesh,
+		Position* positions, Normal* normals, TextCoord* textCoords, Face* faces)
+	{
+		positions += submesh.FirstVertex;
+		normals += submesh.FirstVertex;
+		textCoords += submesh.FirstVertex;
+		for (unsigned int i = 0; i < mesh.mNumVertices; ++i)
+		{
+			positions[i] = { mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z };
+			if (mesh.HasNormals())
+				normals[i] = { mesh.mNormals[i].x, mesh.mNormals[i].y, mesh.mNormals[i].z };
+			else
+				normals[i] = { 0.0f, 0.0f, 0.0f };
+			if (mesh.mTextureCoords[0])
+				textCoords[i] = { mesh.mTextureCoords[0][i].x, mesh.mTextureCoords[0][i].y };
+			else
+				textCoords[i] = { 0.0f, 0.0f };
+		}
 
-	uint32_t rowPitch = width * sizeof(uint32_t);
-	uint32_t imageSize = rowPitch * height;
+		faces += submesh.FirstIndex / 3;
+		const unsigned int base = submesh.FirstVertex;
+		for (unsigned int i = 0; i < mesh.mNumFaces; ++i)
+		{
+			const unsigned int* face = mesh.mFaces[i].mIndices;
+			faces[i] = Face(face[0] + base, face[1] + base, face[2] + base);
+		}
+	}
+}
 
-	std::vector<uint8_t> image;
-	image.resize(size_t(imageSize));
+std::unique_ptr<Model> ImportModel(const std::string& filepath)
+{
+	Assimp::Importer importer;
 
-	if (memcmp(&pixelFormat, &GUID_WICPixelFormat32bppBGRA, sizeof(GUID)) == 0)
+	// Points and lines are split into meshes of their own and skipped below.
+	// Missing normals are generated after the import, smooth like the OBJ path.
+	const aiScene* scene = importer.ReadFile(filepath,
+		aiProcess_Triangulate |
+		aiProcess_SortByPType |
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_ImproveCacheLocality |
+		aiProcess_FlipUVs
+	);
+	if (!scene)
 	{
-		DX::ThrowIfFailed(frame->CopyPixels(nullptr, rowPitch, imageSize, reinterpret_cast<BYTE*>(image.data())));
+		std::cerr << "ERROR: Failed to import " << filepath << std::endl;
+		return nullptr;
 	}
-	else
+
+	// Lay out all triangle meshes one after another in a shared vertex and index list
+	std::vector<const aiMesh*> meshes;
+	std::vector<Submesh> submeshes;
+	std::vector<MeshMaterial> materials;
+	std::vector<uint32_t> materialRemap(scene->mNumMaterials, ~0u);
+	uint64_t numVertices = 0;
+	uint64_t numIndices = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
 	{
-		ComPtr<IWICFormatConverter> formatConverter;
-		DX::ThrowIfFailed(wicFactory->CreateFormatConverter(formatConverter.GetAddressOf()));
+		const aiMesh* mesh = scene->mMeshes[i];
+		if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE || mesh->mNumFaces == 0)
+		{
+			continue;
+		}
 
-		BOOL canConvert = FALSE;
-		DX::ThrowIfFailed(formatConverter->CanConvert(pixelFormat, GUID_WICPixelFormat32bppBGRA, &canConvert));
-		if (!canConvert)
+		uint32_t materialIndex = 0;
+		if (mesh->mMaterialIndex < scene->mNumMaterials)
+		{
+			uint32_t& remapped = materialRemap[mesh->mMaterialIndex];
+			if (remapped == ~0u)
+				remapped = AddMaterial(ConvertMaterial(*scene->mMaterials[mesh->mMaterialIndex]), materials);
+			materialIndex = remapped;
+		}
+		else
 		{
-			throw std::exception("CanConvert");
+			materialIndex = AddMaterial(MeshMaterial(), materials);
 		}
 
-		DX::ThrowIfFailed(formatConverter->Initialize(frame.Get(), GUID_WICPixelFormat32bppBGRA,
-			WICBitmapDitherTypeErrorDiffusion, nullptr, 0, WICBitmapPaletteTypeMedianCut));
+		meshes.push_back(mesh);
+		submeshes.push_back({ static_cast<uint32_t>(numIndices), mesh->mNumFaces * 3,
+			static_cast<uint32_t>(numVertices), mesh->mNumVertices, materialIndex });
+		numVertices += mesh->mNumVertices;
+		numIndices += mesh->mNumFaces * 3ull;
+	}
 
-		DX::ThrowIfFailed(formatConverter->CopyPixels(nullptr, rowPitch, imageSize, reinterpret_cast<BYTE*>(image.data())));
+	if (submeshes.empty())
+	{
+		std::cerr << "ERROR: No triangle meshes in " << filepath << std::endl;
+		return nullptr;
 	}
+	if (numVertices > UINT32_MAX || numIndices > UINT32_MAX)
+	{
+		std::cerr << "ERROR: Too many vertices in " << filepath << std::endl;
+		return nullptr;
+	}
+
+	std::vector<Position> positions(numVertices);
+	std::vector<Normal> normals(numVertices);
+	std::vector<TextCoord> textCoords(numVertices);
+	std::vector<Face> faces(numIndices / 3);
 
-	return image;
+	// One mesh per task, each one writes only its own slice
+	RunParallel(meshes.size(), DefaultThreadCount(), [&](size_t i)
+	{
+		CopyMesh(*meshes[i], submeshes[i], positions.data(), normals.data(), textCoords.data(), faces.data());
+	});
+
+	std::vector<Normal> generatedNormals;
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		if (meshes[i]->HasNormals())
+		{
+			continue;
+		}
+		if (generatedNormals.empty())
+		{
+			ComputeNormals(positions, faces, NORMAL_WEIGHT_ANGLE, generatedNormals);
+		}
+		const auto first = generatedNormals.begin() + submeshes[i].FirstVertex;
+		std::copy(first, first + submeshes[i].VertexCount, normals.begin() + submeshes[i].FirstVertex);
+	}
+
+	return std::make_unique<Model>(std::move(positions), std::move(faces), std::move(normals), std::move(textCoords),
+		std::move(submeshes), std::move(materials));
 }
 
-std::wstring StrToWstr(const std::string& s)
+std::string GetDirectory(const std::string& filepath)
 {
-	size_t numConverted = 0;
-	std::unique_ptr<wchar_t*> bytes = std::make_unique<wchar_t*>(new wchar_t[s.size() + 1]);
-	mbstowcs_s(&numConverted, *bytes, s.size() + 1, s.c_str(), s.size());
-	return std::wstring(*bytes);
+	const size_t slash = filepath.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : filepath.substr(0, slash + 1);
 }
 
-std::unique_ptr<Model> ParseObjectFile(const std::string& filepath)
+bool HasExtension(const std::string& filepath, const char* ext)
 {
-	Assimp::Importer importer;
+	const size_t len = strlen(ext);
+	return filepath.size() >= len && _stricmp(filepath.c_str() + filepath.size() - len, ext) == 0;
+}
 
-	const aiScene* scene = importer.ReadFile(filepath,
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_ImproveCacheLocality |
-		aiProcess_FlipUVs |
-		aiProcess_GenNormals
-	);
-	if (!scene)
+std::unique_ptr<Model> ParseObjectFile(const std::string& filepath, std::string& materialLibrary,
+	MeshOptimizerReport* report)
+{
+	// below this size spinning up threads costs more than it saves
+	constexpr size_t PARALLEL_PARSE_THRESHOLD = 8 * 1024 * 1024;
+
+	const MappedFile f(filepath);
+	if (!f.IsOpen())
 	{
-		std::cerr << "ERROR: Failed to import " << filepath << std::endl;
+		std::cerr << "ERROR: Failed to open " << filepath << std::endl;
 		return nullptr;
 	}
 
-	assert(scene->mNumMeshes == 1); // for now we support only one mesh
-	
-	std::vector<Position> positions;
-	const aiMesh* mesh = scene->mMeshes[0];
-	positions.reserve(mesh->mNumVertices);
-	std::vector<TextCoord> textCoords;
-	textCoords.reserve(mesh->mNumVertices);
+	ObjData data;
+	if (f.GetSize() >= PARALLEL_PARSE_THRESHOLD)
+	{
+		ParseObjBufferParallel(f.GetData(), f.GetData() + f.GetSize(), data);
+	}
+	else
+	{
+		ParseObjBuffer(f.GetData(), f.GetData() + f.GetSize(), data);
+	}
 
-	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+	ObjMesh mesh;
+	WeldObjVertices(data, mesh);
+	// exact tuples are one vertex now, exporters also write the same corner with floats a
+	// rounding apart
+	WeldVertices(mesh.Positions, mesh.Normals, mesh.TextCoords, mesh.Faces, GetDefaultWeldSettings(mesh.Positions));
+
+	// Same convention as aiProcess_FlipUVs on the Assimp path
+	for (TextCoord& tc : mesh.TextCoords)
 	{
-		positions.push_back({ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z });
-		if (mesh->mTextureCoords[0])
-			textCoords.push_back({ mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y });
-		else
-			textCoords.push_back({ 0.0f, 0.0f });
+		tc.Y = 1.0f - tc.Y;
+	}
+
+	OptimizeMesh(mesh.Positions, mesh.Normals, mesh.TextCoords, mesh.Faces, report);
+
+	std::string textPath;
+	materialLibrary = data.MaterialLibrary;
+	if (!data.MaterialLibrary.empty())
+	{
+		const MappedFile mtl(GetDirectory(filepath) + data.MaterialLibrary);
+		if (mtl.IsOpen())
+		{
+			textPath = ParseMtlDiffuseMap(mtl.GetData(), mtl.GetData() + mtl.GetSize());
+		}
 	}
 
-	std::vector<Normal> normals;
-	if (mesh->HasNormals())
+	return std::make_unique<Model>(std::move(mesh.Positions), std::move(mesh.Faces), std::move(mesh.Normals), std::move(mesh.TextCoords), textPath.c_str());
+}
+
+namespace
+{
+	// Content hash of the material library next to the model, 0 without one or when it is missing
+	uint64_t HashMaterialLibrary(const AssetCache& cache, const std::string& filepath, const std::string& materialLibrary)
 	{
-		normals.reserve(mesh->mNumVertices);
-		for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		uint64_t hash = 0;
+		if (materialLibrary.empty() || !cache.HashSource(GetDirectory(filepath) + materialLibrary, hash))
 		{
-			normals.push_back({ mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z });
+			return 0;
 		}
+		return hash;
 	}
+}
 
-	std::vector<Face> faces;
-	faces.reserve(mesh->mNumFaces);
+std::unique_ptr<Model> Model::LoadModel(const std::string& filepath)
+{
+	return LoadModel(filepath, AssetCache::GetDefault());
+}
 
-	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+std::unique_ptr<Model> Model::LoadModel(const std::string& filepath, const AssetCache& cache)
+{
+	// delta encoded indices take about a third of the space and decode faster than they read from disk
+	constexpr bool ENCODE_CACHED_INDICES = true;
+
+	AssetKey key = { 0, GetMeshSettingsHash(ENCODE_CACHED_INDICES) };
+	const bool hasKey = cache.HashSource(filepath, key.SourceHash);
+	const std::string cachePath = cache.GetArtifactPath(key, "mesh");
+	if (hasKey)
 	{
-		assert(mesh->mFaces[i].mNumIndices == 3); // we support triangulated meshes only
-		faces.push_back({ mesh->mFaces[i].mIndices[0],
-			mesh->mFaces[i].mIndices[1] ,
-			mesh->mFaces[i].mIndices[2] });
+		// the texture paths come from the material library, a changed library rebuilds the mesh
+		auto blob = std::make_shared<MeshBlob>();
+		if (blob->Open(cachePath, key)
+			&& HashMaterialLibrary(cache, filepath, blob->GetMaterialLibrary()) == blob->GetMaterialLibraryHash())
+		{
+			cache.Touch(cachePath);
+			return std::make_unique<Model>(std::move(blob));
+		}
 	}
 
-	const aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-	aiString textPath;
-	// TODO: add support for specular and normal maps
-	mat->GetTexture(aiTextureType_DIFFUSE, 0, &textPath);
+	// OBJ files go through the native parser, Assimp handles everything else
+	std::string materialLibrary;
+	std::unique_ptr<Model> model = HasExtension(filepath, ".obj") ? ParseObjectFile(filepath, materialLibrary) : ImportModel(filepath);
+	if (!model)
+	{
+		return nullptr;
+	}
+	model->BuildMeshlets();
+	model->BuildLods();
+	if (hasKey && !WriteMeshCache(cache, cachePath, key, *model, ENCODE_CACHED_INDICES,
+		materialLibrary, HashMaterialLibrary(cache, filepath, materialLibrary)))
+	{
+		std::cerr << "WARNING: Failed to write mesh cache " << cachePath << std::endl;
+	}
+	return model;
+}
 
+void Model::BuildMeshlets()
+{
+	// meshlets follow the index order the optimizer left, a single pass over the indices
+	// of every submesh, cached meshes bring their own
+	m_meshlets.clear();
+	if (GetIndexCount() == 0)
+	{
+		return;
+	}
 
-	return std::make_unique<Model>(std::move(positions), std::move(faces), std::move(normals), std::move(textCoords), textPath.C_Str());
+	const float* positions = m_blob ? &m_blob->GetVertices()->Pos.x : &m_positions.data()->X;
+	const size_t vertexStride = m_blob ? sizeof(Render::Vertex) : sizeof(Position);
+	std::vector<Meshlet> meshlets;
+	for (const Submesh& submesh : m_submeshes)
+	{
+		::BuildMeshlets(GetIndices() + submesh.FirstIndex, submesh.IndexCount, positions, vertexStride, meshlets);
+		for (Meshlet& m : meshlets)
+		{
+			m.FirstTriangle += submesh.FirstIndex / 3;
+		}
+		m_meshlets.insert(m_meshlets.end(), meshlets.begin(), meshlets.end());
+	}
 }
 
-std::unique_ptr<Model> Model::LoadModel(const std::string& filepath)
+void Model::BuildLods()
 {
-	return ParseObjectFile(filepath);
+	// like the meshlets the levels are cached with the mesh, simplification is
+	// deterministic so a rebuild gives the same chains
+	m_lods.clear();
+	if (GetIndexCount() == 0)
+	{
+		return;
+	}
+
+	// The simplifier works on the vertex range of the submesh only
+	const char* positions = reinterpret_cast<const char*>(m_blob ? &m_blob->GetVertices()->Pos.x : &m_positions.data()->X);
+	const size_t vertexStride = m_blob ? sizeof(Render::Vertex) : sizeof(Position);
+	std::vector<std::vector<uint32_t>> localIndices(m_submeshes.size());
+	std::vector<LodSource> sources;
+	sources.reserve(m_submeshes.size());
+	for (size_t i = 0; i < m_submeshes.size(); ++i)
+	{
+		const Submesh& submesh = m_submeshes[i];
+		const uint32_t* indices = GetIndices() + submesh.FirstIndex;
+		localIndices[i].resize(submesh.IndexCount);
+		std::transform(indices, indices + submesh.IndexCount, localIndices[i].begin(),
+			[&](uint32_t index) { return index - submesh.FirstVertex; });
+		sources.push_back({ localIndices[i].data(), submesh.IndexCount,
+			reinterpret_cast<const float*>(positions + submesh.FirstVertex * vertexStride), vertexStride, submesh.VertexCount });
+	}
+
+	BuildLodChains(sources, m_lods);
+	for (size_t i = 0; i < m_lods.size(); ++i)
+	{
+		for (uint32_t& index : m_lods[i].Indices)
+		{
+			index += m_submeshes[i].FirstVertex;
+		}
+	}
 }
 
 const std::vector<Position>& Model::GetPositions() const
@@ -161,17 +403,99 @@ const std::vector<TextCoord>& Model::GetTextCoords() const
 	return m_textCoords;
 }
 
+const std::string& Model::GetTextPath() const
+{
+	return m_textPath;
+}
+
+const std::vector<Submesh>& Model::GetSubmeshes() const
+{
+	return m_submeshes;
+}
+
+const std::vector<MeshMaterial>& Model::GetMaterials() const
+{
+	return m_materials;
+}
+
+const std::vector<Meshlet>& Model::GetMeshlets() const
+{
+	return m_meshlets;
+}
+
+const std::vector<LodChain>& Model::GetLodChains() const
+{
+	return m_lods;
+}
+
+const MeshBlob* Model::GetMeshBlob() const
+{
+	return m_blob.get();
+}
+
+size_t Model::GetVertexCount() const
+{
+	return m_blob ? m_blob->GetNumVertices() : m_positions.size();
+}
+
+size_t Model::GetIndexCount() const
+{
+	return m_blob ? m_blob->GetNumIndices() : m_faces.size() * 3;
+}
+
+const uint32_t* Model::GetIndices() const
+{
+	static_assert(sizeof(Face) == 3 * sizeof(uint32_t), "Faces are read as a flat index list");
+	return m_blob ? m_blob->GetIndices() : reinterpret_cast<const uint32_t*>(m_faces.data());
+}
+
 Model::Model(std::vector<Position>&& positions,
 	std::vector<Face>&& faces, 
 	std::vector<Normal>&& normals,
 	std::vector<TextCoord>&& textCoords,
 	const char* textPath):
-	m_positions(positions),
-	m_faces(faces),
-	m_normals(normals),
-	m_textCoords(textCoords),
+	m_positions(std::move(positions)),
+	m_faces(std::move(faces)),
+	m_normals(std::move(normals)),
+	m_textCoords(std::move(textCoords)),
 	m_textPath(textPath)
 {
+	MeshMaterial material;
+	material.TextPath = m_textPath;
+	m_materials.push_back(material);
+	m_submeshes.push_back({ 0, static_cast<uint32_t>(m_faces.size() * 3), 0, static_cast<uint32_t>(m_positions.size()), 0 });
+}
+
+Model::Model(std::vector<Position>&& positions,
+	std::vector<Face>&& faces,
+	std::vector<Normal>&& normals,
+	std::vector<TextCoord>&& textCoords,
+	std::vector<Submesh>&& submeshes,
+	std::vector<MeshMaterial>&& materials):
+	m_positions(std::move(positions)),
+	m_faces(std::move(faces)),
+	m_normals(std::move(normals)),
+	m_textCoords(std::move(textCoords)),
+	m_submeshes(std::move(submeshes)),
+	m_materials(std::move(materials))
+{
+	if (!m_submeshes.empty())
+	{
+		m_textPath = m_materials[m_submeshes[0].MaterialIndex].TextPath;
+	}
+}
+
+Model::Model(std::shared_ptr<const MeshBlob> blob):
+	m_submeshes(blob->GetSubmeshes()),
+	m_materials(blob->GetMaterials()),
+	m_blob(blob),
+	m_meshlets(blob->GetMeshlets()),
+	m_lods(blob->GetLodChains())
+{
+	if (!m_submeshes.empty())
+	{
+		m_textPath = m_materials[m_submeshes[0].MaterialIndex].TextPath;
+	}
 }
 
 Face::Face(unsigned int x, unsigned int y, unsigned int z):
@@ -187,28 +511,47 @@ std::string FindTexture(const std::string& filename)
 	return "../assets/" + filename;
 }
 
-void Model::LoadTexture(ID3D11Device* device)
+void CreateTexture(ID3D11Device* device, const TextureData& data, uint32_t firstLevel,
+	ID3D11Resource** texture, ID3D11ShaderResourceView** view)
 {
-	uint32_t width = 0;
-	uint32_t height = 0;
-	const std::string fullTextPath = FindTexture(m_textPath);
-	const std::vector<uint8_t> bytes = LoadBGRAImage(StrToWstr(fullTextPath).c_str(), width, height);
+	if (!data.DDSFile.empty())
+	{
+		if (firstLevel != 0)
+		{
+			throw std::runtime_error("CreateTexture: levels of a .dds file can't be skipped");
+		}
+		DX::ThrowIfFailed(DirectX::CreateDDSTextureFromMemory(device, data.DDSFile.data(), data.DDSFile.size(), texture, view));
+		return;
+	}
 
 	D3D11_TEXTURE2D_DESC txtDesc = {};
-	txtDesc.MipLevels = txtDesc.ArraySize = 1;
+	assert(firstLevel < data.MipLevels);
+	txtDesc.MipLevels = data.MipLevels - firstLevel;
+	txtDesc.ArraySize = 1;
 	txtDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB; // sunset.jpg is in sRGB colorspace
 	txtDesc.SampleDesc.Count = 1;
 	txtDesc.Usage = D3D11_USAGE_IMMUTABLE;
 	txtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	txtDesc.Width = width;
-	txtDesc.Height = height;
+	txtDesc.Width = (std::max)(1u, data.Width >> firstLevel);
+	txtDesc.Height = (std::max)(1u, data.Height >> firstLevel);
+
+	const std::vector<D3D11_SUBRESOURCE_DATA> initData = GetSubresourceData(data);
+	ID3D11Texture2D* texture2D = nullptr;
+	DX::ThrowIfFailed(device->CreateTexture2D(&txtDesc, initData.data() + firstLevel, &texture2D));
+	*texture = texture2D;
+	DX::ThrowIfFailed(device->CreateShaderResourceView(*texture, nullptr, view));
+}
 
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = &bytes[0];
-	initData.SysMemPitch = txtDesc.Width * sizeof(uint32_t);
+void Model::LoadTexture(ID3D11Device* device)
+{
+	const std::string fullTextPath = FindTexture(m_textPath);
+	TextureData texture;
+	if (!LoadTextureData(fullTextPath, texture))
+	{
+		throw std::runtime_error("LoadTexture");
+	}
 
-	DX::ThrowIfFailed(device->CreateTexture2D(&txtDesc, &initData, m_text.ReleaseAndGetAddressOf()));
-	DX::ThrowIfFailed(device->CreateShaderResourceView(m_text.Get(), nullptr, m_textView.ReleaseAndGetAddressOf()));
+	CreateTexture(device, texture, 0, m_text.ReleaseAndGetAddressOf(), m_textView.ReleaseAndGetAddressOf());
 
 	D3D11_SAMPLER_DESC samplerDesc = {};
 	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
@@ -5,6 +5,10 @@
 
 #include <d3d11.h>
 
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "TextureCache.h"
+
 struct Position
 {
 	float X;
@@ -51,6 +55,27 @@ struct SurfaceParams
 	bool HasTexture = false;
 };
 
+// Surface of one or more submeshes, equal imported materials share an entry
+struct MeshMaterial
+{
+	Material	Mat;
+	std::string	TextPath;	// diffuse map, empty without one
+};
+
+// Part of the model drawn with one material. Indices are absolute, the vertex range
+// only bounds what the indices of the submesh refer to.
+struct Submesh
+{
+	uint32_t	FirstIndex;
+	uint32_t	IndexCount;
+	uint32_t	FirstVertex;
+	uint32_t	VertexCount;
+	uint32_t	MaterialIndex;
+};
+
+class AssetCache;
+class MeshBlob;
+
 class Model
 {
 public:
@@ -61,28 +86,81 @@ public:
 		std::vector<Normal>&& normals,
 		std::vector<TextCoord>&& textCoords,
 		const char* textPath);
+	// Model of several submeshes flattened into one vertex and index list
+	Model(
+		std::vector<Position>&& positions,
+		std::vector<Face>&& faces,
+		std::vector<Normal>&& normals,
+		std::vector<TextCoord>&& textCoords,
+		std::vector<Submesh>&& submeshes,
+		std::vector<MeshMaterial>&& materials);
+	// Model backed by a cached mesh, only the interleaved streams of the blob are available
+	explicit Model(std::shared_ptr<const MeshBlob> blob);
+	// Loads through the default asset cache
 	static std::unique_ptr<Model> LoadModel(const std::string& filepath);
+	static std::unique_ptr<Model> LoadModel(const std::string& filepath, const AssetCache& cache);
 
 	const std::vector<Position>& GetPositions() const;
 	const std::vector<Face>& GetFaces() const;
 	const std::vector<Normal>& GetNormals() const;
 	const std::vector<TextCoord>& GetTextCoords() const;
+	// Diffuse map of the first submesh, the only texture LoadTexture loads
+	const std::string& GetTextPath() const;
+	const std::vector<Submesh>& GetSubmeshes() const;
+	const std::vector<MeshMaterial>& GetMaterials() const;
+	// Culling clusters over the index buffer, see BuildMeshlets. A meshlet never
+	// spans two submeshes.
+	const std::vector<Meshlet>& GetMeshlets() const;
+	// One chain per submesh of simplified index lists over the same vertices, level 0
+	// is the full submesh. Indices are absolute like GetIndices.
+	const std::vector<LodChain>& GetLodChains() const;
+	const MeshBlob* GetMeshBlob() const;
+	size_t GetVertexCount() const;
+	size_t GetIndexCount() const;
+	// Triangle list of GetIndexCount() indices, from the faces or the cached mesh
+	const uint32_t* GetIndices() const;
 	void LoadTexture(ID3D11Device* device);
 	ID3D11SamplerState* GetTextureSampler();
 	ID3D11ShaderResourceView* GetTextureView();
 
 private:
+	void BuildMeshlets();
+	void BuildLods();
 
 	std::vector<Position>		m_positions;
 	std::vector<Face>			m_faces;
 	std::vector<Normal>			m_normals;
 	std::vector<TextCoord>		m_textCoords;
 	std::string					m_textPath;
+	std::vector<Submesh>		m_submeshes;
+	std::vector<MeshMaterial>	m_materials;
+	std::shared_ptr<const MeshBlob>	m_blob;
+	std::vector<Meshlet>		m_meshlets;
+	std::vector<LodChain>		m_lods;
 
 	// texture related
-	Microsoft::WRL::ComPtr<ID3D11Texture2D>				m_text;
+	Microsoft::WRL::ComPtr<ID3D11Resource>				m_text;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState>			m_sampler;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	m_textView;
 
 };
 
+struct MeshOptimizerReport;
+
+// Imports an OBJ file with the native parser, without the cache. materialLibrary is set
+// to its 'mtllib' record, the vertex caches are simulated around the optimizer when
+// report is set.
+std::unique_ptr<Model> ParseObjectFile(const std::string& filepath, std::string& materialLibrary,
+	MeshOptimizerReport* report = nullptr);
+
+// Case insensitive check of the file extension, ext includes the dot
+bool HasExtension(const std::string& filepath, const char* ext);
+
+// Texture helpers, also used by the asset loader
+std::string FindTexture(const std::string& filename);
+std::wstring StrToWstr(const std::string& s);
+// Immutable texture and its view, from the .dds file with DDSTextureLoader when the
+// data holds one, otherwise sRGB BGRA8 with the levels of the mip chain from firstLevel
+// on. Levels can't be skipped for a .dds file.
+void CreateTexture(ID3D11Device* device, const TextureData& data, uint32_t firstLevel,
+	ID3D11Resource** texture, ID3D11ShaderResourceView** view);
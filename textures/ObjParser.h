@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Model.h"
+
+#include <string>
+#include <vector>
+
+// Marks a stream that a face corner does not reference (e.g. 'f 1//2' has no texture coordinate)
+constexpr unsigned int OBJ_NO_INDEX = ~0u;
+
+// Zero based indices of a face corner into the ObjData streams
+struct ObjCorner
+{
+	unsigned int Position;
+	unsigned int TextCoord;
+	unsigned int Normal;
+};
+
+struct ObjData
+{
+	std::vector<Position>	Positions;
+	std::vector<Normal>		Normals;
+	std::vector<TextCoord>	TextCoords;
+	// three per triangle, quads and n-gons are fan triangulated
+	std::vector<ObjCorner>	Corners;
+	// the first 'mtllib' record, relative to the OBJ file
+	std::string				MaterialLibrary;
+};
+
+// Indexed mesh with one vertex per unique (v, vt, vn) tuple.
+// TextCoords is empty when the file has no texture coordinates.
+struct ObjMesh
+{
+	std::vector<Position>	Positions;
+	std::vector<Normal>		Normals;
+	std::vector<TextCoord>	TextCoords;
+	std::vector<Face>		Faces;
+};
+
+// Parses Wavefront OBJ text in [begin, end) in place, without copying lines.
+// 'v', 'vn', 'vt', 'f' and 'mtllib' records are used, everything else is skipped.
+// Face indices are converted to zero based, negative (relative) indices are resolved.
+void ParseObjBuffer(const char* begin, const char* end, ObjData& out);
+
+// Same result as ParseObjBuffer, but the buffer is split at line boundaries and
+// the chunks are parsed on 'numThreads' worker threads (0 - one per core).
+void ParseObjBufferParallel(const char* begin, const char* end, ObjData& out, unsigned int numThreads = 0);
+
+// Welds the (v, vt, vn) tuples of the face corners into one indexed vertex stream.
+// Vertices without a normal get an area weighted smooth normal.
+void WeldObjVertices(const ObjData& data, ObjMesh& out);
+
+// Returns the diffuse texture ('map_Kd') of the first material in MTL text, or an empty string
+std::string ParseMtlDiffuseMap(const char* begin, const char* end);
+
+// Parses the file 'iterations' times and returns parse throughput in MB/s.
+// Mapping the file is done once and is not part of the measurement.
+double MeasureObjParseThroughput(const std::string& filepath, unsigned int iterations, unsigned int numThreads = 1);
+
+struct ObjScalingResult
+{
+	unsigned int	Threads;
+	double			MegabytesPerSecond;
+	double			Speedup; // relative to a single thread
+};
+
+// Measures ParseObjBufferParallel throughput for 1, 2, 4, ... threads up to the core count.
+std::vector<ObjScalingResult> MeasureObjParseScaling(const std::string& filepath, unsigned int iterations);
+
+// Writes a synthetic OBJ of about 'targetBytes' bytes: a grid of v/vt/vn records
+// with faces that mix absolute and negative (relative) indices.
+bool WriteSyntheticObj(const std::string& filepath, size_t targetBytes);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline unsigned int DefaultThreadCount()
+{
+	const unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+// Runs fn(i) for i in [0, count) on 'numThreads' threads, the calling thread is one of them
+template <typename Fn>
+void RunParallel(size_t count, unsigned int numThreads, Fn&& fn)
+{
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			fn(i);
+	};
+
+	std::vector<std::thread> threads;
+	const size_t numWorkers = (std::min)(static_cast<size_t>(numThreads), count);
+	threads.reserve(numWorkers > 0 ? numWorkers - 1 : 0);
+	for (size_t i = 1; i < numWorkers; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& t : threads)
+		t.join();
+}
@@ -59,6 +59,9 @@ struct PSInput
     float3 normal       : NORMAL;
     float2 textCoord    : TEXTCOORD;
     float3 positionW    : POSITION;
+    float4 tint         : TINT;
+    // of the instance, for a material table once there is one
+    nointerpolation uint material : MATERIAL;
 };
 
 struct Pixel
@@ -238,6 +241,7 @@ Pixel main(PSInput In)
         Out.color = ambient + diffuse + specular;
     }
 
+    Out.color.rgb *= In.tint.rgb;
     Out.color.w = material.Diffuse.w;
 
     return Out;
@@ -2,56 +2,186 @@
 #include "Renderer.h"
 
 #include "ReadData.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
 
 using namespace Render;
 
-void Renderer::Render(const std::vector<Model>& models) const
+namespace
 {
-    ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-    // Set the vertex buffer
-    constexpr UINT strides = sizeof(Vertex);
-    constexpr UINT offsets = 0;
-    context->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &strides, &offsets);
-    // Set the index buffer
-    context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-    // Set input assembler state
-    context->IASetInputLayout(m_inputLayout.Get());
-    // Set the primitive topology
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // Constants in a slice of the ring bound at its offset when there is room, otherwise in
+    // their own buffer
+    void SetConstants(CommandList& commands, const SceneBindings& bindings, ConstantRingAllocator* constantRing,
+        ShaderStage stage, uint32_t slot, ResourceId buffer, const void* data, uint32_t size)
+    {
+        ConstantSlice slice;
+        if (constantRing && bindings.ConstantRing != NULL_RESOURCE && constantRing->Allocate(size, slice))
+        {
+            // the first map of a new dynamic buffer discards it
+            const BufferUpdate mode = constantRing->GetStats().Allocations == 1 ? BUFFER_UPDATE_DISCARD : BUFFER_UPDATE_NO_OVERWRITE;
+            commands.UpdateBuffer(bindings.ConstantRing, slice.Offset, data, size, mode);
+            commands.SetConstantBufferRange(stage, slot, bindings.ConstantRing, slice.Offset / 16, slice.Size / 16);
+        }
+        else
+        {
+            commands.UpdateConstants(buffer, data, size);
+            commands.SetConstantBuffer(stage, slot, buffer);
+        }
+    }
+}
+
+void Render::BatchInstances(const std::vector<MeshInstance>& instances, const std::vector<DrawPacket>& modelDraws,
+    const std::vector<uint32_t>& modelFirstDraw, DrawBucket& scratch, std::vector<InstanceData>& instanceData,
+    std::vector<DrawPacket>& draws)
+{
+    // model above material, sorting groups both
+    scratch.Clear();
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+        scratch.Add(uint64_t(instances[i].Model) << 32 | instances[i].Material, static_cast<uint32_t>(i));
+    }
+    scratch.Sort();
+
+    instanceData.clear();
+    draws.clear();
+    const std::vector<DrawItem>& items = scratch.GetItems();
+    for (size_t first = 0, end = 0; first < items.size(); first = end)
+    {
+        const MeshInstance& batch = instances[items[first].Draw];
+        end = first + 1;
+        while (end < items.size() && items[end].Key == items[first].Key)
+            ++end;
+        // instances of models the renderer doesn't have, Model + 1 would wrap at UINT32_MAX
+        if (modelFirstDraw.empty() || batch.Model >= modelFirstDraw.size() - 1)
+            continue;
+
+        const uint32_t firstDraw = modelFirstDraw[batch.Model];
+        const uint32_t endDraw = modelFirstDraw[batch.Model + 1];
+        const XMVECTOR modelCenter = firstDraw < endDraw ? XMLoadFloat3(&modelDraws[firstDraw].Center) : XMVectorZero();
+        const uint32_t startInstance = static_cast<uint32_t>(instanceData.size());
+        XMVECTOR center = XMVectorZero();
+        for (size_t i = first; i < end; ++i)
+        {
+            const MeshInstance& instance = instances[items[i].Draw];
+            const XMMATRIX world = XMLoadFloat4x4(&instance.World);
+            // the columns, the shader dots each with the position
+            const XMMATRIX columns = XMMatrixTranspose(world);
+            InstanceData data;
+            XMStoreFloat4(&data.World[0], columns.r[0]);
+            XMStoreFloat4(&data.World[1], columns.r[1]);
+            XMStoreFloat4(&data.World[2], columns.r[2]);
+            data.Tint = instance.Tint;
+            data.Material = instance.Material;
+            instanceData.push_back(data);
+            center = XMVectorAdd(center, XMVector3TransformCoord(modelCenter, world));
+        }
+        center = XMVectorScale(center, 1.0f / static_cast<float>(end - first));
+
+        for (uint32_t d = firstDraw; d < endDraw; ++d)
+        {
+            DrawPacket draw = modelDraws[d];
+            draw.Material = batch.Material;
+            draw.InstanceCount = static_cast<uint32_t>(end - first);
+            draw.StartInstance = startInstance;
+            XMStoreFloat3(&draw.Center, center);
+            draws.push_back(draw);
+        }
+    }
+}
 
-    // Set scene data cbuffer
+void Render::SortDraws(const std::vector<DrawPacket>& draws, DrawBucket& bucket)
+{
+    bucket.Clear();
+    for (size_t i = 0; i < draws.size(); ++i)
     {
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        DX::ThrowIfFailed(context->Map(m_cbSceneParams.Get(), 0,
-            D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-        memcpy(mapped.pData, &m_sceneParams, sizeof(SceneParams));
-        context->Unmap(m_cbSceneParams.Get(), 0);
+        const DrawPacket& draw = draws[i];
+        bucket.Add(MakeSortKey(draw.Layer, draw.Pass, draw.PixelShader, draw.Material, draw.Texture, draw.Depth),
+            static_cast<uint32_t>(i));
     }
+    bucket.Sort();
+}
 
-    // Set lighting data cbuffer
+void Render::RecordScene(CommandList& commands, const SceneBindings& bindings, const SceneParams& sceneParams,
+    const LightingParams& lightingParams, const std::vector<DrawPacket>& draws, const DrawBucket& bucket,
+    const std::vector<InstanceData>* instanceUpload, ConstantRingAllocator* constantRing)
+{
+    // Set the vertex buffer
+    commands.SetVertexBuffer(0, bindings.VertexBuffer, sizeof(Vertex), 0);
+    // and the instances next to it
+    if (bindings.InstanceBuffer != NULL_RESOURCE)
     {
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        DX::ThrowIfFailed(context->Map(m_cbLightingParams.Get(), 0,
-            D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-        memcpy(mapped.pData, &m_lightingParams, sizeof(LightingParams));
-        context->Unmap(m_cbLightingParams.Get(), 0);
+        if (instanceUpload && !instanceUpload->empty())
+        {
+            commands.UpdateBuffer(bindings.InstanceBuffer, 0, instanceUpload->data(),
+                static_cast<uint32_t>(instanceUpload->size() * sizeof(InstanceData)), BUFFER_UPDATE_DISCARD);
+        }
+        commands.SetVertexBuffer(1, bindings.InstanceBuffer, sizeof(InstanceData), 0);
     }
+    // Set input assembler state
+    commands.SetInputLayout(bindings.InputLayout);
+    // Set the primitive topology
+    commands.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     // Vertex shader needs view and projection matrices to perform vertex transform
-    context->VSSetConstantBuffers(0, 1, m_cbSceneParams.GetAddressOf());
+    SetConstants(commands, bindings, constantRing, SHADER_STAGE_VERTEX, 0, bindings.SceneConstants,
+        &sceneParams, sizeof(SceneParams));
     // Pixel shader needs lighting data
-    context->PSSetConstantBuffers(0, 1, m_cbLightingParams.GetAddressOf());
-    // Set vertex shader
-    context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-    // Set pixel shader
-    context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+    SetConstants(commands, bindings, constantRing, SHADER_STAGE_PIXEL, 0, bindings.LightingConstants,
+        &lightingParams, sizeof(LightingParams));
+
+    // Draw indexed in bucket order, binding what differs from the previous draw
+    const DrawPacket* previous = nullptr;
+    for (const DrawItem& item : bucket.GetItems())
+    {
+        const DrawPacket& draw = draws[item.Draw];
+        if (!previous || draw.VertexShader != previous->VertexShader)
+            commands.SetVertexShader(draw.VertexShader);
+        if (!previous || draw.PixelShader != previous->PixelShader)
+            commands.SetPixelShader(draw.PixelShader);
+        if (!previous || draw.Sampler != previous->Sampler)
+            commands.SetSampler(SHADER_STAGE_PIXEL, 0, draw.Sampler);
+        if (!previous || draw.Texture != previous->Texture)
+            commands.SetShaderResource(SHADER_STAGE_PIXEL, 0, draw.Texture);
+        if (!previous || draw.Range.Format != previous->Range.Format)
+        {
+            const ResourceId indexBuffer = draw.Range.Format == DXGI_FORMAT_R16_UINT ? bindings.IndexBuffer16 : bindings.IndexBuffer32;
+            commands.SetIndexBuffer(indexBuffer, draw.Range.Format, 0);
+        }
+        if (bindings.InstanceBuffer != NULL_RESOURCE)
+        {
+            commands.DrawIndexedInstanced(draw.Range.IndexCount, draw.InstanceCount, draw.Range.StartIndex,
+                draw.Range.BaseVertex, draw.StartInstance);
+        }
+        else
+        {
+            commands.DrawIndexed(draw.Range.IndexCount, draw.Range.StartIndex, draw.Range.BaseVertex);
+        }
+        previous = &draw;
+    }
+}
 
-    assert(m_samplers.size() == m_textureViews.size());
+void Renderer::Render() const
+{
+    // The scene's world matrix applies to every batch, depth is to the centre of its instances
+    const XMMATRIX worldView = XMMatrixMultiply(XMLoadFloat4x4(&m_sceneParams.WorldMat), XMLoadFloat4x4(&m_sceneParams.ViewMat));
+    for (DrawPacket& draw : m_draws)
+    {
+        draw.Depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&draw.Center), worldView));
+    }
+    SortDraws(m_draws, m_bucket);
 
-    // Set texture and sampler.
-    context->PSSetSamplers(0, m_samplers.size(), &m_samplers[0]);
+    if (m_constantRing)
+        RetireFrames();
 
-    context->PSSetShaderResources(0, m_textureViews.size(), &m_textureViews[0]);
+    // instances are uploaded only after they changed
+    m_commands.Reset();
+    RecordScene(m_commands, m_bindings, m_sceneParams, m_lightingParams, m_draws, m_bucket,
+        m_uploadInstances ? &m_instanceData : nullptr, m_constantRing.get());
+    m_uploadInstances = false;
 
     // Experiment with rasterizer state
     //D3D11_RASTERIZER_DESC rsDesc;
@@ -65,15 +195,66 @@ void Renderer::Render(const std::vector<Model>& models) const
     //DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateRasterizerState(&rsDesc, pRastState.ReleaseAndGetAddressOf()));
     //context->RSSetState(pRastState.Get());
 
-    unsigned int indexOffset = 0;
-    unsigned int vertexOffset = 0;
-    for (const Model& m : models)
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    m_executor.Execute(context, m_commands);
+
+    // the slices of this frame are free once its query is done
+    if (m_constantRing)
+    {
+        ++m_submittedFence;
+        context->End(m_frameQueries[m_submittedFence % MAX_FRAMES_IN_FLIGHT].Get());
+        m_constantRing->EndFrame(m_submittedFence);
+    }
+}
+
+void Renderer::RetireFrames() const
+{
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    // queries finish in the order they were ended
+    while (m_completedFence < m_submittedFence)
+    {
+        const uint64_t fence = m_completedFence + 1;
+        ID3D11Query* query = m_frameQueries[fence % MAX_FRAMES_IN_FLIGHT].Get();
+        // the next frame ends the query of this one again, it has to be done by then
+        const bool wait = m_submittedFence - fence + 1 >= MAX_FRAMES_IN_FLIGHT;
+        HRESULT hr = context->GetData(query, nullptr, 0, wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+        while (wait && hr == S_FALSE)
+        {
+            SwitchToThread();
+            hr = context->GetData(query, nullptr, 0, 0);
+        }
+        if (hr != S_OK)
+            break;
+        m_completedFence = fence;
+    }
+    m_constantRing->Retire(m_completedFence);
+}
+
+void Renderer::SetInstances(const std::vector<MeshInstance>& instances)
+{
+    BatchInstances(instances, m_modelDraws, m_modelFirstDraw, m_batchScratch, m_instanceData, m_draws);
+    if (m_instanceData.size() > MAX_INSTANCES)
     {
-        // Draw indexed
-        context->DrawIndexed(m.GetFaces().size() * 3, indexOffset, vertexOffset);
-        indexOffset += m.GetFaces().size() * 3;
-        vertexOffset += m.GetPositions().size();
+        std::cerr << "WARNING: " << m_instanceData.size() << " instances, only the first " << MAX_INSTANCES
+            << " are drawn" << std::endl;
+        m_instanceData.resize(MAX_INSTANCES);
+        // batches past the end are dropped, the one across it is cut short
+        std::vector<DrawPacket> kept;
+        for (DrawPacket draw : m_draws)
+        {
+            if (draw.StartInstance >= MAX_INSTANCES)
+                continue;
+            draw.InstanceCount = (std::min)(draw.InstanceCount, MAX_INSTANCES - draw.StartInstance);
+            kept.push_back(draw);
+        }
+        m_draws.swap(kept);
     }
+    m_uploadInstances = true;
+}
+
+const StateFilterStats& Renderer::GetFrameStats() const
+{
+    return m_executor.GetStats();
 }
 
 void Renderer::Init(DX::DeviceResources* deviceResources, const std::vector<Model>& models)
@@ -82,16 +263,20 @@ void Renderer::Init(DX::DeviceResources* deviceResources, const std::vector<Mode
 
     // preoccupy memory
     std::vector<Vertex> vertexData;
-    std::vector<unsigned int> indexData;
+    PackedIndices indexData;
     size_t numVertices = 0;
     size_t numIndices = 0;
     for (const Model& m : models)
     {
-        numVertices += m.GetPositions().size();
-        numIndices += m.GetFaces().size() * 3;
+        numVertices += m.GetVertexCount();
+        numIndices += m.GetIndexCount();
     }
-    vertexData.reserve(numVertices);
-    indexData.reserve(numIndices);
+    vertexData.resize(numVertices);
+    indexData.Indices16.reserve(numIndices);
+    std::vector<IndexRange> indexRanges;
+    // model of each index range, and the centre of its bounds
+    std::vector<size_t> rangeModels;
+    std::vector<XMFLOAT3> modelCenters;
 
     ID3D11Device* device = deviceResources->GetD3DDevice();
 
@@ -110,10 +295,16 @@ void Renderer::Init(DX::DeviceResources* deviceResources, const std::vector<Mode
                 nullptr, m_pixelShader.ReleaseAndGetAddressOf()));
 
         // Create input layout
-        static constexpr D3D11_INPUT_ELEMENT_DESC s_inputElementDesc[3] = {
+        static constexpr D3D11_INPUT_ELEMENT_DESC s_inputElementDesc[8] = {
             {"SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
             {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
-            {"TEXTCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0}
+            {"TEXTCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0},
+            // InstanceData
+            {"WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+            {"WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+            {"WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+            {"TINT", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+            {"MATERIAL", 0, DXGI_FORMAT_R32_UINT, 1, 52, D3D11_INPUT_PER_INSTANCE_DATA, 1}
         };
 
         DX::ThrowIfFailed(
@@ -124,30 +315,30 @@ void Renderer::Init(DX::DeviceResources* deviceResources, const std::vector<Mode
 
     // create vertex buffer
     {
+        Vertex* dst = vertexData.data();
         for (const Model& m : models)
         {
-            for (unsigned int i = 0; i < m.GetPositions().size(); ++i)
+            // Cached meshes are already interleaved
+            if (const MeshBlob* blob = m.GetMeshBlob())
+            {
+                std::copy(blob->GetVertices(), blob->GetVertices() + blob->GetNumVertices(), dst);
+            }
+            else
+            {
+                MeshData::FromModel(m).Interleave(dst);
+            }
+
+            XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+            XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (const Vertex* v = dst; v != dst + m.GetVertexCount(); ++v)
             {
-                const Position& p = m.GetPositions()[i];
-                const Normal& n = m.GetNormals()[i];
-                if (m.GetTextCoords().empty())
-                {
-                    vertexData.push_back({
-                        XMFLOAT3(p.X, p.Y, p.Z),
-                        XMFLOAT3(n.X, n.Y, n.Z),
-                        XMFLOAT2(0.0f, 0.0f)
-                        });
-                }
-                else
-                {
-                    const TextCoord& tc = m.GetTextCoords()[i];
-                    vertexData.push_back({
-                        XMFLOAT3(p.X, p.Y, p.Z),
-                        XMFLOAT3(n.X, n.Y, n.Z),
-                        XMFLOAT2(tc.X, tc.Y)
-                        });
-                }
+                lo = XMFLOAT3(std::min(lo.x, v->Pos.x), std::min(lo.y, v->Pos.y), std::min(lo.z, v->Pos.z));
+                hi = XMFLOAT3(std::max(hi.x, v->Pos.x), std::max(hi.y, v->Pos.y), std::max(hi.z, v->Pos.z));
             }
+            modelCenters.push_back(m.GetVertexCount() > 0
+                ? XMFLOAT3((lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f)
+                : XMFLOAT3(0.0f, 0.0f, 0.0f));
+            dst += m.GetVertexCount();
         }
 
         D3D11_SUBRESOURCE_DATA initialData = {};
@@ -164,38 +355,194 @@ void Renderer::Init(DX::DeviceResources* deviceResources, const std::vector<Mode
             m_vertexBuffer.ReleaseAndGetAddressOf()));
     }
 
-    // create index buffer
+    // create index buffers, 16-bit wherever the vertex span allows it
     {
-	    for (const Model& m : models)
-	    {
-            for (unsigned int i = 0; i < m.GetFaces().size(); ++i)
+        size_t vertexOffset = 0;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            const Model& m = models[i];
+            const size_t firstRange = indexRanges.size();
+            const IndexBufferReport report = PackIndices(m.GetIndices(), m.GetIndexCount(), indexData, indexRanges);
+            for (size_t r = firstRange; r < indexRanges.size(); ++r)
             {
-                indexData.push_back(m.GetFaces()[i].X);
-                indexData.push_back(m.GetFaces()[i].Y);
-                indexData.push_back(m.GetFaces()[i].Z);
+                indexRanges[r].BaseVertex += static_cast<uint32_t>(vertexOffset);
             }
-	    }
+            rangeModels.resize(indexRanges.size(), i);
+            vertexOffset += m.GetVertexCount();
 
-        D3D11_SUBRESOURCE_DATA initialData = {};
-        initialData.pSysMem = &indexData[0];
+            const MeshBlob* blob = m.GetMeshBlob();
+            char buff[256] = {};
+            sprintf_s(buff, "Mesh %zu: %zu vertices, %zu KB; %zu indices in %zu ranges (%zu 32-bit), %zu KB instead of %zu KB, %zu KB on disk\n",
+                i, m.GetVertexCount(), m.GetVertexCount() * sizeof(Vertex) / 1024,
+                report.NumIndices, report.NumRanges, report.NumWideRanges,
+                report.PackedBytes / 1024, report.Bytes32 / 1024,
+                (blob ? blob->GetIndexDataSize() : report.Bytes32) / 1024);
+            OutputDebugStringA(buff);
+        }
 
         D3D11_BUFFER_DESC bufferDesc = {};
         bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-        bufferDesc.ByteWidth = sizeof(unsigned int) * indexData.size();
         bufferDesc.StructureByteStride = 0;
         bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 
-        DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc,
-            &initialData,
-            m_indexBuffer.ReleaseAndGetAddressOf()));
+        if (!indexData.Indices16.empty())
+        {
+            D3D11_SUBRESOURCE_DATA initialData = {};
+            initialData.pSysMem = &indexData.Indices16[0];
+            bufferDesc.ByteWidth = sizeof(uint16_t) * indexData.Indices16.size();
+
+            DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc,
+                &initialData,
+                m_indexBuffer16.ReleaseAndGetAddressOf()));
+        }
+
+        if (!indexData.Indices32.empty())
+        {
+            D3D11_SUBRESOURCE_DATA initialData = {};
+            initialData.pSysMem = &indexData.Indices32[0];
+            bufferDesc.ByteWidth = sizeof(uint32_t) * indexData.Indices32.size();
+
+            DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc,
+                &initialData,
+                m_indexBuffer32.ReleaseAndGetAddressOf()));
+        }
+    }
+
+    // create the instance buffer, written when the instances change
+    {
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.ByteWidth = sizeof(InstanceData) * MAX_INSTANCES;
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc, nullptr, m_instanceBuffer.ReleaseAndGetAddressOf()));
+    }
+
+    // create the constant ring where the device binds constant buffers at offsets, with
+    // the queries that fence its frames
+    {
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        m_constantRing.reset();
+        m_submittedFence = 0;
+        m_completedFence = 0;
+        if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+            && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer)
+        {
+            D3D11_BUFFER_DESC bufferDesc = {};
+            bufferDesc.ByteWidth = CONSTANT_RING_SIZE;
+            bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+            bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+            bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc, nullptr, m_constantRingBuffer.ReleaseAndGetAddressOf()));
+
+            D3D11_QUERY_DESC queryDesc = {};
+            queryDesc.Query = D3D11_QUERY_EVENT;
+            for (Microsoft::WRL::ComPtr<ID3D11Query>& query : m_frameQueries)
+            {
+                DX::ThrowIfFailed(device->CreateQuery(&queryDesc, query.ReleaseAndGetAddressOf()));
+            }
+            m_constantRing = std::make_unique<ConstantRingAllocator>(CONSTANT_RING_SIZE);
+        }
+    }
+
+    // create constant buffers, rewritten every frame without a constant ring
+    {
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        bufferDesc.ByteWidth = sizeof(SceneParams);
+        DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc, nullptr, m_cbSceneParams.ReleaseAndGetAddressOf()));
+        bufferDesc.ByteWidth = sizeof(LightingParams);
+        DX::ThrowIfFailed(device->CreateBuffer(&bufferDesc, nullptr, m_cbLightingParams.ReleaseAndGetAddressOf()));
+    }
+
+    // name everything a frame binds for the command list
+    {
+        m_executor.Clear();
+        m_bindings = SceneBindings();
+        m_bindings.VertexBuffer = m_executor.AddBuffer(m_vertexBuffer.Get());
+        if (m_indexBuffer16)
+            m_bindings.IndexBuffer16 = m_executor.AddBuffer(m_indexBuffer16.Get());
+        if (m_indexBuffer32)
+            m_bindings.IndexBuffer32 = m_executor.AddBuffer(m_indexBuffer32.Get());
+        m_bindings.InputLayout = m_executor.AddInputLayout(m_inputLayout.Get());
+        m_bindings.SceneConstants = m_executor.AddBuffer(m_cbSceneParams.Get());
+        m_bindings.LightingConstants = m_executor.AddBuffer(m_cbLightingParams.Get());
+        m_bindings.InstanceBuffer = m_executor.AddBuffer(m_instanceBuffer.Get());
+        if (m_constantRing)
+            m_bindings.ConstantRing = m_executor.AddBuffer(m_constantRingBuffer.Get());
+        const ResourceId vertexShader = m_executor.AddVertexShader(m_vertexShader.Get());
+        const ResourceId pixelShader = m_executor.AddPixelShader(m_pixelShader.Get());
+        std::vector<ResourceId> samplers;
+        for (ID3D11SamplerState* sampler : m_samplers)
+            samplers.push_back(m_executor.AddSampler(sampler));
+        std::vector<ResourceId> textureViews;
+        for (ID3D11ShaderResourceView* view : m_textureViews)
+            textureViews.push_back(m_executor.AddShaderResource(view));
+
+        // the sampler and texture of a model are the ones at its index
+        m_modelDraws.clear();
+        m_modelFirstDraw.assign(models.size() + 1, 0);
+        for (size_t r = 0; r < indexRanges.size(); ++r)
+        {
+            const size_t model = rangeModels[r];
+            DrawPacket draw;
+            draw.Range = indexRanges[r];
+            draw.VertexShader = vertexShader;
+            draw.PixelShader = pixelShader;
+            draw.Sampler = model < samplers.size() ? samplers[model] : NULL_RESOURCE;
+            draw.Texture = model < textureViews.size() ? textureViews[model] : NULL_RESOURCE;
+            draw.Center = modelCenters[model];
+            m_modelDraws.push_back(draw);
+            ++m_modelFirstDraw[model + 1];
+        }
+        for (size_t m = 0; m < models.size(); ++m)
+        {
+            m_modelFirstDraw[m + 1] += m_modelFirstDraw[m];
+        }
+    }
+
+    // every model once where it is, with a material of its own
+    std::vector<MeshInstance> instances(models.size());
+    for (size_t m = 0; m < models.size(); ++m)
+    {
+        instances[m].Model = static_cast<uint32_t>(m);
+        instances[m].Material = static_cast<uint32_t>(m);
+        XMStoreFloat4x4(&instances[m].World, XMMatrixIdentity());
+        instances[m].Tint = 0xFFFFFFFF;
     }
+    SetInstances(instances);
 }
 
 void Renderer::Deinit()
 {
+    m_executor.Clear();
+    m_bindings = SceneBindings();
+    m_commands.Reset();
     m_inputLayout.Reset();
     m_vertexBuffer.Reset();
-    m_indexBuffer.Reset();
+    m_indexBuffer16.Reset();
+    m_indexBuffer32.Reset();
+    m_instanceBuffer.Reset();
+    m_modelDraws.clear();
+    m_modelFirstDraw.clear();
+    m_draws.clear();
+    m_instanceData.clear();
+    m_uploadInstances = false;
+    m_bucket.Clear();
     m_vertexShader.Reset();
     m_pixelShader.Reset();
+    m_cbSceneParams.Reset();
+    m_cbLightingParams.Reset();
+    m_constantRing.reset();
+    m_constantRingBuffer.Reset();
+    for (Microsoft::WRL::ComPtr<ID3D11Query>& query : m_frameQueries)
+    {
+        query.Reset();
+    }
+    m_submittedFence = 0;
+    m_completedFence = 0;
 }
@@ -1,8 +1,14 @@
 #pragma once
 
+#include "CommandExecutor.h"
+#include "CommandList.h"
+#include "ConstantRing.h"
 #include "DeviceResources.h"
+#include "DrawBucket.h"
+#include "IndexBuffer.h"
 #include "Model.h"
 
+#include <memory>
 #include <vector>
 
 namespace Render
@@ -77,33 +83,157 @@ namespace Render
     static_assert((sizeof(SceneParams) % 16) == 0, "Constant buffer must always be 16-byte aligned");
     static_assert((sizeof(LightingParams) % 16) == 0, "Constant buffer must always be 16-byte aligned");
 
+    // One placement of a model, drawn before the world matrix of the scene
+    struct MeshInstance
+    {
+        // index in the models the renderer was initialised with
+        uint32_t    Model;
+        uint32_t    Material;
+        XMFLOAT4X4  World;
+        // RGBA8, red in the low byte, multiplies the lit colour
+        uint32_t    Tint;
+    };
+
+    // Per instance vertex stream in input slot 1
+    struct InstanceData
+    {
+        // the first three columns of the world matrix, it has to be affine
+        XMFLOAT4 World[3];
+        uint32_t Tint;
+        uint32_t Material;
+    };
+
+    // Instances one instance buffer holds, more than that aren't drawn
+    constexpr uint32_t MAX_INSTANCES = 128 * 1024;
+
+    // Constant slices of a few frames of many draws
+    constexpr uint32_t CONSTANT_RING_SIZE = 4 * 1024 * 1024;
+    // Frames the CPU records ahead of the GPU, each ends with a fence of the constant ring
+    constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+    // What every draw of a frame binds, as ids of the backend that runs its commands
+    struct SceneBindings
+    {
+        ResourceId VertexBuffer = NULL_RESOURCE;
+        ResourceId IndexBuffer16 = NULL_RESOURCE;
+        ResourceId IndexBuffer32 = NULL_RESOURCE;
+        ResourceId InputLayout = NULL_RESOURCE;
+        ResourceId SceneConstants = NULL_RESOURCE;
+        ResourceId LightingConstants = NULL_RESOURCE;
+        // dynamic, of InstanceData. Without one nothing is drawn instanced.
+        ResourceId InstanceBuffer = NULL_RESOURCE;
+        // dynamic constant buffer a ConstantRingAllocator hands out slices of
+        ResourceId ConstantRing = NULL_RESOURCE;
+    };
+
+    // One draw with the state it binds and what orders it among the others
+    struct DrawPacket
+    {
+        IndexRange  Range;
+        ResourceId  VertexShader = NULL_RESOURCE;
+        ResourceId  PixelShader = NULL_RESOURCE;
+        // pixel shader slot 0
+        ResourceId  Sampler = NULL_RESOURCE;
+        ResourceId  Texture = NULL_RESOURCE;
+        // keeps the draws of a material together, binds nothing of its own yet
+        uint32_t    Material = 0;
+        uint32_t    Layer = 0;
+        DrawPass    Pass = DRAW_PASS_OPAQUE;
+        // of the instance buffer, when the scene has one
+        uint32_t    InstanceCount = 1;
+        uint32_t    StartInstance = 0;
+        // world space centre and its view space distance, for the order within the state or
+        // pass of the draw
+        XMFLOAT3    Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        float       Depth = 0.0f;
+    };
+
+    // Groups the instances by model and material and writes the instance stream in that
+    // order. Each group is drawn with one instanced draw per index range of its model, made
+    // from the model's draws: those from modelFirstDraw[model] up to modelFirstDraw[model + 1]
+    // in modelDraws. The centre of a group is the average of its instances.
+    void BatchInstances(const std::vector<MeshInstance>& instances, const std::vector<DrawPacket>& modelDraws,
+        const std::vector<uint32_t>& modelFirstDraw, DrawBucket& scratch, std::vector<InstanceData>& instanceData,
+        std::vector<DrawPacket>& draws);
+
+    // Keys every draw by layer, pass, pixel shader, material, texture and depth into the
+    // cleared bucket and sorts it
+    void SortDraws(const std::vector<DrawPacket>& draws, DrawBucket& bucket);
+
+    // Records everything Renderer::Render submits in a frame, draws in the order of the
+    // bucket with only the state that changes from one to the next. instanceUpload is
+    // written to the instance buffer first, null when it already holds the instances.
+    // Constants go to slices of the constant ring when there is one and it has room,
+    // otherwise to buffers of their own. Needs no device.
+    void RecordScene(CommandList& commands, const SceneBindings& bindings, const SceneParams& sceneParams,
+        const LightingParams& lightingParams, const std::vector<DrawPacket>& draws, const DrawBucket& bucket,
+        const std::vector<InstanceData>* instanceUpload, ConstantRingAllocator* constantRing);
+
 
 class Renderer
 {
 public:
 
-	void Render(const std::vector<Model>& models) const;
+	void Render() const;
     void Init(DX::DeviceResources* deviceResources, const std::vector<Model>& models);
     void Deinit();
 
+    // Replaces what is drawn, same models and materials are batched into instanced draws.
+    // Until it is called every model is drawn once where it is.
+    void SetInstances(const std::vector<MeshInstance>& instances);
+
+    // Binds the last frame issued and dropped as redundant
+    const StateFilterStats& GetFrameStats() const;
+
 private:
+    // Frees the constant slices of the frames the GPU has finished, waits for the oldest
+    // when its query is the next to be reused
+    void RetireFrames() const;
+
 	DX::DeviceResources* m_deviceResources;
     // Sample objects
     Microsoft::WRL::ComPtr<ID3D11InputLayout>       m_inputLayout;
     Microsoft::WRL::ComPtr<ID3D11Buffer>            m_vertexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Buffer>            m_indexBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>            m_indexBuffer16;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>            m_indexBuffer32;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>            m_instanceBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>            m_cbSceneParams;
     Microsoft::WRL::ComPtr<ID3D11Buffer>            m_cbLightingParams;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>            m_constantRingBuffer;
     Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_vertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_pixelShader;
 
     SceneParams                                     m_sceneParams;
     LightingParams                                  m_lightingParams;
 
+    // a draw per index range of each model, base vertices are absolute and centres are
+    // those of the model's bounds
+    std::vector<DrawPacket>                         m_modelDraws;
+    std::vector<uint32_t>                           m_modelFirstDraw;
+
+    // instance batches, their depth is measured every frame
+    mutable std::vector<DrawPacket>                 m_draws;
+    std::vector<InstanceData>                       m_instanceData;
+    mutable bool                                    m_uploadInstances = false;
+    DrawBucket                                      m_batchScratch;
+
     // textures
     std::vector<ID3D11ShaderResourceView*>   m_textureViews;
     std::vector<ID3D11Texture2D*>            m_textures;
     std::vector<ID3D11SamplerState*>         m_samplers;
+
+    // every frame is recorded into the same command list and replayed on the context
+    mutable D3D11CommandExecutor                    m_executor;
+    SceneBindings                                   m_bindings;
+    mutable DrawBucket                              m_bucket;
+    mutable CommandList                             m_commands;
+
+    // only with D3D11.1 constant buffer offsets and NO_OVERWRITE maps on constant buffers.
+    // Fence n is the event query n % MAX_FRAMES_IN_FLIGHT ended after frame n.
+    mutable std::unique_ptr<ConstantRingAllocator>  m_constantRing;
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameQueries[MAX_FRAMES_IN_FLIGHT];
+    mutable uint64_t                                m_submittedFence = 0;
+    mutable uint64_t                                m_completedFence = 0;
 };
 
 } // namespace Renderer
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "StateFilter.h"
+
+using namespace Render;
+
+RedundantStateFilter::RedundantStateFilter():
+    m_stats()
+{
+    Invalidate();
+}
+
+bool RedundantStateFilter::ShouldIssue(const Command& command)
+{
+    bool changed = true;
+    switch (command.Type)
+    {
+    case COMMAND_SET_VERTEX_BUFFER:
+    {
+        const SetVertexBufferCommand& set = *static_cast<const SetVertexBufferCommand*>(command.Data);
+        if (set.Slot < MAX_VERTEX_BUFFER_SLOTS)
+        {
+            SetVertexBufferCommand& bound = m_vertexBuffers[set.Slot];
+            changed = set.Buffer != bound.Buffer || set.Stride != bound.Stride || set.Offset != bound.Offset;
+            bound = set;
+        }
+        break;
+    }
+    case COMMAND_SET_INDEX_BUFFER:
+    {
+        const SetIndexBufferCommand& set = *static_cast<const SetIndexBufferCommand*>(command.Data);
+        changed = set.Buffer != m_indexBuffer.Buffer || set.Format != m_indexBuffer.Format || set.Offset != m_indexBuffer.Offset;
+        m_indexBuffer = set;
+        break;
+    }
+    case COMMAND_SET_INPUT_LAYOUT:
+        changed = Set(m_inputLayout, static_cast<const SetResourceCommand*>(command.Data)->Resource);
+        break;
+    case COMMAND_SET_TOPOLOGY:
+        changed = Set(m_topology, static_cast<const SetTopologyCommand*>(command.Data)->Topology);
+        break;
+    case COMMAND_SET_VERTEX_SHADER:
+        changed = Set(m_vertexShader, static_cast<const SetResourceCommand*>(command.Data)->Resource);
+        break;
+    case COMMAND_SET_PIXEL_SHADER:
+        changed = Set(m_pixelShader, static_cast<const SetResourceCommand*>(command.Data)->Resource);
+        break;
+    case COMMAND_SET_CONSTANT_BUFFER:
+    {
+        const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+        changed = Set(set.Stage, set.Slot, { set.Resource, 0, WHOLE_BUFFER });
+        break;
+    }
+    case COMMAND_SET_CONSTANT_BUFFER_RANGE:
+    {
+        const SetConstantBufferRangeCommand& set = *static_cast<const SetConstantBufferRangeCommand*>(command.Data);
+        changed = Set(set.Stage, set.Slot, { set.Buffer, set.FirstConstant, set.ConstantCount });
+        break;
+    }
+    case COMMAND_SET_SAMPLER:
+    {
+        const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+        if (set.Stage < SHADER_STAGE_COUNT && set.Slot < MAX_SAMPLER_SLOTS)
+            changed = Set(m_samplers[set.Stage][set.Slot], set.Resource);
+        break;
+    }
+    case COMMAND_SET_SHADER_RESOURCE:
+    {
+        const SetSlotCommand& set = *static_cast<const SetSlotCommand*>(command.Data);
+        if (set.Stage < SHADER_STAGE_COUNT && set.Slot < MAX_SHADER_RESOURCE_SLOTS)
+            changed = Set(m_shaderResources[set.Stage][set.Slot], set.Resource);
+        break;
+    }
+    default:
+        // not a bind
+        return true;
+    }
+
+    if (changed)
+        ++m_stats.Issued;
+    else
+        ++m_stats.Filtered;
+    return changed;
+}
+
+void RedundantStateFilter::Invalidate()
+{
+    for (uint32_t slot = 0; slot < MAX_VERTEX_BUFFER_SLOTS; ++slot)
+    {
+        m_vertexBuffers[slot] = { slot, UNKNOWN, 0, 0 };
+    }
+    m_indexBuffer = { UNKNOWN, DXGI_FORMAT_UNKNOWN, 0 };
+    m_topology = UNKNOWN;
+    m_inputLayout = UNKNOWN;
+    m_vertexShader = UNKNOWN;
+    m_pixelShader = UNKNOWN;
+    std::fill_n(&m_constantBuffers[0][0], SHADER_STAGE_COUNT * MAX_CONSTANT_BUFFER_SLOTS, ConstantBinding{ UNKNOWN, 0, 0 });
+    std::fill_n(&m_samplers[0][0], SHADER_STAGE_COUNT * MAX_SAMPLER_SLOTS, UNKNOWN);
+    std::fill_n(&m_shaderResources[0][0], SHADER_STAGE_COUNT * MAX_SHADER_RESOURCE_SLOTS, UNKNOWN);
+}
+
+const StateFilterStats& RedundantStateFilter::GetStats() const
+{
+    return m_stats;
+}
+
+void RedundantStateFilter::ResetStats()
+{
+    m_stats = {};
+}
+
+bool RedundantStateFilter::Set(uint32_t& slot, uint32_t value)
+{
+    if (slot == value)
+        return false;
+    slot = value;
+    return true;
+}
+
+bool RedundantStateFilter::Set(ShaderStage stage, uint32_t slot, const ConstantBinding& binding)
+{
+    // out of range binds fail on the context, they aren't state to remember
+    if (stage >= SHADER_STAGE_COUNT || slot >= MAX_CONSTANT_BUFFER_SLOTS)
+        return true;
+    ConstantBinding& bound = m_constantBuffers[stage][slot];
+    if (bound.Buffer == binding.Buffer && bound.FirstConstant == binding.FirstConstant
+        && bound.ConstantCount == binding.ConstantCount)
+        return false;
+    bound = binding;
+    return true;
+}
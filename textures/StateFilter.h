@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CommandList.h"
+
+namespace Render
+{
+    struct StateFilterStats
+    {
+        // binds passed on to the context, and dropped because the slot already held
+        // exactly what they set
+        size_t  Issued;
+        size_t  Filtered;
+    };
+
+    // Remembers what each bind last set and drops those that would set it again. Draws
+    // and constant updates always pass. The state is kept from one command list to the
+    // next, so anything that binds on the context behind the filter has to Invalidate it.
+    class RedundantStateFilter
+    {
+    public:
+        RedundantStateFilter();
+
+        // False for a bind that changes nothing
+        bool ShouldIssue(const Command& command);
+        // Nothing is known to be bound, every bind passes once
+        void Invalidate();
+
+        const StateFilterStats& GetStats() const;
+        void ResetStats();
+
+    private:
+        // what a slot holds when it isn't known, no resource id gets this high
+        static constexpr uint32_t UNKNOWN = NULL_RESOURCE - 1;
+
+        // A whole buffer binds as a range of WHOLE_BUFFER constants from 0
+        struct ConstantBinding
+        {
+            ResourceId  Buffer;
+            uint32_t    FirstConstant;
+            uint32_t    ConstantCount;
+        };
+        static constexpr uint32_t WHOLE_BUFFER = UINT32_MAX;
+
+        // True when value is new and is now what the slot holds
+        bool Set(uint32_t& slot, uint32_t value);
+        bool Set(ShaderStage stage, uint32_t slot, const ConstantBinding& binding);
+
+        SetVertexBufferCommand  m_vertexBuffers[MAX_VERTEX_BUFFER_SLOTS];
+        SetIndexBufferCommand   m_indexBuffer;
+        uint32_t                m_topology;
+        ResourceId              m_inputLayout;
+        ResourceId              m_vertexShader;
+        ResourceId              m_pixelShader;
+        ConstantBinding         m_constantBuffers[SHADER_STAGE_COUNT][MAX_CONSTANT_BUFFER_SLOTS];
+        ResourceId              m_samplers[SHADER_STAGE_COUNT][MAX_SAMPLER_SLOTS];
+        ResourceId              m_shaderResources[SHADER_STAGE_COUNT][MAX_SHADER_RESOURCE_SLOTS];
+        StateFilterStats        m_stats;
+    };
+}
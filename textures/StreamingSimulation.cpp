@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "StreamingSimulation.h"
+#include "MipGenerator.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr uint32_t GRID_SIZE = 8;
+	constexpr float GRID_SPACING = 4.0f;
+	constexpr float OBJECT_RADIUS = 1.0f;
+	constexpr uint32_t TEXTURE_SIZE = 512;
+	// how far in front of and behind the grid the camera turns around
+	constexpr float FLIGHT_MARGIN = 40.0f;
+}
+
+StreamingSimulationReport RunStreamingSimulation(const StreamingSettings& settings, unsigned int steps)
+{
+	StreamingSimulationReport report = {};
+	report.BudgetBytes = settings.BudgetBytes;
+
+	RecordingUploadDevice device;
+	TextureStreamer streamer(device, settings);
+
+	// One texture per object, the contents don't matter to the streamer
+	const float gridExtent = (GRID_SIZE - 1) * GRID_SPACING;
+	for (uint32_t z = 0; z < GRID_SIZE; ++z)
+	{
+		for (uint32_t x = 0; x < GRID_SIZE; ++x)
+		{
+			TextureData texture;
+			texture.Width = TEXTURE_SIZE;
+			texture.Height = TEXTURE_SIZE;
+			texture.MipLevels = GetMipLevelCount(TEXTURE_SIZE, TEXTURE_SIZE);
+			texture.Pixels.resize(GetMipOffset(TEXTURE_SIZE, TEXTURE_SIZE, texture.MipLevels));
+			report.FullChainBytes += texture.Pixels.size();
+
+			const StreamedTextureId id = streamer.AddTexture(std::move(texture));
+			streamer.AddInstance(id, XMFLOAT3(x * GRID_SPACING, 0.0f, z * GRID_SPACING), OBJECT_RADIUS);
+		}
+	}
+	report.TextureCount = streamer.GetTextureCount();
+
+	// Down the middle of the grid a little above it, out past the far end and back
+	const XMFLOAT3 gridCenter(gridExtent * 0.5f, 0.0f, gridExtent * 0.5f);
+	const float start = -FLIGHT_MARGIN;
+	const float end = gridExtent + FLIGHT_MARGIN;
+	for (unsigned int step = 0; step < steps; ++step)
+	{
+		const float t = steps > 1 ? float(step) / (steps - 1) : 0.0f;
+		const bool returning = t > 0.5f;
+		const float along = returning ? 2.0f * (1.0f - t) : 2.0f * t;
+
+		StreamingView view;
+		view.Position = XMFLOAT3(gridCenter.x, 2.0f, start + (end - start) * along);
+		view.Forward = XMFLOAT3(0.0f, 0.0f, returning ? -1.0f : 1.0f);
+		view.FovY = XM_PIDIV4;
+		view.ViewportHeight = 1080.0f;
+
+		StreamingStep result;
+		result.Distance = std::sqrt((view.Position.x - gridCenter.x) * (view.Position.x - gridCenter.x)
+			+ (view.Position.z - gridCenter.z) * (view.Position.z - gridCenter.z));
+		result.Stats = streamer.Update(view);
+		report.PeakResidentBytes = (std::max)(report.PeakResidentBytes, result.Stats.ResidentBytes);
+		report.TotalUploadedBytes += result.Stats.UploadedBytes;
+		report.Steps.push_back(result);
+	}
+	return report;
+}
+
+void PrintStreamingSimulation(const StreamingSimulationReport& report, FILE* out)
+{
+	const auto megabytes = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+	fprintf(out, "%5s %9s %11s %8s %8s %11s %8s %8s\n", "step", "distance", "resident MB", "in", "evicted", "uploaded MB", "coarser", "missing");
+	for (size_t i = 0; i < report.Steps.size(); ++i)
+	{
+		const StreamingStep& step = report.Steps[i];
+		fprintf(out, "%5zu %9.1f %11.2f %8llu %8llu %11.2f %8zu %8zu\n", i, step.Distance,
+			megabytes(step.Stats.ResidentBytes), step.Stats.LevelsStreamedIn, step.Stats.LevelsEvicted,
+			megabytes(step.Stats.UploadedBytes), step.Stats.TexturesBelowDesired, step.Stats.MissingLevels);
+	}
+	fprintf(out, "%zu textures, full chains %.2f MB, budget %.2f MB\n", report.TextureCount,
+		megabytes(report.FullChainBytes), megabytes(report.BudgetBytes));
+	fprintf(out, "peak resident %.2f MB, uploaded %.2f MB over %zu steps\n",
+		megabytes(report.PeakResidentBytes), megabytes(report.TotalUploadedBytes), report.Steps.size());
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "TextureStreamer.h"
+
+#include <cstdio>
+#include <vector>
+
+struct StreamingStep
+{
+	float			Distance;
+	StreamingStats	Stats;
+};
+
+struct StreamingSimulationReport
+{
+	size_t						TextureCount;
+	uint64_t					BudgetBytes;
+	// every level of every texture, what loading them whole would take
+	uint64_t					FullChainBytes;
+	uint64_t					PeakResidentBytes;
+	uint64_t					TotalUploadedBytes;
+	std::vector<StreamingStep>	Steps;
+};
+
+// Flies a camera over a grid of textured objects without a GPU: from far in front down
+// the grid, out past its far end and back the same way, updating a TextureStreamer on
+// a recording device every step. With a budget below the full chains levels get
+// evicted on the way.
+StreamingSimulationReport RunStreamingSimulation(const StreamingSettings& settings, unsigned int steps = 120);
+
+void PrintStreamingSimulation(const StreamingSimulationReport& report, FILE* out);
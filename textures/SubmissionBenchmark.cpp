@@ -0,0 +1,277 @@
+#include "pch.h"
+#include "SubmissionBenchmark.h"
+#include "Renderer.h"
+
+#include <chrono>
+#include <random>
+
+using namespace Render;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	constexpr uint32_t CUBE_VERTICES = 24;
+	constexpr uint32_t CUBE_INDICES = 36;
+	// one draw in this many has 32-bit indices, the index buffer switches around it
+	constexpr size_t WIDE_DRAW_INTERVAL = 64;
+	// one draw in this many is transparent
+	constexpr size_t TRANSPARENT_DRAW_INTERVAL = 8;
+	constexpr uint32_t SHADER_COUNT = 4;
+	constexpr uint32_t MATERIAL_COUNT = 64;
+	constexpr uint32_t TEXTURE_COUNT = 32;
+	constexpr float MAX_DRAW_DEPTH = 1000.0f;
+
+	// rocks and trees, each of a few materials, scattered over a square
+	struct InstancedModel
+	{
+		uint32_t	Vertices;
+		uint32_t	Indices;
+		uint32_t	Materials;
+	};
+	const InstancedModel INSTANCED_MODELS[] = { { 300, 1500, 4 }, { 1200, 6000, 4 } };
+	constexpr float INSTANCE_FIELD_SIZE = 2000.0f;
+
+	size_t CountBinds(const CommandList& commands)
+	{
+		size_t binds = 0;
+		Command command;
+		for (size_t offset = 0; commands.Read(offset, command);)
+		{
+			if (command.Type < COMMAND_UPDATE_CONSTANTS)
+				++binds;
+		}
+		return binds;
+	}
+}
+
+SubmissionBenchmarkReport BenchmarkSubmission(size_t drawsPerFrame, unsigned int frames)
+{
+	SubmissionBenchmarkReport report = {};
+	report.DrawsPerFrame = drawsPerFrame;
+	report.Frames = frames;
+
+	CommandRecorder recorder;
+	SceneBindings bindings;
+	bindings.InputLayout = recorder.AddInputLayout();
+	bindings.SceneConstants = recorder.AddBuffer(sizeof(SceneParams), D3D11_BIND_CONSTANT_BUFFER);
+	bindings.LightingConstants = recorder.AddBuffer(sizeof(LightingParams), D3D11_BIND_CONSTANT_BUFFER);
+	std::vector<ResourceId> vertexShaders;
+	std::vector<ResourceId> pixelShaders;
+	for (uint32_t i = 0; i < SHADER_COUNT; ++i)
+	{
+		vertexShaders.push_back(recorder.AddVertexShader());
+		pixelShaders.push_back(recorder.AddPixelShader());
+	}
+	const ResourceId sampler = recorder.AddSampler();
+	std::vector<ResourceId> textures;
+	for (uint32_t i = 0; i < TEXTURE_COUNT; ++i)
+	{
+		textures.push_back(recorder.AddShaderResource());
+	}
+
+	// The scene as the renderer would lay it out, every draw a range of its own
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> depths(0.0f, MAX_DRAW_DEPTH);
+	std::vector<DrawPacket> draws;
+	uint32_t indices16 = 0;
+	uint32_t indices32 = 0;
+	for (size_t i = 0; i < drawsPerFrame; ++i)
+	{
+		const bool wide = i % WIDE_DRAW_INTERVAL == WIDE_DRAW_INTERVAL - 1;
+		uint32_t& start = wide ? indices32 : indices16;
+		const uint32_t shader = random() % SHADER_COUNT;
+
+		DrawPacket draw;
+		draw.Range = { wide ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT, start, CUBE_INDICES,
+			static_cast<uint32_t>(i) * CUBE_VERTICES };
+		draw.VertexShader = vertexShaders[shader];
+		draw.PixelShader = pixelShaders[shader];
+		draw.Sampler = sampler;
+		draw.Texture = textures[random() % TEXTURE_COUNT];
+		draw.Material = random() % MATERIAL_COUNT;
+		draw.Pass = i % TRANSPARENT_DRAW_INTERVAL == 0 ? DRAW_PASS_TRANSPARENT : DRAW_PASS_OPAQUE;
+		draw.Depth = depths(random);
+		draws.push_back(draw);
+		start += CUBE_INDICES;
+	}
+	bindings.VertexBuffer = recorder.AddBuffer(static_cast<uint32_t>(drawsPerFrame * CUBE_VERTICES * sizeof(Vertex)), D3D11_BIND_VERTEX_BUFFER);
+	bindings.IndexBuffer16 = recorder.AddBuffer(indices16 * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER);
+	bindings.IndexBuffer32 = recorder.AddBuffer(indices32 * sizeof(uint32_t), D3D11_BIND_INDEX_BUFFER);
+
+	const SceneParams sceneParams = {};
+	const LightingParams lightingParams;
+	CommandList commands;
+
+	// the draws in the order they were made, as the renderer submitted them before sorting
+	DrawBucket bucket;
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		bucket.Add(0, static_cast<uint32_t>(i));
+	}
+	RecordScene(commands, bindings, sceneParams, lightingParams, draws, bucket, nullptr, nullptr);
+	report.UnsortedBinds = CountBinds(commands);
+
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		Clock::time_point start = Clock::now();
+		SortDraws(draws, bucket);
+		report.SortMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		commands.Reset();
+		RecordScene(commands, bindings, sceneParams, lightingParams, draws, bucket, nullptr, nullptr);
+		report.RecordMs += MillisecondsSince(start);
+
+		recorder.ResetCounts();
+		start = Clock::now();
+		recorder.Execute(commands);
+		report.ReplayMs += MillisecondsSince(start);
+	}
+	report.SortedBinds = CountBinds(commands);
+
+	if (frames > 0)
+	{
+		report.SortMs /= frames;
+		report.RecordMs /= frames;
+		report.ReplayMs /= frames;
+	}
+	report.Commands = commands.GetCommandCount();
+	report.CommandBytes = commands.GetSizeInBytes();
+	report.Counts = recorder.GetCounts();
+	report.Errors = recorder.GetErrors();
+	return report;
+}
+
+InstancingBenchmarkReport BenchmarkInstancing(size_t instanceCount, unsigned int frames)
+{
+	InstancingBenchmarkReport report = {};
+	report.Instances = instanceCount;
+	report.Frames = frames;
+
+	CommandRecorder recorder;
+	SceneBindings bindings;
+	bindings.InputLayout = recorder.AddInputLayout();
+	bindings.SceneConstants = recorder.AddBuffer(sizeof(SceneParams), D3D11_BIND_CONSTANT_BUFFER);
+	bindings.LightingConstants = recorder.AddBuffer(sizeof(LightingParams), D3D11_BIND_CONSTANT_BUFFER);
+	bindings.InstanceBuffer = recorder.AddBuffer(MAX_INSTANCES * sizeof(InstanceData), D3D11_BIND_VERTEX_BUFFER);
+	const ResourceId vertexShader = recorder.AddVertexShader();
+	const ResourceId pixelShader = recorder.AddPixelShader();
+	const ResourceId sampler = recorder.AddSampler();
+
+	// a draw per model as Renderer::Init makes them, all indices 16-bit
+	std::vector<DrawPacket> modelDraws;
+	std::vector<uint32_t> modelFirstDraw(1, 0);
+	uint32_t vertices = 0;
+	uint32_t indices = 0;
+	for (const InstancedModel& model : INSTANCED_MODELS)
+	{
+		DrawPacket draw;
+		draw.Range = { DXGI_FORMAT_R16_UINT, indices, model.Indices, vertices };
+		draw.VertexShader = vertexShader;
+		draw.PixelShader = pixelShader;
+		draw.Sampler = sampler;
+		draw.Texture = recorder.AddShaderResource();
+		modelDraws.push_back(draw);
+		modelFirstDraw.push_back(static_cast<uint32_t>(modelDraws.size()));
+		vertices += model.Vertices;
+		indices += model.Indices;
+	}
+	bindings.VertexBuffer = recorder.AddBuffer(vertices * sizeof(Vertex), D3D11_BIND_VERTEX_BUFFER);
+	bindings.IndexBuffer16 = recorder.AddBuffer(indices * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> positions(-0.5f * INSTANCE_FIELD_SIZE, 0.5f * INSTANCE_FIELD_SIZE);
+	std::uniform_real_distribution<float> angles(0.0f, XM_2PI);
+	std::vector<MeshInstance> instances(instanceCount);
+	for (MeshInstance& instance : instances)
+	{
+		instance.Model = random() % _countof(INSTANCED_MODELS);
+		instance.Material = random() % INSTANCED_MODELS[instance.Model].Materials;
+		XMStoreFloat4x4(&instance.World, XMMatrixRotationY(angles(random)) * XMMatrixTranslation(positions(random), 0.0f, positions(random)));
+		instance.Tint = 0xFF000000 | (random() & 0xFFFFFF);
+	}
+	size_t drawsBefore = 0;
+	for (const MeshInstance& instance : instances)
+	{
+		drawsBefore += modelFirstDraw[instance.Model + 1] - modelFirstDraw[instance.Model];
+	}
+	report.DrawsBefore = drawsBefore;
+
+	// every instance moves every frame, so all of them are batched and uploaded again
+	const SceneParams sceneParams = {};
+	const LightingParams lightingParams;
+	DrawBucket scratch;
+	DrawBucket bucket;
+	std::vector<InstanceData> instanceData;
+	std::vector<DrawPacket> draws;
+	CommandList commands;
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		Clock::time_point start = Clock::now();
+		BatchInstances(instances, modelDraws, modelFirstDraw, scratch, instanceData, draws);
+		SortDraws(draws, bucket);
+		report.BatchMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		commands.Reset();
+		RecordScene(commands, bindings, sceneParams, lightingParams, draws, bucket, &instanceData, nullptr);
+		report.RecordMs += MillisecondsSince(start);
+
+		recorder.ResetCounts();
+		start = Clock::now();
+		recorder.Execute(commands);
+		report.ReplayMs += MillisecondsSince(start);
+	}
+
+	if (frames > 0)
+	{
+		report.BatchMs /= frames;
+		report.RecordMs /= frames;
+		report.ReplayMs /= frames;
+	}
+	report.Commands = commands.GetCommandCount();
+	report.Counts = recorder.GetCounts();
+	report.Errors = recorder.GetErrors();
+	return report;
+}
+
+void PrintSubmissionBenchmark(const SubmissionBenchmarkReport& report, FILE* out)
+{
+	const CommandCounts& counts = report.Counts;
+	fprintf(out, "%zu draws per frame, %u frames\n", report.DrawsPerFrame, report.Frames);
+	fprintf(out, "per frame: %zu commands in %.1f KB, %zu draws, %zu indices, %zu constant bytes\n",
+		report.Commands, report.CommandBytes / 1024.0, counts.Draws, counts.Indices, counts.ConstantBytes);
+	fprintf(out, "binds: %zu in draw order, %zu sorted (%.1f%% fewer); %zu issued, %zu filtered as redundant\n",
+		report.UnsortedBinds, report.SortedBinds,
+		report.UnsortedBinds > 0 ? 100.0 * (1.0 - static_cast<double>(report.SortedBinds) / report.UnsortedBinds) : 0.0,
+		counts.Binds.Issued, counts.Binds.Filtered);
+	fprintf(out, "sort %.3f ms per frame, %.3f ms per 100k draws\n", report.SortMs,
+		report.DrawsPerFrame > 0 ? report.SortMs * 100000.0 / report.DrawsPerFrame : 0.0);
+	fprintf(out, "record %.3f ms, replay %.3f ms per frame, %.1f ns per draw\n", report.RecordMs, report.ReplayMs,
+		report.DrawsPerFrame > 0 ? (report.SortMs + report.RecordMs + report.ReplayMs) * 1e6 / report.DrawsPerFrame : 0.0);
+	fprintf(out, "%zu validation errors\n", counts.Errors);
+	for (const std::string& error : report.Errors)
+	{
+		fprintf(out, "  %s\n", error.c_str());
+	}
+}
+
+void PrintInstancingBenchmark(const InstancingBenchmarkReport& report, FILE* out)
+{
+	const CommandCounts& counts = report.Counts;
+	fprintf(out, "%zu instances of %zu models, %u frames\n", report.Instances, _countof(INSTANCED_MODELS), report.Frames);
+	fprintf(out, "per frame: %zu draws instead of %zu, %zu instances, %zu commands, %.1f MB of instances uploaded\n",
+		counts.Draws, report.DrawsBefore, counts.Instances, report.Commands, counts.UploadBytes / (1024.0 * 1024.0));
+	fprintf(out, "batch and sort %.3f ms, record %.3f ms, replay %.3f ms per frame\n", report.BatchMs, report.RecordMs, report.ReplayMs);
+	fprintf(out, "%zu validation errors\n", counts.Errors);
+	for (const std::string& error : report.Errors)
+	{
+		fprintf(out, "  %s\n", error.c_str());
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "CommandRecorder.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct SubmissionBenchmarkReport
+{
+	size_t						DrawsPerFrame;
+	unsigned int				Frames;
+	// of one frame
+	size_t						Commands;
+	size_t						CommandBytes;
+	Render::CommandCounts		Counts;
+	// bind commands of a frame recorded in the order the draws were made, and sorted
+	size_t						UnsortedBinds;
+	size_t						SortedBinds;
+	// average per frame: Render::SortDraws, Render::RecordScene into a reset command
+	// list, and replaying that on the recording backend
+	double						SortMs;
+	double						RecordMs;
+	double						ReplayMs;
+	std::vector<std::string>	Errors;
+};
+
+// Submits a scene of drawsPerFrame cube sized draws frames times without a device: the
+// renderer sorts and records each frame and the headless CommandRecorder validates and
+// counts it. The draws spread over a few shaders, many materials and textures, some of
+// them transparent, at random depths.
+SubmissionBenchmarkReport BenchmarkSubmission(size_t drawsPerFrame = 100000, unsigned int frames = 100);
+
+void PrintSubmissionBenchmark(const SubmissionBenchmarkReport& report, FILE* out);
+
+struct InstancingBenchmarkReport
+{
+	size_t						Instances;
+	unsigned int				Frames;
+	// one per instance and index range of its model, as without instancing
+	size_t						DrawsBefore;
+	// of one frame
+	size_t						Commands;
+	Render::CommandCounts		Counts;
+	// average per frame: Render::BatchInstances with Render::SortDraws, Render::RecordScene
+	// with the upload of every instance, and replaying that on the recording backend
+	double						BatchMs;
+	double						RecordMs;
+	double						ReplayMs;
+	std::vector<std::string>	Errors;
+};
+
+// Scatters instanceCount rocks and trees of a few materials each and submits them frames
+// times without a device, batching and uploading all instances every frame as if they
+// all moved
+InstancingBenchmarkReport BenchmarkInstancing(size_t instanceCount = 100000, unsigned int frames = 100);
+
+void PrintInstancingBenchmark(const InstancingBenchmarkReport& report, FILE* out);
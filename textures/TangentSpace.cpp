@@ -0,0 +1,439 @@
+#include "pch.h"
+#include "TangentSpace.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+	// triangles that share one vertex index bound
+	constexpr size_t TANGENT_BLOCK_TRIANGLES = 4096;
+	// smaller vertex ranges are not worth a task of their own
+	constexpr size_t MIN_SLICE_VERTICES = 4096;
+	// a few ranges per thread even out meshes whose triangles are not spread evenly
+	constexpr size_t SLICES_PER_THREAD = 2;
+
+	struct Vec3
+	{
+		float X, Y, Z;
+	};
+
+	Vec3 Add(const Vec3& a, const Vec3& b)
+	{
+		return { a.X + b.X, a.Y + b.Y, a.Z + b.Z };
+	}
+
+	Vec3 Sub(const Vec3& a, const Vec3& b)
+	{
+		return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	}
+
+	Vec3 Scale(const Vec3& a, float s)
+	{
+		return { a.X * s, a.Y * s, a.Z * s };
+	}
+
+	Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	float Dot(const Vec3& a, const Vec3& b)
+	{
+		return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+	}
+
+	// Zero stays zero
+	Vec3 Normalize(const Vec3& a)
+	{
+		const float length = std::sqrt(Dot(a, a));
+		return length > 0.0f ? Scale(a, 1.0f / length) : a;
+	}
+
+	// a with its component along the unit vector n removed
+	Vec3 ProjectOnPlane(const Vec3& a, const Vec3& n)
+	{
+		return Sub(a, Scale(n, Dot(n, a)));
+	}
+
+	float AngleBetween(const Vec3& a, const Vec3& b)
+	{
+		const float lengths = std::sqrt(Dot(a, a) * Dot(b, b));
+		if (lengths == 0.0f)
+			return 0.0f;
+		return std::acos((std::max)(-1.0f, (std::min)(1.0f, Dot(a, b) / lengths)));
+	}
+
+	Vec3 ToVec3(const Position& p)
+	{
+		return { p.X, p.Y, p.Z };
+	}
+
+	Vec3 ToVec3(const Normal& n)
+	{
+		return { n.X, n.Y, n.Z };
+	}
+
+	// Both the parallel and the reference path go through these, so every vertex sums
+	// the same values in the same order
+
+	void NormalContributions(const std::vector<Position>& positions, const Face& face, NormalWeighting weighting, Vec3 out[3])
+	{
+		const Vec3 p0 = ToVec3(positions[face.X]);
+		const Vec3 p1 = ToVec3(positions[face.Y]);
+		const Vec3 p2 = ToVec3(positions[face.Z]);
+		// the cross product length is twice the triangle area, which gives the area weighting
+		const Vec3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+		if (weighting == NORMAL_WEIGHT_AREA)
+		{
+			out[0] = out[1] = out[2] = n;
+			return;
+		}
+
+		const Vec3 unit = Normalize(n);
+		out[0] = Scale(unit, AngleBetween(Sub(p1, p0), Sub(p2, p0)));
+		out[1] = Scale(unit, AngleBetween(Sub(p2, p1), Sub(p0, p1)));
+		out[2] = Scale(unit, AngleBetween(Sub(p0, p2), Sub(p1, p2)));
+	}
+
+	Normal FinishNormal(const Vec3& sum)
+	{
+		const float length = std::sqrt(Dot(sum, sum));
+		return length > 0.0f ? Normal{ sum.X / length, sum.Y / length, sum.Z / length } : Normal{ 0.0f, 1.0f, 0.0f };
+	}
+
+	// MikkTSpace per corner terms: the face tangent and bitangent projected on the tangent
+	// plane of the vertex normal, weighted by the corner angle on that plane
+	void TangentContributions(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+		const std::vector<TextCoord>& textCoords, const Face& face, Vec3 tangents[3], Vec3 bitangents[3])
+	{
+		const unsigned int corners[3] = { face.X, face.Y, face.Z };
+		const Vec3 p[3] = { ToVec3(positions[face.X]), ToVec3(positions[face.Y]), ToVec3(positions[face.Z]) };
+		const Vec3 d1 = Sub(p[1], p[0]);
+		const Vec3 d2 = Sub(p[2], p[0]);
+		const float t21x = textCoords[face.Y].X - textCoords[face.X].X;
+		const float t21y = textCoords[face.Y].Y - textCoords[face.X].Y;
+		const float t31x = textCoords[face.Z].X - textCoords[face.X].X;
+		const float t31y = textCoords[face.Z].Y - textCoords[face.X].Y;
+
+		// dP/du and dP/dv times the signed UV area, the sign turns them the right way
+		// round for mirrored UVs
+		const float signedArea = t21x * t31y - t21y * t31x;
+		if (signedArea == 0.0f)
+		{
+			for (int k = 0; k < 3; ++k)
+				tangents[k] = bitangents[k] = { 0.0f, 0.0f, 0.0f };
+			return;
+		}
+		const float sign = signedArea > 0.0f ? 1.0f : -1.0f;
+		const Vec3 faceTangent = Normalize(Scale(Sub(Scale(d1, t31y), Scale(d2, t21y)), sign));
+		const Vec3 faceBitangent = Normalize(Scale(Sub(Scale(d2, t21x), Scale(d1, t31x)), sign));
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const Vec3 n = ToVec3(normals[corners[k]]);
+			const Vec3 toNext = ProjectOnPlane(Sub(p[(k + 1) % 3], p[k]), n);
+			const Vec3 toPrev = ProjectOnPlane(Sub(p[(k + 2) % 3], p[k]), n);
+			const float angle = AngleBetween(toNext, toPrev);
+			tangents[k] = Scale(Normalize(ProjectOnPlane(faceTangent, n)), angle);
+			bitangents[k] = Scale(Normalize(ProjectOnPlane(faceBitangent, n)), angle);
+		}
+	}
+
+	Tangent FinishTangent(const Normal& normal, const Vec3& tangentSum, const Vec3& bitangentSum)
+	{
+		const Vec3 n = ToVec3(normal);
+		Vec3 t = Normalize(tangentSum);
+		if (Dot(t, t) == 0.0f)
+		{
+			// no UV gradient, any direction in the tangent plane will do
+			const Vec3 axis = std::fabs(n.X) < 0.9f ? Vec3{ 1.0f, 0.0f, 0.0f } : Vec3{ 0.0f, 1.0f, 0.0f };
+			t = Normalize(ProjectOnPlane(axis, n));
+		}
+		const float w = Dot(Cross(n, t), bitangentSum) < 0.0f ? -1.0f : 1.0f;
+		return { t.X, t.Y, t.Z, w };
+	}
+
+	struct BlockBounds
+	{
+		unsigned int	First;
+		unsigned int	Last;
+	};
+
+	// Lowest and highest vertex of every block of triangles. Vertex fetch optimized
+	// meshes use narrow ranges, so a vertex range only visits a few blocks.
+	std::vector<BlockBounds> ComputeBlockBounds(const std::vector<Face>& faces, unsigned int numThreads)
+	{
+		std::vector<BlockBounds> bounds((faces.size() + TANGENT_BLOCK_TRIANGLES - 1) / TANGENT_BLOCK_TRIANGLES);
+		RunParallel(bounds.size(), numThreads, [&](size_t b)
+		{
+			const size_t end = (std::min)(faces.size(), (b + 1) * TANGENT_BLOCK_TRIANGLES);
+			BlockBounds range = { ~0u, 0 };
+			for (size_t t = b * TANGENT_BLOCK_TRIANGLES; t < end; ++t)
+			{
+				const Face& f = faces[t];
+				range.First = (std::min)(range.First, (std::min)(f.X, (std::min)(f.Y, f.Z)));
+				range.Last = (std::max)(range.Last, (std::max)(f.X, (std::max)(f.Y, f.Z)));
+			}
+			bounds[b] = range;
+		});
+		return bounds;
+	}
+
+	// Splits the vertices in ranges and runs sliceFn(first, last) for each of them in
+	// parallel. The ranges only decide who sums which vertex, not the order of the sums.
+	template <typename SliceFn>
+	void ForEachVertexSlice(size_t numVertices, unsigned int numThreads, SliceFn&& sliceFn)
+	{
+		const size_t maxSlices = (numVertices + MIN_SLICE_VERTICES - 1) / MIN_SLICE_VERTICES;
+		const size_t numSlices = (std::max<size_t>)(1, (std::min)(maxSlices, numThreads * SLICES_PER_THREAD));
+		const size_t sliceSize = (numVertices + numSlices - 1) / numSlices;
+		RunParallel(numSlices, numThreads, [&](size_t s)
+		{
+			const size_t first = s * sliceSize;
+			sliceFn(first, (std::min)(numVertices, first + sliceSize));
+		});
+	}
+
+	// Calls fn(t) for the triangles with a corner in [first, last), in triangle order
+	template <typename TriangleFn>
+	void ForEachTriangleInSlice(const std::vector<Face>& faces, const std::vector<BlockBounds>& bounds,
+		size_t first, size_t last, TriangleFn&& fn)
+	{
+		const size_t count = last - first;
+		for (size_t b = 0; b < bounds.size(); ++b)
+		{
+			if (bounds[b].Last < first || bounds[b].First >= last)
+				continue;
+
+			const size_t end = (std::min)(faces.size(), (b + 1) * TANGENT_BLOCK_TRIANGLES);
+			for (size_t t = b * TANGENT_BLOCK_TRIANGLES; t < end; ++t)
+			{
+				const Face& f = faces[t];
+				if (f.X - first < count || f.Y - first < count || f.Z - first < count)
+					fn(t);
+			}
+		}
+	}
+}
+
+void ComputeNormals(const std::vector<Position>& positions, const std::vector<Face>& faces,
+	NormalWeighting weighting, std::vector<Normal>& normals, unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = DefaultThreadCount();
+
+	normals.resize(positions.size());
+	const std::vector<BlockBounds> bounds = ComputeBlockBounds(faces, numThreads);
+	ForEachVertexSlice(positions.size(), numThreads, [&](size_t first, size_t last)
+	{
+		// every thread sums into its own range only, no atomics and no merge step
+		const size_t count = last - first;
+		std::vector<Vec3> sums(count, Vec3{ 0.0f, 0.0f, 0.0f });
+		ForEachTriangleInSlice(faces, bounds, first, last, [&](size_t t)
+		{
+			const Face& f = faces[t];
+			const unsigned int corners[3] = { f.X, f.Y, f.Z };
+			Vec3 contributions[3];
+			NormalContributions(positions, f, weighting, contributions);
+			for (int k = 0; k < 3; ++k)
+			{
+				if (corners[k] - first < count)
+					sums[corners[k] - first] = Add(sums[corners[k] - first], contributions[k]);
+			}
+		});
+
+		for (size_t v = 0; v < count; ++v)
+			normals[first + v] = FinishNormal(sums[v]);
+	});
+}
+
+void ComputeTangents(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+	const std::vector<TextCoord>& textCoords, const std::vector<Face>& faces,
+	std::vector<Tangent>& tangents, unsigned int numThreads)
+{
+	assert(normals.size() == positions.size() && textCoords.size() == positions.size());
+	if (numThreads == 0)
+		numThreads = DefaultThreadCount();
+
+	tangents.resize(positions.size());
+	const std::vector<BlockBounds> bounds = ComputeBlockBounds(faces, numThreads);
+	ForEachVertexSlice(positions.size(), numThreads, [&](size_t first, size_t last)
+	{
+		const size_t count = last - first;
+		std::vector<Vec3> tangentSums(count, Vec3{ 0.0f, 0.0f, 0.0f });
+		std::vector<Vec3> bitangentSums(count, Vec3{ 0.0f, 0.0f, 0.0f });
+		ForEachTriangleInSlice(faces, bounds, first, last, [&](size_t t)
+		{
+			const Face& f = faces[t];
+			const unsigned int corners[3] = { f.X, f.Y, f.Z };
+			Vec3 faceTangents[3];
+			Vec3 faceBitangents[3];
+			TangentContributions(positions, normals, textCoords, f, faceTangents, faceBitangents);
+			for (int k = 0; k < 3; ++k)
+			{
+				const size_t v = corners[k] - first;
+				if (v < count)
+				{
+					tangentSums[v] = Add(tangentSums[v], faceTangents[k]);
+					bitangentSums[v] = Add(bitangentSums[v], faceBitangents[k]);
+				}
+			}
+		});
+
+		for (size_t v = 0; v < count; ++v)
+			tangents[first + v] = FinishTangent(normals[first + v], tangentSums[v], bitangentSums[v]);
+	});
+}
+
+void ComputeNormalsReference(const std::vector<Position>& positions, const std::vector<Face>& faces,
+	NormalWeighting weighting, std::vector<Normal>& normals)
+{
+	std::vector<Vec3> sums(positions.size(), Vec3{ 0.0f, 0.0f, 0.0f });
+	for (const Face& f : faces)
+	{
+		Vec3 contributions[3];
+		NormalContributions(positions, f, weighting, contributions);
+		sums[f.X] = Add(sums[f.X], contributions[0]);
+		sums[f.Y] = Add(sums[f.Y], contributions[1]);
+		sums[f.Z] = Add(sums[f.Z], contributions[2]);
+	}
+
+	normals.resize(positions.size());
+	for (size_t v = 0; v < positions.size(); ++v)
+		normals[v] = FinishNormal(sums[v]);
+}
+
+void ComputeTangentsReference(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+	const std::vector<TextCoord>& textCoords, const std::vector<Face>& faces, std::vector<Tangent>& tangents)
+{
+	std::vector<Vec3> tangentSums(positions.size(), Vec3{ 0.0f, 0.0f, 0.0f });
+	std::vector<Vec3> bitangentSums(positions.size(), Vec3{ 0.0f, 0.0f, 0.0f });
+	for (const Face& f : faces)
+	{
+		const unsigned int corners[3] = { f.X, f.Y, f.Z };
+		Vec3 faceTangents[3];
+		Vec3 faceBitangents[3];
+		TangentContributions(positions, normals, textCoords, f, faceTangents, faceBitangents);
+		for (int k = 0; k < 3; ++k)
+		{
+			tangentSums[corners[k]] = Add(tangentSums[corners[k]], faceTangents[k]);
+			bitangentSums[corners[k]] = Add(bitangentSums[corners[k]], faceBitangents[k]);
+		}
+	}
+
+	tangents.resize(positions.size());
+	for (size_t v = 0; v < positions.size(); ++v)
+		tangents[v] = FinishTangent(normals[v], tangentSums[v], bitangentSums[v]);
+}
+
+TangentSpaceCheckReport CheckTangentSpace(unsigned int gridSize)
+{
+	constexpr int TIMED_RUNS = 3;
+	using Clock = std::chrono::steady_clock;
+
+	// Best of a few runs of fn in milliseconds
+	const auto bestOf = [](auto&& fn)
+	{
+		double best = 0.0;
+		for (int i = 0; i < TIMED_RUNS; ++i)
+		{
+			const Clock::time_point start = Clock::now();
+			fn();
+			const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (i == 0 || ms < best)
+				best = ms;
+		}
+		return best;
+	};
+
+	const size_t side = gridSize + 1;
+	std::vector<Position> positions(side * side);
+	std::vector<TextCoord> textCoords(side * side);
+	for (size_t y = 0; y < side; ++y)
+	{
+		for (size_t x = 0; x < side; ++x)
+		{
+			const float u = static_cast<float>(x) / gridSize;
+			const float v = static_cast<float>(y) / gridSize;
+			positions[y * side + x] = { u, v, 0.05f * std::sin(u * 40.0f) * std::cos(v * 30.0f) };
+			textCoords[y * side + x] = { 1.0f - std::fabs(2.0f * u - 1.0f), v };
+		}
+	}
+	std::vector<Face> faces;
+	faces.reserve(2 * static_cast<size_t>(gridSize) * gridSize);
+	for (size_t y = 0; y < gridSize; ++y)
+	{
+		for (size_t x = 0; x < gridSize; ++x)
+		{
+			const unsigned int a = static_cast<unsigned int>(y * side + x);
+			const unsigned int c = static_cast<unsigned int>(a + side);
+			faces.push_back(Face(a, a + 1, c));
+			faces.push_back(Face(a + 1, c + 1, c));
+		}
+	}
+
+	TangentSpaceCheckReport report = {};
+	report.NumVertices = positions.size();
+	report.NumTriangles = faces.size();
+
+	std::vector<unsigned int> threadCounts = { 1, 3, DefaultThreadCount() };
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	for (int shuffled = 0; shuffled < 2; ++shuffled)
+	{
+		if (shuffled)
+			std::shuffle(faces.begin(), faces.end(), std::mt19937(12345));
+
+		// The summation order follows the triangle order, so every order has its own reference
+		std::vector<Normal> areaNormals;
+		std::vector<Normal> angleNormals;
+		std::vector<Tangent> tangents;
+		TangentSpaceRun reference = { shuffled != 0, 0 };
+		reference.AreaNormalsMs = bestOf([&]() { ComputeNormalsReference(positions, faces, NORMAL_WEIGHT_AREA, areaNormals); });
+		reference.AngleNormalsMs = bestOf([&]() { ComputeNormalsReference(positions, faces, NORMAL_WEIGHT_ANGLE, angleNormals); });
+		reference.TangentsMs = bestOf([&]() { ComputeTangentsReference(positions, angleNormals, textCoords, faces, tangents); });
+		reference.Identical = true;
+		report.Runs.push_back(reference);
+
+		for (unsigned int numThreads : threadCounts)
+		{
+			std::vector<Normal> normals;
+			std::vector<Tangent> parallelTangents;
+			TangentSpaceRun run = { shuffled != 0, numThreads };
+			run.AreaNormalsMs = bestOf([&]() { ComputeNormals(positions, faces, NORMAL_WEIGHT_AREA, normals, numThreads); });
+			run.Identical = memcmp(normals.data(), areaNormals.data(), normals.size() * sizeof(Normal)) == 0;
+			run.AngleNormalsMs = bestOf([&]() { ComputeNormals(positions, faces, NORMAL_WEIGHT_ANGLE, normals, numThreads); });
+			run.Identical &= memcmp(normals.data(), angleNormals.data(), normals.size() * sizeof(Normal)) == 0;
+			run.TangentsMs = bestOf([&]() { ComputeTangents(positions, angleNormals, textCoords, faces, parallelTangents, numThreads); });
+			run.Identical &= memcmp(parallelTangents.data(), tangents.data(), tangents.size() * sizeof(Tangent)) == 0;
+			report.Runs.push_back(run);
+		}
+	}
+	return report;
+}
+
+void PrintTangentSpaceCheck(const TangentSpaceCheckReport& report, FILE* out)
+{
+	fprintf(out, "%zu vertices, %zu triangles, M triangles/s\n", report.NumVertices, report.NumTriangles);
+	fprintf(out, "%-10s %9s %12s %12s %12s  %s\n", "order", "threads", "area", "angle", "tangents", "result");
+	const auto rate = [&](double ms) { return ms > 0.0 ? report.NumTriangles / ms / 1000.0 : 0.0; };
+	size_t different = 0;
+	for (const TangentSpaceRun& run : report.Runs)
+	{
+		char threads[16] = "reference";
+		if (run.NumThreads > 0)
+			sprintf_s(threads, "%u", run.NumThreads);
+		fprintf(out, "%-10s %9s %12.1f %12.1f %12.1f  %s\n", run.Shuffled ? "shuffled" : "rows", threads,
+			rate(run.AreaNormalsMs), rate(run.AngleNormalsMs), rate(run.TangentsMs),
+			run.Identical ? "identical" : "DIFFERENT");
+		if (!run.Identical)
+			++different;
+	}
+	if (different == 0)
+		fprintf(out, "all runs bit identical to the references\n");
+	else
+		fprintf(out, "%zu runs differ from the references\n", different);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdio>
+#include <vector>
+
+// xyz along increasing U, w is the handedness: bitangent = W * cross(normal, tangent)
+struct Tangent
+{
+	float X;
+	float Y;
+	float Z;
+	float W;
+};
+
+enum NormalWeighting
+{
+	// by triangle area, cheapest, large triangles dominate
+	NORMAL_WEIGHT_AREA,
+	// by the angle at the corner, independent of how a surface is triangulated
+	NORMAL_WEIGHT_ANGLE
+};
+
+// Smooth vertex normals from the faces. Vertices no face uses get (0, 1, 0).
+// Triangles are read in blocks in parallel and every thread sums the corners of its
+// own vertex range in triangle order, so the result does not depend on numThreads and
+// is bit identical to ComputeNormalsReference. numThreads 0 picks the core count.
+void ComputeNormals(const std::vector<Position>& positions, const std::vector<Face>& faces,
+	NormalWeighting weighting, std::vector<Normal>& normals, unsigned int numThreads = 0);
+
+// Per vertex tangents following MikkTSpace: the UV gradient of every face is projected
+// onto the tangent plane of the vertex normal and summed with angle weights, and the
+// sign comes from the summed bitangents. Gives the same basis as MikkTSpace as long as
+// vertices are already split at UV seams and mirrored UVs, like the welded OBJ and
+// Assimp output. Vertices without usable UVs get a tangent perpendicular to the normal.
+void ComputeTangents(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+	const std::vector<TextCoord>& textCoords, const std::vector<Face>& faces,
+	std::vector<Tangent>& tangents, unsigned int numThreads = 0);
+
+// Single threaded scalar versions that scatter every triangle into its vertices
+void ComputeNormalsReference(const std::vector<Position>& positions, const std::vector<Face>& faces,
+	NormalWeighting weighting, std::vector<Normal>& normals);
+void ComputeTangentsReference(const std::vector<Position>& positions, const std::vector<Normal>& normals,
+	const std::vector<TextCoord>& textCoords, const std::vector<Face>& faces, std::vector<Tangent>& tangents);
+
+struct TangentSpaceRun
+{
+	bool			Shuffled;	// triangles in random order instead of row by row
+	unsigned int	NumThreads;	// 0 for the references
+	double			AreaNormalsMs;
+	double			AngleNormalsMs;
+	double			TangentsMs;
+	// every output bit equals the reference of the same triangle order
+	bool			Identical;
+};
+
+struct TangentSpaceCheckReport
+{
+	size_t							NumVertices;
+	size_t							NumTriangles;
+	std::vector<TangentSpaceRun>	Runs;
+};
+
+// Builds a wavy grid of gridSize quads a side with UVs mirrored in the middle, and runs
+// both normal weightings and the tangents against the references, with the triangles row
+// by row and shuffled, on 1 and 3 threads and on every core. Times are the best of a few
+// runs.
+TangentSpaceCheckReport CheckTangentSpace(unsigned int gridSize = 1000);
+
+void PrintTangentSpaceCheck(const TangentSpaceCheckReport& report, FILE* out);
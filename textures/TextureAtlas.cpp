@@ -0,0 +1,445 @@
+#include "pch.h"
+#include "TextureAtlas.h"
+#include "AssetWarmup.h"
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	uint32_t NextPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	uint32_t RoundUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool CanPack(const TextureData& texture, const AtlasSettings& settings)
+	{
+		return texture.DDSFile.empty() && texture.Width > 0 && texture.Height > 0
+			&& texture.Width <= settings.MaxTextureSize && texture.Height <= settings.MaxTextureSize;
+	}
+
+	// Copies the top level of the texture to (x, y) of the slice and fills the rest of
+	// the rectangle [left, right) x [top, bottom) with the nearest edge texels
+	void CopyWithClampedBorder(const TextureData& texture, TextureData& slice, uint32_t x, uint32_t y,
+		uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+	{
+		const size_t rowBytes = size_t(texture.Width) * 4;
+		for (uint32_t row = top; row < bottom; ++row)
+		{
+			const uint32_t srcRow = row < y ? 0 : (std::min)(row - y, texture.Height - 1);
+			const uint8_t* src = texture.Pixels.data() + srcRow * rowBytes;
+			uint8_t* dst = slice.Pixels.data() + (size_t(row) * slice.Width) * 4;
+			for (uint32_t col = left; col < x; ++col)
+			{
+				memcpy(dst + col * 4, src, 4);
+			}
+			memcpy(dst + x * 4, src, rowBytes);
+			for (uint32_t col = x + texture.Width; col < right; ++col)
+			{
+				memcpy(dst + col * 4, src + rowBytes - 4, 4);
+			}
+		}
+	}
+
+	void AppendSlice(AtlasArray& array, TextureData& slice, const MipSettings& settings, uint32_t mipLevels)
+	{
+		GenerateMips(slice, settings);
+		slice.Pixels.resize(GetMipOffset(slice.Width, slice.Height, mipLevels));
+		array.Pixels.insert(array.Pixels.end(), slice.Pixels.begin(), slice.Pixels.end());
+		++array.ArraySize;
+	}
+
+	TextureData CreateSlice(uint32_t width, uint32_t height)
+	{
+		TextureData slice;
+		slice.Width = width;
+		slice.Height = height;
+		slice.Pixels.resize(size_t(width) * height * 4);
+		return slice;
+	}
+
+	void PackSkyline(const std::vector<const TextureData*>& textures, const AtlasSettings& settings, TextureAtlas& atlas)
+	{
+		const uint32_t mipLevels = (std::max)(1u, (std::min)(settings.MipLevels, GetMipLevelCount(settings.PageSize, settings.PageSize)));
+		const uint32_t gutter = 1u << (mipLevels - 1);
+
+		// Tallest first keeps the skyline flat
+		std::vector<size_t> order;
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			if (CanPack(*textures[i], settings) && RoundUp(textures[i]->Width, gutter) + 2 * gutter <= settings.PageSize
+				&& RoundUp(textures[i]->Height, gutter) + 2 * gutter <= settings.PageSize)
+			{
+				order.push_back(i);
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+		{
+			return textures[a]->Height != textures[b]->Height
+				? textures[a]->Height > textures[b]->Height
+				: textures[a]->Width > textures[b]->Width;
+		});
+
+		const auto paddedSize = [&](uint32_t size) { return RoundUp(size, gutter) + 2 * gutter; };
+
+		// A single page is as small as it can be, halving either side while everything still
+		// fits and the levels of the array do
+		uint32_t pageWidth = settings.PageSize;
+		uint32_t pageHeight = settings.PageSize;
+		const auto fitsOnePage = [&](uint32_t width, uint32_t height)
+		{
+			if (GetMipLevelCount(width, height) < mipLevels)
+			{
+				return false;
+			}
+			SkylinePacker packer(width, height);
+			uint32_t x;
+			uint32_t y;
+			for (size_t i : order)
+			{
+				if (!packer.Insert(paddedSize(textures[i]->Width), paddedSize(textures[i]->Height), x, y))
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		while (!order.empty())
+		{
+			if (pageHeight >= pageWidth && fitsOnePage(pageWidth, pageHeight / 2))
+			{
+				pageHeight /= 2;
+			}
+			else if (fitsOnePage(pageWidth / 2, pageHeight))
+			{
+				pageWidth /= 2;
+			}
+			else if (pageHeight < pageWidth && fitsOnePage(pageWidth, pageHeight / 2))
+			{
+				pageHeight /= 2;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		std::vector<SkylinePacker> packers;
+		std::vector<TextureData> pages;
+		for (size_t i : order)
+		{
+			const TextureData& texture = *textures[i];
+			const uint32_t width = paddedSize(texture.Width);
+			const uint32_t height = paddedSize(texture.Height);
+
+			uint32_t x = 0;
+			uint32_t y = 0;
+			size_t page = 0;
+			while (page < packers.size() && !packers[page].Insert(width, height, x, y))
+			{
+				++page;
+			}
+			if (page == packers.size())
+			{
+				packers.emplace_back(pageWidth, pageHeight);
+				pages.push_back(CreateSlice(pageWidth, pageHeight));
+				packers.back().Insert(width, height, x, y);
+			}
+
+			CopyWithClampedBorder(texture, pages[page], x + gutter, y + gutter, x, y, x + width, y + height);
+			AtlasPlacement& placement = atlas.Placements[i];
+			placement.Packed = true;
+			placement.Array = 0;
+			placement.Slice = static_cast<uint32_t>(page);
+			placement.Scale = DirectX::XMFLOAT2(float(texture.Width) / pageWidth, float(texture.Height) / pageHeight);
+			placement.Offset = DirectX::XMFLOAT2(float(x + gutter) / pageWidth, float(y + gutter) / pageHeight);
+			atlas.Stats.PaddedTexels += uint64_t(width) * height;
+		}
+		if (pages.empty())
+		{
+			return;
+		}
+
+		// Aligned 2x2 boxes never reach across a gutter, wider filters would
+		MipSettings mipSettings;
+		mipSettings.Filter = MIP_FILTER_BOX;
+		mipSettings.Wrap = false;
+		AtlasArray array = { pageWidth, pageHeight, mipLevels, 0, {} };
+		for (TextureData& page : pages)
+		{
+			AppendSlice(array, page, mipSettings, mipLevels);
+		}
+		atlas.Arrays.push_back(std::move(array));
+	}
+
+	void PackArrays(const std::vector<const TextureData*>& textures, const AtlasSettings& settings, TextureAtlas& atlas)
+	{
+		std::map<std::pair<uint32_t, uint32_t>, std::vector<size_t>> sizeClasses;
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			if (CanPack(*textures[i], settings))
+			{
+				sizeClasses[{ NextPowerOfTwo(textures[i]->Width), NextPowerOfTwo(textures[i]->Height) }].push_back(i);
+			}
+		}
+
+		for (const auto& sizeClass : sizeClasses)
+		{
+			const uint32_t width = sizeClass.first.first;
+			const uint32_t height = sizeClass.first.second;
+			const uint32_t mipLevels = GetMipLevelCount(width, height);
+			for (size_t i : sizeClass.second)
+			{
+				if (atlas.Arrays.empty() || atlas.Arrays.back().Width != width || atlas.Arrays.back().Height != height
+					|| atlas.Arrays.back().ArraySize == D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+				{
+					atlas.Arrays.push_back({ width, height, mipLevels, 0, {} });
+				}
+				AtlasArray& array = atlas.Arrays.back();
+
+				// Slices don't share texels, only the padding of a smaller texture can't wrap
+				const TextureData& texture = *textures[i];
+				TextureData slice = CreateSlice(width, height);
+				CopyWithClampedBorder(texture, slice, 0, 0, 0, 0, width, height);
+				MipSettings mipSettings;
+				mipSettings.Wrap = texture.Width == width && texture.Height == height;
+
+				AtlasPlacement& placement = atlas.Placements[i];
+				placement.Packed = true;
+				placement.Array = static_cast<uint32_t>(atlas.Arrays.size() - 1);
+				placement.Slice = array.ArraySize;
+				placement.Scale = DirectX::XMFLOAT2(float(texture.Width) / width, float(texture.Height) / height);
+				placement.Offset = DirectX::XMFLOAT2(0.0f, 0.0f);
+				atlas.Stats.PaddedTexels += uint64_t(width) * height;
+				AppendSlice(array, slice, mipSettings, mipLevels);
+			}
+		}
+	}
+}
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height):
+	m_width(width),
+	m_height(height),
+	m_usedArea(0),
+	m_skyline{ { 0, 0, width } }
+{
+}
+
+bool SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+{
+	// Lowest top edge wins, then the narrowest segment to leave the wide ones
+	size_t best = m_skyline.size();
+	uint32_t bestTop = UINT32_MAX;
+	uint32_t bestWidth = UINT32_MAX;
+	uint32_t bestY = 0;
+	for (size_t i = 0; i < m_skyline.size(); ++i)
+	{
+		if (m_skyline[i].X + width > m_width)
+		{
+			break;
+		}
+		uint32_t top = 0;
+		uint32_t covered = 0;
+		for (size_t j = i; covered < width; ++j)
+		{
+			top = (std::max)(top, m_skyline[j].Y);
+			covered += m_skyline[j].Width;
+		}
+		if (top + height <= m_height
+			&& (top + height < bestTop || (top + height == bestTop && m_skyline[i].Width < bestWidth)))
+		{
+			best = i;
+			bestTop = top + height;
+			bestWidth = m_skyline[i].Width;
+			bestY = top;
+		}
+	}
+	if (best == m_skyline.size())
+	{
+		return false;
+	}
+
+	x = m_skyline[best].X;
+	y = bestY;
+	m_usedArea += uint64_t(width) * height;
+
+	// The new segment replaces what it covers, the last one covered is cut short
+	const Segment placed = { x, bestTop, width };
+	size_t next = best;
+	while (next < m_skyline.size() && m_skyline[next].X + m_skyline[next].Width <= x + width)
+	{
+		++next;
+	}
+	if (next < m_skyline.size() && m_skyline[next].X < x + width)
+	{
+		m_skyline[next].Width -= x + width - m_skyline[next].X;
+		m_skyline[next].X = x + width;
+	}
+	m_skyline.erase(m_skyline.begin() + best, m_skyline.begin() + next);
+	m_skyline.insert(m_skyline.begin() + best, placed);
+
+	// Neighbours at the same height are one segment
+	for (size_t i = 0; i + 1 < m_skyline.size();)
+	{
+		if (m_skyline[i].Y == m_skyline[i + 1].Y)
+		{
+			m_skyline[i].Width += m_skyline[i + 1].Width;
+			m_skyline.erase(m_skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	return true;
+}
+
+uint64_t SkylinePacker::GetUsedArea() const
+{
+	return m_usedArea;
+}
+
+TextureAtlas BuildTextureAtlas(const std::vector<const TextureData*>& textures, AtlasLayout layout, const AtlasSettings& settings)
+{
+	TextureAtlas atlas = {};
+	atlas.Layout = layout;
+	atlas.Placements.resize(textures.size(), { false, 0, 0, DirectX::XMFLOAT2(1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) });
+	if (layout == ATLAS_LAYOUT_SKYLINE)
+	{
+		PackSkyline(textures, settings, atlas);
+	}
+	else
+	{
+		PackArrays(textures, settings, atlas);
+	}
+
+	AtlasStats& stats = atlas.Stats;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		if (atlas.Placements[i].Packed)
+		{
+			++stats.PackedTextures;
+			stats.SourceTexels += uint64_t(textures[i]->Width) * textures[i]->Height;
+		}
+		else
+		{
+			++stats.UnpackedTextures;
+		}
+	}
+	for (const AtlasArray& array : atlas.Arrays)
+	{
+		stats.Slices += array.ArraySize;
+		stats.AllocatedTexels += uint64_t(array.Width) * array.Height * array.ArraySize;
+	}
+	stats.Arrays = atlas.Arrays.size();
+	stats.Efficiency = stats.AllocatedTexels > 0 ? double(stats.SourceTexels) / stats.AllocatedTexels : 0.0;
+	stats.BindsBefore = textures.size();
+	stats.BindsAfter = stats.Arrays + stats.UnpackedTextures;
+	return atlas;
+}
+
+void CreateTextureArray(ID3D11Device* device, const AtlasArray& array, ID3D11Resource** texture,
+	ID3D11ShaderResourceView** textureView)
+{
+	D3D11_TEXTURE2D_DESC txtDesc = {};
+	txtDesc.Width = array.Width;
+	txtDesc.Height = array.Height;
+	txtDesc.MipLevels = array.MipLevels;
+	txtDesc.ArraySize = array.ArraySize;
+	txtDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	txtDesc.SampleDesc.Count = 1;
+	txtDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	txtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	// Subresources go level by level within a slice, as the slices are laid out
+	const size_t sliceBytes = GetMipOffset(array.Width, array.Height, array.MipLevels);
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(size_t(array.MipLevels) * array.ArraySize);
+	for (uint32_t slice = 0; slice < array.ArraySize; ++slice)
+	{
+		for (uint32_t level = 0; level < array.MipLevels; ++level)
+		{
+			D3D11_SUBRESOURCE_DATA& data = initData[size_t(slice) * array.MipLevels + level];
+			data.pSysMem = array.Pixels.data() + slice * sliceBytes + GetMipOffset(array.Width, array.Height, level);
+			data.SysMemPitch = (std::max)(1u, array.Width >> level) * 4;
+			data.SysMemSlicePitch = 0;
+		}
+	}
+
+	ID3D11Texture2D* texture2D = nullptr;
+	DX::ThrowIfFailed(device->CreateTexture2D(&txtDesc, initData.data(), &texture2D));
+	*texture = texture2D;
+	DX::ThrowIfFailed(device->CreateShaderResourceView(*texture, nullptr, textureView));
+}
+
+AtlasReport MeasureTextureAtlas(const std::string& directory, const AtlasSettings& settings, const AssetCache& cache)
+{
+	AtlasReport report = {};
+	std::vector<TextureData> textures;
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind != WARMUP_TEXTURE)
+		{
+			continue;
+		}
+		TextureData texture;
+		if (!LoadTextureData(asset.Path, texture, cache))
+		{
+			std::cerr << "ERROR: Failed to open texture " << asset.Path << std::endl;
+			++report.Failed;
+			continue;
+		}
+		report.Paths.push_back(asset.Path);
+		textures.push_back(std::move(texture));
+	}
+
+	std::vector<const TextureData*> sources;
+	for (const TextureData& texture : textures)
+	{
+		sources.push_back(&texture);
+	}
+	Clock::time_point start = Clock::now();
+	report.Skyline = BuildTextureAtlas(sources, ATLAS_LAYOUT_SKYLINE, settings).Stats;
+	report.SkylineMs = MillisecondsSince(start);
+	start = Clock::now();
+	report.Array = BuildTextureAtlas(sources, ATLAS_LAYOUT_ARRAY, settings).Stats;
+	report.ArrayMs = MillisecondsSince(start);
+	return report;
+}
+
+void PrintAtlasReport(const AtlasReport& report, FILE* out)
+{
+	fprintf(out, "%zu textures, %zu failed to load\n", report.Paths.size(), report.Failed);
+	fprintf(out, "%-8s %7s %9s %7s %7s %12s %12s %12s %10s %7s %10s\n", "layout", "packed", "unpacked", "arrays",
+		"slices", "texels", "padded", "allocated", "efficiency", "binds", "build ms");
+	const auto print = [&](const char* name, const AtlasStats& stats, double ms)
+	{
+		fprintf(out, "%-8s %7zu %9zu %7zu %7zu %12llu %12llu %12llu %9.1f%% %3zu/%-3zu %10.1f\n", name,
+			stats.PackedTextures, stats.UnpackedTextures, stats.Arrays, stats.Slices,
+			static_cast<unsigned long long>(stats.SourceTexels), static_cast<unsigned long long>(stats.PaddedTexels),
+			static_cast<unsigned long long>(stats.AllocatedTexels), stats.Efficiency * 100.0,
+			stats.BindsAfter, stats.BindsBefore, ms);
+	};
+	print("skyline", report.Skyline, report.SkylineMs);
+	print("array", report.Array, report.ArrayMs);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "AssetCache.h"
+#include "TextureCache.h"
+
+#include <DirectXMath.h>
+#include <d3d11.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum AtlasLayout
+{
+	// pages of PageSize, textures packed bottom-left on a skyline with a gutter of
+	// clamped edge texels that keeps the levels of neighbours apart
+	ATLAS_LAYOUT_SKYLINE,
+	// one array per power of two size class, a texture per slice, smaller textures
+	// padded out to the class with their edge texels
+	ATLAS_LAYOUT_ARRAY
+};
+
+struct AtlasSettings
+{
+	// side of a skyline page, a power of two. When everything fits on one page its sides
+	// shrink to the smallest powers of two that hold it.
+	uint32_t	PageSize = 2048;
+	// textures larger than this on either side are left as they are
+	uint32_t	MaxTextureSize = 512;
+	// levels of a skyline page. Textures are placed on multiples of 2^(MipLevels-1)
+	// texels with that many texels of gutter around them, so that box filtered levels
+	// never mix neighbours and the coarsest still has a texel of gutter. Array slices
+	// get the full chain of their size class.
+	uint32_t	MipLevels = 4;
+};
+
+// Where a texture ended up: uv * Scale + Offset in slice Slice of array Array, for
+// UVs in [0, 1]. Wrapped UVs have to be frac()'ed first, in the shader.
+struct AtlasPlacement
+{
+	// false for textures left as they are: block compressed or too large
+	bool				Packed;
+	uint32_t			Array;
+	uint32_t			Slice;
+	DirectX::XMFLOAT2	Scale;
+	DirectX::XMFLOAT2	Offset;
+};
+
+// BGRA8 sRGB texture array, the slices one after another, each with its mip chain
+// laid out as GetMipOffset has it
+struct AtlasArray
+{
+	uint32_t				Width;
+	uint32_t				Height;
+	uint32_t				MipLevels;
+	uint32_t				ArraySize;
+	std::vector<uint8_t>	Pixels;
+};
+
+struct AtlasStats
+{
+	size_t		PackedTextures;
+	size_t		UnpackedTextures;
+	size_t		Arrays;
+	size_t		Slices;
+	// top level texels of the packed textures, of them and their gutters and of the
+	// slices holding them. Efficiency is the first over the last.
+	uint64_t	SourceTexels;
+	uint64_t	PaddedTexels;
+	uint64_t	AllocatedTexels;
+	double		Efficiency;
+	// shader resource binds to draw with every texture once, sorted by what is bound:
+	// a bind per texture before, a bind per array and unpacked texture after
+	size_t		BindsBefore;
+	size_t		BindsAfter;
+};
+
+struct TextureAtlas
+{
+	AtlasLayout					Layout;
+	std::vector<AtlasArray>		Arrays;
+	// one per texture given to BuildTextureAtlas, in the same order
+	std::vector<AtlasPlacement>	Placements;
+	AtlasStats					Stats;
+};
+
+// Places rectangles on a page by keeping the top edge of what is placed so far as a
+// list of horizontal segments, each rectangle goes where it leaves that edge lowest
+class SkylinePacker
+{
+public:
+	SkylinePacker(uint32_t width, uint32_t height);
+
+	// False when the rectangle doesn't fit anywhere
+	bool Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+	uint64_t GetUsedArea() const;
+
+private:
+	struct Segment
+	{
+		uint32_t	X;
+		uint32_t	Y;
+		uint32_t	Width;
+	};
+
+	uint32_t				m_width;
+	uint32_t				m_height;
+	uint64_t				m_usedArea;
+	std::vector<Segment>	m_skyline;
+};
+
+// Packs the top level of the small, uncompressed textures into texture arrays and
+// generates the levels of every slice. Block compressed textures and those larger
+// than MaxTextureSize are left for their own binds.
+TextureAtlas BuildTextureAtlas(const std::vector<const TextureData*>& textures, AtlasLayout layout,
+	const AtlasSettings& settings);
+
+// Texture2DArray of every slice and level
+void CreateTextureArray(ID3D11Device* device, const AtlasArray& array, ID3D11Resource** texture,
+	ID3D11ShaderResourceView** textureView);
+
+struct AtlasReport
+{
+	std::vector<std::string>	Paths;
+	// textures that failed to load, not packed
+	size_t						Failed;
+	AtlasStats					Skyline;
+	AtlasStats					Array;
+	double						SkylineMs;
+	double						ArrayMs;
+};
+
+// Packs every texture in the directory, not recursing, both ways and measures them
+AtlasReport MeasureTextureAtlas(const std::string& directory, const AtlasSettings& settings, const AssetCache& cache);
+
+void PrintAtlasReport(const AtlasReport& report, FILE* out);
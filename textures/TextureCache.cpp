@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include "BlockCompression.h"
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "Model.h"
+
+#include <iostream>
+
+namespace
+{
+	bool ReadTextureFile(const std::string& cachePath, const AssetKey& key, TextureData& texture)
+	{
+		const MappedFile file(cachePath);
+		if (!file.IsOpen() || file.GetSize() < sizeof(TextureFileHeader))
+		{
+			return false;
+		}
+
+		TextureFileHeader header;
+		memcpy(&header, file.GetData(), sizeof(header));
+		if (header.Magic != TEXTURE_FILE_MAGIC
+			|| header.Version != TEXTURE_FILE_VERSION
+			|| header.SourceHash != key.SourceHash
+			|| header.SettingsHash != key.SettingsHash
+			|| header.Width == 0 || header.Height == 0
+			|| header.MipLevels == 0 || header.MipLevels > GetMipLevelCount(header.Width, header.Height)
+			|| header.PixelSize != GetMipOffset(header.Width, header.Height, header.MipLevels)
+			|| header.PixelOffset + header.PixelSize > file.GetSize())
+		{
+			return false;
+		}
+
+		const uint8_t* pixels = reinterpret_cast<const uint8_t*>(file.GetData() + header.PixelOffset);
+		texture.Width = header.Width;
+		texture.Height = header.Height;
+		texture.MipLevels = header.MipLevels;
+		texture.Pixels.assign(pixels, pixels + header.PixelSize);
+		return true;
+	}
+
+	bool WriteTextureFile(const AssetCache& cache, const std::string& cachePath, const AssetKey& key, const TextureData& texture)
+	{
+		TextureFileHeader header = {};
+		header.Magic = TEXTURE_FILE_MAGIC;
+		header.Version = TEXTURE_FILE_VERSION;
+		header.SourceHash = key.SourceHash;
+		header.SettingsHash = key.SettingsHash;
+		header.Width = texture.Width;
+		header.Height = texture.Height;
+		header.MipLevels = texture.MipLevels;
+		header.PixelOffset = sizeof(TextureFileHeader);
+		header.PixelSize = texture.Pixels.size();
+
+		std::vector<uint8_t> file(sizeof(TextureFileHeader) + texture.Pixels.size());
+		memcpy(file.data(), &header, sizeof(header));
+		std::copy(texture.Pixels.begin(), texture.Pixels.end(), file.begin() + header.PixelOffset);
+		return cache.WriteArtifact(cachePath, file.data(), file.size());
+	}
+
+	bool ReadCompressedTexture(const std::string& filepath, TextureData& texture)
+	{
+		const std::string ddsPath = GetCompressedTexturePath(filepath);
+		SourceStamp compressed;
+		SourceStamp source;
+		if (!GetSourceStamp(ddsPath, compressed)
+			|| (GetSourceStamp(filepath, source) && source.WriteTime > compressed.WriteTime))
+		{
+			return false;
+		}
+
+		const MappedFile file(ddsPath);
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(file.GetData());
+		if (!file.IsOpen() || !ReadDDSDescription(data, file.GetSize(), texture.Width, texture.Height, texture.MipLevels))
+		{
+			std::cerr << "WARNING: Ignoring unreadable " << ddsPath << std::endl;
+			return false;
+		}
+		texture.DDSFile.assign(data, data + file.GetSize());
+		texture.Pixels.clear();
+		return true;
+	}
+}
+
+std::string GetCompressedTexturePath(const std::string& filepath)
+{
+	const size_t dot = filepath.find_last_of('.');
+	const size_t slash = filepath.find_last_of("/\\");
+	const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+	return (hasExtension ? filepath.substr(0, dot) : filepath) + ".dds";
+}
+
+uint64_t GetTextureSettingsHash()
+{
+	const MipSettings mips;
+	const uint32_t settings[] = { TEXTURE_FILE_VERSION, static_cast<uint32_t>(mips.Filter), mips.SRGB, mips.Wrap };
+	return HashSettings(settings, sizeof(settings));
+}
+
+bool DecodeTextureData(const std::string& filepath, TextureData& texture, const AssetCache& cache)
+{
+	AssetKey key = { 0, GetTextureSettingsHash() };
+	if (!cache.HashSource(filepath, key.SourceHash))
+	{
+		return false;
+	}
+
+	const std::string cachePath = cache.GetArtifactPath(key, "texture");
+	if (ReadTextureFile(cachePath, key, texture))
+	{
+		cache.Touch(cachePath);
+		return true;
+	}
+
+	texture.Pixels = LoadBGRAImage(filepath, texture.Width, texture.Height);
+	texture.MipLevels = 1;
+	GenerateMips(texture, MipSettings());
+	if (!WriteTextureFile(cache, cachePath, key, texture))
+	{
+		std::cerr << "WARNING: Failed to write texture cache " << cachePath << std::endl;
+	}
+	return true;
+}
+
+bool LoadTextureData(const std::string& filepath, TextureData& texture, const AssetCache& cache)
+{
+	return ReadCompressedTexture(filepath, texture) || DecodeTextureData(filepath, texture, cache);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AssetCache.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of a cached texture:
+//     TextureFileHeader | uint8_t[PixelSize]
+// Pixels are the MipLevels levels of the chain one after another, each tightly packed
+// BGRA8 rows, the format LoadBGRAImage produces.
+// Bump TEXTURE_FILE_VERSION whenever the layout or the decode changes.
+constexpr uint32_t TEXTURE_FILE_MAGIC = 0x54584554; // "TEXT"
+constexpr uint32_t TEXTURE_FILE_VERSION = 3;
+
+struct TextureFileHeader
+{
+	uint32_t	Magic;
+	uint32_t	Version;
+	// cache key
+	uint64_t	SourceHash;
+	uint64_t	SettingsHash;
+	// payload
+	uint32_t	Width;
+	uint32_t	Height;
+	uint32_t	MipLevels;
+	uint32_t	Reserved;
+	uint64_t	PixelOffset;
+	uint64_t	PixelSize;
+};
+
+// Decoded texture, tightly packed BGRA8 rows in sRGB, the MipLevels levels of the chain
+// one after another (see GetMipOffset)
+struct TextureData
+{
+	uint32_t				Width = 0;
+	uint32_t				Height = 0;
+	uint32_t				MipLevels = 1;
+	std::vector<uint8_t>	Pixels;
+	// Whole .dds file of a block compressed texture when one was loaded instead, then
+	// Pixels is empty and the GPU texture comes from DDSTextureLoader
+	std::vector<uint8_t>	DDSFile;
+};
+
+// Settings part of the cache key of a texture
+uint64_t GetTextureSettingsHash();
+
+// Where the offline compression stage writes the block compressed version of a
+// texture, the source path with a .dds extension
+std::string GetCompressedTexturePath(const std::string& filepath);
+
+// Decodes the image file, from the cache when it holds the texture for the current
+// content and settings, otherwise with LoadBGRAImage plus GenerateMips and then stored
+// in the cache. False when the file can't be read, decode errors throw like LoadBGRAImage.
+bool DecodeTextureData(const std::string& filepath, TextureData& texture,
+	const AssetCache& cache = AssetCache::GetDefault());
+
+// The compressed .dds next to the image file when there is one at least as new as the
+// image, otherwise DecodeTextureData
+bool LoadTextureData(const std::string& filepath, TextureData& texture,
+	const AssetCache& cache = AssetCache::GetDefault());
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "TextureCompressor.h"
+#include "AssetWarmup.h"
+#include "MipGenerator.h"
+#include "Model.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+	const char* const NORMAL_MAP_SUFFIXES[] = { "_n", "_nrm", "_normal" };
+
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool IsNormalMap(const std::string& filepath)
+	{
+		// the suffix is checked on the path without its extension
+		const size_t dot = filepath.find_last_of('.');
+		const std::string name = dot != std::string::npos ? filepath.substr(0, dot) : filepath;
+		for (const char* suffix : NORMAL_MAP_SUFFIXES)
+		{
+			if (HasExtension(name, suffix))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool HasAlpha(const TextureData& texture)
+	{
+		const size_t texels = size_t(texture.Width) * texture.Height;
+		for (size_t i = 0; i < texels; ++i)
+		{
+			if (texture.Pixels[i * 4 + 3] != 255)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool CompressFile(CompressionResult& result, bool highQuality, const AssetCache& cache, unsigned int numThreads)
+	{
+		TextureData texture;
+		if (!DecodeTextureData(result.Path, texture, cache))
+		{
+			std::cerr << "ERROR: Failed to open texture " << result.Path << std::endl;
+			return false;
+		}
+		if (!CanBlockCompress(texture.Width, texture.Height))
+		{
+			std::cerr << "ERROR: " << result.Path << " is " << texture.Width << "x" << texture.Height
+				<< ", block compression needs multiples of 4" << std::endl;
+			return false;
+		}
+
+		result.Format = ChooseBlockFormat(result.Path, texture, highQuality);
+		if (result.Format == BLOCK_FORMAT_BC5)
+		{
+			// vectors are not sRGB, filter them again as plain numbers
+			texture.Pixels.resize(size_t(texture.Width) * texture.Height * 4);
+			texture.MipLevels = 1;
+			MipSettings settings;
+			settings.SRGB = false;
+			GenerateMips(texture, settings, numThreads);
+		}
+
+		const Clock::time_point start = Clock::now();
+		const CompressedTexture compressed = CompressTexture(texture, result.Format, numThreads);
+		result.EncodeMs = MillisecondsSince(start);
+		result.Megapixels = texture.Pixels.size() / 4 / 1e6;
+		result.UncompressedBytes = texture.Pixels.size();
+		result.CompressedBytes = compressed.Blocks.size();
+		result.PSNR = ComputePSNR(texture, DecompressTexture(compressed), result.Format);
+
+		const std::vector<uint8_t> file = BuildDDSFile(compressed);
+		const std::string ddsPath = GetCompressedTexturePath(result.Path);
+		if (!cache.WriteArtifact(ddsPath, file.data(), file.size()))
+		{
+			std::cerr << "ERROR: Failed to write " << ddsPath << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+BlockFormat ChooseBlockFormat(const std::string& filepath, const TextureData& texture, bool highQuality)
+{
+	if (IsNormalMap(filepath))
+	{
+		return BLOCK_FORMAT_BC5;
+	}
+	if (highQuality)
+	{
+		return BLOCK_FORMAT_BC7;
+	}
+	return HasAlpha(texture) ? BLOCK_FORMAT_BC3 : BLOCK_FORMAT_BC1;
+}
+
+CompressionReport CompressTextures(const std::string& directory, bool highQuality, const AssetCache& cache, unsigned int numThreads)
+{
+	CompressionReport report = {};
+	report.NumThreads = numThreads > 0 ? numThreads : DefaultThreadCount();
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind == WARMUP_TEXTURE)
+		{
+			report.Textures.push_back({ asset.Path, BLOCK_FORMAT_BC1, false, 0.0, 0.0, 0.0, 0, 0 });
+		}
+	}
+
+	// Each texture is parallel on its own, the blocks are plenty of work
+	for (CompressionResult& texture : report.Textures)
+	{
+		try
+		{
+			texture.Succeeded = CompressFile(texture, highQuality, cache, report.NumThreads);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << texture.Path << ": " << e.what() << std::endl;
+		}
+		report.EncodeMs += texture.EncodeMs;
+	}
+	return report;
+}
+
+void PrintCompressionReport(const CompressionReport& report, FILE* out)
+{
+	fprintf(out, "%-40s %-6s %8s %10s %8s %8s %7s\n", "texture", "format", "MP", "encode ms", "MP/s", "PSNR dB", "ratio");
+	double megapixels = 0.0;
+	for (const CompressionResult& texture : report.Textures)
+	{
+		if (!texture.Succeeded)
+		{
+			fprintf(out, "%-40s %-6s %8s\n", texture.Path.c_str(), "", "FAILED");
+			continue;
+		}
+		megapixels += texture.Megapixels;
+		fprintf(out, "%-40s %-6s %8.2f %10.1f %8.2f %8.2f %6.1fx\n", texture.Path.c_str(), GetBlockFormatName(texture.Format),
+			texture.Megapixels, texture.EncodeMs, texture.EncodeMs > 0.0 ? texture.Megapixels / (texture.EncodeMs / 1000.0) : 0.0,
+			texture.PSNR, texture.CompressedBytes > 0 ? double(texture.UncompressedBytes) / texture.CompressedBytes : 0.0);
+	}
+	fprintf(out, "%zu textures on %u threads: %.2f MP in %.1f ms, %.2f MP/s\n", report.Textures.size(), report.NumThreads,
+		megapixels, report.EncodeMs, report.EncodeMs > 0.0 ? megapixels / (report.EncodeMs / 1000.0) : 0.0);
+}
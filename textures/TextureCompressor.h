@@ -0,0 +1,42 @@
+#pragma once
+
+#include "AssetCache.h"
+#include "BlockCompression.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct CompressionResult
+{
+	std::string	Path;
+	BlockFormat	Format;
+	bool		Succeeded;
+	// megapixels of the whole mip chain
+	double		Megapixels;
+	double		EncodeMs;
+	// of the top level, see ComputePSNR
+	double		PSNR;
+	uint64_t	UncompressedBytes;
+	uint64_t	CompressedBytes;
+};
+
+struct CompressionReport
+{
+	std::vector<CompressionResult>	Textures;
+	unsigned int					NumThreads;
+	double							EncodeMs;
+};
+
+// Normal maps, named with a _n, _nrm or _normal suffix, get BC5. Other textures get BC7
+// when highQuality is set, otherwise BC1, or BC3 when some texel isn't opaque.
+BlockFormat ChooseBlockFormat(const std::string& filepath, const TextureData& texture, bool highQuality);
+
+// Writes the block compressed version of every texture in the directory, not recursing,
+// next to it (see GetCompressedTexturePath) for LoadTextureData to pick up. Textures are
+// encoded one after another on numThreads threads each (0 uses every core). Textures
+// whose size isn't a multiple of 4 can't be block compressed and fail.
+CompressionReport CompressTextures(const std::string& directory, bool highQuality,
+	const AssetCache& cache, unsigned int numThreads = 0);
+
+void PrintCompressionReport(const CompressionReport& report, FILE* out);
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <iostream>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+	uint32_t FindTailLevel(const TextureData& texture)
+	{
+		uint32_t level = 0;
+		while (level + 1 < texture.MipLevels
+			&& (std::max)(texture.Width >> level, texture.Height >> level) > STREAMING_MIP_TAIL_SIZE)
+		{
+			++level;
+		}
+		return level;
+	}
+}
+
+TextureStreamer::TextureStreamer(IUploadDevice& device, const StreamingSettings& settings):
+	m_device(device),
+	m_settings(settings),
+	m_residentBytes(0)
+{
+}
+
+StreamedTextureId TextureStreamer::AddTexture(TextureData&& texture)
+{
+	StreamedTexture streamed;
+	streamed.Data = std::move(texture);
+	streamed.TailLevel = streamed.Data.DDSFile.empty() ? FindTailLevel(streamed.Data) : 0;
+	streamed.ResidentLevel = streamed.TailLevel;
+	streamed.DesiredLevel = streamed.TailLevel;
+	streamed.ScreenArea = 0.0f;
+	streamed.View = m_device.CreateTexture(streamed.Data, streamed.ResidentLevel);
+
+	m_residentBytes += GetChainBytes(streamed, streamed.ResidentLevel);
+	if (m_residentBytes > m_settings.BudgetBytes)
+	{
+		std::cerr << "WARNING: Mip tails alone exceed the streaming budget" << std::endl;
+	}
+	m_textures.push_back(std::move(streamed));
+	return static_cast<StreamedTextureId>(m_textures.size() - 1);
+}
+
+void TextureStreamer::AddInstance(StreamedTextureId id, const XMFLOAT3& center, float radius, float uvScale)
+{
+	m_textures[id].Instances.push_back({ center, radius, uvScale });
+}
+
+StreamingStats TextureStreamer::Update(const StreamingView& view)
+{
+	StreamingStats stats = {};
+	UpdateDesiredLevels(view);
+
+	// Resident levels as this update leaves them, created on the GPU at the end
+	std::vector<uint32_t> resident(m_textures.size());
+	std::priority_queue<std::pair<float, StreamedTextureId>> requests;
+	for (StreamedTextureId id = 0; id < m_textures.size(); ++id)
+	{
+		const StreamedTexture& texture = m_textures[id];
+		resident[id] = texture.ResidentLevel;
+		if (texture.ResidentLevel > texture.DesiredLevel)
+		{
+			requests.push({ texture.ScreenArea, id });
+		}
+	}
+
+	// Levels no view wants are worth less than any wanted one
+	const auto usefulness = [&](StreamedTextureId id)
+	{
+		return resident[id] < m_textures[id].DesiredLevel ? -1.0f : m_textures[id].ScreenArea;
+	};
+
+	uint64_t uploadBudget = m_settings.MaxUploadBytesPerUpdate;
+	while (!requests.empty())
+	{
+		const StreamedTextureId id = requests.top().second;
+		requests.pop();
+		const StreamedTexture& texture = m_textures[id];
+		const uint32_t level = resident[id] - 1;
+		const uint64_t bytes = GetLevelBytes(texture, level);
+		if (bytes > uploadBudget && stats.LevelsStreamedIn > 0)
+		{
+			break;
+		}
+
+		// Make room from levels less useful than this one
+		while (m_residentBytes + bytes > m_settings.BudgetBytes)
+		{
+			StreamedTextureId victim = id;
+			for (StreamedTextureId other = 0; other < m_textures.size(); ++other)
+			{
+				if (other != id && resident[other] < m_textures[other].TailLevel
+					&& usefulness(other) < texture.ScreenArea
+					&& (victim == id || usefulness(other) < usefulness(victim)))
+				{
+					victim = other;
+				}
+			}
+			if (victim == id)
+			{
+				break;
+			}
+			m_residentBytes -= GetLevelBytes(m_textures[victim], resident[victim]);
+			++resident[victim];
+			++stats.LevelsEvicted;
+		}
+		if (m_residentBytes + bytes > m_settings.BudgetBytes)
+		{
+			continue;
+		}
+
+		resident[id] = level;
+		m_residentBytes += bytes;
+		uploadBudget -= (std::min)(uploadBudget, bytes);
+		++stats.LevelsStreamedIn;
+		if (level > texture.DesiredLevel)
+		{
+			requests.push({ texture.ScreenArea, id });
+		}
+	}
+
+	for (StreamedTextureId id = 0; id < m_textures.size(); ++id)
+	{
+		StreamedTexture& texture = m_textures[id];
+		if (resident[id] != texture.ResidentLevel)
+		{
+			texture.View = m_device.CreateTexture(texture.Data, resident[id]);
+			texture.ResidentLevel = resident[id];
+			stats.UploadedBytes += GetChainBytes(texture, resident[id]);
+		}
+		if (texture.ResidentLevel > texture.DesiredLevel)
+		{
+			++stats.TexturesBelowDesired;
+			stats.MissingLevels += texture.ResidentLevel - texture.DesiredLevel;
+		}
+	}
+	stats.ResidentBytes = m_residentBytes;
+	return stats;
+}
+
+void TextureStreamer::UpdateDesiredLevels(const StreamingView& view)
+{
+	const XMVECTOR position = XMLoadFloat3(&view.Position);
+	const XMVECTOR forward = XMLoadFloat3(&view.Forward);
+	const float pixelsPerUnit = view.ViewportHeight / (2.0f * std::tan(view.FovY * 0.5f));
+
+	for (StreamedTexture& texture : m_textures)
+	{
+		texture.DesiredLevel = texture.TailLevel;
+		texture.ScreenArea = 0.0f;
+		for (const Instance& instance : texture.Instances)
+		{
+			const XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&instance.Center), position);
+			const float distance = XMVectorGetX(XMVector3Length(toCenter));
+			if (XMVectorGetX(XMVector3Dot(toCenter, forward)) < -instance.Radius)
+			{
+				continue;
+			}
+
+			// Diameter on screen against the texels mapped across it
+			const float pixels = distance > instance.Radius
+				? 2.0f * instance.Radius * pixelsPerUnit / distance
+				: view.ViewportHeight;
+			const float texels = (std::max)(texture.Data.Width, texture.Data.Height) * instance.UVScale;
+			const uint32_t level = texels > pixels ? static_cast<uint32_t>(std::floor(std::log2(texels / pixels))) : 0;
+			texture.DesiredLevel = (std::min)(texture.DesiredLevel, level);
+			texture.ScreenArea += pixels * pixels * XM_PIDIV4;
+		}
+	}
+}
+
+uint64_t TextureStreamer::GetLevelBytes(const StreamedTexture& texture, uint32_t level) const
+{
+	return GetChainBytes(texture, level) - GetChainBytes(texture, level + 1);
+}
+
+uint64_t TextureStreamer::GetChainBytes(const StreamedTexture& texture, uint32_t firstLevel) const
+{
+	const TextureData& data = texture.Data;
+	if (!data.DDSFile.empty())
+	{
+		return firstLevel == 0 ? data.DDSFile.size() : 0;
+	}
+	return GetMipOffset(data.Width, data.Height, data.MipLevels) - GetMipOffset(data.Width, data.Height, (std::min)(firstLevel, data.MipLevels));
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetView(StreamedTextureId id) const
+{
+	return m_textures[id].View.Get();
+}
+
+uint32_t TextureStreamer::GetResidentLevel(StreamedTextureId id) const
+{
+	return m_textures[id].ResidentLevel;
+}
+
+uint32_t TextureStreamer::GetDesiredLevel(StreamedTextureId id) const
+{
+	return m_textures[id].DesiredLevel;
+}
+
+uint64_t TextureStreamer::GetResidentBytes() const
+{
+	return m_residentBytes;
+}
+
+size_t TextureStreamer::GetTextureCount() const
+{
+	return m_textures.size();
+}
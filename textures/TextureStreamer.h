@@ -0,0 +1,108 @@
+#pragma once
+
+#include "AssetLoader.h"
+#include "TextureCache.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Levels this large or smaller on their longer side stay resident for good
+constexpr uint32_t STREAMING_MIP_TAIL_SIZE = 64;
+
+// What the camera sees, enough to size things on screen
+struct StreamingView
+{
+	DirectX::XMFLOAT3	Position;
+	// unit length
+	DirectX::XMFLOAT3	Forward;
+	// vertical field of view in radians
+	float				FovY;
+	float				ViewportHeight;
+};
+
+struct StreamingSettings
+{
+	// GPU memory of all resident levels, mip tails included
+	uint64_t	BudgetBytes = 256ull << 20;
+	// levels streamed in per update, spreads the uploads over frames. A single level
+	// larger than this still streams in on an update of its own.
+	uint64_t	MaxUploadBytesPerUpdate = 16ull << 20;
+};
+
+struct StreamingStats
+{
+	uint64_t	ResidentBytes;
+	uint64_t	LevelsStreamedIn;
+	uint64_t	LevelsEvicted;
+	// size of the textures created again for their new levels
+	uint64_t	UploadedBytes;
+	// textures shown coarser than the view wants and the levels they miss
+	size_t		TexturesBelowDesired;
+	size_t		MissingLevels;
+};
+
+using StreamedTextureId = uint32_t;
+
+// Keeps the mip tail of every texture resident and streams the finer levels in and
+// out. Each update sizes every texture on screen from its instances: the level whose
+// texels match the screen pixels is the one it wants, the area it covers is how useful
+// its levels are. Wanted levels stream in biggest area first, one level at a time from
+// the coarse end. When they don't fit the budget, levels no view wants go first, then
+// the levels of the textures covering the least area, never for a texture covering
+// less than the evicting one. The whole chain stays in system memory, the GPU texture
+// is created again for each new resident level. Block compressed (.dds) textures are
+// resident whole.
+class TextureStreamer
+{
+public:
+	TextureStreamer(IUploadDevice& device, const StreamingSettings& settings);
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Creates the mip tail on the GPU right away
+	StreamedTextureId AddTexture(TextureData&& texture);
+	// Where the texture is seen: a bounding sphere it is mapped across uvScale times
+	void AddInstance(StreamedTextureId id, const DirectX::XMFLOAT3& center, float radius, float uvScale = 1.0f);
+
+	StreamingStats Update(const StreamingView& view);
+
+	ID3D11ShaderResourceView* GetView(StreamedTextureId id) const;
+	// Most detailed resident level
+	uint32_t GetResidentLevel(StreamedTextureId id) const;
+	// Level the last update wanted
+	uint32_t GetDesiredLevel(StreamedTextureId id) const;
+	uint64_t GetResidentBytes() const;
+	size_t GetTextureCount() const;
+
+private:
+	struct Instance
+	{
+		DirectX::XMFLOAT3	Center;
+		float				Radius;
+		float				UVScale;
+	};
+
+	struct StreamedTexture
+	{
+		TextureData											Data;
+		std::vector<Instance>								Instances;
+		uint32_t											TailLevel;
+		uint32_t											ResidentLevel;
+		uint32_t											DesiredLevel;
+		// pixels, zero when no instance is in front of the camera
+		float												ScreenArea;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	View;
+	};
+
+	void UpdateDesiredLevels(const StreamingView& view);
+	uint64_t GetLevelBytes(const StreamedTexture& texture, uint32_t level) const;
+	uint64_t GetChainBytes(const StreamedTexture& texture, uint32_t firstLevel) const;
+
+	IUploadDevice&					m_device;
+	StreamingSettings				m_settings;
+	std::vector<StreamedTexture>	m_textures;
+	uint64_t						m_residentBytes;
+};
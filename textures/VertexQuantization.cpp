@@ -0,0 +1,344 @@
+#include "pch.h"
+#include "VertexQuantization.h"
+#include "AssetWarmup.h"
+
+#include <emmintrin.h>
+#include <iostream>
+
+namespace
+{
+	constexpr float UNORM16_MAX = 65535.0f;
+	constexpr float SNORM16_MAX = 32767.0f;
+	constexpr float UNORM10_MAX = 1023.0f;
+	constexpr float RADIANS_TO_DEGREES = 57.2957795f;
+
+	__m128 Clamp(__m128 v, __m128 lo, __m128 hi)
+	{
+		return _mm_min_ps(_mm_max_ps(v, lo), hi);
+	}
+
+	__m128 Abs(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	// +1 or -1 with the sign of v, zero counts as positive
+	__m128 SignNotZero(__m128 v)
+	{
+		return _mm_or_ps(_mm_and_ps(v, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f));
+	}
+
+	// Float to half with round to nearest even, including denormals, infinities and NaNs
+	// (Fabian Giesen's branchless SSE2 conversion). The half is in the low 16 bits.
+	__m128i FloatToHalf(__m128 f)
+	{
+		const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+		const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		const __m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+		const __m128 absF = _mm_xor_ps(f, sign);
+		const __m128i absBits = _mm_castps_si128(absF);
+
+		const __m128i isRegular = _mm_cmpgt_epi32(f16Max, absBits);
+		const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+		const __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+		// the float add does the rounding of subnormals
+		const __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absBits);
+		const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+		// rebias the exponent and round the mantissa, ties go to even
+		const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+		const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+		const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+		const __m128i half = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan));
+		return _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	float HalfToFloat(uint16_t h)
+	{
+		const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+		const uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+
+		uint32_t bits;
+		if (exponent == 0x1f)
+		{
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else if (exponent != 0)
+		{
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+		else if (mantissa != 0)
+		{
+			// subnormal, normalize it
+			int e = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				--e;
+			}
+			bits = sign | (static_cast<uint32_t>(e) << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		else
+		{
+			bits = sign;
+		}
+
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	DirectX::XMFLOAT3 DecodeOctahedral(uint32_t packed)
+	{
+		const float x = (std::max)(static_cast<int16_t>(packed & 0xffff) / SNORM16_MAX, -1.0f);
+		const float y = (std::max)(static_cast<int16_t>(packed >> 16) / SNORM16_MAX, -1.0f);
+		DirectX::XMFLOAT3 n(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+		if (n.z < 0.0f)
+		{
+			n.x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			n.y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return n;
+	}
+
+	DirectX::XMFLOAT3 DecodePacked1010102(uint32_t packed)
+	{
+		return DirectX::XMFLOAT3(
+			(packed & 0x3ff) / UNORM10_MAX * 2.0f - 1.0f,
+			((packed >> 10) & 0x3ff) / UNORM10_MAX * 2.0f - 1.0f,
+			((packed >> 20) & 0x3ff) / UNORM10_MAX * 2.0f - 1.0f);
+	}
+
+	float Length(float x, float y, float z)
+	{
+		return std::sqrt(x * x + y * y + z * z);
+	}
+}
+
+QuantizationError QuantizeMesh(const MeshData& mesh, NormalEncoding normals, QuantizedMesh& quantized)
+{
+	const size_t n = mesh.GetNumVertices();
+	quantized.Normals = normals;
+	quantized.Vertices.resize(mesh.GetPaddedCount());
+	if (n == 0)
+	{
+		quantized.Vertices.clear();
+		return QuantizationError();
+	}
+
+	DirectX::XMFLOAT3 boundsMin, boundsMax;
+	mesh.ComputeBounds(boundsMin, boundsMax);
+	// flat axes keep a unit scale, every vertex encodes to zero there
+	const auto extent = [](float lo, float hi) { return hi > lo ? hi - lo : 1.0f; };
+	quantized.PositionOffset = boundsMin;
+	quantized.PositionScale = DirectX::XMFLOAT3(
+		extent(boundsMin.x, boundsMax.x) / UNORM16_MAX,
+		extent(boundsMin.y, boundsMax.y) / UNORM16_MAX,
+		extent(boundsMin.z, boundsMax.z) / UNORM16_MAX);
+
+	const float* px = mesh.GetStream(MeshData::POSITION_X);
+	const float* py = mesh.GetStream(MeshData::POSITION_Y);
+	const float* pz = mesh.GetStream(MeshData::POSITION_Z);
+	const float* nx = mesh.GetStream(MeshData::NORMAL_X);
+	const float* ny = mesh.GetStream(MeshData::NORMAL_Y);
+	const float* nz = mesh.GetStream(MeshData::NORMAL_Z);
+	const float* u = mesh.GetStream(MeshData::TEXTCOORD_U);
+	const float* v = mesh.GetStream(MeshData::TEXTCOORD_V);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 unorm16 = _mm_set1_ps(UNORM16_MAX);
+	const __m128 offsetX = _mm_set1_ps(boundsMin.x);
+	const __m128 offsetY = _mm_set1_ps(boundsMin.y);
+	const __m128 offsetZ = _mm_set1_ps(boundsMin.z);
+	const __m128 invScaleX = _mm_set1_ps(1.0f / quantized.PositionScale.x);
+	const __m128 invScaleY = _mm_set1_ps(1.0f / quantized.PositionScale.y);
+	const __m128 invScaleZ = _mm_set1_ps(1.0f / quantized.PositionScale.z);
+	const __m128i lowHalf = _mm_set1_epi32(0xffff);
+
+	// The padded stream size is a multiple of four, the padding vertices are dropped at the end
+	QuantizedVertex* out = quantized.Vertices.data();
+	for (size_t i = 0; i < mesh.GetPaddedCount(); i += 4, out += 4)
+	{
+		// position, unorm16 relative to the bounds
+		const __m128i qx = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(px + i), offsetX), invScaleX), zero, unorm16));
+		const __m128i qy = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(py + i), offsetY), invScaleY), zero, unorm16));
+		const __m128i qz = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(pz + i), offsetZ), invScaleZ), zero, unorm16));
+		const __m128i posXY = _mm_or_si128(qx, _mm_slli_epi32(qy, 16));
+
+		// normal, normalized first, zero length stays zero
+		__m128 x = _mm_load_ps(nx + i);
+		__m128 y = _mm_load_ps(ny + i);
+		__m128 z = _mm_load_ps(nz + i);
+		const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		const __m128 invLength = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(lengthSq)), _mm_cmpgt_ps(lengthSq, zero));
+		x = _mm_mul_ps(x, invLength);
+		y = _mm_mul_ps(y, invLength);
+		z = _mm_mul_ps(z, invLength);
+
+		__m128i norm;
+		if (normals == NORMAL_OCTAHEDRAL_16)
+		{
+			// project on the octahedron and fold the lower half over the diagonals
+			const __m128 l1 = _mm_max_ps(_mm_add_ps(_mm_add_ps(Abs(x), Abs(y)), Abs(z)), _mm_set1_ps(1e-20f));
+			const __m128 ox = _mm_div_ps(x, l1);
+			const __m128 oy = _mm_div_ps(y, l1);
+			const __m128 foldX = _mm_mul_ps(_mm_sub_ps(one, Abs(oy)), SignNotZero(ox));
+			const __m128 foldY = _mm_mul_ps(_mm_sub_ps(one, Abs(ox)), SignNotZero(oy));
+			const __m128 lower = _mm_cmplt_ps(z, zero);
+			const __m128 ex = _mm_or_ps(_mm_and_ps(lower, foldX), _mm_andnot_ps(lower, ox));
+			const __m128 ey = _mm_or_ps(_mm_and_ps(lower, foldY), _mm_andnot_ps(lower, oy));
+
+			const __m128 snorm16 = _mm_set1_ps(SNORM16_MAX);
+			const __m128i sx = _mm_cvtps_epi32(_mm_mul_ps(Clamp(ex, _mm_set1_ps(-1.0f), one), snorm16));
+			const __m128i sy = _mm_cvtps_epi32(_mm_mul_ps(Clamp(ey, _mm_set1_ps(-1.0f), one), snorm16));
+			norm = _mm_or_si128(_mm_and_si128(sx, lowHalf), _mm_slli_epi32(sy, 16));
+		}
+		else
+		{
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 unorm10 = _mm_set1_ps(UNORM10_MAX);
+			const __m128i ux = _mm_cvtps_epi32(_mm_mul_ps(Clamp(_mm_add_ps(_mm_mul_ps(x, half), half), zero, one), unorm10));
+			const __m128i uy = _mm_cvtps_epi32(_mm_mul_ps(Clamp(_mm_add_ps(_mm_mul_ps(y, half), half), zero, one), unorm10));
+			const __m128i uz = _mm_cvtps_epi32(_mm_mul_ps(Clamp(_mm_add_ps(_mm_mul_ps(z, half), half), zero, one), unorm10));
+			norm = _mm_or_si128(_mm_or_si128(ux, _mm_slli_epi32(uy, 10)), _mm_slli_epi32(uz, 20));
+		}
+
+		// texture coordinates, half floats
+		const __m128i tex = _mm_or_si128(
+			_mm_and_si128(FloatToHalf(_mm_load_ps(u + i)), lowHalf),
+			_mm_slli_epi32(FloatToHalf(_mm_load_ps(v + i)), 16));
+
+		// four 32-bit columns per vertex, one transpose turns them into four vertices
+		__m128 c0 = _mm_castsi128_ps(posXY);
+		__m128 c1 = _mm_castsi128_ps(qz);
+		__m128 c2 = _mm_castsi128_ps(norm);
+		__m128 c3 = _mm_castsi128_ps(tex);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(reinterpret_cast<float*>(out + 0), c0);
+		_mm_storeu_ps(reinterpret_cast<float*>(out + 1), c1);
+		_mm_storeu_ps(reinterpret_cast<float*>(out + 2), c2);
+		_mm_storeu_ps(reinterpret_cast<float*>(out + 3), c3);
+	}
+	quantized.Vertices.resize(n);
+
+	// Measure against the reference decoder
+	QuantizationError error;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const Render::Vertex decoded = DequantizeVertex(quantized, i);
+
+		error.MaxPositionError = (std::max)(error.MaxPositionError,
+			Length(decoded.Pos.x - px[i], decoded.Pos.y - py[i], decoded.Pos.z - pz[i]));
+
+		const float sourceLength = Length(nx[i], ny[i], nz[i]);
+		const float decodedLength = Length(decoded.Norm.x, decoded.Norm.y, decoded.Norm.z);
+		if (sourceLength > 0.0f && decodedLength > 0.0f)
+		{
+			const float cosAngle = (nx[i] * decoded.Norm.x + ny[i] * decoded.Norm.y + nz[i] * decoded.Norm.z) / (sourceLength * decodedLength);
+			const float angle = std::acos((std::min)((std::max)(cosAngle, -1.0f), 1.0f)) * RADIANS_TO_DEGREES;
+			error.MaxNormalAngle = (std::max)(error.MaxNormalAngle, angle);
+		}
+
+		error.MaxTextCoordError = (std::max)(error.MaxTextCoordError,
+			(std::max)(std::fabs(decoded.Tex.x - u[i]), std::fabs(decoded.Tex.y - v[i])));
+	}
+	return error;
+}
+
+Render::Vertex DequantizeVertex(const QuantizedMesh& quantized, size_t index)
+{
+	const QuantizedVertex& q = quantized.Vertices[index];
+
+	Render::Vertex vertex;
+	vertex.Pos = DirectX::XMFLOAT3(
+		quantized.PositionOffset.x + q.Pos[0] * quantized.PositionScale.x,
+		quantized.PositionOffset.y + q.Pos[1] * quantized.PositionScale.y,
+		quantized.PositionOffset.z + q.Pos[2] * quantized.PositionScale.z);
+
+	DirectX::XMFLOAT3 n = quantized.Normals == NORMAL_OCTAHEDRAL_16 ? DecodeOctahedral(q.Norm) : DecodePacked1010102(q.Norm);
+	const float length = Length(n.x, n.y, n.z);
+	if (length > 0.0f)
+	{
+		n = DirectX::XMFLOAT3(n.x / length, n.y / length, n.z / length);
+	}
+	vertex.Norm = n;
+
+	vertex.Tex = DirectX::XMFLOAT2(HalfToFloat(q.Tex[0]), HalfToFloat(q.Tex[1]));
+	return vertex;
+}
+
+const D3D11_INPUT_ELEMENT_DESC* GetQuantizedInputLayout(NormalEncoding normals)
+{
+	static constexpr D3D11_INPUT_ELEMENT_DESC s_octahedral[3] = {
+		{"SV_Position", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"TEXTCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
+	};
+	static constexpr D3D11_INPUT_ELEMENT_DESC s_packed[3] = {
+		{"SV_Position", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, DXGI_FORMAT_R10G10B10A2_UNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"TEXTCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
+	};
+	return normals == NORMAL_OCTAHEDRAL_16 ? s_octahedral : s_packed;
+}
+
+QuantizationReport MeasureMeshQuantization(const std::string& directory, const AssetCache& cache)
+{
+	QuantizationReport report;
+	for (const WarmupResult& asset : FindAssets(directory))
+	{
+		if (asset.Kind != WARMUP_MESH)
+		{
+			continue;
+		}
+		MeshQuantizationResult result = {};
+		result.Path = asset.Path;
+		const std::unique_ptr<Model> model = Model::LoadModel(asset.Path, cache);
+		result.Succeeded = model != nullptr;
+		if (!result.Succeeded)
+		{
+			std::cerr << "ERROR: Failed to load mesh " << asset.Path << std::endl;
+			report.Meshes.push_back(result);
+			continue;
+		}
+
+		const MeshData mesh = MeshData::FromModel(*model);
+		result.NumVertices = mesh.GetNumVertices();
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		mesh.ComputeBounds(boundsMin, boundsMax);
+		result.Extent = (std::max)((std::max)(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+
+		QuantizedMesh quantized;
+		result.Octahedral = QuantizeMesh(mesh, NORMAL_OCTAHEDRAL_16, quantized);
+		result.Packed = QuantizeMesh(mesh, NORMAL_PACKED_10_10_10_2, quantized);
+		report.Meshes.push_back(result);
+	}
+	return report;
+}
+
+void PrintQuantizationReport(const QuantizationReport& report, FILE* out)
+{
+	fprintf(out, "%-40s %9s %11s %12s %9s %12s %10s %10s\n", "mesh", "vertices", "KB", "position", "relative",
+		"oct 16", "10:10:10", "UV");
+	for (const MeshQuantizationResult& mesh : report.Meshes)
+	{
+		if (!mesh.Succeeded)
+		{
+			fprintf(out, "%-40s %9s\n", mesh.Path.c_str(), "FAILED");
+			continue;
+		}
+		// the position and UV errors don't depend on the normal encoding
+		fprintf(out, "%-40s %9zu %4zu->%-5zu %12.3g %9.2e %8.3f deg %6.3f deg %10.3g\n", mesh.Path.c_str(), mesh.NumVertices,
+			mesh.NumVertices * sizeof(Render::Vertex) / 1024, mesh.NumVertices * sizeof(QuantizedVertex) / 1024,
+			mesh.Octahedral.MaxPositionError, mesh.Extent > 0.0f ? mesh.Octahedral.MaxPositionError / mesh.Extent : 0.0f,
+			mesh.Octahedral.MaxNormalAngle, mesh.Packed.MaxNormalAngle, mesh.Octahedral.MaxTextCoordError);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "AssetCache.h"
+#include "MeshData.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Compact GPU vertex, half the size of Render::Vertex:
+//     position  R16G16B16A16_UNORM  relative to the mesh bounds, w is unused
+//     normal    R16G16_SNORM        octahedral, or R10G10B10A2_UNORM (n * 0.5 + 0.5)
+//     textcoord R16G16_FLOAT
+struct QuantizedVertex
+{
+	uint16_t	Pos[4];
+	uint32_t	Norm;
+	uint16_t	Tex[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex must match the quantized input layout");
+
+enum NormalEncoding
+{
+	NORMAL_OCTAHEDRAL_16,
+	NORMAL_PACKED_10_10_10_2
+};
+
+struct QuantizedMesh
+{
+	std::vector<QuantizedVertex>	Vertices;
+	NormalEncoding					Normals = NORMAL_OCTAHEDRAL_16;
+	// position = PositionOffset + unorm * PositionScale
+	DirectX::XMFLOAT3				PositionOffset = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	DirectX::XMFLOAT3				PositionScale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+};
+
+// Largest difference between the source and the decoded mesh
+struct QuantizationError
+{
+	float	MaxPositionError = 0.0f;	// distance in mesh units
+	float	MaxNormalAngle = 0.0f;		// degrees
+	float	MaxTextCoordError = 0.0f;
+};
+
+// Encodes four vertices at a time straight from the streams of mesh. Normals are
+// normalized first, zero normals are left out of the error.
+QuantizationError QuantizeMesh(const MeshData& mesh, NormalEncoding normals, QuantizedMesh& quantized);
+
+// Reference decoder, does what the vertex shader has to do with the quantized attributes
+Render::Vertex DequantizeVertex(const QuantizedMesh& quantized, size_t index);
+
+// Input layout for QuantizedVertex with the given normal encoding, three elements
+const D3D11_INPUT_ELEMENT_DESC* GetQuantizedInputLayout(NormalEncoding normals);
+
+struct MeshQuantizationResult
+{
+	std::string			Path;
+	bool				Succeeded;
+	size_t				NumVertices;
+	// largest extent of the bounds, position errors are relative to the mesh size
+	float				Extent;
+	QuantizationError	Octahedral;
+	QuantizationError	Packed;
+};
+
+struct QuantizationReport
+{
+	std::vector<MeshQuantizationResult>	Meshes;
+};
+
+// Loads every mesh in the directory, not recursing, and quantizes it with both normal
+// encodings
+QuantizationReport MeasureMeshQuantization(const std::string& directory, const AssetCache& cache);
+
+void PrintQuantizationReport(const QuantizationReport& report, FILE* out);
@@ -5,12 +5,24 @@ struct Vertex
     float2 textCoord    : TEXTCOORD;
 };
 
+// Input slot 1, the first three columns of the affine world matrix of the instance
+struct Instance
+{
+    float4 world0       : WORLD0;
+    float4 world1       : WORLD1;
+    float4 world2       : WORLD2;
+    float4 tint         : TINT;
+    uint material       : MATERIAL;
+};
+
 struct PSInput
 {
     float4 position     : SV_Position;
     float3 normal       : NORMAL;
     float2 textCoord    : TEXTCOORD;
     float3 positionW    : POSITION;
+    float4 tint         : TINT;
+    nointerpolation uint material : MATERIAL;
 };
 
 cbuffer Constants : register(b0)
@@ -20,15 +32,22 @@ cbuffer Constants : register(b0)
     float4x4 mProjection;
 };
 
-PSInput main(Vertex In)
+PSInput main(Vertex In, Instance Inst)
 {
     PSInput Out;
-    Out.normal = In.normal;
+    // placed by the instance first, then by the world matrix of the scene
+    float4 position = float4(In.position, 1.0f);
+    position = float4(dot(Inst.world0, position), dot(Inst.world1, position), dot(Inst.world2, position), 1.0f);
+    float4 normal = float4(In.normal, 0.0f);
+    normal = float4(dot(Inst.world0, normal), dot(Inst.world1, normal), dot(Inst.world2, normal), 0.0f);
+
     Out.textCoord = In.textCoord;
-    Out.position = mul(float4(In.position, 1.0f), mWorld);
+    Out.position = mul(position, mWorld);
     Out.position = mul(Out.position, mView);
     Out.position = mul(Out.position, mProjection);
-    Out.normal = mul(float4(Out.normal, 0.0f), mWorld).xyz;
-    Out.positionW = mul(float4(In.position, 1.0f), mWorld).xyz;
+    Out.normal = mul(normal, mWorld).xyz;
+    Out.positionW = mul(position, mWorld).xyz;
+    Out.tint = Inst.tint;
+    Out.material = Inst.material;
     return Out;
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Model.h"
+
+#include <vector>
+
+// How close two vertices have to be to become one. Normals and texture coordinates
+// are only compared when the stream is present and the tolerance is not negative.
+struct WeldSettings
+{
+	float	PositionTolerance = 0.0f;
+	// degrees between the normals
+	float	NormalAngle = -1.0f;
+	float	TextCoordTolerance = -1.0f;
+};
+
+struct WeldReport
+{
+	size_t	VerticesBefore = 0;
+	size_t	VerticesAfter = 0;
+	// triangles that lost an edge because two of their corners were welded
+	size_t	TrianglesRemoved = 0;
+};
+
+// What the OBJ loader welds with: positions within 1e-6 of the bounding box diagonal,
+// normals within 1 degree and texture coordinates within 1e-5
+WeldSettings GetDefaultWeldSettings(const std::vector<Position>& positions);
+
+// Old to new vertex index remap, several vertices map to the same new index when they
+// are within the tolerances of each other. Vertices are swept in slabs along the longest
+// axis of the bounds, at least PositionTolerance wide, with a hash grid over the
+// representatives of the current and previous slab only, so the extra memory is one
+// order index per vertex besides the remap, plus two slabs of grid. Every vertex joins
+// the closest earlier representative within tolerance, the result is deterministic. New
+// indices follow the order of the representatives.
+std::vector<unsigned int> BuildWeldRemap(const std::vector<Position>& positions,
+	const std::vector<Normal>& normals, const std::vector<TextCoord>& textCoords, const WeldSettings& settings);
+
+// Welds in place: faces are remapped and lose their degenerate triangles, the vertex
+// arrays are compacted to the representatives without a second copy. The remap is
+// written to remap when one is passed.
+WeldReport WeldVertices(std::vector<Position>& positions, std::vector<Normal>& normals,
+	std::vector<TextCoord>& textCoords, std::vector<Face>& faces, const WeldSettings& settings,
+	std::vector<unsigned int>* remap = nullptr);